@@ -0,0 +1,42 @@
+#include "AliasTable.h"
+
+namespace my {
+void BuildAliasTable(const std::vector<double>& weights,
+                     std::vector<AliasEntry>& table) {
+  const uint32_t count = static_cast<uint32_t>(weights.size());
+  table.resize(count);
+  if (count == 0) return;
+
+  double total = 0.0;
+  for (double w : weights) total += w;
+
+  // Scale so the average bucket holds exactly 1, then let every overfull
+  // bucket top up an underfull one until all are full.
+  std::vector<double> scaled(count);
+  std::vector<uint32_t> small;
+  std::vector<uint32_t> large;
+  for (uint32_t i = 0; i < count; i++) {
+    scaled[i] = total > 0.0 ? weights[i] * count / total : 1.0;
+    (scaled[i] < 1.0 ? small : large).push_back(i);
+  }
+
+  while (!small.empty() && !large.empty()) {
+    const uint32_t s = small.back();
+    small.pop_back();
+    const uint32_t l = large.back();
+
+    table[s].probability = static_cast<float>(scaled[s]);
+    table[s].alias = l;
+
+    scaled[l] -= 1.0 - scaled[s];
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  // Whatever is left is full up to rounding error.
+  for (uint32_t i : large) table[i] = {1.0f, i};
+  for (uint32_t i : small) table[i] = {1.0f, i};
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace my {
+// One bucket of a Walker alias table: keep the bucket's own index with
+// probability `probability`, otherwise take `alias`.
+struct AliasEntry {
+  float probability;
+  uint32_t alias;
+};
+
+// Builds the table for a discrete distribution proportional to weights
+// (Vose's method, O(n)). All-zero weights give a uniform table.
+void BuildAliasTable(const std::vector<double>& weights,
+                     std::vector<AliasEntry>& table);
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "EmissionSet.h"
+
+#include <cmath>
+
+#include "AliasTable.h"
+
+namespace my {
+namespace {
+struct Vec3d {
+  double x, y, z;
+};
+
+Vec3d Sub(Vec3d a, Vec3d b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+double Dot(Vec3d a, Vec3d b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+Vec3d Cross(Vec3d a, Vec3d b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+
+// Row vector times matrix, like mul(float4(v, w), world) in the emit kernel.
+Vec3d Transform(const float4x4& m, Vec3d v, double w) {
+  return {v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + w * m.m[3][0],
+          v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + w * m.m[3][1],
+          v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + w * m.m[3][2]};
+}
+}  // namespace
+
+void BuildEmissionSet(const float* positions, const uint32_t* indices,
+                      uint32_t indexCount, const float4x4& transform,
+                      const float velocity[3],
+                      std::vector<EmissionEntry>& set) {
+  const Vec3d v = {velocity[0], velocity[1], velocity[2]};
+  const double speed = std::sqrt(Dot(v, v));
+
+  std::vector<uint32_t> triangles;
+  std::vector<double> areas;
+  for (uint32_t t = 0; t < indexCount / 3; t++) {
+    Vec3d p[3];
+    for (uint32_t k = 0; k < 3; k++) {
+      const float* q = positions + indices[t * 3 + k] * 3;
+      p[k] = {q[0], q[1], q[2]};
+    }
+
+    // area in world space:
+    const Vec3d world[3] = {Transform(transform, p[0], 1.0),
+                            Transform(transform, p[1], 1.0),
+                            Transform(transform, p[2], 1.0)};
+    const Vec3d c = Cross(Sub(world[1], world[0]), Sub(world[2], world[0]));
+    const double area = 0.5 * std::sqrt(Dot(c, c));
+    if (!(area > 0.0)) continue;
+
+    // the normal exactly as the emit kernel derives it: mesh-space face
+    // normal through the upper 3x3 of the world matrix
+    if (speed > 0.0) {
+      const Vec3d n = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+      const Vec3d nw = Transform(transform, n, 0.0);
+      const double length = std::sqrt(Dot(nw, nw));
+      if (!(length > 0.0) ||
+          std::abs(Dot(nw, v)) < EMIT_DIRECTION_COSINE * length * speed)
+        continue;
+    }
+
+    triangles.push_back(t);
+    areas.push_back(area);
+  }
+
+  std::vector<AliasEntry> table;
+  BuildAliasTable(areas, table);
+
+  set.resize(table.size());
+  for (size_t i = 0; i < table.size(); i++) {
+    set[i].probability = table[i].probability;
+    set[i].triangle = triangles[i];
+    set[i].aliasTriangle = triangles[table[i].alias];
+    set[i].padding = 0;
+  }
+}
+}  // namespace my
\ No newline at end of file
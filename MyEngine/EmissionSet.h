@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ParticleSystemTypes.h"
+
+namespace my {
+// One bucket of an emitter's emission set: a Walker alias bucket that
+// resolves straight to triangle ids, so the emit kernel needs no second
+// lookup. Same layout as StructuredBuffer<EmissionEntry> in hlsl/Header.hlsli.
+struct EmissionEntry {
+  float probability;
+  uint32_t triangle;       // kept with probability `probability`
+  uint32_t aliasTriangle;  // taken otherwise
+  uint32_t padding;
+};
+static_assert(sizeof(EmissionEntry) == 16,
+              "EmissionEntry must match the HLSL layout.");
+
+// An emitter with a starting velocity only emits from triangles whose world
+// normal is within this cosine of the velocity direction (either side).
+static const float EMIT_DIRECTION_COSINE = 0.9f;
+
+// Triangles of a mesh an emitter may emit from, weighted by their world-space
+// area under transform. With a zero velocity every triangle qualifies,
+// otherwise only the ones passing the direction filter. positions are tightly
+// packed float3s, indices a triangle list; degenerate triangles are left out.
+// An empty set means the emitter cannot emit from this mesh at all.
+void BuildEmissionSet(const float* positions, const uint32_t* indices,
+                      uint32_t indexCount, const float4x4& transform,
+                      const float velocity[3],
+                      std::vector<EmissionEntry>& set);
+
+// Resolves a bucket and a uniform fraction in [0, 1) to a triangle.
+inline uint32_t SampleEmissionSet(const EmissionEntry* set, uint32_t bucket,
+                                  float fraction) {
+  return fraction < set[bucket].probability ? set[bucket].triangle
+                                            : set[bucket].aliasTriangle;
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "FixedTimestep.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace my {
+void FixedTimestep::SetStep(float step) {
+  if (step <= 0.0f) return;
+  m_step = step;
+}
+
+void FixedTimestep::SetMaxSubsteps(uint32_t maxSubsteps) {
+  m_maxSubsteps = std::max(1u, maxSubsteps);
+}
+
+uint32_t FixedTimestep::Advance(float dt) {
+  m_accumulator += std::max(0.0f, dt);
+
+  uint32_t steps = static_cast<uint32_t>(m_accumulator / m_step);
+  if (steps > m_maxSubsteps) {
+    m_droppedSteps += steps - m_maxSubsteps;
+    steps = m_maxSubsteps;
+
+    // keep the fractional part so the interpolation stays continuous
+    m_accumulator -= std::floor(m_accumulator / m_step) * m_step;
+    m_accumulator += steps * static_cast<double>(m_step);
+  }
+
+  m_accumulator -= steps * static_cast<double>(m_step);
+  m_time += steps * static_cast<double>(m_step);
+
+  return steps;
+}
+
+float FixedTimestep::GetInterpolation() const {
+  return std::min(1.0f, static_cast<float>(m_accumulator / m_step));
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+namespace my {
+// Accumulator-driven fixed-step scheduler. Advance() banks the frame delta
+// and returns how many fixed steps to simulate; at most maxSubsteps run per
+// frame and any backlog beyond that is dropped, so a frame-time spike costs
+// a bounded amount of simulation instead of one huge integration step.
+// GetInterpolation() is the fraction of a step left in the accumulator, used
+// to blend the previous and current simulated states for rendering.
+class FixedTimestep {
+ public:
+  void SetStep(float step);
+  void SetMaxSubsteps(uint32_t maxSubsteps);
+
+  uint32_t Advance(float dt);
+
+  float GetStep() const { return m_step; }
+  float GetInterpolation() const;
+
+  // Simulated time at the end of the last step.
+  double GetTime() const { return m_time; }
+
+  // Steps thrown away by the substep cap since the start.
+  uint64_t GetDroppedSteps() const { return m_droppedSteps; }
+
+ private:
+  float m_step = 1.0f / 60.0f;
+  uint32_t m_maxSubsteps = 4;
+
+  double m_accumulator = 0.0;
+  double m_time = 0.0;
+  uint64_t m_droppedSteps = 0;
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace my {
+namespace {
+// Range of groups [begin, end) packed into one word, so the owner popping
+// from the front and a thief splitting off the back race on a single CAS.
+struct alignas(64) GroupRange {
+  std::atomic<uint64_t> packed{0};
+
+  static uint64_t Pack(uint32_t begin, uint32_t end) {
+    return (static_cast<uint64_t>(end) << 32) | begin;
+  }
+  static uint32_t Begin(uint64_t range) {
+    return static_cast<uint32_t>(range);
+  }
+  static uint32_t End(uint64_t range) {
+    return static_cast<uint32_t>(range >> 32);
+  }
+};
+
+struct DispatchState {
+  const std::function<void(JobArgs)>* task = nullptr;
+  uint32_t jobCount = 0;
+  uint32_t groupSize = 0;
+  uint32_t groupCount = 0;
+  std::unique_ptr<GroupRange[]> ranges;  // one per thread
+  uint32_t rangeCount = 0;
+  std::atomic<uint32_t> finishedGroups{0};
+};
+
+struct Pool {
+  // Joins the workers of a process that exits without ShutDown(), before
+  // the condition variables they wait on are destroyed.
+  ~Pool() { Stop(); }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+    current.reset();
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::mutex dispatchMutex;  // one dispatch in flight at a time
+  std::shared_ptr<DispatchState> current;
+  uint64_t generation = 0;
+  bool running = false;
+};
+
+Pool g_pool;
+thread_local uint32_t t_threadIndex = 0;
+thread_local uint32_t t_jobDepth = 0;  // > 0 while executing a job
+
+// Takes the next group from the front of this thread's own range.
+bool PopGroup(GroupRange& range, uint32_t& groupID) {
+  uint64_t current = range.packed.load();
+  for (;;) {
+    const uint32_t begin = GroupRange::Begin(current);
+    const uint32_t end = GroupRange::End(current);
+    if (begin >= end) return false;
+    if (range.packed.compare_exchange_weak(
+            current, GroupRange::Pack(begin + 1, end))) {
+      groupID = begin;
+      return true;
+    }
+  }
+}
+
+// Moves the back half of another thread's range into our own (empty) range.
+bool StealGroups(DispatchState& dispatch, uint32_t self) {
+  for (uint32_t i = 1; i < dispatch.rangeCount; i++) {
+    GroupRange& victim = dispatch.ranges[(self + i) % dispatch.rangeCount];
+    uint64_t current = victim.packed.load();
+    for (;;) {
+      const uint32_t begin = GroupRange::Begin(current);
+      const uint32_t end = GroupRange::End(current);
+      if (begin >= end) break;
+      const uint32_t mid = begin + (end - begin) / 2;
+      if (victim.packed.compare_exchange_weak(current,
+                                              GroupRange::Pack(begin, mid))) {
+        dispatch.ranges[self].packed.store(GroupRange::Pack(mid, end));
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void RunGroups(DispatchState& dispatch, uint32_t threadIndex) {
+  // Threads beyond the range count (nested inline runs) start by stealing.
+  const uint32_t self = threadIndex % dispatch.rangeCount;
+  GroupRange& own = dispatch.ranges[self];
+
+  t_jobDepth++;
+  uint32_t finished = 0;
+  for (;;) {
+    uint32_t groupID;
+    if (!PopGroup(own, groupID)) {
+      if (!StealGroups(dispatch, self)) break;
+      continue;
+    }
+
+    const uint32_t begin = groupID * dispatch.groupSize;
+    const uint32_t end =
+        std::min(begin + dispatch.groupSize, dispatch.jobCount);
+
+    JobArgs args;
+    args.groupID = groupID;
+    args.threadIndex = threadIndex;
+    for (uint32_t i = begin; i < end; i++) {
+      args.jobIndex = i;
+      args.groupIndex = i - begin;
+      (*dispatch.task)(args);
+    }
+    finished++;
+  }
+  t_jobDepth--;
+
+  if (finished > 0 &&
+      dispatch.finishedGroups.fetch_add(finished) + finished ==
+          dispatch.groupCount) {
+    std::lock_guard<std::mutex> lock(g_pool.mutex);
+    g_pool.done.notify_all();
+  }
+}
+
+void WorkerLoop(uint32_t threadIndex) {
+  t_threadIndex = threadIndex;
+
+  uint64_t seen = 0;
+  for (;;) {
+    std::shared_ptr<DispatchState> dispatch;
+    {
+      std::unique_lock<std::mutex> lock(g_pool.mutex);
+      g_pool.wake.wait(lock, [&seen] {
+        return !g_pool.running || g_pool.generation != seen;
+      });
+      if (!g_pool.running) return;
+      seen = g_pool.generation;
+      dispatch = g_pool.current;
+    }
+    if (dispatch) RunGroups(*dispatch, threadIndex);
+  }
+}
+}  // namespace
+
+void JobSystem::Initialize(uint32_t threadCount) {
+  ShutDown();
+
+  if (threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+  g_pool.running = true;
+  for (uint32_t i = 1; i < threadCount; i++)
+    g_pool.workers.emplace_back(WorkerLoop, i);
+}
+
+void JobSystem::ShutDown() { g_pool.Stop(); }
+
+uint32_t JobSystem::GetThreadCount() {
+  return static_cast<uint32_t>(g_pool.workers.size()) + 1;
+}
+
+bool JobSystem::IsInsideJob() { return t_jobDepth > 0; }
+
+uint32_t JobSystem::GetGroupCount(uint32_t jobCount, uint32_t groupSize) {
+  return (jobCount + groupSize - 1) / groupSize;
+}
+
+void JobSystem::Dispatch(uint32_t jobCount, uint32_t groupSize,
+                         const std::function<void(JobArgs)>& task) {
+  if (jobCount == 0 || groupSize == 0) return;
+
+  auto dispatch = std::make_shared<DispatchState>();
+  dispatch->task = &task;
+  dispatch->jobCount = jobCount;
+  dispatch->groupSize = groupSize;
+  dispatch->groupCount = GetGroupCount(jobCount, groupSize);
+
+  // Nested dispatches and single-group work run on the calling thread.
+  if (t_jobDepth > 0 || g_pool.workers.empty() || dispatch->groupCount == 1) {
+    dispatch->rangeCount = 1;
+    dispatch->ranges.reset(new GroupRange[1]);
+    dispatch->ranges[0].packed = GroupRange::Pack(0, dispatch->groupCount);
+    RunGroups(*dispatch, t_threadIndex);
+    return;
+  }
+
+  // Every thread starts on its own contiguous slice of the groups and only
+  // steals once that runs dry, so threads rarely touch the same cache line.
+  const uint32_t threadCount = GetThreadCount();
+  dispatch->rangeCount = threadCount;
+  dispatch->ranges.reset(new GroupRange[threadCount]);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    const uint64_t begin =
+        static_cast<uint64_t>(dispatch->groupCount) * i / threadCount;
+    const uint64_t end =
+        static_cast<uint64_t>(dispatch->groupCount) * (i + 1) / threadCount;
+    dispatch->ranges[i].packed = GroupRange::Pack(
+        static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+  }
+
+  std::lock_guard<std::mutex> dispatchLock(g_pool.dispatchMutex);
+  {
+    std::lock_guard<std::mutex> lock(g_pool.mutex);
+    g_pool.current = dispatch;
+    g_pool.generation++;
+  }
+  g_pool.wake.notify_all();
+
+  RunGroups(*dispatch, 0);
+
+  std::unique_lock<std::mutex> lock(g_pool.mutex);
+  g_pool.done.wait(lock, [&dispatch] {
+    return dispatch->finishedGroups.load() == dispatch->groupCount;
+  });
+  g_pool.current.reset();
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace my {
+struct JobArgs {
+  uint32_t jobIndex;     // index of the job inside the whole dispatch
+  uint32_t groupID;      // index of the group the job belongs to
+  uint32_t groupIndex;   // index of the job inside its group
+  uint32_t threadIndex;  // worker executing the job (0 = calling thread)
+};
+
+// Minimal fork/join thread pool used by the CPU backends. Dispatch() splits
+// jobCount jobs into groups of groupSize, runs them on the worker threads and
+// the calling thread, and returns once every group has finished.
+//
+// Groups are handed out work-stealing style: each thread owns a contiguous
+// slice of the groups and steals half of another thread's remaining slice
+// when its own is empty. A group never changes thread once started, so
+// JobArgs::threadIndex can index per-thread scratch data without locking.
+class JobSystem {
+ public:
+  // threadCount includes the calling thread; 0 picks the hardware count.
+  static void Initialize(uint32_t threadCount = 0);
+  static void ShutDown();
+
+  static uint32_t GetThreadCount();
+
+  // Returns true while a job is executing on this thread. Dispatches issued
+  // from inside a job run inline instead of going back to the pool.
+  static bool IsInsideJob();
+
+  static void Dispatch(uint32_t jobCount, uint32_t groupSize,
+                       const std::function<void(JobArgs)>& task);
+
+  static uint32_t GetGroupCount(uint32_t jobCount, uint32_t groupSize);
+};
+}  // namespace my
\ No newline at end of file
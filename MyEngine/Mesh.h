@@ -3,6 +3,9 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 
+#include <cstdint>
+#include <vector>
+
 using Microsoft::WRL::ComPtr;
 
 namespace my {
@@ -21,6 +24,11 @@ class Mesh {
   ComPtr<ID3D11ShaderResourceView> vertexBufferSRV;
   ComPtr<ID3D11ShaderResourceView> indexBufferSRV;
 
+  // CPU copies of the float3 positions and the indices, from which the
+  // emission set of every emitter using this mesh is built.
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+
   UINT indexCount = 0;
   UINT vertexCount = 0;
   UINT stride = 0;
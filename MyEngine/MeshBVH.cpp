@@ -0,0 +1,591 @@
+#include "MeshBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "JobSystem.h"
+#include "SIMD.h"
+
+namespace my {
+namespace {
+// Centroid bins the SAH evaluates per axis.
+const uint32_t kBinCount = 16;
+
+// Cost of visiting a node relative to testing a triangle, and the most
+// triangles a leaf may keep when a split would not pay off.
+const float kTraversalCost = 1.0f;
+const uint32_t kMaxLeafSize = 8;
+
+// Triangles one refit job transforms.
+const uint32_t kTriangleGroupSize = 4096;
+
+// Segments closer to parallel with a triangle than this (squared
+// determinant) pass it, as do direction components this close to zero,
+// which would otherwise turn the slab test into 0 * inf.
+const float kParallel = 1e-30f;
+const float kTinyDirection = 1e-20f;
+
+struct Vec3 {
+  float x, y, z;
+};
+
+Vec3 ToVec3(const float3& v) { return {v.x, v.y, v.z}; }
+Vec3 operator-(Vec3 a, Vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+float Dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+Vec3 Cross(Vec3 a, Vec3 b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+float Component(Vec3 v, uint32_t axis) {
+  return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+// Row vector times matrix, like mul(float4(v, 1), world) in the shaders.
+float3 Transform(const float4x4& m, const float3& v) {
+  float3 r;
+  r.x = v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + m.m[3][0];
+  r.y = v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + m.m[3][1];
+  r.z = v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + m.m[3][2];
+  return r;
+}
+
+BVHTriangle Transform(const float4x4& m, const BVHTriangle& triangle) {
+  return {Transform(m, triangle.v0), Transform(m, triangle.v1),
+          Transform(m, triangle.v2)};
+}
+
+struct Bounds {
+  Vec3 lo = {INFINITY, INFINITY, INFINITY};
+  Vec3 hi = {-INFINITY, -INFINITY, -INFINITY};
+
+  void Grow(Vec3 p) {
+    lo = {std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z)};
+    hi = {std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z)};
+  }
+  void Grow(const Bounds& b) {
+    lo = {std::min(lo.x, b.lo.x), std::min(lo.y, b.lo.y),
+          std::min(lo.z, b.lo.z)};
+    hi = {std::max(hi.x, b.hi.x), std::max(hi.y, b.hi.y),
+          std::max(hi.z, b.hi.z)};
+  }
+  float GetArea() const {
+    const Vec3 e = hi - lo;
+    return e.x < 0.0f ? 0.0f : e.x * e.y + e.y * e.z + e.z * e.x;
+  }
+};
+
+Bounds GetBounds(const BVHTriangle& triangle) {
+  Bounds b;
+  b.Grow(ToVec3(triangle.v0));
+  b.Grow(ToVec3(triangle.v1));
+  b.Grow(ToVec3(triangle.v2));
+  return b;
+}
+
+float SafeInverse(float d) {
+  return 1.0f / (d < kTinyDirection && d > -kTinyDirection ? kTinyDirection
+                                                           : d);
+}
+
+// Slab test of the segment from + d * t, t in [0, tMax), against the
+// bounds of node; tNear is where it enters them.
+bool IntersectBounds(const BVHNode& node, Vec3 from, Vec3 inverse, float tMax,
+                     float& tNear) {
+  const float x0 = (node.boundsMin.x - from.x) * inverse.x;
+  const float x1 = (node.boundsMax.x - from.x) * inverse.x;
+  const float y0 = (node.boundsMin.y - from.y) * inverse.y;
+  const float y1 = (node.boundsMax.y - from.y) * inverse.y;
+  const float z0 = (node.boundsMin.z - from.z) * inverse.z;
+  const float z1 = (node.boundsMax.z - from.z) * inverse.z;
+  tNear = std::max(std::max(std::min(x0, x1), std::min(y0, y1)),
+                   std::max(std::min(z0, z1), 0.0f));
+  const float tFar = std::min(std::min(std::max(x0, x1), std::max(y0, y1)),
+                              std::min(std::max(z0, z1), tMax));
+  return !(tFar < tNear);
+}
+
+// Moeller-Trumbore, both sides: where the segment from + d * t crosses the
+// triangle, if that is in [0, tMax).
+bool IntersectTriangle(const BVHTriangle& triangle, Vec3 from, Vec3 d,
+                       float tMax, float& t) {
+  const Vec3 v0 = ToVec3(triangle.v0);
+  const Vec3 e1 = ToVec3(triangle.v1) - v0;
+  const Vec3 e2 = ToVec3(triangle.v2) - v0;
+  const Vec3 p = Cross(d, e2);
+  const float det = Dot(e1, p);
+  if (det * det < kParallel) return false;
+
+  const float inverse = 1.0f / det;
+  const Vec3 s = from - v0;
+  const float u = Dot(s, p) * inverse;
+  const Vec3 q = Cross(s, e1);
+  const float v = Dot(d, q) * inverse;
+  const float crossing = Dot(e2, q) * inverse;
+  if (u < 0.0f || v < 0.0f || u + v > 1.0f || crossing < 0.0f ||
+      !(crossing < tMax))
+    return false;
+  t = crossing;
+  return true;
+}
+
+// Unit normal of triangle, turned against the segment direction d.
+float3 FacingNormal(const BVHTriangle& triangle, Vec3 d) {
+  const Vec3 v0 = ToVec3(triangle.v0);
+  Vec3 n = Cross(ToVec3(triangle.v1) - v0, ToVec3(triangle.v2) - v0);
+  const float length = std::sqrt(Dot(n, n));
+  const float scale = (Dot(n, d) > 0.0f ? -1.0f : 1.0f) / length;
+  float3 normal;
+  normal.x = n.x * scale;
+  normal.y = n.y * scale;
+  normal.z = n.z * scale;
+  return normal;
+}
+
+// Depth-first walk over the nodes the segment(s) enter, nearer child first.
+// visitLeaf(node) tests a leaf's triangles; enter(node, tNear) tests the
+// bounds of a node and tells where the walk enters them.
+template <typename Enter, typename VisitLeaf>
+void Traverse(const BVHNode* nodes, Enter&& enter, VisitLeaf&& visitLeaf) {
+  float tNear[2];
+  if (!enter(nodes[0], tNear[0])) return;
+
+  uint32_t stack[MeshBVH::MAX_DEPTH];
+  uint32_t stackSize = 0;
+  uint32_t nodeIndex = 0;
+  for (;;) {
+    const BVHNode& node = nodes[nodeIndex];
+    if (node.triangleCount > 0) {
+      visitLeaf(node);
+    } else {
+      const uint32_t left = node.leftFirst;
+      const bool hitLeft = enter(nodes[left], tNear[0]);
+      const bool hitRight = enter(nodes[left + 1], tNear[1]);
+      if (hitLeft && hitRight) {
+        const bool rightFirst = tNear[1] < tNear[0];
+        stack[stackSize++] = rightFirst ? left : left + 1;
+        nodeIndex = rightFirst ? left + 1 : left;
+        continue;
+      }
+      if (hitLeft || hitRight) {
+        nodeIndex = hitLeft ? left : left + 1;
+        continue;
+      }
+    }
+    if (stackSize == 0) break;
+    nodeIndex = stack[--stackSize];
+  }
+}
+
+// A SIMD vector of segments walking the tree together; lanes outside
+// active take no part.
+struct Packet {
+  simd::vfloat from[3];
+  simd::vfloat d[3];
+  simd::vfloat inverse[3];
+  simd::vfloat tMax;
+  uint32_t active;
+  uint32_t triangle[simd::kWidth];
+};
+
+simd::vfloat Dot(const simd::vfloat a[3], const simd::vfloat b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void Cross(const simd::vfloat a[3], const simd::vfloat b[3],
+           simd::vfloat r[3]) {
+  r[0] = a[1] * b[2] - a[2] * b[1];
+  r[1] = a[2] * b[0] - a[0] * b[2];
+  r[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// IntersectBounds() of every lane; returns the lanes that enter node and
+// sets tNear to the nearest entry among them.
+uint32_t IntersectBounds(const Packet& packet, const BVHNode& node,
+                         float& tNear) {
+  using namespace simd;
+
+  const float lo[3] = {node.boundsMin.x, node.boundsMin.y, node.boundsMin.z};
+  const float hi[3] = {node.boundsMax.x, node.boundsMax.y, node.boundsMax.z};
+  vfloat entry = Set1(0.0f);
+  vfloat exit = packet.tMax;
+  for (uint32_t c = 0; c < 3; c++) {
+    const vfloat t0 = (Set1(lo[c]) - packet.from[c]) * packet.inverse[c];
+    const vfloat t1 = (Set1(hi[c]) - packet.from[c]) * packet.inverse[c];
+    entry = Max(entry, Min(t0, t1));
+    exit = Min(exit, Max(t0, t1));
+  }
+  const uint32_t lanes = packet.active & ~MoveMask(exit < entry);
+  if (lanes == 0) return 0;
+
+  float entries[kWidth];
+  Store(entries, entry);
+  tNear = INFINITY;
+  for (uint32_t l = 0; l < kWidth; l++)
+    if (lanes & (1u << l)) tNear = std::min(tNear, entries[l]);
+  return lanes;
+}
+
+void IntersectTriangle(Packet& packet, const BVHTriangle& triangle,
+                       uint32_t index) {
+  using namespace simd;
+
+  const Vec3 v0 = ToVec3(triangle.v0);
+  const Vec3 e1s = ToVec3(triangle.v1) - v0;
+  const Vec3 e2s = ToVec3(triangle.v2) - v0;
+  const vfloat e1[3] = {Set1(e1s.x), Set1(e1s.y), Set1(e1s.z)};
+  const vfloat e2[3] = {Set1(e2s.x), Set1(e2s.y), Set1(e2s.z)};
+
+  vfloat p[3];
+  Cross(packet.d, e2, p);
+  const vfloat det = Dot(e1, p);
+  const vfloat inverse = Set1(1.0f) / det;
+  const vfloat s[3] = {packet.from[0] - Set1(v0.x),
+                       packet.from[1] - Set1(v0.y),
+                       packet.from[2] - Set1(v0.z)};
+  const vfloat u = Dot(s, p) * inverse;
+  vfloat q[3];
+  Cross(s, e1, q);
+  const vfloat v = Dot(packet.d, q) * inverse;
+  const vfloat t = Dot(e2, q) * inverse;
+
+  const vfloat zero = Set1(0.0f);
+  const vmask miss = (det * det < Set1(kParallel)) | (u < zero) |
+                     (v < zero) | (u + v > Set1(1.0f)) | (t < zero);
+  const uint32_t lanes =
+      packet.active & ~MoveMask(miss) & MoveMask(t < packet.tMax);
+  if (lanes == 0) return;
+
+  packet.tMax = Select(FromBits(lanes), t, packet.tMax);
+  for (uint32_t l = 0; l < kWidth; l++)
+    if (lanes & (1u << l)) packet.triangle[l] = index;
+}
+}  // namespace
+
+void MeshBVH::Clear() {
+  m_meshes.clear();
+  m_nodes.clear();
+  m_triangles.clear();
+  m_localTriangles.clear();
+  m_triangleMeshes.clear();
+  m_moved = false;
+  m_version++;
+}
+
+uint32_t MeshBVH::AddMesh(const float* positions, const uint32_t* indices,
+                          uint32_t indexCount, const float4x4& transform) {
+  const uint32_t mesh = static_cast<uint32_t>(m_meshes.size());
+  m_meshes.push_back(Mesh());
+  m_meshes.back().transform = transform;
+
+  auto vertex = [&](uint32_t i) {
+    const float* p = positions + indices[i] * 3;
+    float3 v;
+    v.x = p[0];
+    v.y = p[1];
+    v.z = p[2];
+    return v;
+  };
+  for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+    m_localTriangles.push_back({vertex(i), vertex(i + 1), vertex(i + 2)});
+    m_triangleMeshes.push_back(mesh);
+  }
+  return mesh;
+}
+
+void MeshBVH::Build() {
+  const uint32_t count = static_cast<uint32_t>(m_localTriangles.size());
+  m_nodes.clear();
+  m_triangles.resize(count);
+  for (uint32_t i = 0; i < count; i++)
+    m_triangles[i] = Transform(m_meshes[m_triangleMeshes[i]].transform,
+                               m_localTriangles[i]);
+  for (Mesh& mesh : m_meshes) mesh.moved = false;
+  m_moved = false;
+  m_version++;
+  if (count == 0) return;
+
+  std::vector<Bounds> bounds(count);
+  std::vector<Vec3> centroids(count);
+  for (uint32_t i = 0; i < count; i++) {
+    bounds[i] = GetBounds(m_triangles[i]);
+    centroids[i] = {(bounds[i].lo.x + bounds[i].hi.x) * 0.5f,
+                    (bounds[i].lo.y + bounds[i].hi.y) * 0.5f,
+                    (bounds[i].lo.z + bounds[i].hi.z) * 0.5f};
+  }
+  std::vector<uint32_t> order(count);
+  for (uint32_t i = 0; i < count; i++) order[i] = i;
+
+  auto boundsOf = [&](uint32_t first, uint32_t size) {
+    Bounds b;
+    for (uint32_t i = first; i < first + size; i++) b.Grow(bounds[order[i]]);
+    return b;
+  };
+  auto setBounds = [](BVHNode& node, const Bounds& b) {
+    node.boundsMin = {b.lo.x, b.lo.y, b.lo.z};
+    node.boundsMax = {b.hi.x, b.hi.y, b.hi.z};
+  };
+
+  // A binary tree over count leaves has at most 2 * count - 1 nodes, so
+  // the references below stay valid.
+  m_nodes.reserve(2 * count);
+  m_nodes.push_back(BVHNode());
+  m_nodes[0].leftFirst = 0;
+  m_nodes[0].triangleCount = count;
+  Bounds rootBounds = boundsOf(0, count);
+  setBounds(m_nodes[0], rootBounds);
+
+  struct Work {
+    uint32_t node;
+    uint32_t depth;
+    Bounds bounds;
+  };
+  std::vector<Work> work = {{0, 0, rootBounds}};
+  while (!work.empty()) {
+    const Work item = work.back();
+    work.pop_back();
+    BVHNode& node = m_nodes[item.node];
+    const uint32_t first = node.leftFirst;
+    const uint32_t size = node.triangleCount;
+    if (size <= 1 || item.depth + 1 >= MAX_DEPTH) continue;
+
+    Bounds centroidBounds;
+    for (uint32_t i = first; i < first + size; i++)
+      centroidBounds.Grow(centroids[order[i]]);
+
+    // cheapest split between two bins, in triangle tests times area
+    float bestCost = INFINITY;
+    uint32_t bestAxis = 0;
+    uint32_t bestSplit = 0;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      const float lo = Component(centroidBounds.lo, axis);
+      const float hi = Component(centroidBounds.hi, axis);
+      if (!(hi > lo)) continue;
+
+      const float scale = kBinCount / (hi - lo);
+      Bounds binBounds[kBinCount];
+      uint32_t binCounts[kBinCount] = {};
+      for (uint32_t i = first; i < first + size; i++) {
+        const float c = Component(centroids[order[i]], axis);
+        const uint32_t bin = std::min(
+            kBinCount - 1, static_cast<uint32_t>((c - lo) * scale));
+        binBounds[bin].Grow(bounds[order[i]]);
+        binCounts[bin]++;
+      }
+
+      float leftCost[kBinCount];
+      Bounds sweep;
+      uint32_t sweepCount = 0;
+      for (uint32_t b = 0; b + 1 < kBinCount; b++) {
+        sweep.Grow(binBounds[b]);
+        sweepCount += binCounts[b];
+        leftCost[b] = sweep.GetArea() * sweepCount;
+      }
+      sweep = Bounds();
+      sweepCount = 0;
+      for (uint32_t b = kBinCount - 1; b > 0; b--) {
+        sweep.Grow(binBounds[b]);
+        sweepCount += binCounts[b];
+        if (sweepCount == 0 || sweepCount == size) continue;
+        const float cost = leftCost[b - 1] + sweep.GetArea() * sweepCount;
+        if (cost < bestCost) {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = b;
+        }
+      }
+    }
+    if (bestCost == INFINITY) continue;  // every centroid in one spot
+
+    const float area = item.bounds.GetArea();
+    const float splitCost =
+        area > 0.0f ? kTraversalCost + bestCost / area : kTraversalCost;
+    if (splitCost >= size && size <= kMaxLeafSize) continue;
+
+    const float lo = Component(centroidBounds.lo, bestAxis);
+    const float scale =
+        kBinCount / (Component(centroidBounds.hi, bestAxis) - lo);
+    const uint32_t* middle = std::partition(
+        order.data() + first, order.data() + first + size,
+        [&](uint32_t triangle) {
+          const float c = Component(centroids[triangle], bestAxis);
+          return std::min(kBinCount - 1,
+                          static_cast<uint32_t>((c - lo) * scale)) <
+                 bestSplit;
+        });
+    const uint32_t leftSize =
+        static_cast<uint32_t>(middle - (order.data() + first));
+    if (leftSize == 0 || leftSize == size) continue;
+
+    const uint32_t left = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(BVHNode());
+    m_nodes.push_back(BVHNode());
+    BVHNode& parent = m_nodes[item.node];
+    parent.leftFirst = left;
+    parent.triangleCount = 0;
+
+    const Bounds leftBounds = boundsOf(first, leftSize);
+    const Bounds rightBounds = boundsOf(first + leftSize, size - leftSize);
+    m_nodes[left].leftFirst = first;
+    m_nodes[left].triangleCount = leftSize;
+    setBounds(m_nodes[left], leftBounds);
+    m_nodes[left + 1].leftFirst = first + leftSize;
+    m_nodes[left + 1].triangleCount = size - leftSize;
+    setBounds(m_nodes[left + 1], rightBounds);
+
+    work.push_back({left, item.depth + 1, leftBounds});
+    work.push_back({left + 1, item.depth + 1, rightBounds});
+  }
+
+  // triangles into leaf order
+  std::vector<BVHTriangle> triangles(count);
+  std::vector<BVHTriangle> localTriangles(count);
+  std::vector<uint32_t> triangleMeshes(count);
+  for (uint32_t i = 0; i < count; i++) {
+    triangles[i] = m_triangles[order[i]];
+    localTriangles[i] = m_localTriangles[order[i]];
+    triangleMeshes[i] = m_triangleMeshes[order[i]];
+  }
+  m_triangles.swap(triangles);
+  m_localTriangles.swap(localTriangles);
+  m_triangleMeshes.swap(triangleMeshes);
+}
+
+bool MeshBVH::SetTransform(uint32_t mesh, const float4x4& transform) {
+  Mesh& target = m_meshes[mesh];
+  if (memcmp(&target.transform, &transform, sizeof(float4x4)) == 0)
+    return false;
+
+  target.transform = transform;
+  target.moved = true;
+  m_moved = true;
+  return true;
+}
+
+bool MeshBVH::Refit() {
+  if (!m_moved) return false;
+
+  const uint32_t count = static_cast<uint32_t>(m_triangles.size());
+  JobSystem::Dispatch(
+      JobSystem::GetGroupCount(count, kTriangleGroupSize), 1,
+      [&](JobArgs args) {
+        const uint32_t begin = args.jobIndex * kTriangleGroupSize;
+        const uint32_t end = std::min(begin + kTriangleGroupSize, count);
+        for (uint32_t i = begin; i < end; i++) {
+          const Mesh& mesh = m_meshes[m_triangleMeshes[i]];
+          if (mesh.moved)
+            m_triangles[i] = Transform(mesh.transform, m_localTriangles[i]);
+        }
+      });
+
+  // children are stored after their parent, so a backwards walk sees them
+  // first
+  for (size_t i = m_nodes.size(); i-- > 0;) UpdateBounds(m_nodes[i]);
+
+  for (Mesh& mesh : m_meshes) mesh.moved = false;
+  m_moved = false;
+  m_version++;
+  return true;
+}
+
+void MeshBVH::UpdateBounds(BVHNode& node) const {
+  Bounds b;
+  if (node.triangleCount > 0) {
+    for (uint32_t i = 0; i < node.triangleCount; i++)
+      b.Grow(GetBounds(m_triangles[node.leftFirst + i]));
+  } else {
+    for (uint32_t i = 0; i < 2; i++) {
+      const BVHNode& child = m_nodes[node.leftFirst + i];
+      b.Grow(ToVec3(child.boundsMin));
+      b.Grow(ToVec3(child.boundsMax));
+    }
+  }
+  node.boundsMin = {b.lo.x, b.lo.y, b.lo.z};
+  node.boundsMax = {b.hi.x, b.hi.y, b.hi.z};
+}
+
+bool MeshBVH::IntersectSegment(const float3& from, const float3& to,
+                               SegmentHit& hit) const {
+  hit.t = 1.0f;
+  hit.triangle = NO_HIT;
+  if (m_nodes.empty()) return false;
+
+  const Vec3 origin = ToVec3(from);
+  const Vec3 d = ToVec3(to) - origin;
+  const Vec3 inverse = {SafeInverse(d.x), SafeInverse(d.y), SafeInverse(d.z)};
+
+  Traverse(
+      m_nodes.data(),
+      [&](const BVHNode& node, float& tNear) {
+        return IntersectBounds(node, origin, inverse, hit.t, tNear);
+      },
+      [&](const BVHNode& node) {
+        for (uint32_t i = node.leftFirst;
+             i < node.leftFirst + node.triangleCount; i++) {
+          if (IntersectTriangle(m_triangles[i], origin, d, hit.t, hit.t))
+            hit.triangle = i;
+        }
+      });
+
+  if (hit.triangle == NO_HIT) return false;
+  hit.normal = FacingNormal(m_triangles[hit.triangle], d);
+  return true;
+}
+
+void MeshBVH::IntersectSegments(const float* const from[3],
+                                const float* const to[3], uint32_t count,
+                                SegmentHit* hits) const {
+  using namespace simd;
+
+  for (uint32_t base = 0; base < count; base += kWidth) {
+    const uint32_t lanes = std::min(kWidth, count - base);
+
+    // a partial vector runs with zero length segments in the spare lanes
+    float lane[2][3][kWidth] = {};
+    for (uint32_t c = 0; c < 3; c++) {
+      std::copy(from[c] + base, from[c] + base + lanes, lane[0][c]);
+      std::copy(to[c] + base, to[c] + base + lanes, lane[1][c]);
+    }
+
+    Packet packet;
+    for (uint32_t c = 0; c < 3; c++) {
+      packet.from[c] = Load(lane[0][c]);
+      packet.d[c] = Load(lane[1][c]) - packet.from[c];
+      const vfloat tiny = Set1(kTinyDirection);
+      const vmask small =
+          (packet.d[c] < tiny) & (packet.d[c] > Set1(-kTinyDirection));
+      packet.inverse[c] = Set1(1.0f) / Select(small, tiny, packet.d[c]);
+    }
+    packet.tMax = Set1(1.0f);
+    packet.active = (1u << lanes) - 1;
+    std::fill(packet.triangle, packet.triangle + kWidth, NO_HIT);
+
+    if (!m_nodes.empty()) {
+      Traverse(
+          m_nodes.data(),
+          [&](const BVHNode& node, float& tNear) {
+            return IntersectBounds(packet, node, tNear) != 0;
+          },
+          [&](const BVHNode& node) {
+            for (uint32_t i = node.leftFirst;
+                 i < node.leftFirst + node.triangleCount; i++)
+              IntersectTriangle(packet, m_triangles[i], i);
+          });
+    }
+
+    float t[kWidth];
+    Store(t, packet.tMax);
+    for (uint32_t l = 0; l < lanes; l++) {
+      SegmentHit& hit = hits[base + l];
+      hit.triangle = packet.triangle[l];
+      hit.t = t[l];
+      if (hit.triangle == NO_HIT) continue;
+
+      const Vec3 d = {lane[1][0][l] - lane[0][0][l],
+                      lane[1][1][l] - lane[0][1][l],
+                      lane[1][2][l] - lane[0][2][l]};
+      hit.normal = FacingNormal(m_triangles[hit.triangle], d);
+    }
+  }
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ParticleSystemTypes.h"
+
+namespace my {
+// Twins of the collider structures in hlsl/Header.hlsli.
+struct BVHNode {
+  float3 boundsMin;  // WS
+  uint leftFirst;    // first of the two children, or first leaf triangle
+  float3 boundsMax;  // WS
+  uint triangleCount;  // 0 for inner nodes
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode must match the HLSL layout.");
+
+struct BVHTriangle {
+  float3 v0, v1, v2;  // WS
+};
+static_assert(sizeof(BVHTriangle) == 36,
+              "BVHTriangle must match the HLSL layout.");
+
+// Nearest crossing of a segment with the triangles.
+struct SegmentHit {
+  float t;  // from + (to - from) * t, in [0, 1)
+  uint32_t triangle;  // in BVH order, MeshBVH::NO_HIT when there is none
+  float3 normal;      // unit, on the side of the segment's start
+};
+
+// Bounding volume hierarchy over the triangles of a set of meshes, which
+// particles collide with. Build() splits by the surface area heuristic over
+// binned triangle centroids. A mesh moved by SetTransform() only needs
+// Refit(), which keeps the tree and recomputes the bounds bottom-up; for the
+// rigid motions the models make the bounds stay reasonably tight.
+//
+// Triangles are stored in world space in leaf order, and nodes so that the
+// children of an inner node are adjacent, exactly as
+// CS_ParticleSystem_Simulate.hlsl reads them. The segment queries mirror
+// the shader's traversal; IntersectSegments() runs a SIMD vector of
+// segments through the tree together.
+class MeshBVH {
+ public:
+  static const uint32_t NO_HIT = 0xFFFFFFFF;
+  // Deepest leaf, so the traversal stack of the shader has a fixed size.
+  static const uint32_t MAX_DEPTH = 32;
+  // A collided particle is put back this far in front of the surface.
+  static constexpr float COLLISION_SKIN = 1e-3f;
+
+  void Clear();
+
+  // Adds a mesh placed with transform and returns its index. positions are
+  // tightly packed float3s, indices a triangle list; the tree only sees it
+  // at the next Build().
+  uint32_t AddMesh(const float* positions, const uint32_t* indices,
+                   uint32_t indexCount, const float4x4& transform);
+  void Build();
+
+  // Places mesh with transform; false when that is where it already was.
+  // The bounds are stale until the next Refit().
+  bool SetTransform(uint32_t mesh, const float4x4& transform);
+  // Recomputes the bounds if any mesh moved; false when none did.
+  bool Refit();
+
+  // Nearest crossing of the segment from -> to; false when there is none.
+  bool IntersectSegment(const float3& from, const float3& to,
+                        SegmentHit& hit) const;
+  // IntersectSegment() of count segments given as coordinate columns, a
+  // SIMD vector of them at a time.
+  void IntersectSegments(const float* const from[3], const float* const to[3],
+                         uint32_t count, SegmentHit* hits) const;
+
+  bool IsEmpty() const { return m_triangles.empty(); }
+  const std::vector<BVHNode>& GetNodes() const { return m_nodes; }
+  const std::vector<BVHTriangle>& GetTriangles() const { return m_triangles; }
+
+  // Changes with every Build() and Refit() that moved something, so copies
+  // of the nodes and triangles know when to update.
+  uint32_t GetVersion() const { return m_version; }
+
+ private:
+  struct Mesh {
+    float4x4 transform;
+    bool moved = false;
+  };
+
+  // Bounds of node from its children or triangles.
+  void UpdateBounds(BVHNode& node) const;
+
+  std::vector<Mesh> m_meshes;
+  std::vector<BVHNode> m_nodes;
+  std::vector<BVHTriangle> m_triangles;
+
+  // Object space triangles and their mesh, in the order of m_triangles.
+  std::vector<BVHTriangle> m_localTriangles;
+  std::vector<uint32_t> m_triangleMeshes;
+
+  bool m_moved = false;
+  uint32_t m_version = 0;
+};
+}  // namespace my
\ No newline at end of file
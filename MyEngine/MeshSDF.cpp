@@ -0,0 +1,683 @@
+#include "MeshSDF.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "JobSystem.h"
+
+namespace my {
+namespace {
+const uint32_t SAMPLES_PER_AXIS = MeshSDF::BRICK_SIZE + 1;
+const uint32_t NO_TRIANGLE = 0xFFFFFFFF;
+
+// Start of a cache file. The version changes with the file layout and with
+// anything that changes what Build() bakes.
+const char kCacheMagic[4] = {'M', 'S', 'D', 'F'};
+const uint32_t kCacheVersion = 1;
+
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t fingerprint;
+  SDFInstance constants;
+  uint32_t brickCount;
+  uint32_t allocatedBricks;
+};
+
+struct Vec3 {
+  float x, y, z;
+};
+
+Vec3 operator+(Vec3 a, Vec3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+Vec3 operator-(Vec3 a, Vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+Vec3 operator*(Vec3 a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+float Dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+float Component(Vec3 v, uint32_t axis) {
+  return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+// Squared distance from p to triangle abc, through its closest point
+// (Ericson, Real-Time Collision Detection, 5.1.5).
+float DistanceSquared(Vec3 p, Vec3 a, Vec3 b, Vec3 c) {
+  const Vec3 ab = b - a;
+  const Vec3 ac = c - a;
+  const Vec3 ap = p - a;
+  const float d1 = Dot(ab, ap);
+  const float d2 = Dot(ac, ap);
+  Vec3 closest;
+  if (d1 <= 0.0f && d2 <= 0.0f) {
+    closest = a;
+  } else {
+    const Vec3 bp = p - b;
+    const float d3 = Dot(ab, bp);
+    const float d4 = Dot(ac, bp);
+    const Vec3 cp = p - c;
+    const float d5 = Dot(ab, cp);
+    const float d6 = Dot(ac, cp);
+    const float vc = d1 * d4 - d3 * d2;
+    const float vb = d5 * d2 - d1 * d6;
+    const float va = d3 * d6 - d5 * d4;
+    if (d3 >= 0.0f && d4 <= d3) {
+      closest = b;
+    } else if (d6 >= 0.0f && d5 <= d6) {
+      closest = c;
+    } else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+      closest = a + ab * (d1 / (d1 - d3));
+    } else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+      closest = a + ac * (d2 / (d2 - d6));
+    } else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+      closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    } else {
+      const float denominator = 1.0f / (va + vb + vc);
+      closest = a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+  }
+  const Vec3 d = p - closest;
+  return Dot(d, d);
+}
+
+uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+  // FNV-1a
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ull;
+  }
+  return hash;
+}
+}  // namespace
+
+void MeshSDF::Clear() {
+  m_triangles.clear();
+  m_bricks.clear();
+  m_samples.clear();
+  m_constants = {};
+}
+
+void MeshSDF::AddMesh(const float* positions, const uint32_t* indices,
+                      uint32_t indexCount) {
+  for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+    for (uint32_t v = 0; v < 3; v++) {
+      const float* p = positions + indices[i + v] * 3;
+      m_triangles.insert(m_triangles.end(), {p[0], p[1], p[2]});
+    }
+  }
+}
+
+void MeshSDF::Build() {
+  m_bricks.clear();
+  m_samples.clear();
+  m_constants = SDFInstance();
+  m_constants.distanceScale = 1.0f;
+
+  const uint32_t triangleCount = GetTriangleCount();
+  if (triangleCount == 0) return;
+
+  auto vertex = [&](uint32_t triangle, uint32_t v) {
+    const float* p = &m_triangles[(triangle * 3 + v) * 3];
+    return Vec3{p[0], p[1], p[2]};
+  };
+
+  // The box of the mesh padded by the band and a voxel, in whole bricks.
+  Vec3 lo = vertex(0, 0);
+  Vec3 hi = lo;
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    for (uint32_t v = 0; v < 3; v++) {
+      const Vec3 p = vertex(t, v);
+      lo = {std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z)};
+      hi = {std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z)};
+    }
+  }
+  const Vec3 size = hi - lo;
+  const float extent = std::max(std::max(size.x, size.y), size.z);
+  const float voxelSize =
+      std::max(extent, 1e-6f) / std::max(m_settings.resolution, 1u);
+  const float bandVoxels = std::max(m_settings.band, 1.0f);
+  const float band = bandVoxels * voxelSize;
+  const uint32_t padding = static_cast<uint32_t>(std::ceil(bandVoxels)) + 1;
+
+  uint32_t brickDim[3];
+  uint32_t sampleDim[3];
+  float volumeMin[3];
+  for (uint32_t axis = 0; axis < 3; axis++) {
+    const uint32_t voxels =
+        static_cast<uint32_t>(std::ceil(Component(size, axis) / voxelSize)) +
+        2 * padding;
+    brickDim[axis] = (voxels + BRICK_SIZE - 1) / BRICK_SIZE;
+    sampleDim[axis] = brickDim[axis] * BRICK_SIZE + 1;
+    const float center = (Component(lo, axis) + Component(hi, axis)) / 2;
+    volumeMin[axis] = center - brickDim[axis] * BRICK_SIZE * voxelSize / 2;
+  }
+  const uint32_t brickCount = brickDim[0] * brickDim[1] * brickDim[2];
+
+  m_constants.volumeMin.x = volumeMin[0];
+  m_constants.volumeMin.y = volumeMin[1];
+  m_constants.volumeMin.z = volumeMin[2];
+  m_constants.voxelSize = voxelSize;
+  for (uint32_t axis = 0; axis < 3; axis++)
+    m_constants.brickDim[axis] = brickDim[axis];
+  m_constants.band = band;
+
+  auto samplePosition = [&](uint32_t x, uint32_t y, uint32_t z) {
+    return Vec3{volumeMin[0] + x * voxelSize, volumeMin[1] + y * voxelSize,
+                volumeMin[2] + z * voxelSize};
+  };
+  // Samples within a voxel diagonal of a triangle are seeded with it.
+  const float seedRadius = 1.7321f * voxelSize;
+  const float seedRadius2 = seedRadius * seedRadius;
+  auto sampleRange = [&](const Vec3& a, const Vec3& b, const Vec3& c,
+                         uint32_t axis, float reach, int32_t& first,
+                         int32_t& last) {
+    const float low = std::min(std::min(Component(a, axis),
+                                        Component(b, axis)),
+                               Component(c, axis));
+    const float high = std::max(std::max(Component(a, axis),
+                                         Component(b, axis)),
+                                Component(c, axis));
+    const float origin = volumeMin[axis];
+    first = std::max(static_cast<int32_t>(
+                         std::ceil((low - reach - origin) / voxelSize)),
+                     0);
+    last = std::min(static_cast<int32_t>(
+                        std::floor((high + reach - origin) / voxelSize)),
+                    static_cast<int32_t>(sampleDim[axis]) - 1);
+  };
+
+  // Triangles by the bricks whose samples they seed, as offsets into one
+  // list per brick.
+  std::vector<uint32_t> binStart(brickCount + 1, 0);
+  std::vector<uint32_t> binTriangles;
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      int32_t first[3], last[3];
+      for (uint32_t axis = 0; axis < 3; axis++) {
+        sampleRange(vertex(t, 0), vertex(t, 1), vertex(t, 2), axis,
+                    seedRadius, first[axis], last[axis]);
+        // a brick holds the samples from its corner to the next brick's
+        first[axis] = std::max(first[axis] - 1, 0) / BRICK_SIZE;
+        last[axis] = std::min(static_cast<uint32_t>(last[axis]) / BRICK_SIZE,
+                              brickDim[axis] - 1);
+      }
+      for (int32_t z = first[2]; z <= last[2]; z++) {
+        for (int32_t y = first[1]; y <= last[1]; y++) {
+          for (int32_t x = first[0]; x <= last[0]; x++) {
+            const uint32_t brick = (z * brickDim[1] + y) * brickDim[0] + x;
+            if (pass == 0)
+              binStart[brick + 1]++;
+            else
+              binTriangles[binStart[brick]++] = t;
+          }
+        }
+      }
+    }
+    if (pass == 0) {
+      for (uint32_t b = 0; b < brickCount; b++)
+        binStart[b + 1] += binStart[b];
+      binTriangles.resize(binStart[brickCount]);
+    } else {
+      // the fill moved every start to the next brick's
+      for (uint32_t b = brickCount; b > 0; b--) binStart[b] = binStart[b - 1];
+      binStart[0] = 0;
+    }
+  }
+
+  // Bricks the band reaches: the seeded ones and their neighbors, as far
+  // as the band goes.
+  std::vector<uint32_t> brickSlots(brickCount, uint32_t(NO_SAMPLES));
+  const int32_t reach = static_cast<int32_t>(
+      std::ceil(bandVoxels / BRICK_SIZE));
+  std::vector<uint32_t> bandBricks;
+  for (uint32_t z = 0; z < brickDim[2]; z++) {
+    for (uint32_t y = 0; y < brickDim[1]; y++) {
+      for (uint32_t x = 0; x < brickDim[0]; x++) {
+        bool near = false;
+        for (int32_t dz = -reach; dz <= reach && !near; dz++) {
+          for (int32_t dy = -reach; dy <= reach && !near; dy++) {
+            for (int32_t dx = -reach; dx <= reach && !near; dx++) {
+              const int32_t n[3] = {static_cast<int32_t>(x) + dx,
+                                    static_cast<int32_t>(y) + dy,
+                                    static_cast<int32_t>(z) + dz};
+              if (n[0] < 0 || n[1] < 0 || n[2] < 0 ||
+                  n[0] >= static_cast<int32_t>(brickDim[0]) ||
+                  n[1] >= static_cast<int32_t>(brickDim[1]) ||
+                  n[2] >= static_cast<int32_t>(brickDim[2]))
+                continue;
+              const uint32_t brick = (n[2] * brickDim[1] + n[1]) *
+                                         brickDim[0] +
+                                     n[0];
+              near = binStart[brick + 1] > binStart[brick];
+            }
+          }
+        }
+        if (!near) continue;
+        const uint32_t brick = (z * brickDim[1] + y) * brickDim[0] + x;
+        brickSlots[brick] = static_cast<uint32_t>(bandBricks.size());
+        bandBricks.push_back(brick);
+      }
+    }
+  }
+  const uint32_t bandBrickCount = static_cast<uint32_t>(bandBricks.size());
+
+  // Nearest triangle and squared distance of every sample of the band
+  // bricks, twice for the jump flood to read one while writing the other.
+  // Samples on a shared face are kept by both bricks.
+  const size_t slotCount = size_t(bandBrickCount) * SAMPLES_PER_BRICK;
+  std::vector<uint32_t> nearest[2] = {
+      std::vector<uint32_t>(slotCount, NO_TRIANGLE),
+      std::vector<uint32_t>(slotCount, NO_TRIANGLE)};
+  std::vector<float> distance2[2] = {std::vector<float>(slotCount),
+                                     std::vector<float>(slotCount)};
+
+  auto brickCorner = [&](uint32_t brick, uint32_t corner[3]) {
+    corner[0] = brick % brickDim[0] * BRICK_SIZE;
+    corner[1] = brick / brickDim[0] % brickDim[1] * BRICK_SIZE;
+    corner[2] = brick / brickDim[0] / brickDim[1] * BRICK_SIZE;
+  };
+  auto triangleDistance2 = [&](uint32_t triangle, const Vec3& p) {
+    return DistanceSquared(p, vertex(triangle, 0), vertex(triangle, 1),
+                           vertex(triangle, 2));
+  };
+
+  JobSystem::Dispatch(bandBrickCount, 1, [&](JobArgs args) {
+    const uint32_t brick = bandBricks[args.jobIndex];
+    uint32_t corner[3];
+    brickCorner(brick, corner);
+    uint32_t* ids = &nearest[0][size_t(args.jobIndex) * SAMPLES_PER_BRICK];
+    float* d2 = &distance2[0][size_t(args.jobIndex) * SAMPLES_PER_BRICK];
+    for (uint32_t i = binStart[brick]; i < binStart[brick + 1]; i++) {
+      const uint32_t t = binTriangles[i];
+      int32_t first[3], last[3];
+      for (uint32_t axis = 0; axis < 3; axis++) {
+        sampleRange(vertex(t, 0), vertex(t, 1), vertex(t, 2), axis,
+                    seedRadius, first[axis], last[axis]);
+        first[axis] =
+            std::max(first[axis] - static_cast<int32_t>(corner[axis]), 0);
+        last[axis] = std::min(last[axis] - static_cast<int32_t>(corner[axis]),
+                              static_cast<int32_t>(BRICK_SIZE));
+      }
+      for (int32_t z = first[2]; z <= last[2]; z++) {
+        for (int32_t y = first[1]; y <= last[1]; y++) {
+          for (int32_t x = first[0]; x <= last[0]; x++) {
+            const uint32_t s =
+                (z * SAMPLES_PER_AXIS + y) * SAMPLES_PER_AXIS + x;
+            const float d = triangleDistance2(
+                t, samplePosition(corner[0] + x, corner[1] + y,
+                                  corner[2] + z));
+            if (ids[s] == NO_TRIANGLE || d < d2[s]) {
+              ids[s] = t;
+              d2[s] = d;
+            }
+          }
+        }
+      }
+    }
+  });
+
+  // Jump flood: every sample takes the nearest of the triangles its
+  // neighbors step samples away have, for steps halving down to 1, then once
+  // more at 1 to mend what the coarse steps got wrong. The seeds already
+  // reach a voxel out, so the steps start below the band width.
+  uint32_t firstStep = 1;
+  while (firstStep * 2 < bandVoxels) firstStep *= 2;
+  std::vector<uint32_t> steps;
+  for (uint32_t step = firstStep; step > 0; step /= 2) steps.push_back(step);
+  steps.push_back(1);
+
+  uint32_t current = 0;
+  for (uint32_t step : steps) {
+    const std::vector<uint32_t>& readIds = nearest[current];
+    const std::vector<float>& readD2 = distance2[current];
+    std::vector<uint32_t>& writeIds = nearest[1 - current];
+    std::vector<float>& writeD2 = distance2[1 - current];
+
+    // nearest triangle of the sample at global (x, y, z), from the brick
+    // that holds it
+    auto readNearest = [&](int32_t x, int32_t y, int32_t z) {
+      const int32_t s[3] = {x, y, z};
+      uint32_t brick[3], local[3];
+      for (uint32_t axis = 0; axis < 3; axis++) {
+        if (s[axis] < 0 || s[axis] >= static_cast<int32_t>(sampleDim[axis]))
+          return NO_TRIANGLE;
+        brick[axis] = std::min(static_cast<uint32_t>(s[axis]) / BRICK_SIZE,
+                               brickDim[axis] - 1);
+        local[axis] = s[axis] - brick[axis] * BRICK_SIZE;
+      }
+      const uint32_t slot =
+          brickSlots[(brick[2] * brickDim[1] + brick[1]) * brickDim[0] +
+                     brick[0]];
+      if (slot == NO_SAMPLES) return NO_TRIANGLE;
+      return readIds[size_t(slot) * SAMPLES_PER_BRICK +
+                     (local[2] * SAMPLES_PER_AXIS + local[1]) *
+                         SAMPLES_PER_AXIS +
+                     local[0]];
+    };
+
+    JobSystem::Dispatch(bandBrickCount, 1, [&](JobArgs args) {
+      uint32_t corner[3];
+      brickCorner(bandBricks[args.jobIndex], corner);
+      const size_t base = size_t(args.jobIndex) * SAMPLES_PER_BRICK;
+      const int32_t d = static_cast<int32_t>(step);
+      for (uint32_t z = 0; z < SAMPLES_PER_AXIS; z++) {
+        for (uint32_t y = 0; y < SAMPLES_PER_AXIS; y++) {
+          for (uint32_t x = 0; x < SAMPLES_PER_AXIS; x++) {
+            const size_t s = base + (z * SAMPLES_PER_AXIS + y) *
+                                        SAMPLES_PER_AXIS +
+                             x;
+            const int32_t g[3] = {static_cast<int32_t>(corner[0] + x),
+                                  static_cast<int32_t>(corner[1] + y),
+                                  static_cast<int32_t>(corner[2] + z)};
+            const Vec3 p = samplePosition(g[0], g[1], g[2]);
+            uint32_t best = readIds[s];
+            float bestD2 = readD2[s];
+            if (best != NO_TRIANGLE && bestD2 <= seedRadius2) {
+              // seeded with every triangle this close, so already exact
+              writeIds[s] = best;
+              writeD2[s] = bestD2;
+              continue;
+            }
+            // neighbors mostly share triangles, often in a row
+            uint32_t tried = best;
+            for (int32_t dz = -d; dz <= d; dz += d) {
+              for (int32_t dy = -d; dy <= d; dy += d) {
+                for (int32_t dx = -d; dx <= d; dx += d) {
+                  const int32_t x1 = static_cast<int32_t>(x) + dx;
+                  const int32_t y1 = static_cast<int32_t>(y) + dy;
+                  const int32_t z1 = static_cast<int32_t>(z) + dz;
+                  const int32_t size = SAMPLES_PER_AXIS;
+                  const uint32_t t =
+                      x1 >= 0 && y1 >= 0 && z1 >= 0 && x1 < size &&
+                              y1 < size && z1 < size
+                          ? readIds[base + (z1 * size + y1) * size + x1]
+                          : readNearest(g[0] + dx, g[1] + dy, g[2] + dz);
+                  if (t == NO_TRIANGLE || t == tried || t == best) continue;
+                  tried = t;
+                  const float candidate = triangleDistance2(t, p);
+                  if (best == NO_TRIANGLE || candidate < bestD2) {
+                    best = t;
+                    bestD2 = candidate;
+                  }
+                }
+              }
+            }
+            writeIds[s] = best;
+            writeD2[s] = bestD2;
+          }
+        }
+      }
+    });
+    current = 1 - current;
+  }
+
+  // Sign by parity: the x where the triangles cross every row of samples
+  // along x, a job per plane of rows. The rows are nudged off the sample
+  // lattice so they do not run through vertices and edges of meshes that
+  // are aligned with it.
+  const float nudgeY = 1.234e-4f * voxelSize;
+  const float nudgeZ = 0.567e-4f * voxelSize;
+  std::vector<std::vector<float>> crossings(size_t(sampleDim[1]) *
+                                            sampleDim[2]);
+  std::vector<uint32_t> planeStart(sampleDim[2] + 1, 0);
+  std::vector<uint32_t> planeTriangles;
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      int32_t first, last;
+      sampleRange(vertex(t, 0), vertex(t, 1), vertex(t, 2), 2, voxelSize,
+                  first, last);
+      for (int32_t z = first; z <= last; z++) {
+        if (pass == 0)
+          planeStart[z + 1]++;
+        else
+          planeTriangles[planeStart[z]++] = t;
+      }
+    }
+    if (pass == 0) {
+      for (uint32_t z = 0; z < sampleDim[2]; z++)
+        planeStart[z + 1] += planeStart[z];
+      planeTriangles.resize(planeStart[sampleDim[2]]);
+    } else {
+      for (uint32_t z = sampleDim[2]; z > 0; z--)
+        planeStart[z] = planeStart[z - 1];
+      planeStart[0] = 0;
+    }
+  }
+
+  JobSystem::Dispatch(sampleDim[2], 1, [&](JobArgs args) {
+    const uint32_t z = args.jobIndex;
+    const float pz = volumeMin[2] + z * voxelSize + nudgeZ;
+    for (uint32_t i = planeStart[z]; i < planeStart[z + 1]; i++) {
+      const uint32_t t = planeTriangles[i];
+      const Vec3 a = vertex(t, 0);
+      const Vec3 b = vertex(t, 1);
+      const Vec3 c = vertex(t, 2);
+      // the triangle projected onto yz, and its doubled signed area
+      const float area =
+          (b.y - a.y) * (c.z - a.z) - (c.y - a.y) * (b.z - a.z);
+      if (area == 0.0f) continue;
+
+      int32_t first, last;
+      sampleRange(a, b, c, 1, voxelSize, first, last);
+      for (int32_t y = first; y <= last; y++) {
+        const float py = volumeMin[1] + y * voxelSize + nudgeY;
+        const float wa =
+            ((b.y - py) * (c.z - pz) - (c.y - py) * (b.z - pz)) / area;
+        const float wb =
+            ((c.y - py) * (a.z - pz) - (a.y - py) * (c.z - pz)) / area;
+        const float wc = 1.0f - wa - wb;
+        if (wa < 0.0f || wb < 0.0f || wc < 0.0f) continue;
+        crossings[size_t(z) * sampleDim[1] + y].push_back(wa * a.x + wb * b.x +
+                                                          wc * c.x);
+      }
+    }
+    for (uint32_t y = 0; y < sampleDim[1]; y++) {
+      std::vector<float>& row = crossings[size_t(z) * sampleDim[1] + y];
+      std::sort(row.begin(), row.end());
+    }
+  });
+
+  auto inside = [&](uint32_t x, uint32_t y, uint32_t z) {
+    const std::vector<float>& row = crossings[size_t(z) * sampleDim[1] + y];
+    const float px = volumeMin[0] + x * voxelSize;
+    return (std::upper_bound(row.begin(), row.end(), px) - row.begin()) % 2 ==
+           1;
+  };
+
+  // Signed, clamped samples of the band bricks into slots in band order,
+  // then the ones the band really passes through, packed in that order.
+  // Every other brick is all inside or all outside.
+  m_bricks.resize(brickCount);
+  m_samples.resize(slotCount);
+  JobSystem::Dispatch(brickCount, 64, [&](JobArgs args) {
+    const uint32_t brick = args.jobIndex;
+    uint32_t corner[3];
+    brickCorner(brick, corner);
+    SDFBrick& entry = m_bricks[brick];
+    entry.index = NO_SAMPLES;
+
+    const uint32_t slot = brickSlots[brick];
+    if (slot == NO_SAMPLES) {
+      entry.value = inside(corner[0], corner[1], corner[2]) ? -band : band;
+      return;
+    }
+
+    const size_t base = size_t(slot) * SAMPLES_PER_BRICK;
+    bool crossed = false;
+    float value = 0.0f;
+    for (uint32_t z = 0; z < SAMPLES_PER_AXIS; z++) {
+      for (uint32_t y = 0; y < SAMPLES_PER_AXIS; y++) {
+        for (uint32_t x = 0; x < SAMPLES_PER_AXIS; x++) {
+          const size_t s =
+              base + (z * SAMPLES_PER_AXIS + y) * SAMPLES_PER_AXIS + x;
+          const float d = nearest[current][s] == NO_TRIANGLE
+                              ? band
+                              : std::min(std::sqrt(distance2[current][s]),
+                                         band);
+          value = inside(corner[0] + x, corner[1] + y, corner[2] + z) ? -d : d;
+          m_samples[s] = value;
+          crossed = crossed || d < band;
+        }
+      }
+    }
+    if (crossed)
+      entry.index = slot;
+    else
+      entry.value = value;
+  });
+
+  uint32_t allocated = 0;
+  for (uint32_t slot = 0; slot < bandBrickCount; slot++) {
+    SDFBrick& entry = m_bricks[bandBricks[slot]];
+    if (entry.index == NO_SAMPLES) continue;
+    if (slot != allocated) {
+      memmove(&m_samples[size_t(allocated) * SAMPLES_PER_BRICK],
+              &m_samples[size_t(slot) * SAMPLES_PER_BRICK],
+              SAMPLES_PER_BRICK * sizeof(float));
+    }
+    entry.index = allocated++;
+  }
+  m_samples.resize(size_t(allocated) * SAMPLES_PER_BRICK);
+}
+
+bool MeshSDF::BuildCached(const std::string& path) {
+  if (Load(path)) return true;
+  Build();
+  return Save(path);
+}
+
+uint64_t MeshSDF::GetFingerprint() const {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  hash = HashBytes(hash, &kCacheVersion, sizeof(kCacheVersion));
+  hash = HashBytes(hash, &m_settings.resolution,
+                   sizeof(m_settings.resolution));
+  hash = HashBytes(hash, &m_settings.band, sizeof(m_settings.band));
+  return HashBytes(hash, m_triangles.data(),
+                   m_triangles.size() * sizeof(float));
+}
+
+bool MeshSDF::Save(const std::string& path) const {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) return false;
+
+  CacheHeader header = {};
+  memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = kCacheVersion;
+  header.fingerprint = GetFingerprint();
+  header.constants = m_constants;
+  header.brickCount = static_cast<uint32_t>(m_bricks.size());
+  header.allocatedBricks = GetAllocatedBrickCount();
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(m_bricks.data()),
+             m_bricks.size() * sizeof(SDFBrick));
+  file.write(reinterpret_cast<const char*>(m_samples.data()),
+             m_samples.size() * sizeof(float));
+  return static_cast<bool>(file);
+}
+
+bool MeshSDF::Load(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+
+  CacheHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+      header.version != kCacheVersion ||
+      header.fingerprint != GetFingerprint())
+    return false;
+
+  const uint32_t* brickDim = header.constants.brickDim;
+  if (static_cast<uint64_t>(brickDim[0]) * brickDim[1] * brickDim[2] !=
+      header.brickCount)
+    return false;
+
+  std::vector<SDFBrick> bricks(header.brickCount);
+  std::vector<float> samples(size_t(header.allocatedBricks) *
+                             SAMPLES_PER_BRICK);
+  if (!file.read(reinterpret_cast<char*>(bricks.data()),
+                 bricks.size() * sizeof(SDFBrick)) ||
+      !file.read(reinterpret_cast<char*>(samples.data()),
+                 samples.size() * sizeof(float)))
+    return false;
+  for (const SDFBrick& brick : bricks) {
+    if (brick.index != NO_SAMPLES && brick.index >= header.allocatedBricks)
+      return false;
+  }
+
+  m_constants = header.constants;
+  m_bricks = std::move(bricks);
+  m_samples = std::move(samples);
+  return true;
+}
+
+float MeshSDF::GetDistance(const float3& pos, float3* gradient) const {
+  const float p[3] = {pos.x, pos.y, pos.z};
+  float g[3];
+  const float distance =
+      SampleSDF(m_constants, m_bricks.data(), m_samples.data(), p, g);
+  if (gradient != nullptr) {
+    gradient->x = g[0];
+    gradient->y = g[1];
+    gradient->z = g[2];
+  }
+  return distance;
+}
+
+float SampleSDF(const SDFInstance& instance, const SDFBrick* bricks,
+                const float* samples, const float pos[3], float gradient[3]) {
+  const uint32_t B = MeshSDF::BRICK_SIZE;
+  const float volumeMin[3] = {instance.volumeMin.x, instance.volumeMin.y,
+                              instance.volumeMin.z};
+  if (gradient != nullptr) gradient[0] = gradient[1] = gradient[2] = 0.0f;
+
+  uint32_t brick[3];
+  uint32_t cell[3];
+  float t[3];
+  for (uint32_t axis = 0; axis < 3; axis++) {
+    const float voxel = (pos[axis] - volumeMin[axis]) / instance.voxelSize;
+    const float b = std::floor(voxel / B);
+    // nothing was baked outside the box, which is padded by the band
+    if (!(b >= 0.0f && b < static_cast<float>(instance.brickDim[axis])))
+      return instance.band;
+    brick[axis] = static_cast<uint32_t>(b);
+    const float local = voxel - b * B;
+    cell[axis] = std::min(static_cast<uint32_t>(local), B - 1);
+    t[axis] = local - cell[axis];
+  }
+
+  const SDFBrick& entry =
+      bricks[instance.brickOffset +
+             (brick[2] * instance.brickDim[1] + brick[1]) *
+                 instance.brickDim[0] +
+             brick[0]];
+  if (entry.index == MeshSDF::NO_SAMPLES) return entry.value;
+
+  const float* s = samples + size_t(entry.index) * MeshSDF::SAMPLES_PER_BRICK +
+                   (cell[2] * SAMPLES_PER_AXIS + cell[1]) * SAMPLES_PER_AXIS +
+                   cell[0];
+  const uint32_t dy = SAMPLES_PER_AXIS;
+  const uint32_t dz = SAMPLES_PER_AXIS * SAMPLES_PER_AXIS;
+  const float c000 = s[0], c100 = s[1];
+  const float c010 = s[dy], c110 = s[dy + 1];
+  const float c001 = s[dz], c101 = s[dz + 1];
+  const float c011 = s[dz + dy], c111 = s[dz + dy + 1];
+  auto lerp = [](float a, float b, float f) { return a + f * (b - a); };
+
+  const float x00 = lerp(c000, c100, t[0]);
+  const float x10 = lerp(c010, c110, t[0]);
+  const float x01 = lerp(c001, c101, t[0]);
+  const float x11 = lerp(c011, c111, t[0]);
+  const float y0 = lerp(x00, x10, t[1]);
+  const float y1 = lerp(x01, x11, t[1]);
+  if (gradient != nullptr) {
+    const float scale = 1.0f / instance.voxelSize;
+    gradient[0] = lerp(lerp(c100 - c000, c110 - c010, t[1]),
+                       lerp(c101 - c001, c111 - c011, t[1]), t[2]) *
+                  scale;
+    gradient[1] = lerp(x10 - x00, x11 - x01, t[2]) * scale;
+    gradient[2] = (y1 - y0) * scale;
+  }
+  return lerp(y0, y1, t[2]);
+}
+}  // namespace my
\ No newline at end of file
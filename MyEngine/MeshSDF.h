@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ParticleSystemTypes.h"
+
+namespace my {
+// Twins of the distance collider structures in hlsl/Header.hlsli.
+struct SDFBrick {
+  uint index;   // of the brick's samples, or MeshSDF::NO_SAMPLES
+  float value;  // what the whole brick reads when it has no samples
+};
+
+// A baked distance field placed in the world. A MeshSDF's own constants
+// place it at the origin.
+struct SDFInstance {
+  float4x4 worldToLocal;  // transposed, as the shaders read it
+  float3 volumeMin;       // OS
+  float voxelSize;        // OS
+  uint brickDim[3];       // bricks per axis
+  uint brickOffset;       // of the first brick in the packed bricks
+  float distanceScale;    // OS to WS distances
+  float band;             // OS; the field is clamped to +-band beyond it
+  uint padding[2];
+};
+static_assert(sizeof(SDFInstance) == 112,
+              "SDFInstance must match the HLSL layout.");
+
+// Narrow-band signed distance field of a closed mesh, baked into sparse
+// bricks like MetaballVolume: bricks of BRICK_SIZE^3 voxels the surface
+// passes within band voxels of keep their (BRICK_SIZE + 1)^3 corner samples,
+// every other brick reads +band outside the mesh or -band inside. Sampling
+// is trilinear, so a query costs the same however many triangles the mesh
+// has.
+//
+// Build() seeds the samples around every triangle with their exact distance
+// and nearest triangle, then spreads the nearest triangles through the band
+// by jump flooding, every pass a job per brick near the surface. The sign
+// comes from the parity of the triangles crossed along x, a job per plane
+// of samples. Baking takes a while, so BuildCached() keeps the result on
+// disk, keyed by the meshes and the settings.
+class MeshSDF {
+ public:
+  static const uint32_t BRICK_SIZE = 8;
+  static const uint32_t NO_SAMPLES = 0xFFFFFFFF;
+
+  struct Settings {
+    uint32_t resolution = 64;  // voxels along the longest side of the mesh
+    float band = 3.0f;         // in voxels
+  };
+
+  Settings& GetSettings() { return m_settings; }
+
+  void Clear();
+  // Adds a mesh in the field's object space: positions are tightly packed
+  // float3s, indices a triangle list. The field only sees it at the next
+  // Build().
+  void AddMesh(const float* positions, const uint32_t* indices,
+               uint32_t indexCount);
+  void Build();
+
+  // Loads path when it holds the field of the same meshes and settings,
+  // otherwise builds the field and saves it there. False when the file
+  // could not be written; the field is built either way.
+  bool BuildCached(const std::string& path);
+  bool Save(const std::string& path) const;
+  // False when path is missing, unreadable or was baked from other meshes
+  // or settings; the field is left as it was then.
+  bool Load(const std::string& path);
+
+  // Distance to the surface, negative inside, and its gradient, OS.
+  float GetDistance(const float3& pos, float3* gradient = nullptr) const;
+
+  bool IsEmpty() const { return m_bricks.empty(); }
+  uint32_t GetAllocatedBrickCount() const {
+    return static_cast<uint32_t>(m_samples.size() / SAMPLES_PER_BRICK);
+  }
+  uint32_t GetTriangleCount() const {
+    return static_cast<uint32_t>(m_triangles.size() / 9);
+  }
+
+  const SDFInstance& GetConstants() const { return m_constants; }
+  const std::vector<SDFBrick>& GetBricks() const { return m_bricks; }
+  const std::vector<float>& GetSamples() const { return m_samples; }
+
+  static const uint32_t SAMPLES_PER_BRICK =
+      (BRICK_SIZE + 1) * (BRICK_SIZE + 1) * (BRICK_SIZE + 1);
+
+ private:
+  // Key of the meshes and settings the cache files are checked against.
+  uint64_t GetFingerprint() const;
+
+  Settings m_settings;
+  SDFInstance m_constants = {};
+
+  // The added triangles, nine floats each.
+  std::vector<float> m_triangles;
+
+  std::vector<SDFBrick> m_bricks;
+  std::vector<float> m_samples;
+};
+
+// Trilinear sample of the field of instance at pos (OS), out of the packed
+// bricks and samples; gradient, when given, is that of the interpolation.
+float SampleSDF(const SDFInstance& instance, const SDFBrick* bricks,
+                const float* samples, const float pos[3],
+                float gradient[3] = nullptr);
+}  // namespace my
\ No newline at end of file
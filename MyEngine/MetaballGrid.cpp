@@ -0,0 +1,279 @@
+#include "MetaballGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace my {
+namespace {
+float SphereSDF(const float3& pos, const Metaball& sphere) {
+  const float dx = pos.x - sphere.center.x;
+  const float dy = pos.y - sphere.center.y;
+  const float dz = pos.z - sphere.center.z;
+  return std::sqrt(dx * dx + dy * dy + dz * dz) - sphere.radius;
+}
+
+float3 Make(float x, float y, float z) {
+  float3 v;
+  v.x = x;
+  v.y = y;
+  v.z = z;
+  return v;
+}
+}  // namespace
+
+void MetaballGrid::Build(const Particle* particles, const uint32_t* aliveList,
+                         uint32_t aliveCount, const float3& boxCenter,
+                         float boxHalfSize, float smoothing) {
+  const Settings& settings = m_settings;
+  m_smoothing = smoothing;
+  const float cutoff = std::log(1.0f / settings.tolerance) / smoothing;
+
+  m_spheres.resize(aliveCount);
+  m_colors.resize(aliveCount);
+  m_all.resize(aliveCount);
+  float radiusSum = 0.0f;
+  for (uint32_t i = 0; i < aliveCount; i++) {
+    // GetParticleSize() of the shader:
+    const Particle& particle = particles[aliveList[i]];
+    const float lifeLerp = 1 - particle.life / particle.maxLife;
+    const float size = particle.sizeBeginEnd.x +
+                       lifeLerp * (particle.sizeBeginEnd.y -
+                                   particle.sizeBeginEnd.x);
+    m_spheres[i].center = particle.position;
+    m_spheres[i].radius = size / 2.0f;
+    m_colors[i] = particle.color;
+    m_all[i] = i;
+    radiusSum += m_spheres[i].radius;
+  }
+
+  // Cells about as wide as an influence radius: a sphere lands in two or
+  // three cells per axis, which keeps the per-frame build cheap, and a cell
+  // lists little beyond its neighbourhood.
+  const float boxSize = 2.0f * std::max(boxHalfSize, 0.0f);
+  const float meanRadius = aliveCount > 0 ? radiusSum / aliveCount : 0.0f;
+  float cellSize = std::max(boxSize / settings.maxCellsPerAxis,
+                            std::max(meanRadius, 0.0f) + cutoff);
+  const uint32_t dim = std::min(
+      std::max(static_cast<uint32_t>(std::ceil(boxSize / cellSize)), 1u),
+      std::max(settings.maxCellsPerAxis, 1u));
+  cellSize = std::max(boxSize / dim, cellSize);
+
+  m_constants.gridMin = Make(boxCenter.x - boxSize / 2,
+                             boxCenter.y - boxSize / 2,
+                             boxCenter.z - boxSize / 2);
+  m_constants.cellSize = cellSize;
+  m_constants.gridDim[0] = dim;
+  m_constants.gridDim[1] = dim;
+  m_constants.gridDim[2] = dim;
+  m_constants.cutoff = cutoff;
+
+  // Cell ranges of every sphere's influence box, clamped to the grid.
+  // Spheres whose influence misses the grid get an empty range.
+  auto cellRange = [&](const Metaball& sphere, uint32_t lo[3],
+                       uint32_t hi[3]) {
+    const float center[3] = {sphere.center.x, sphere.center.y,
+                             sphere.center.z};
+    const float gridMin[3] = {m_constants.gridMin.x, m_constants.gridMin.y,
+                              m_constants.gridMin.z};
+    const float reach = std::max(sphere.radius, 0.0f) + cutoff;
+    bool empty = false;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      const float first = std::floor((center[axis] - reach - gridMin[axis]) /
+                                     cellSize);
+      const float last = std::floor((center[axis] + reach - gridMin[axis]) /
+                                    cellSize);
+      empty = empty || last < 0.0f || first >= static_cast<float>(dim);
+      lo[axis] = static_cast<uint32_t>(std::max(first, 0.0f));
+      hi[axis] = static_cast<uint32_t>(
+          std::min(last, static_cast<float>(dim - 1)));
+    }
+    return !empty;
+  };
+
+  // counting sort of the (cell, sphere) pairs:
+  m_cells.assign(static_cast<size_t>(dim) * dim * dim, MetaballCell());
+  for (const Metaball& sphere : m_spheres) {
+    uint32_t lo[3], hi[3];
+    if (!cellRange(sphere, lo, hi)) continue;
+    for (uint32_t z = lo[2]; z <= hi[2]; z++)
+      for (uint32_t y = lo[1]; y <= hi[1]; y++)
+        for (uint32_t x = lo[0]; x <= hi[0]; x++)
+          m_cells[(z * dim + y) * dim + x].count++;
+  }
+
+  uint32_t first = 0;
+  for (MetaballCell& cell : m_cells) {
+    cell.first = first;
+    first += cell.count;
+    cell.count = 0;
+  }
+
+  m_entries.resize(first);
+  for (uint32_t i = 0; i < aliveCount; i++) {
+    uint32_t lo[3], hi[3];
+    if (!cellRange(m_spheres[i], lo, hi)) continue;
+    for (uint32_t z = lo[2]; z <= hi[2]; z++) {
+      for (uint32_t y = lo[1]; y <= hi[1]; y++) {
+        for (uint32_t x = lo[0]; x <= hi[0]; x++) {
+          MetaballCell& cell = m_cells[(z * dim + y) * dim + x];
+          m_entries[cell.first + cell.count++] = i;
+        }
+      }
+    }
+  }
+}
+
+float MetaballGrid::GetDistance(const float3& pos) const {
+  const MetaballCell* cell = FindCell(pos);
+  if (cell == nullptr) return m_constants.cutoff;
+  return Evaluate(pos, m_entries.data() + cell->first, cell->count, true);
+}
+
+float3 MetaballGrid::GetNormal(const float3& pos) const {
+  const float epsilon = 0.01f;
+  const float distance = GetDistance(pos);
+  float3 normal = Make(
+      distance - GetDistance(Make(pos.x - epsilon, pos.y, pos.z)),
+      distance - GetDistance(Make(pos.x, pos.y - epsilon, pos.z)),
+      distance - GetDistance(Make(pos.x, pos.y, pos.z - epsilon)));
+
+  const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y +
+                                 normal.z * normal.z);
+  if (length > 0.0f) {
+    normal.x /= length;
+    normal.y /= length;
+    normal.z /= length;
+  }
+  return normal;
+}
+
+float3 MetaballGrid::GetColor(const float3& pos) const {
+  const MetaballCell* cell = FindCell(pos);
+  if (cell == nullptr) return float3();
+  return EvaluateColor(pos, m_entries.data() + cell->first, cell->count);
+}
+
+MetaballSurface MetaballGrid::GetSurface(const float3& pos) const {
+  MetaballSurface surface;
+  surface.distance = m_constants.cutoff;
+
+  const MetaballCell* cell = FindCell(pos);
+  if (cell == nullptr) return surface;
+
+  // With w_i = exp(-k * d_i) and F = -log(sum(w_i)) / k, the gradient is
+  // sum(w_i * grad(d_i)) / sum(w_i), grad(d_i) being the unit vector from
+  // the sphere's center to pos. Its length does not matter for the normal.
+  float sum = 0.0f;
+  float gradient[3] = {0.0f, 0.0f, 0.0f};
+  float color[3] = {0.0f, 0.0f, 0.0f};
+  float weightSum = 0.0f;
+  for (uint32_t i = 0; i < cell->count; i++) {
+    const uint32_t index = m_entries[cell->first + i];
+    const Metaball& sphere = m_spheres[index];
+    const float offset[3] = {pos.x - sphere.center.x, pos.y - sphere.center.y,
+                             pos.z - sphere.center.z};
+    const float length = std::sqrt(offset[0] * offset[0] +
+                                   offset[1] * offset[1] +
+                                   offset[2] * offset[2]);
+    const float distance = length - sphere.radius;
+
+    const float weight = 1.0f / distance;
+    for (uint32_t c = 0; c < 3; c++) {
+      color[c] +=
+          static_cast<float>((m_colors[index] >> (c * 8)) & 0xFF) / 255.0f *
+          weight;
+    }
+    weightSum += weight;
+
+    if (distance < m_constants.cutoff) {
+      const float w = std::exp(-m_smoothing * distance);
+      sum += w;
+      if (length > 0.0f) {
+        for (uint32_t c = 0; c < 3; c++) gradient[c] += w * offset[c] / length;
+      }
+    }
+  }
+
+  if (sum > 0.0f) {
+    surface.distance =
+        std::min(-std::log(sum) / m_smoothing, m_constants.cutoff);
+  }
+  const float length =
+      std::sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1] +
+                gradient[2] * gradient[2]);
+  if (length > 0.0f) {
+    surface.normal =
+        Make(gradient[0] / length, gradient[1] / length, gradient[2] / length);
+  }
+  if (weightSum != 0.0f) {
+    surface.color = Make(color[0] / weightSum, color[1] / weightSum,
+                         color[2] / weightSum);
+  }
+  return surface;
+}
+
+float MetaballGrid::GetDistanceBrute(const float3& pos) const {
+  return Evaluate(pos, m_all.data(), static_cast<uint32_t>(m_all.size()),
+                  false);
+}
+
+float3 MetaballGrid::GetColorBrute(const float3& pos) const {
+  return EvaluateColor(pos, m_all.data(),
+                       static_cast<uint32_t>(m_all.size()));
+}
+
+uint32_t MetaballGrid::GetCandidateCount(const float3& pos) const {
+  const MetaballCell* cell = FindCell(pos);
+  return cell != nullptr ? cell->count : 0;
+}
+
+const MetaballCell* MetaballGrid::FindCell(const float3& pos) const {
+  const float p[3] = {pos.x - m_constants.gridMin.x,
+                      pos.y - m_constants.gridMin.y,
+                      pos.z - m_constants.gridMin.z};
+  uint32_t cell[3];
+  for (uint32_t axis = 0; axis < 3; axis++) {
+    const float c = std::floor(p[axis] / m_constants.cellSize);
+    if (!(c >= 0.0f && c < static_cast<float>(m_constants.gridDim[axis])))
+      return nullptr;
+    cell[axis] = static_cast<uint32_t>(c);
+  }
+  const uint32_t dimX = m_constants.gridDim[0];
+  const uint32_t dimY = m_constants.gridDim[1];
+  return &m_cells[(cell[2] * dimY + cell[1]) * dimX + cell[0]];
+}
+
+float MetaballGrid::Evaluate(const float3& pos, const uint32_t* indices,
+                             uint32_t count, bool truncate) const {
+  // spheres beyond cutoff add less than tolerance; skip their exp
+  const float limit = truncate ? m_constants.cutoff : INFINITY;
+  float sum = 0.0f;
+  for (uint32_t i = 0; i < count; i++) {
+    const float distance = SphereSDF(pos, m_spheres[indices[i]]);
+    if (distance < limit) sum += std::exp(-m_smoothing * distance);
+  }
+
+  // the field never reads more than cutoff, with or without the grid
+  if (!(sum > 0.0f)) return m_constants.cutoff;
+  return std::min(-std::log(sum) / m_smoothing, m_constants.cutoff);
+}
+
+float3 MetaballGrid::EvaluateColor(const float3& pos, const uint32_t* indices,
+                                   uint32_t count) const {
+  float color[3] = {0.0f, 0.0f, 0.0f};
+  float weightSum = 0.0f;
+  for (uint32_t i = 0; i < count; i++) {
+    const uint32_t index = indices[i];
+    const float weight = 1.0f / SphereSDF(pos, m_spheres[index]);
+    for (uint32_t c = 0; c < 3; c++) {
+      color[c] +=
+          static_cast<float>((m_colors[index] >> (c * 8)) & 0xFF) / 255.0f *
+          weight;
+    }
+    weightSum += weight;
+  }
+  if (weightSum == 0.0f) return float3();
+  return Make(color[0] / weightSum, color[1] / weightSum,
+              color[2] / weightSum);
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ParticleSystemTypes.h"
+
+namespace my {
+// Twins of the metaball structures in hlsl/Header.hlsli.
+struct Metaball {
+  float3 center;
+  float radius;
+};
+static_assert(sizeof(Metaball) == 16, "Metaball must match the HLSL layout.");
+
+struct MetaballCell {
+  uint first;  // in the entry list
+  uint count;
+};
+
+struct alignas(16) MetaballGridCB {
+  float3 gridMin;  // WS
+  float cellSize;
+  uint gridDim[3];
+  float cutoff;  // influence radius beyond a sphere's surface
+};
+
+// Everything the shading of a hit needs, from one pass over a cell.
+struct MetaballSurface {
+  float distance;
+  float3 normal;  // normalized gradient of the field
+  float3 color;
+};
+
+// Uniform grid over the particle spheres of the metaball field that
+// PS_RayMARCH.hlsl marches, rebuilt every frame from the alive particles.
+//
+// The field is the smooth minimum -log(sum(exp(-k * d_i))) / k of the sphere
+// distances d_i. A sphere farther than cutoff = log(1 / tolerance) / k adds
+// less than tolerance to the sum, so it is left out: every cell lists the
+// spheres whose surface is within cutoff of it, and a sample only visits
+// the list of its own cell. Where no sphere is that close, the field reads
+// cutoff, a safe step for the marcher.
+//
+// The evaluation functions mirror the shader, so the CPU side can check and
+// time it; the *Brute variants visit every sphere like the shader used to.
+class MetaballGrid {
+ public:
+  struct Settings {
+    uint32_t maxCellsPerAxis = 64;
+    float tolerance = 1e-4f;
+  };
+
+  // Grid over the cube boxCenter +- boxHalfSize (the shader's distBox). A
+  // particle becomes a sphere of half its size at its current life, colored
+  // like the particle; smoothing is the k of the smooth minimum.
+  void Build(const Particle* particles, const uint32_t* aliveList,
+             uint32_t aliveCount, const float3& boxCenter, float boxHalfSize,
+             float smoothing);
+
+  Settings& GetSettings() { return m_settings; }
+  float GetSmoothing() const { return m_smoothing; }
+
+  float GetDistance(const float3& pos) const;
+  float3 GetNormal(const float3& pos) const;  // by finite differences
+  float3 GetColor(const float3& pos) const;
+
+  // GetDistance and GetColor fused into one traversal, with the analytic
+  // gradient of the field instead of GetNormal's four extra evaluations.
+  MetaballSurface GetSurface(const float3& pos) const;
+
+  float GetDistanceBrute(const float3& pos) const;
+  float3 GetColorBrute(const float3& pos) const;
+
+  // Spheres a sample at pos visits.
+  uint32_t GetCandidateCount(const float3& pos) const;
+
+  // What the shader binds: cbMetaballGrid and the four buffers.
+  const MetaballGridCB& GetConstants() const { return m_constants; }
+  const std::vector<Metaball>& GetSpheres() const { return m_spheres; }
+  const std::vector<uint32_t>& GetColors() const { return m_colors; }
+  const std::vector<MetaballCell>& GetCells() const { return m_cells; }
+  const std::vector<uint32_t>& GetEntries() const { return m_entries; }
+
+ private:
+  // Cell of pos; nullptr outside the grid.
+  const MetaballCell* FindCell(const float3& pos) const;
+
+  // With truncate, spheres beyond cutoff are skipped.
+  float Evaluate(const float3& pos, const uint32_t* indices, uint32_t count,
+                 bool truncate) const;
+  float3 EvaluateColor(const float3& pos, const uint32_t* indices,
+                       uint32_t count) const;
+
+  Settings m_settings;
+  float m_smoothing = 1.0f;
+  MetaballGridCB m_constants = {};
+
+  std::vector<Metaball> m_spheres;
+  std::vector<uint32_t> m_colors;
+  std::vector<MetaballCell> m_cells;
+  std::vector<uint32_t> m_entries;
+  std::vector<uint32_t> m_all;  // 0..n-1, for the brute force variants
+};
+}  // namespace my
\ No newline at end of file
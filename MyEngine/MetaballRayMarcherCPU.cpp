@@ -0,0 +1,351 @@
+#include "MetaballRayMarcherCPU.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "JobSystem.h"
+#include "SIMD.h"
+#include "stb_image_write.h"
+
+namespace my {
+namespace {
+using namespace simd;
+
+// PS_RayMARCH.hlsl:
+const uint32_t MAX_STEPS = 100;
+const float SURF_DIST = 1e-5f;
+const uint32_t SURF_REFINEMENT = 5;
+
+const uint32_t NO_CELL = 0xFFFFFFFF;
+
+// A packet is PACKET_ROWS rows of kWidth / PACKET_ROWS pixels, compact so
+// its rays share grid cells as long as possible.
+const uint32_t PACKET_ROWS = 2;
+const uint32_t PACKET_COLUMNS = kWidth / PACKET_ROWS;
+
+// One point or direction per lane.
+struct Packet {
+  vfloat x, y, z;
+};
+
+Packet Along(const Packet& origin, const Packet& direction, vfloat t) {
+  return {MulAdd(direction.x, t, origin.x), MulAdd(direction.y, t, origin.y),
+          MulAdd(direction.z, t, origin.z)};
+}
+
+uint32_t CountLanes(uint32_t bits) {
+  uint32_t count = 0;
+  for (; bits != 0; bits &= bits - 1) count++;
+  return count;
+}
+
+float3 Make(float x, float y, float z) {
+  float3 v;
+  v.x = x;
+  v.y = y;
+  v.z = z;
+  return v;
+}
+
+float Dot(const float3& a, const float3& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+float3 Normalize(const float3& v) {
+  const float length = std::sqrt(Dot(v, v));
+  if (!(length > 0.0f)) return v;
+  return Make(v.x / length, v.y / length, v.z / length);
+}
+
+// pack_rgba/unpack_rgba of hlsl/Header.hlsli.
+float Unpack(uint32_t color, uint32_t shift) {
+  return static_cast<float>((color >> shift) & 0xFF) / 255.0f;
+}
+
+uint32_t Pack(float value, uint32_t shift) {
+  return static_cast<uint32_t>(value * 255.0f) << shift;
+}
+
+// GetDist() of the shader for the lanes in active; the others read garbage.
+// The lanes of one cell walk its spheres together, masked to the group.
+vfloat Distance(const MetaballGrid& grid, const Packet& pos, uint32_t active) {
+  const MetaballGridCB& cb = grid.GetConstants();
+  const std::vector<MetaballCell>& cells = grid.GetCells();
+  const std::vector<uint32_t>& entries = grid.GetEntries();
+  const std::vector<Metaball>& spheres = grid.GetSpheres();
+  const float k = grid.GetSmoothing();
+
+  float lanes[3][kWidth];
+  Store(lanes[0], pos.x);
+  Store(lanes[1], pos.y);
+  Store(lanes[2], pos.z);
+
+  // MetaballGrid::FindCell() per lane
+  const float gridMin[3] = {cb.gridMin.x, cb.gridMin.y, cb.gridMin.z};
+  uint32_t cellOf[kWidth];
+  for (uint32_t l = 0; l < kWidth; l++) {
+    cellOf[l] = NO_CELL;
+    if (((active >> l) & 1) == 0) continue;
+
+    uint32_t cell[3];
+    bool inside = true;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      const float c =
+          std::floor((lanes[axis][l] - gridMin[axis]) / cb.cellSize);
+      inside = inside && c >= 0.0f && c < static_cast<float>(cb.gridDim[axis]);
+      cell[axis] = inside ? static_cast<uint32_t>(c) : 0;
+    }
+    if (inside)
+      cellOf[l] = (cell[2] * cb.gridDim[1] + cell[1]) * cb.gridDim[0] + cell[0];
+  }
+
+  const vfloat zero = Set1(0.0f);
+  const vfloat cutoff = Set1(cb.cutoff);
+  const vfloat minusK = Set1(-k);
+  vfloat sum = zero;
+  for (uint32_t pending = active; pending != 0;) {
+    uint32_t first = 0;
+    while (((pending >> first) & 1) == 0) first++;
+
+    const uint32_t index = cellOf[first];
+    uint32_t group = 0;
+    for (uint32_t l = first; l < kWidth; l++) {
+      if (((pending >> l) & 1) != 0 && cellOf[l] == index) group |= 1u << l;
+    }
+    pending &= ~group;
+    if (index == NO_CELL) continue;
+
+    const vmask inGroup = FromBits(group);
+    const MetaballCell& cell = cells[index];
+    for (uint32_t i = 0; i < cell.count; i++) {
+      const Metaball& sphere = spheres[entries[cell.first + i]];
+      const vfloat dx = pos.x - Set1(sphere.center.x);
+      const vfloat dy = pos.y - Set1(sphere.center.y);
+      const vfloat dz = pos.z - Set1(sphere.center.z);
+      const vfloat distance =
+          Sqrt(dx * dx + dy * dy + dz * dz) - Set1(sphere.radius);
+      const vmask near = inGroup & (distance < cutoff);
+      if (MoveMask(near) != 0)
+        sum = sum + Select(near, Exp(minusK * distance), zero);
+    }
+  }
+
+  // once per step, so the log is left to the library
+  float sums[kWidth];
+  Store(sums, sum);
+  for (uint32_t l = 0; l < kWidth; l++) {
+    sums[l] = sums[l] > 0.0f ? std::min(-std::log(sums[l]) / k, cb.cutoff)
+                             : cb.cutoff;
+  }
+  return Load(sums);
+}
+
+// GetLight() of the shader, packed.
+uint32_t Shade(const MetaballGrid& grid, const RayMarchView& view,
+               const float3& pos) {
+  const MetaballSurface surface = grid.GetSurface(pos);
+  const float3 toEye = Normalize(
+      Make(view.cameraPosition.x - pos.x, view.cameraPosition.y - pos.y,
+           view.cameraPosition.z - pos.z));
+  const float3 lightVec = Normalize(
+      Make(view.lightPosition.x - pos.x, view.lightPosition.y - pos.y,
+           view.lightPosition.z - pos.z));
+
+  // Scale light down by Lambert's cosine law.
+  const float ndotl = std::max(Dot(lightVec, surface.normal), 0.0f);
+  const float strength = view.lightIntensity * ndotl;
+
+  // BlinnPhong() of Header.hlsli with the shader's material
+  const float fresnelR0 = 0.05f;
+  const float m = 0.8f * 256.0f;
+  const float3 halfVec = Normalize(Make(
+      toEye.x + lightVec.x, toEye.y + lightVec.y, toEye.z + lightVec.z));
+  const float roughness =
+      (m + 8.0f) * std::pow(std::max(Dot(halfVec, surface.normal), 0.0f), m) /
+      8.0f;
+  const float f0 =
+      1.0f - std::min(std::max(Dot(halfVec, lightVec), 0.0f), 1.0f);
+  const float fresnel =
+      fresnelR0 + (1.0f - fresnelR0) * (f0 * f0 * f0 * f0 * f0);
+  float specular = fresnel * roughness;
+  specular = specular / (specular + 1.0f);
+
+  const float albedo[3] = {surface.color.x, surface.color.y, surface.color.z};
+  uint32_t packed = 0xFF000000;
+  for (uint32_t c = 0; c < 3; c++) {
+    const float value =
+        (albedo[c] + specular) * Unpack(view.lightColor, c * 8) * strength;
+    packed |= Pack(std::min(std::max(value, 0.0f), 1.0f), c * 8);
+  }
+  return packed;
+}
+}  // namespace
+
+void MetaballRayMarcherCPU::Resize(uint32_t width, uint32_t height) {
+  m_width = width;
+  m_height = height;
+  m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+  m_pixels.resize(static_cast<size_t>(width) * height);
+  m_tileStats.resize(m_tilesX * m_tilesY);
+}
+
+void MetaballRayMarcherCPU::Render(const MetaballGrid& grid,
+                                   const RayMarchView& view) {
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  m_stats = Stats();
+  const uint32_t tileCount = m_tilesX * m_tilesY;
+  JobSystem::Dispatch(tileCount, 1, [&](JobArgs args) {
+    Stats& stats = m_tileStats[args.jobIndex];
+    stats = Stats();
+    RenderTile(args.jobIndex, grid, view, stats);
+  });
+
+  for (uint32_t i = 0; i < tileCount; i++) {
+    m_stats.rays += m_tileStats[i].rays;
+    m_stats.hits += m_tileStats[i].hits;
+    m_stats.steps += m_tileStats[i].steps;
+  }
+
+  const auto stop = std::chrono::high_resolution_clock::now();
+  m_stats.milliseconds =
+      std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+bool MetaballRayMarcherCPU::WritePNG(const std::string& path) const {
+  if (m_pixels.empty()) return false;
+
+  // little endian: the packed pixels already are R, G, B, A bytes
+  return stbi_write_png(path.c_str(), m_width, m_height, 4, m_pixels.data(),
+                        m_width * sizeof(uint32_t)) != 0;
+}
+
+void MetaballRayMarcherCPU::RenderTile(uint32_t tile, const MetaballGrid& grid,
+                                       const RayMarchView& view,
+                                       Stats& stats) {
+  const uint32_t tileX = (tile % m_tilesX) * TILE_SIZE;
+  const uint32_t tileY = (tile / m_tilesX) * TILE_SIZE;
+  const uint32_t tileEndX = std::min(tileX + TILE_SIZE, m_width);
+  const uint32_t tileEndY = std::min(tileY + TILE_SIZE, m_height);
+
+  const float (*clipToWorld)[4] = view.clipToWorld.m;
+  const float eye[3] = {view.cameraPosition.x, view.cameraPosition.y,
+                        view.cameraPosition.z};
+  const float boxMin[3] = {view.boxCenter.x - view.boxHalfSize,
+                           view.boxCenter.y - view.boxHalfSize,
+                           view.boxCenter.z - view.boxHalfSize};
+  const float boxMax[3] = {view.boxCenter.x + view.boxHalfSize,
+                           view.boxCenter.y + view.boxHalfSize,
+                           view.boxCenter.z + view.boxHalfSize};
+
+  const Packet origin = {Set1(eye[0]), Set1(eye[1]), Set1(eye[2])};
+  const vfloat zero = Set1(0.0f);
+  const vfloat surfaceDistance = Set1(SURF_DIST);
+
+  for (uint32_t y0 = tileY; y0 < tileEndY; y0 += PACKET_ROWS) {
+    for (uint32_t x0 = tileX; x0 < tileEndX; x0 += PACKET_COLUMNS) {
+      float direction[3][kWidth];
+      float tNear[kWidth];
+      float tFar[kWidth];
+      uint32_t* pixels[kWidth];
+      uint32_t active = 0;
+      for (uint32_t l = 0; l < kWidth; l++) {
+        direction[0][l] = direction[1][l] = direction[2][l] = 0.0f;
+        tNear[l] = tFar[l] = 0.0f;
+        pixels[l] = nullptr;
+        const uint32_t x = x0 + l % PACKET_COLUMNS;
+        const uint32_t y = y0 + l / PACKET_COLUMNS;
+        if (x >= tileEndX || y >= tileEndY) continue;
+        pixels[l] = &m_pixels[static_cast<size_t>(y) * m_width + x];
+        *pixels[l] = 0xFF000000;
+
+        // the pixel's center on the near plane, like SV_POSITION
+        const float clip[4] = {2.0f * (x + 0.5f) / m_width - 1.0f,
+                               -2.0f * (y + 0.5f) / m_height + 1.0f, 0.0f,
+                               1.0f};
+        float world[4];
+        for (uint32_t c = 0; c < 4; c++) {
+          world[c] = 0.0f;
+          for (uint32_t r = 0; r < 4; r++)
+            world[c] += clip[r] * clipToWorld[r][c];
+        }
+        // The shader leaves out the divide by w, which is 1 only for the
+        // engine's near plane at 1.
+        float3 dir = Normalize(Make(world[0] / world[3] - eye[0],
+                                    world[1] / world[3] - eye[1],
+                                    world[2] / world[3] - eye[2]));
+        direction[0][l] = dir.x;
+        direction[1][l] = dir.y;
+        direction[2][l] = dir.z;
+
+        // ComputeAABBHits() of Header.hlsli
+        const float d[3] = {dir.x, dir.y, dir.z};
+        float largestMin = -INFINITY;
+        float smallestMax = INFINITY;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+          const float invR = 1.0f / d[axis];
+          const float bottom = invR * (boxMin[axis] - eye[axis]);
+          const float top = invR * (boxMax[axis] - eye[axis]);
+          largestMin = std::max(largestMin, std::min(bottom, top));
+          smallestMax = std::min(smallestMax, std::max(bottom, top));
+        }
+        tNear[l] = std::max(largestMin, 0.0f);
+        tFar[l] = smallestMax;
+        if (tNear[l] <= tFar[l]) active |= 1u << l;
+      }
+      stats.rays += CountLanes(active);
+
+      const Packet dir = {Load(direction[0]), Load(direction[1]),
+                          Load(direction[2])};
+      const vfloat far = Load(tFar);
+      vfloat t = Load(tNear);
+      vfloat hitT = zero;
+      uint32_t hit = 0;
+      for (uint32_t step = 0; step < MAX_STEPS && active != 0; step++) {
+        const vfloat distance = Distance(grid, Along(origin, dir, t), active);
+        stats.steps += CountLanes(active);
+
+        const uint32_t surface = active & ~MoveMask(distance > zero);
+        hitT = Select(FromBits(surface), t, hitT);
+        hit |= surface;
+        active &= ~surface;
+
+        t = t + Max(distance, surfaceDistance);
+        active &= ~MoveMask(t > far);
+      }
+
+      if (hit == 0) continue;
+      stats.hits += CountLanes(hit);
+
+      // bisect the last SURF_DIST before each hit, all hit lanes at once
+      Packet end = Along(origin, dir, hitT);
+      Packet begin = Along(origin, dir, hitT - surfaceDistance);
+      Packet mid = end;
+      const vfloat half = Set1(0.5f);
+      for (uint32_t j = 0; j < SURF_REFINEMENT; j++) {
+        mid = {(begin.x + end.x) * half, (begin.y + end.y) * half,
+               (begin.z + end.z) * half};
+        const vmask outside = Distance(grid, mid, hit) > zero;
+        stats.steps += CountLanes(hit);
+        begin = {Select(outside, mid.x, begin.x),
+                 Select(outside, mid.y, begin.y),
+                 Select(outside, mid.z, begin.z)};
+        end = {Select(outside, end.x, mid.x), Select(outside, end.y, mid.y),
+               Select(outside, end.z, mid.z)};
+      }
+
+      float hitPos[3][kWidth];
+      Store(hitPos[0], mid.x);
+      Store(hitPos[1], mid.y);
+      Store(hitPos[2], mid.z);
+      for (uint32_t l = 0; l < kWidth; l++) {
+        if (((hit >> l) & 1) == 0) continue;
+        *pixels[l] =
+            Shade(grid, view, Make(hitPos[0][l], hitPos[1][l], hitPos[2][l]));
+      }
+    }
+  }
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MetaballGrid.h"
+
+namespace my {
+// The quadRenderer constants PS_RayMARCH.hlsl reads, in the row-vector
+// convention of Camera (the CPU side before the transpose).
+struct RayMarchView {
+  float3 cameraPosition;  // posCam
+  float4x4 clipToWorld;   // matPS2WS
+  float3 lightPosition;   // posLight
+  float lightIntensity;
+  uint32_t lightColor;    // packed like Particle::color
+  float3 boxCenter;       // distBoxCenter
+  float boxHalfSize;      // distBoxSize
+};
+
+// Headless twin of PS_RayMARCH.hlsl over a MetaballGrid: every pixel's ray
+// is clipped to the distBox, sphere traced with the shader's MAX_STEPS,
+// SURF_DIST and SURF_REFINEMENT bisection, and shaded with the fused
+// MetaballGrid::GetSurface() and Blinn-Phong into an RGBA8 image. Unlike
+// the shader, a ray stops once it leaves the box instead of finishing its
+// steps; nothing is baked outside the box, so it would only have found
+// spheres sticking out of it.
+//
+// Rays are traced in packets of simd::kWidth neighbouring pixels of a row
+// with a mask of the lanes still marching, so a packet is done when its
+// last ray is. The lanes of a packet evaluate the field together: the
+// spheres of a grid cell are walked once for all lanes inside it, which
+// for coherent rays is all of them. The image is split into TILE_SIZE
+// tiles, one job each.
+class MetaballRayMarcherCPU {
+ public:
+  static const uint32_t TILE_SIZE = 16;
+
+  struct Stats {
+    uint64_t rays = 0;   // that entered the box
+    uint64_t hits = 0;
+    uint64_t steps = 0;  // field evaluations of single rays, refinement too
+    double milliseconds = 0.0;  // of the last Render()
+  };
+
+  void Resize(uint32_t width, uint32_t height);
+
+  // Renders the field of grid, which must have been built for view's box.
+  void Render(const MetaballGrid& grid, const RayMarchView& view);
+
+  uint32_t GetWidth() const { return m_width; }
+  uint32_t GetHeight() const { return m_height; }
+
+  // Rows top to bottom, one packed RGBA8 pixel each.
+  const std::vector<uint32_t>& GetPixels() const { return m_pixels; }
+
+  bool WritePNG(const std::string& path) const;
+
+  const Stats& GetStats() const { return m_stats; }
+
+ private:
+  void RenderTile(uint32_t tile, const MetaballGrid& grid,
+                  const RayMarchView& view, Stats& stats);
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  uint32_t m_tilesX = 0;
+  uint32_t m_tilesY = 0;
+  std::vector<uint32_t> m_pixels;
+  std::vector<Stats> m_tileStats;
+
+  Stats m_stats;
+};
+}  // namespace my
\ No newline at end of file
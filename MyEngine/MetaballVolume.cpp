@@ -0,0 +1,220 @@
+#include "MetaballVolume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "JobSystem.h"
+
+namespace my {
+namespace {
+const uint32_t SAMPLES_PER_AXIS = MetaballVolume::BRICK_SIZE + 1;
+const uint32_t SAMPLES_PER_BRICK =
+    SAMPLES_PER_AXIS * SAMPLES_PER_AXIS * SAMPLES_PER_AXIS;
+}  // namespace
+
+void MetaballVolume::Build(const MetaballGrid& grid, const float3& boxCenter,
+                           float boxHalfSize) {
+  const MetaballGridCB& gridCB = grid.GetConstants();
+  const float cutoff = gridCB.cutoff;
+  m_cutoff = cutoff;
+  const float boxSize = 2.0f * std::max(boxHalfSize, 0.0f);
+
+  const uint32_t brickDim =
+      std::max((m_settings.resolution + BRICK_SIZE - 1) / BRICK_SIZE, 1u);
+  const float voxelSize = boxSize / (brickDim * BRICK_SIZE);
+  const float band = m_settings.band * voxelSize;
+
+  m_constants.volumeMin.x = boxCenter.x - boxSize / 2;
+  m_constants.volumeMin.y = boxCenter.y - boxSize / 2;
+  m_constants.volumeMin.z = boxCenter.z - boxSize / 2;
+  m_constants.voxelSize = voxelSize;
+  m_constants.brickDim = brickDim;
+  m_constants.brickSamples = SAMPLES_PER_BRICK;
+
+  MetaballBrick empty;
+  empty.index = NO_SAMPLES;
+  empty.value = cutoff;
+  m_bricks.assign(static_cast<size_t>(brickDim) * brickDim * brickDim, empty);
+
+  // Bricks overlapping a grid cell that lists a sphere; the field is cutoff
+  // everywhere else.
+  const std::vector<MetaballCell>& cells = grid.GetCells();
+  const float brickSize = voxelSize * BRICK_SIZE;
+  const float gridMin[3] = {gridCB.gridMin.x, gridCB.gridMin.y,
+                            gridCB.gridMin.z};
+  const float volumeMin[3] = {m_constants.volumeMin.x,
+                              m_constants.volumeMin.y,
+                              m_constants.volumeMin.z};
+  m_candidates.clear();
+  for (uint32_t z = 0; z < brickDim; z++) {
+    for (uint32_t y = 0; y < brickDim; y++) {
+      for (uint32_t x = 0; x < brickDim; x++) {
+        const uint32_t brick[3] = {x, y, z};
+        int32_t lo[3], hi[3];
+        for (uint32_t axis = 0; axis < 3; axis++) {
+          const float begin = volumeMin[axis] + brick[axis] * brickSize;
+          const int32_t last = static_cast<int32_t>(gridCB.gridDim[axis]) - 1;
+          lo[axis] = static_cast<int32_t>(
+              std::floor((begin - gridMin[axis]) / gridCB.cellSize));
+          hi[axis] = static_cast<int32_t>(std::floor(
+              (begin + brickSize - gridMin[axis]) / gridCB.cellSize));
+          lo[axis] = std::min(std::max(lo[axis], 0), last);
+          hi[axis] = std::min(std::max(hi[axis], 0), last);
+        }
+
+        bool reached = false;
+        for (int32_t cz = lo[2]; cz <= hi[2] && !reached; cz++) {
+          for (int32_t cy = lo[1]; cy <= hi[1] && !reached; cy++) {
+            for (int32_t cx = lo[0]; cx <= hi[0] && !reached; cx++) {
+              reached = cells[(cz * gridCB.gridDim[1] + cy) *
+                                  gridCB.gridDim[0] +
+                              cx].count > 0;
+            }
+          }
+        }
+        if (reached) m_candidates.push_back((z * brickDim + y) * brickDim + x);
+      }
+    }
+  }
+
+  // Evaluate the candidates into slots in candidate order, then keep the
+  // ones the surface passes through, packed in the same order.
+  const uint32_t candidateCount = static_cast<uint32_t>(m_candidates.size());
+  m_samples.resize(static_cast<size_t>(candidateCount) * SAMPLES_PER_BRICK);
+
+  const float halfDiagonal = 0.8661f * brickSize;
+  JobSystem::Dispatch(candidateCount, 1, [&](JobArgs args) {
+    const uint32_t brick = m_candidates[args.jobIndex];
+    const uint32_t bx = brick % brickDim;
+    const uint32_t by = brick / brickDim % brickDim;
+    const uint32_t bz = brick / brickDim / brickDim;
+    float* samples = &m_samples[size_t(args.jobIndex) * SAMPLES_PER_BRICK];
+    MetaballBrick& entry = m_bricks[brick];
+
+    // The field changes by at most the distance moved, so a brick whose
+    // center is farther from the surface than its half diagonal (plus the
+    // band) lies wholly outside or inside, and one sample settles it.
+    float3 center;
+    center.x = volumeMin[0] + (bx + 0.5f) * brickSize;
+    center.y = volumeMin[1] + (by + 0.5f) * brickSize;
+    center.z = volumeMin[2] + (bz + 0.5f) * brickSize;
+    const float centerValue = grid.GetDistance(center);
+    if (centerValue - halfDiagonal >= band) {
+      entry.value = centerValue - halfDiagonal;
+      return;
+    }
+    if (centerValue + halfDiagonal <= -band) {
+      entry.value = centerValue + halfDiagonal;
+      return;
+    }
+
+    float lowest = cutoff;
+    float highest = -cutoff;
+    for (uint32_t z = 0; z < SAMPLES_PER_AXIS; z++) {
+      for (uint32_t y = 0; y < SAMPLES_PER_AXIS; y++) {
+        for (uint32_t x = 0; x < SAMPLES_PER_AXIS; x++) {
+          float3 pos;
+          pos.x = volumeMin[0] + (bx * BRICK_SIZE + x) * voxelSize;
+          pos.y = volumeMin[1] + (by * BRICK_SIZE + y) * voxelSize;
+          pos.z = volumeMin[2] + (bz * BRICK_SIZE + z) * voxelSize;
+          const float value = grid.GetDistance(pos);
+          *samples++ = value;
+          lowest = std::min(lowest, value);
+          highest = std::max(highest, value);
+        }
+      }
+    }
+
+    // No point of the brick is farther than half a voxel diagonal from a
+    // sample, so that much less than the lowest sample is a safe step.
+    if (lowest >= band) {
+      entry.value = lowest - 0.8661f * voxelSize;
+    } else if (highest <= -band) {
+      entry.value = highest;
+    } else {
+      entry.index = args.jobIndex;
+      entry.value = 0.0f;
+    }
+  });
+
+  m_allocatedBricks = 0;
+  for (uint32_t i = 0; i < candidateCount; i++) {
+    MetaballBrick& entry = m_bricks[m_candidates[i]];
+    if (entry.index == NO_SAMPLES) continue;
+
+    if (i != m_allocatedBricks) {
+      memmove(&m_samples[size_t(m_allocatedBricks) * SAMPLES_PER_BRICK],
+              &m_samples[size_t(i) * SAMPLES_PER_BRICK],
+              SAMPLES_PER_BRICK * sizeof(float));
+    }
+    entry.index = m_allocatedBricks++;
+  }
+  m_samples.resize(static_cast<size_t>(m_allocatedBricks) * SAMPLES_PER_BRICK);
+}
+
+float MetaballVolume::GetDistance(const float3& pos) const {
+  const float p[3] = {pos.x, pos.y, pos.z};
+  const float volumeMin[3] = {m_constants.volumeMin.x,
+                              m_constants.volumeMin.y,
+                              m_constants.volumeMin.z};
+  const uint32_t brickDim = m_constants.brickDim;
+
+  uint32_t brick[3];
+  uint32_t cell[3];
+  float t[3];
+  for (uint32_t axis = 0; axis < 3; axis++) {
+    const float voxel = (p[axis] - volumeMin[axis]) / m_constants.voxelSize;
+    const float b = std::floor(voxel / BRICK_SIZE);
+    // nothing was baked outside the box; the grid reads cutoff there too
+    if (!(b >= 0.0f && b < static_cast<float>(brickDim))) return m_cutoff;
+    brick[axis] = static_cast<uint32_t>(b);
+    const float local = voxel - b * BRICK_SIZE;
+    cell[axis] = std::min(static_cast<uint32_t>(local), BRICK_SIZE - 1);
+    t[axis] = local - cell[axis];
+  }
+
+  const MetaballBrick& entry =
+      m_bricks[(brick[2] * brickDim + brick[1]) * brickDim + brick[0]];
+  if (entry.index == NO_SAMPLES) return entry.value;
+
+  const float* s = &m_samples[size_t(entry.index) * SAMPLES_PER_BRICK];
+  auto at = [&](uint32_t dx, uint32_t dy, uint32_t dz) {
+    return s[((cell[2] + dz) * SAMPLES_PER_AXIS + cell[1] + dy) *
+                 SAMPLES_PER_AXIS +
+             cell[0] + dx];
+  };
+  auto lerp = [](float a, float b, float f) { return a + f * (b - a); };
+
+  const float x00 = lerp(at(0, 0, 0), at(1, 0, 0), t[0]);
+  const float x10 = lerp(at(0, 1, 0), at(1, 1, 0), t[0]);
+  const float x01 = lerp(at(0, 0, 1), at(1, 0, 1), t[0]);
+  const float x11 = lerp(at(0, 1, 1), at(1, 1, 1), t[0]);
+  return lerp(lerp(x00, x10, t[1]), lerp(x01, x11, t[1]), t[2]);
+}
+
+float3 MetaballVolume::GetNormal(const float3& pos) const {
+  const float epsilon = 0.01f;
+  const float distance = GetDistance(pos);
+
+  float3 p = pos;
+  float3 normal;
+  p.x -= epsilon;
+  normal.x = distance - GetDistance(p);
+  p.x = pos.x;
+  p.y -= epsilon;
+  normal.y = distance - GetDistance(p);
+  p.y = pos.y;
+  p.z -= epsilon;
+  normal.z = distance - GetDistance(p);
+
+  const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y +
+                                 normal.z * normal.z);
+  if (length > 0.0f) {
+    normal.x /= length;
+    normal.y /= length;
+    normal.z /= length;
+  }
+  return normal;
+}
+}  // namespace my
\ No newline at end of file
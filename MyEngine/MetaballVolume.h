@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MetaballGrid.h"
+
+namespace my {
+// Twins of the distance volume structures in hlsl/Header.hlsli.
+struct MetaballBrick {
+  uint index;   // of the brick's samples, or MetaballVolume::NO_SAMPLES
+  float value;  // what the whole brick reads when it has no samples
+};
+
+struct alignas(16) MetaballVolumeCB {
+  float3 volumeMin;  // WS
+  float voxelSize;
+  uint brickDim;  // bricks per axis
+  uint brickSamples;  // (BRICK_SIZE + 1)^3
+  uint padding[2];
+};
+
+// Sparse, baked version of the metaball field of a MetaballGrid: the
+// distBox is split into bricks of BRICK_SIZE^3 voxels, and only bricks the
+// surface passes through (within band voxels) keep their (BRICK_SIZE + 1)^3
+// corner samples, which the marcher interpolates trilinearly. Every other
+// brick reads one value: a safe step below its smallest sample when it lies
+// outside, its largest sample when inside, and the grid's cutoff when no
+// sphere reaches it, so a step costs the same however many particles there
+// are.
+//
+// Build() evaluates the bricks in parallel on the job system; a brick only
+// reads the grid, so no two jobs write the same memory.
+class MetaballVolume {
+ public:
+  static const uint32_t BRICK_SIZE = 8;
+  static const uint32_t NO_SAMPLES = 0xFFFFFFFF;
+
+  struct Settings {
+    uint32_t resolution = 64;  // voxels per axis, rounded up to bricks
+    float band = 2.0f;          // in voxels
+  };
+
+  Settings& GetSettings() { return m_settings; }
+
+  // Bakes the field of grid, which must have been built for the same box.
+  void Build(const MetaballGrid& grid, const float3& boxCenter,
+             float boxHalfSize);
+
+  float GetDistance(const float3& pos) const;
+  float3 GetNormal(const float3& pos) const;
+
+  uint32_t GetAllocatedBrickCount() const { return m_allocatedBricks; }
+
+  // What the shader binds: cbMetaballVolume and the two buffers.
+  const MetaballVolumeCB& GetConstants() const { return m_constants; }
+  const std::vector<MetaballBrick>& GetBricks() const { return m_bricks; }
+  const std::vector<float>& GetSamples() const { return m_samples; }
+
+ private:
+  Settings m_settings;
+  MetaballVolumeCB m_constants = {};
+  float m_cutoff = 0.0f;
+  uint32_t m_allocatedBricks = 0;
+
+  std::vector<MetaballBrick> m_bricks;
+  std::vector<float> m_samples;
+  std::vector<uint32_t> m_candidates;  // bricks some sphere reaches
+};
+}  // namespace my
\ No newline at end of file
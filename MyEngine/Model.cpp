@@ -1,35 +1,28 @@
 #include "Model.h"
 
+#include "RHID3D11.h"
+
 using Microsoft::WRL::ComPtr;
 using namespace DirectX::SimpleMath;
 
 namespace my {
 void Model::Initialize(const ComPtr<ID3D11Device>& device,
                        const ComPtr<ID3D11DeviceContext>& context,
+                       rhi::ConstantBufferCache& constantBuffers,
                        const std::string& fileName) {
   auto models = GeometryGenerator::LoadModel(fileName);
 
-  Initialize(device, context, models);
+  Initialize(device, context, constantBuffers, models);
 }
 
 void Model::Initialize(const ComPtr<ID3D11Device>& device,
                        const ComPtr<ID3D11DeviceContext>& context,
+                       rhi::ConstantBufferCache& constantBuffers,
                        const std::vector<MeshData>& models) {
-  D3D11_BUFFER_DESC bd = {};
-  bd.ByteWidth = sizeof(objectConstants);
-  bd.Usage = D3D11_USAGE_DYNAMIC;
-  bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-  bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-
-  D3D11_SUBRESOURCE_DATA initData = {};
-  initData.pSysMem = &m_objectConstants;
-
-  device->CreateBuffer(&bd, &initData, &m_objectCB);
-
-  bd.ByteWidth = sizeof(materialConstants);
-  initData.pSysMem = &m_materialConstants;
-
-  device->CreateBuffer(&bd, &initData, &m_materialCB);
+  m_objectCB =
+      constantBuffers.Create(sizeof(objectConstants), &m_objectConstants);
+  m_materialCB =
+      constantBuffers.Create(sizeof(materialConstants), &m_materialConstants);
 
   for (const auto& x : models) {
     std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
@@ -80,27 +73,27 @@ void Model::Initialize(const ComPtr<ID3D11Device>& device,
     device->CreateShaderResourceView(mesh->indexBuffer.Get(), &srvDesc,
                                      &mesh->indexBufferSRV);
 
+    // kept for building emission sets, which depend on the emitter transform
+    mesh->positions.assign(reinterpret_cast<const float*>(vertices.data()),
+                           reinterpret_cast<const float*>(vertices.data()) +
+                               vertices.size() * 3);
+    mesh->indices.assign(x.indices.begin(), x.indices.end());
+
     m_meshes.push_back(mesh);
   }
 }
 
-void Model::Update(const ComPtr<ID3D11Device>& device,
+void Model::Update(rhi::ConstantBufferCache& constantBuffers,
                    const ComPtr<ID3D11DeviceContext>& context) {
   m_objectConstants.world = m_transform.Transpose();
 
-  D3D11_MAPPED_SUBRESOURCE mappedResource = {};
-  context->Map(m_objectCB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0,
-               &mappedResource);
-  memcpy(mappedResource.pData, &m_objectConstants, sizeof(objectConstants));
-  context->Unmap(m_objectCB.Get(), 0);
-
-  context->Map(m_materialCB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0,
-               &mappedResource);
-  memcpy(mappedResource.pData, &m_materialConstants, sizeof(materialConstants));
-  context->Unmap(m_materialCB.Get(), 0);
+  constantBuffers.Update(m_objectCB, &m_objectConstants);
+  constantBuffers.Update(m_materialCB, &m_materialConstants);
 
-  context->VSSetConstantBuffers(10, 1, m_objectCB.GetAddressOf());
-  context->PSSetConstantBuffers(10, 1, m_materialCB.GetAddressOf());
+  ID3D11Buffer* objectCB = rhi::D3D11Device::GetNative(m_objectCB);
+  ID3D11Buffer* materialCB = rhi::D3D11Device::GetNative(m_materialCB);
+  context->VSSetConstantBuffers(10, 1, &objectCB);
+  context->PSSetConstantBuffers(10, 1, &materialCB);
 }
 
 void Model::Draw(const ComPtr<ID3D11DeviceContext>& context) {
@@ -11,6 +11,7 @@
 #include "GeometryGenerator.h"
 #include "Mesh.h"
 #include "MeshData.h"
+#include "RHIConstantBufferCache.h"
 #include "SimpleMath.h"
 
 struct objectConstants {
@@ -29,19 +30,24 @@ class Model {
   ~Model() {
     m_meshes.clear();
 
-    m_objectCB.Reset();
-    m_materialCB.Reset();
+    m_objectCB.reset();
+    m_materialCB.reset();
   }
 
+  // The constant buffers are created on, and uploaded through,
+  // constantBuffers, whose device must wrap device.
   void Initialize(const Microsoft::WRL::ComPtr<ID3D11Device>& device,
                   const Microsoft::WRL::ComPtr<ID3D11DeviceContext>& context,
+                  rhi::ConstantBufferCache& constantBuffers,
                   const std::string& fileName);
 
   void Initialize(const Microsoft::WRL::ComPtr<ID3D11Device>& device,
                   const Microsoft::WRL::ComPtr<ID3D11DeviceContext>& context,
+                  rhi::ConstantBufferCache& constantBuffers,
                   const std::vector<MeshData>& models);
 
-  void Update(const Microsoft::WRL::ComPtr<ID3D11Device>& device,
+  // Uploads the constants that changed since the last call.
+  void Update(rhi::ConstantBufferCache& constantBuffers,
               const Microsoft::WRL::ComPtr<ID3D11DeviceContext>& context);
 
   void Draw(const Microsoft::WRL::ComPtr<ID3D11DeviceContext>& context);
@@ -54,7 +60,7 @@ class Model {
   objectConstants m_objectConstants;
   materialConstants m_materialConstants;
 
-  Microsoft::WRL::ComPtr<ID3D11Buffer> m_objectCB;
-  Microsoft::WRL::ComPtr<ID3D11Buffer> m_materialCB;
+  rhi::BufferPtr m_objectCB;
+  rhi::BufferPtr m_materialCB;
 };
 }  // namespace my
\ No newline at end of file
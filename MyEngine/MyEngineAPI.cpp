@@ -13,8 +13,8 @@ ComPtr<ID3D11DeviceContext> g_context;
 // Resources
 ComPtr<ID3D11Texture2D> g_renderTargetBuffer;
 ComPtr<ID3D11Texture2D> g_depthStencilBuffer;
-ComPtr<ID3D11Buffer> g_frameCB;
-ComPtr<ID3D11Buffer> g_quadRendererCB;
+my::rhi::BufferPtr g_frameCB;         // through my::constantBuffers
+my::rhi::BufferPtr g_quadRendererCB;  // through my::constantBuffers
 
 // Views
 ComPtr<ID3D11RenderTargetView> g_renderTargetView;
@@ -37,8 +37,21 @@ ComPtr<ID3D11InputLayout> g_inputLayout;
 namespace my {
 bool isWireframe = false;
 
+// Simulation steps run so far; the emit kernels seed their RNG with it.
 uint32_t frameCount = 0;
 
+FixedTimestep simulationClock;
+
+// Steps banked by Update() for the next DoTest() to simulate.
+uint32_t pendingSteps = 0;
+
+// Passes of the frame DoTest() renders, rebuilt every frame.
+RenderGraph frameGraph;
+
+// Every dynamic constant buffer of the engine, the particle world's included,
+// is uploaded through it, so unchanged ones are skipped.
+std::unique_ptr<rhi::ConstantBufferCache> constantBuffers;
+
 PointLight pointLight;
 
 Camera camera;
@@ -52,322 +65,206 @@ float distBoxSize;
 
 std::unordered_map<std::string, std::shared_ptr<Model>> models;
 
+// Every mesh of every model, which the particles collide with, and the model
+// each collider mesh belongs to.
+MeshBVH modelCollider;
+std::vector<std::shared_ptr<Model>> colliderModels;
+
+// Rebuilds modelCollider from the models and hands it to the particle world.
+void BuildModelCollider() {
+  modelCollider.Clear();
+  colliderModels.clear();
+  for (const auto& model : models) {
+    if (model.second == nullptr) continue;
+    for (const auto& mesh : model.second->m_meshes) {
+      modelCollider.AddMesh(mesh->positions.data(), mesh->indices.data(),
+                            static_cast<uint32_t>(mesh->indices.size()),
+                            model.second->m_transform);
+      colliderModels.push_back(model.second);
+    }
+  }
+  modelCollider.Build();
+}
+
+// Baked distance field of every model, which the particles collide with
+// instead of modelCollider while distanceCollision is set, and the model of
+// each. The fields are signed by ray parity, which needs closed meshes, so
+// the swept BVH stays the default; they are baked the first time
+// distanceCollision is turned on.
+SDFColliderSet modelDistanceColliders;
+std::vector<std::shared_ptr<Model>> distanceColliderModels;
+bool distanceCollision = false;
+bool distanceCollidersBuilt = false;
+
+// Baked fields are cached here so later runs skip the bake. The directory is
+// created on the first bake and is not part of the repository.
+const std::string distanceFieldCache = "../assets/cache/";
+
+// Rebuilds modelDistanceColliders from the models, baking only the fields
+// that are not cached yet.
+void BuildModelDistanceColliders() {
+  distanceCollidersBuilt = true;
+  modelDistanceColliders.Clear();
+  distanceColliderModels.clear();
+  std::error_code error;
+  std::filesystem::create_directories(distanceFieldCache, error);
+  for (const auto& model : models) {
+    if (model.second == nullptr) continue;
+    MeshSDF field;
+    for (const auto& mesh : model.second->m_meshes) {
+      field.AddMesh(mesh->positions.data(), mesh->indices.data(),
+                    static_cast<uint32_t>(mesh->indices.size()));
+    }
+    const std::string path = distanceFieldCache + model.first + ".msdf";
+    if (!field.BuildCached(path))
+      g_apiLogger->warn("Could not cache the distance field in {}.", path);
+    if (field.IsEmpty()) continue;
+    modelDistanceColliders.Add(field, model.second->m_transform);
+    distanceColliderModels.push_back(model.second);
+  }
+}
+
+// Hands the particle world the colliders distanceCollision picks.
+void SelectModelColliders() {
+  if (distanceCollision && !distanceCollidersBuilt)
+    BuildModelDistanceColliders();
+  ParticleSystem::world.SetCollider(distanceCollision ? nullptr
+                                                      : &modelCollider);
+  ParticleSystem::world.SetDistanceColliders(
+      distanceCollision ? &modelDistanceColliders : nullptr);
+}
+
 D3D11_VIEWPORT viewport;
 
 int renderTargetWidth;
 int renderTargetHeight;
 
 namespace ParticleSystem {
-void CreateSelfBuffers() {
-  // Particle buffer:
-  {
-    D3D11_BUFFER_DESC bd = {};
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(Particle) * MAX_PARTICLES;
-    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
-    bd.CPUAccessFlags = 0;
-    bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-    bd.StructureByteStride = sizeof(Particle);
-
-    HRESULT hr = g_device->CreateBuffer(
-        &bd, nullptr, particleBuffer.ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-    srvDesc.BufferEx.NumElements = MAX_PARTICLES;
-
-    hr = g_device->CreateShaderResourceView(
-        particleBuffer.Get(), &srvDesc,
-        particleBufferSRV.ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateShaderResourceView Failed.");
+EmitterID CreateEmitter() { return world.GetRegistry().Create(); }
 
-    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-    uavDesc.Format = DXGI_FORMAT_UNKNOWN;
-    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-    uavDesc.Buffer.NumElements = MAX_PARTICLES;
+void DestroyEmitter(EmitterID id) { world.GetRegistry().Destroy(id); }
 
-    hr = g_device->CreateUnorderedAccessView(
-        particleBuffer.Get(), &uavDesc,
-        particleBufferUAV.ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateUnorderedAccessView Failed.");
-  }
-
-  // Alive index lists (double buffered):
-  {
-    D3D11_BUFFER_DESC bd = {};
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(uint32_t) * MAX_PARTICLES;
-    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
-    bd.CPUAccessFlags = 0;
-    bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-    bd.StructureByteStride = sizeof(uint32_t);
-
-    HRESULT hr = g_device->CreateBuffer(&bd, nullptr,
-                                        aliveList[0].ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-
-    hr = g_device->CreateBuffer(&bd, nullptr,
-                                aliveList[1].ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-    srvDesc.BufferEx.NumElements = MAX_PARTICLES;
-
-    hr = g_device->CreateShaderResourceView(
-        aliveList[0].Get(), &srvDesc, aliveListSRV[0].ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateShaderResourceView Failed.");
+ParticleEmitter* GetEmitter(EmitterID id) {
+  return world.GetRegistry().Get(id);
+}
 
-    hr = g_device->CreateShaderResourceView(
-        aliveList[1].Get(), &srvDesc, aliveListSRV[1].ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateShaderResourceView Failed.");
+uint32_t GetEmitterCount() {
+  return static_cast<uint32_t>(world.GetRegistry().GetEmitters().size());
+}
 
-    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-    uavDesc.Format = DXGI_FORMAT_UNKNOWN;
-    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-    uavDesc.Buffer.NumElements = MAX_PARTICLES;
+EmitterID GetEmitterAt(uint32_t index) {
+  const std::vector<EmitterID> ids = world.GetRegistry().GetEmitters();
+  return index < ids.size() ? ids[index] : INVALID_EMITTER;
+}
 
-    hr = g_device->CreateUnorderedAccessView(
-        aliveList[0].Get(), &uavDesc, aliveListUAV[0].ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateUnorderedAccessView Failed.");
+ParticleWorldSettings* GetWorldSettings() { return &world.GetSettings(); }
 
-    hr = g_device->CreateUnorderedAccessView(
-        aliveList[1].Get(), &uavDesc, aliveListUAV[1].ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateUnorderedAccessView Failed.");
-  }
+ParticleCounters GetStatistics() { return world.GetStatistics(); }
 
-  // Dead index list:
-  {
-    D3D11_BUFFER_DESC bd = {};
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(uint32_t) * MAX_PARTICLES;
-    bd.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-    bd.CPUAccessFlags = 0;
-    bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-    bd.StructureByteStride = sizeof(uint32_t);
-
-    D3D11_SUBRESOURCE_DATA initData = {};
-    std::vector<uint32_t> indices(MAX_PARTICLES);
-    for (uint32_t i = 0; i < MAX_PARTICLES; i++) indices[i] = i;
-    initData.pSysMem = indices.data();
-
-    HRESULT hr = g_device->CreateBuffer(&bd, &initData,
-                                        deadList.ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-
-    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-    uavDesc.Format = DXGI_FORMAT_UNKNOWN;
-    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-    uavDesc.Buffer.NumElements = MAX_PARTICLES;
-
-    hr = g_device->CreateUnorderedAccessView(
-        deadList.Get(), &uavDesc, deadListUAV.ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateUnorderedAccessView Failed.");
-  }
+uint32_t GetStatisticsFrame() { return world.GetStatisticsFrame(); }
 
-  // Particle System statistics:
-  {
-    ParticleCounters counters = {};
-    counters.aliveCount = 0;
-    counters.deadCount = MAX_PARTICLES;
-    counters.realEmitCount = 0;
-    counters.aliveCount_afterSimulation = 0;
-
-    D3D11_BUFFER_DESC bd = {};
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(counters);
-    bd.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-    bd.CPUAccessFlags = 0;
-    bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
-
-    D3D11_SUBRESOURCE_DATA initData = {};
-    initData.pSysMem = &counters;
-
-    HRESULT hr = g_device->CreateBuffer(&bd, &initData,
-                                        counterBuffer.ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-
-    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-    uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-    uavDesc.Buffer.NumElements = sizeof(counters) / sizeof(uint32_t);
-    uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
-
-    hr = g_device->CreateUnorderedAccessView(
-        counterBuffer.Get(), &uavDesc,
-        counterBufferUAV.ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateUnorderedAccessView Failed.");
-  }
+rhi::StateCache::Counters GetStateCacheCounters() {
+  return stateCache ? stateCache->GetLastFrameCounters()
+                    : rhi::StateCache::Counters();
+}
+}  // namespace ParticleSystem
 
-  // Debug information CPU-readback buffer:
-  {
-    D3D11_BUFFER_DESC bd;
-    counterBuffer->GetDesc(&bd);
-    bd.Usage = D3D11_USAGE_STAGING;
-    bd.BindFlags = 0;
-    bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-    bd.MiscFlags = 0;
-
-    HRESULT hr = g_device->CreateBuffer(
-        &bd, nullptr, statisticsReadbackBuffer.ReleaseAndGetAddressOf());
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-  }
+rhi::ConstantBufferCache::Stats GetConstantBufferStats() {
+  return constantBuffers ? constantBuffers->GetLastFrameStats()
+                         : rhi::ConstantBufferCache::Stats();
 }
 
-void UpdateGPU(uint32_t instanceIndex, const std::shared_ptr<Model>& model) {
-  Mesh* mesh = nullptr;
-  if (model != nullptr && model->m_meshes.size() > 0)
-    mesh = model->m_meshes[0].get();
+Camera* GetCamera() { return &my::camera; }
 
-  // Update emitter properties constant buffer.
-  {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
-
-    ParticleSystemCB cb = {};
-    cb.xEmitterWorld = emitter.transform.Transpose();
-    cb.xEmitCount = static_cast<uint32_t>(emit);
-    cb.xEmitterMeshIndexCount = mesh == nullptr ? 0 : mesh->indexCount;
-    cb.xEmitterMeshVertexPositionStride = sizeof(Vector3);
-    cb.xEmitterRandomness = dis(gen);
-    cb.xParticleLifeSpan = emitter.life;
-    cb.xParticleLifeSpanRandomness = emitter.random_life;
-    cb.xParticleNormalFactor = emitter.normal_factor;
-    cb.xParticleRandomFactor = emitter.random_factor;
-    cb.xParticleScaling = emitter.scale;
-    cb.xParticleSize = emitter.size;
-    cb.xParticleRotation = emitter.rotation * XM_PI * 60;
-    cb.xParticleColor = emitter.color;
-    cb.xParticleMass = emitter.mass;
-    cb.xEmitterMaxParticleCount = MAX_PARTICLES;
-    cb.xEmitterRestitution = emitter.restitution;
-    cb.xParticleGravity = float3(emitter.gravity);
-    cb.xParticleDrag = emitter.drag;
-    cb.xParticleVelocity = float3(emitter.velocity);
-    cb.xParticleRandomColorFactor = emitter.random_color;
-
-    D3D11_MAPPED_SUBRESOURCE mappedResource = {};
-    g_context->Map(constantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0,
-                   &mappedResource);
-    memcpy(mappedResource.pData, &cb, sizeof(cb));
-    g_context->Unmap(constantBuffer.Get(), 0);
-  }
+void SetWireframe(bool value) { isWireframe = value; }
 
-  g_context->CSSetConstantBuffers(1, 1, constantBuffer.GetAddressOf());
+bool IsWireframe() { return isWireframe; }
 
-  // kick off updating, set up state
-  {
-    g_context->CSSetShader(ParticleSystem::kickoffUpdateCS.Get(), nullptr, 0);
-    g_context->CSSetUnorderedAccessViews(4, 1, counterBufferUAV.GetAddressOf(),
-                                         nullptr);
-    g_context->Dispatch(1, 1, 1);
+void SetDistanceCollision(bool value) {
+  distanceCollision = value;
+  SelectModelColliders();
+}
 
-    GPUBarrier();
+bool IsDistanceCollision() { return distanceCollision; }
+
+void RunSimulateBenchmark(uint32_t particleCount, uint32_t maxThreads) {
+  auto samples =
+      ParticleBenchmark::RunSimulateScaling(particleCount, 100, maxThreads);
+  for (const auto& sample : samples) {
+    g_apiLogger->info(
+        "Simulate {} particles, {} threads: {:.3f} ms/frame, speedup {:.2f}x, "
+        "efficiency {:.0f}%",
+        particleCount, sample.threadCount, sample.millisecondsPerFrame,
+        sample.speedup, sample.efficiency * 100.0);
   }
+}
 
-  // emit the required amount if there are free slots in dead list
-  {
-    g_context->CSSetShader(
-        mesh == nullptr ? emitCS.Get() : emitCS_FROMMESH.Get(), nullptr, 0);
-    g_context->CSSetUnorderedAccessViews(0, 1, particleBufferUAV.GetAddressOf(),
-                                         nullptr);
-    g_context->CSSetUnorderedAccessViews(1, 1, aliveListUAV[0].GetAddressOf(),
-                                         nullptr);
-    g_context->CSSetUnorderedAccessViews(2, 1, aliveListUAV[1].GetAddressOf(),
-                                         nullptr);
-    g_context->CSSetUnorderedAccessViews(3, 1, deadListUAV.GetAddressOf(),
-                                         nullptr);
-    g_context->CSSetUnorderedAccessViews(4, 1, counterBufferUAV.GetAddressOf(),
-                                         nullptr);
-
-    if (mesh != nullptr) {
-      g_context->CSSetShaderResources(0, 1,
-                                      mesh->vertexBufferSRV.GetAddressOf());
-      g_context->CSSetShaderResources(1, 1,
-                                      mesh->indexBufferSRV.GetAddressOf());
-    }
-
-    g_context->Dispatch(MAX_PARTICLES, 1, 1);
-
-    GPUBarrier();
+void RunFluidBenchmark(uint32_t particleCount, uint32_t maxThreads) {
+  auto samples =
+      ParticleBenchmark::RunFluidScaling(particleCount, 20, maxThreads);
+  for (const auto& sample : samples) {
+    g_apiLogger->info(
+        "SPH {} particles, {} threads: {:.3f} ms/frame, speedup {:.2f}x, "
+        "{:.1f} neighbors per particle",
+        particleCount, sample.threadCount, sample.millisecondsPerFrame,
+        sample.speedup, sample.neighborsPerParticle);
   }
+}
 
-  // update CURRENT alive list, write NEW alive list
-  {
-    g_context->CSSetShader(ParticleSystem::simulateCS.Get(), nullptr, 0);
-    g_context->CSSetUnorderedAccessViews(0, 1, particleBufferUAV.GetAddressOf(),
-                                         nullptr);
-    g_context->CSSetUnorderedAccessViews(1, 1, aliveListUAV[0].GetAddressOf(),
-                                         nullptr);
-    g_context->CSSetUnorderedAccessViews(2, 1, aliveListUAV[1].GetAddressOf(),
-                                         nullptr);
-    g_context->CSSetUnorderedAccessViews(3, 1, deadListUAV.GetAddressOf(),
-                                         nullptr);
-    g_context->CSSetUnorderedAccessViews(4, 1, counterBufferUAV.GetAddressOf(),
-                                         nullptr);
-    g_context->Dispatch(MAX_PARTICLES, 1, 1);
-
-    GPUBarrier();
+void RunNeighborGridBenchmark(uint32_t minParticles, uint32_t maxParticles) {
+  auto samples = ParticleBenchmark::RunNeighborGrid(minParticles,
+                                                    maxParticles, 5, 100000);
+  for (const auto& sample : samples) {
+    g_apiLogger->info(
+        "Neighbor grid {} particles, {} buckets: build {:.3f} ms, query "
+        "{:.1f} ns, {:.1f} neighbors per query",
+        sample.particleCount, sample.bucketCount, sample.buildMilliseconds,
+        sample.queryNanoseconds, sample.neighborsPerQuery);
   }
-
-  // Swap CURRENT alivelist with NEW alivelist
-  std::swap(aliveList[0], aliveList[1]);
-  std::swap(aliveListSRV[0], aliveListSRV[1]);
-  std::swap(aliveListUAV[0], aliveListUAV[1]);
-
-  // Statistics is copied to readback:
-  g_context->CopyResource(statisticsReadbackBuffer.Get(), counterBuffer.Get());
-
-  // Read back statistics
-  D3D11_MAPPED_SUBRESOURCE mappedResource = {};
-  g_context->Map(statisticsReadbackBuffer.Get(), 0, D3D11_MAP_READ, 0,
-                 &mappedResource);
-  memcpy(&statistics, mappedResource.pData, sizeof(statistics));
-  g_context->Unmap(statisticsReadbackBuffer.Get(), 0);
 }
 
-void UpdateCPU(float dt) {
-  emit = std::max(0.0f, emit - std::floor(emit));
-
-  emit += emitter.count * dt;
+void RunMeshBVHBenchmark(uint32_t triangleCount, uint32_t segmentCount) {
+  const BVHSample sample =
+      ParticleBenchmark::RunMeshBVH(triangleCount, segmentCount);
+  g_apiLogger->info(
+      "Mesh BVH {} triangles, {} nodes: build {:.3f} ms, refit {:.3f} ms",
+      sample.triangleCount, sample.nodeCount, sample.buildMilliseconds,
+      sample.refitMilliseconds);
+  auto logRate = [](const char* query, const SegmentQueryRate& rate) {
+    g_apiLogger->info(
+        "Mesh BVH {}: {:.2f} Mrays/s one at a time, {:.2f} Mrays/s as SIMD "
+        "vectors, {:.1f}% hit",
+        query, rate.scalarMegaRaysPerSecond, rate.packetMegaRaysPerSecond,
+        rate.hitRate * 100.0);
+  };
+  logRate("camera rays", sample.cameraRays);
+  logRate("particle steps", sample.particleSteps);
 }
 
-void Draw() {
-  g_context->IASetInputLayout(nullptr);
-
-  g_context->IASetVertexBuffers(0, 0, nullptr, nullptr, nullptr);
-  g_context->IASetIndexBuffer(nullptr, DXGI_FORMAT_UNKNOWN, 0);
-
-  g_context->VSSetShader(vertexShader.Get(), nullptr, 0);
-  g_context->GSSetShader(geometryShader.Get(), nullptr, 0);
-  g_context->PSSetShader(pixelShader.Get(), nullptr, 0);
-  g_context->OMSetBlendState(g_blendState.Get(), nullptr, 0xffffffff);
-
-  g_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
-  g_context->VSSetShaderResources(0, 1, particleBufferSRV.GetAddressOf());
-  g_context->VSSetShaderResources(1, 1, aliveListSRV[0].GetAddressOf());
-  g_context->GSSetShaderResources(0, 1, particleBufferSRV.GetAddressOf());
-  g_context->Draw(MAX_PARTICLES, 0);
-
-  GPUBarrier();
-
-  g_context->Flush();
+void RunMeshSDFBenchmark(uint32_t maxTriangles, uint32_t particleCount) {
+  std::error_code error;
+  std::filesystem::create_directories(distanceFieldCache, error);
+  auto samples = ParticleBenchmark::RunMeshSDF(
+      1000, maxTriangles, particleCount,
+      distanceFieldCache + "benchmark.msdf");
+  for (const auto& sample : samples) {
+    g_apiLogger->info(
+        "Mesh SDF {} triangles: {} of {} bricks baked, {:.2f} MB, bake "
+        "{:.1f} ms, cached load {:.2f} ms, {:.1f} ns per particle, {:.1f} ns "
+        "with the BVH",
+        sample.triangleCount, sample.allocatedBricks, sample.brickCount,
+        sample.megabytes, sample.bakeMilliseconds, sample.loadMilliseconds,
+        sample.distanceNanoseconds, sample.bvhNanoseconds);
+  }
 }
 
-ParticleEmitter* GetParticleEmitter() { return &emitter; }
-
-ParticleCounters GetStatistics() { return statistics; }
-}  // namespace ParticleSystem
-
-Camera* GetCamera() { return &my::camera; }
-
-void SetWireframe(bool value) { isWireframe = value; }
-
-bool IsWireframe() { return isWireframe; }
+void RunForceFieldBenchmark(uint32_t particleCount) {
+  auto samples = ParticleBenchmark::RunForceFields(particleCount, 20);
+  for (const auto& sample : samples) {
+    g_apiLogger->info("Force field {} ({} fields): {:.2f} ns per particle",
+                      sample.name, sample.fieldCount, sample.nanoseconds);
+  }
+}
 
 void SetFloorHeight(float value) { floorHeight = value; }
 
@@ -397,50 +294,20 @@ bool InitEngine(const std::shared_ptr<spdlog::logger>& spdlogPtr) {
   if (featureLevel != D3D_FEATURE_LEVEL_11_0)
     FailRet("Direct3D Feature Level 11 unsupported.");
 
-  // Particle System constant buffer:
-  {
-    D3D11_BUFFER_DESC bd = {};
-    bd.ByteWidth = sizeof(ParticleSystemCB);
-    bd.Usage = D3D11_USAGE_DYNAMIC;
-    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    bd.MiscFlags = 0;
-
-    hr = g_device->CreateBuffer(
-        &bd, nullptr, ParticleSystem::constantBuffer.ReleaseAndGetAddressOf());
-
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-  }
+  ParticleSystem::device =
+      std::make_unique<rhi::D3D11Device>(g_device, g_context);
+  ParticleSystem::stateCache =
+      std::make_unique<rhi::StateCache>(ParticleSystem::device.get());
+  constantBuffers =
+      std::make_unique<rhi::ConstantBufferCache>(ParticleSystem::device.get());
 
   // Frame constant buffer:
-  {
-    D3D11_BUFFER_DESC bd = {};
-    bd.ByteWidth = sizeof(FrameCB);
-    bd.Usage = D3D11_USAGE_DYNAMIC;
-    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    bd.MiscFlags = 0;
-
-    hr = g_device->CreateBuffer(&bd, nullptr,
-                                g_frameCB.ReleaseAndGetAddressOf());
-
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-  }
+  g_frameCB = constantBuffers->Create(sizeof(FrameCB));
+  if (g_frameCB == nullptr) FailRet("CreateBuffer Failed.");
 
   // PostRenderer constant buffer:
-  {
-    D3D11_BUFFER_DESC bd = {};
-    bd.ByteWidth = sizeof(PostRenderer);
-    bd.Usage = D3D11_USAGE_DYNAMIC;
-    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    bd.MiscFlags = 0;
-
-    hr = g_device->CreateBuffer(&bd, nullptr,
-                                g_quadRendererCB.ReleaseAndGetAddressOf());
-
-    if (FAILED(hr)) FailRet("CreateBuffer Failed.");
-  }
+  g_quadRendererCB = constantBuffers->Create(sizeof(PostRenderer));
+  if (g_quadRendererCB == nullptr) FailRet("CreateBuffer Failed.");
 
   D3D11_RASTERIZER_DESC rasterizerDesc = {};
   rasterizerDesc.FillMode = D3D11_FILL_SOLID;
@@ -502,14 +369,40 @@ bool InitEngine(const std::shared_ptr<spdlog::logger>& spdlogPtr) {
       "../assets/models/free_-_tire_001_r17/scene.gltf");
 
   Model tire;
-  tire.Initialize(g_device, g_context, model);
+  tire.Initialize(g_device, g_context, *constantBuffers, model);
   models["tire"] = std::make_shared<Model>(tire);
 
   Matrix m = Matrix::CreateScale(10.0f);
   m *= Matrix::CreateRotationY(XM_PI / 2);
   models["tire"]->m_transform = m;
 
-  ParticleSystem::CreateSelfBuffers();
+  // Emitters sample the CPU copies of the models' first meshes.
+  auto lookupMesh = [](const std::string& name, EmitterMeshCPU& emitterMesh) {
+    auto it = models.find(name);
+    if (it == models.end() || it->second == nullptr ||
+        it->second->m_meshes.empty())
+      return false;
+
+    const Mesh* mesh = it->second->m_meshes[0].get();
+    emitterMesh.positions = mesh->positions.data();
+    emitterMesh.vertexCount =
+        static_cast<uint32_t>(mesh->positions.size() / 3);
+    emitterMesh.indices = mesh->indices.data();
+    emitterMesh.indexCount = static_cast<uint32_t>(mesh->indices.size());
+    return true;
+  };
+
+  // The CPU particle backend and the benchmarks share one worker pool for
+  // the life of the engine.
+  JobSystem::Initialize();
+
+  if (!ParticleSystem::world.Initialize(ParticleSystem::stateCache.get(),
+                                        constantBuffers.get(), lookupMesh,
+                                        g_apiLogger))
+    FailRet("Particle System Initialize Failed.");
+  ParticleSystem::world.GetRegistry().Create();
+  BuildModelCollider();
+  SelectModelColliders();
 
   // Build the view matrix.
   Vector3 pos(0.0f, 0.0f, -5.0f);
@@ -622,28 +515,24 @@ void Update(float dt) {
   models["tire"]->m_transform *= Matrix::CreateRotationZ(dt * -XM_PI * 0.5f);
   for (auto& model : models) {
     if (model.second == nullptr) continue;
-    model.second->Update(g_device, g_context);
+    model.second->Update(*constantBuffers, g_context);
   }
 
-  ParticleSystem::UpdateCPU(dt);
-
-  // Update frame constant buffer.
-  {
-    FrameCB frameCB = {};
-    frameCB.delta_time = dt;
-    frameCB.frame_count = frameCount++;
-
-    D3D11_MAPPED_SUBRESOURCE mappedResource = {};
-    g_context->Map(g_frameCB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0,
-                   &mappedResource);
-    memcpy(mappedResource.pData, &frameCB, sizeof(frameCB));
-    g_context->Unmap(g_frameCB.Get(), 0);
+  // The models only turn, so refitting the collider is enough.
+  for (uint32_t i = 0; i < colliderModels.size(); i++)
+    modelCollider.SetTransform(i, colliderModels[i]->m_transform);
+  modelCollider.Refit();
+  for (uint32_t i = 0; i < distanceColliderModels.size(); i++) {
+    modelDistanceColliders.SetTransform(i,
+                                        distanceColliderModels[i]->m_transform);
   }
 
-  g_context->VSSetConstantBuffers(0, 1, g_frameCB.GetAddressOf());
-  g_context->GSSetConstantBuffers(0, 1, g_frameCB.GetAddressOf());
-  g_context->PSSetConstantBuffers(0, 1, g_frameCB.GetAddressOf());
-  g_context->CSSetConstantBuffers(0, 1, g_frameCB.GetAddressOf());
+  const ParticleWorldSettings& settings = ParticleSystem::world.GetSettings();
+  simulationClock.SetStep(settings.fixed_timestep);
+  simulationClock.SetMaxSubsteps(settings.max_substeps);
+  // The clock caps the steps and counts the dropped ones; DoTest() runs
+  // once per Update(), so nothing is left over from the last frame.
+  pendingSteps = simulationClock.Advance(dt);
 
   // Update post renderer constant buffer.
   {
@@ -663,20 +552,36 @@ void Update(float dt) {
     quadRenderer.distBoxCenter = distBoxCenter;
     quadRenderer.distBoxSize = distBoxSize;
 
-    D3D11_MAPPED_SUBRESOURCE mappedResource = {};
-    g_context->Map(g_quadRendererCB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0,
-                   &mappedResource);
-    memcpy(mappedResource.pData, &quadRenderer, sizeof(quadRenderer));
-    g_context->Unmap(g_quadRendererCB.Get(), 0);
+    constantBuffers->Update(g_quadRendererCB, &quadRenderer);
   }
 
-  g_context->VSSetConstantBuffers(2, 1, g_quadRendererCB.GetAddressOf());
-  g_context->GSSetConstantBuffers(2, 1, g_quadRendererCB.GetAddressOf());
-  g_context->PSSetConstantBuffers(2, 1, g_quadRendererCB.GetAddressOf());
-  g_context->CSSetConstantBuffers(2, 1, g_quadRendererCB.GetAddressOf());
+  ID3D11Buffer* quadRendererCB = rhi::D3D11Device::GetNative(g_quadRendererCB);
+  g_context->VSSetConstantBuffers(2, 1, &quadRendererCB);
+  g_context->GSSetConstantBuffers(2, 1, &quadRendererCB);
+  g_context->PSSetConstantBuffers(2, 1, &quadRendererCB);
+  g_context->CSSetConstantBuffers(2, 1, &quadRendererCB);
 }
 
-bool DoTest() {
+void UpdateFrameCB(double time, float interpolation) {
+  const float step = simulationClock.GetStep();
+
+  FrameCB frameCB = {};
+  frameCB.frame_count = frameCount;
+  frameCB.time = static_cast<float>(time);
+  frameCB.time_previous = static_cast<float>(time - step);
+  frameCB.delta_time = step;
+  frameCB.interpolation = interpolation;
+
+  constantBuffers->Update(g_frameCB, &frameCB);
+
+  ID3D11Buffer* nativeFrameCB = rhi::D3D11Device::GetNative(g_frameCB);
+  g_context->VSSetConstantBuffers(0, 1, &nativeFrameCB);
+  g_context->GSSetConstantBuffers(0, 1, &nativeFrameCB);
+  g_context->PSSetConstantBuffers(0, 1, &nativeFrameCB);
+  g_context->CSSetConstantBuffers(0, 1, &nativeFrameCB);
+}
+
+void DrawModels() {
   const float clearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
   g_context->ClearRenderTargetView(g_renderTargetView.Get(), clearColor);
 
@@ -698,11 +603,63 @@ bool DoTest() {
 
   g_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-  if (models[ParticleSystem::emitter.meshName] != nullptr)
-    models[ParticleSystem::emitter.meshName]->Draw(g_context);
+  for (const std::string& name : ParticleSystem::world.GetGeometryMeshNames())
+    models[name]->Draw(g_context);
 
-  ParticleSystem::UpdateGPU(0, models[ParticleSystem::emitter.meshName]);
-  ParticleSystem::Draw();
+  // The models were drawn behind the state cache's back.
+  ParticleSystem::stateCache->Invalidate();
+}
+
+bool DoTest() {
+  ParticleSystemGPU& world = ParticleSystem::world;
+
+  frameGraph.Reset();
+  const RenderGraph::ResourceHandle frameConstants =
+      frameGraph.ImportResource("frameCB");
+  const RenderGraph::ResourceHandle renderTarget =
+      frameGraph.ImportResource("renderTarget");
+  world.ImportResources(frameGraph);
+
+  frameGraph.AddPass("Models", DrawModels)
+      .Read(frameConstants)
+      .Write(renderTarget);
+
+  // Run the fixed steps banked since the last frame, then draw between the
+  // last two simulated states. The clock time is already at the end of the
+  // last banked step, so each step counts back from it.
+  const bool stepped = pendingSteps > 0;
+  const uint32_t lastFrame = frameCount + pendingSteps;
+  for (; pendingSteps > 0; pendingSteps--) {
+    const double step = simulationClock.GetStep();
+    const double time = simulationClock.GetTime() - (pendingSteps - 1) * step;
+    frameGraph
+        .AddPass("Frame constants",
+                 [time]() {
+                   UpdateFrameCB(time, 1.0f);
+                   frameCount++;
+                 })
+        .Upload(frameConstants)
+        .SideEffect();
+    world.AddStepPasses(frameGraph, simulationClock.GetStep(),
+                        frameConstants);
+  }
+  world.AddStatisticsPass(frameGraph, stepped, lastFrame);
+
+  frameGraph
+      .AddPass("Frame constants",
+               []() {
+                 UpdateFrameCB(simulationClock.GetTime(),
+                               simulationClock.GetInterpolation());
+               })
+      .Upload(frameConstants)
+      .SideEffect();
+  world.AddDrawPass(frameGraph, frameConstants, renderTarget);
+
+  frameGraph.Compile();
+  frameGraph.Execute(ParticleSystem::stateCache.get());
+
+  ParticleSystem::stateCache->EndFrame();
+  constantBuffers->EndFrame();
 
   return true;
 }
@@ -764,33 +721,21 @@ bool GetDX11SharedRenderTarget(ID3D11Device* dx11ImGuiDevice,
 }
 
 void DeinitEngine() {
-  ParticleSystem::statisticsReadbackBuffer.Reset();
-
-  ParticleSystem::particleBuffer.Reset();
-  ParticleSystem::aliveList[0].Reset();
-  ParticleSystem::aliveList[1].Reset();
-  ParticleSystem::deadList.Reset();
-  ParticleSystem::counterBuffer.Reset();
-  ParticleSystem::constantBuffer.Reset();
-  ParticleSystem::particleBufferSRV.Reset();
-  ParticleSystem::particleBufferUAV.Reset();
-  ParticleSystem::aliveListSRV[0].Reset();
-  ParticleSystem::aliveListSRV[1].Reset();
-  ParticleSystem::aliveListUAV[0].Reset();
-  ParticleSystem::aliveListUAV[1].Reset();
-  ParticleSystem::deadListUAV.Reset();
-  ParticleSystem::counterBufferUAV.Reset();
-
-  ParticleSystem::vertexShader.Reset();
-  ParticleSystem::geometryShader.Reset();
-  ParticleSystem::pixelShader.Reset();
-  ParticleSystem::kickoffUpdateCS.Reset();
-  ParticleSystem::emitCS.Reset();
-  ParticleSystem::emitCS_FROMMESH.Reset();
-  ParticleSystem::simulateCS.Reset();
-
+  frameGraph = RenderGraph();  // and its pooled transient buffers
+  ParticleSystem::world.Reset();
+  ParticleSystem::stateCache.reset();
+  constantBuffers.reset();
+  ParticleSystem::device.reset();
+
+  colliderModels.clear();
+  modelCollider.Clear();
+  distanceColliderModels.clear();
+  modelDistanceColliders.Clear();
+  distanceCollidersBuilt = false;
   models.clear();
 
+  JobSystem::ShutDown();
+
   // Input Layouts
   g_inputLayout.Reset();
 
@@ -812,8 +757,8 @@ void DeinitEngine() {
   // Resources
   g_renderTargetBuffer.Reset();
   g_depthStencilBuffer.Reset();
-  g_frameCB.Reset();
-  g_quadRendererCB.Reset();
+  g_frameCB.reset();
+  g_quadRendererCB.reset();
 
   g_context.Reset();
   g_device.Reset();
@@ -869,42 +814,76 @@ bool LoadShaders() {
     return true;
   };
 
-  if (!RegisterShaderObjFile(
-          "VS_ParticleSystem", "VS",
-          reinterpret_cast<ID3D11DeviceChild**>(
-              ParticleSystem::vertexShader.ReleaseAndGetAddressOf())))
-    FailRet("RegisterShaderObjFile Failed.");
-  if (!RegisterShaderObjFile(
-          "GS_ParticleSystem", "GS",
-          reinterpret_cast<ID3D11DeviceChild**>(
-              ParticleSystem::geometryShader.ReleaseAndGetAddressOf())))
-    FailRet("RegisterShaderObjFile Failed.");
-  if (!RegisterShaderObjFile(
-          "PS_ParticleSystem", "PS",
-          reinterpret_cast<ID3D11DeviceChild**>(
-              ParticleSystem::pixelShader.ReleaseAndGetAddressOf())))
-    FailRet("RegisterShaderObjFile Failed.");
+  // The particle shaders are created through the particle world's device.
+  ParticleShaders particleShaders;
+  auto RegisterParticleShader = [&enginePath](
+                                    const std::string& shaderObjFileName,
+                                    rhi::ShaderStage stage,
+                                    rhi::ShaderPtr& shader) -> bool {
+    std::vector<BYTE> byteCode;
+    Helper::ReadData(enginePath + "/hlsl/objs/" + shaderObjFileName, byteCode);
 
-  if (!RegisterShaderObjFile(
-          "CS_ParticleSystem_KickoffUpdate", "CS",
-          reinterpret_cast<ID3D11DeviceChild**>(
-              ParticleSystem::kickoffUpdateCS.ReleaseAndGetAddressOf())))
-    FailRet("RegisterShaderObjFile Failed.");
-  if (!RegisterShaderObjFile(
-          "CS_ParticleSystem_Emit", "CS",
-          reinterpret_cast<ID3D11DeviceChild**>(
-              ParticleSystem::emitCS.ReleaseAndGetAddressOf())))
-    FailRet("RegisterShaderObjFile Failed.");
-  if (!RegisterShaderObjFile(
-          "CS_ParticleSystem_Emit_FROMMESH", "CS",
-          reinterpret_cast<ID3D11DeviceChild**>(
-              ParticleSystem::emitCS_FROMMESH.ReleaseAndGetAddressOf())))
-    FailRet("RegisterShaderObjFile Failed.");
-  if (!RegisterShaderObjFile(
-          "CS_ParticleSystem_Simulate", "CS",
-          reinterpret_cast<ID3D11DeviceChild**>(
-              ParticleSystem::simulateCS.ReleaseAndGetAddressOf())))
-    FailRet("RegisterShaderObjFile Failed.");
+    shader = ParticleSystem::device->CreateShader(stage, byteCode.data(),
+                                                  byteCode.size());
+    if (shader == nullptr) return FailRet("CreateShader Failed.");
+    return true;
+  };
+
+  if (!RegisterParticleShader("VS_ParticleSystem", rhi::ShaderStage::Vertex,
+                              particleShaders.vertex))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("GS_ParticleSystem", rhi::ShaderStage::Geometry,
+                              particleShaders.geometry))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("PS_ParticleSystem", rhi::ShaderStage::Pixel,
+                              particleShaders.pixel))
+    FailRet("RegisterParticleShader Failed.");
+
+  if (!RegisterParticleShader("CS_ParticleSystem_KickoffUpdate",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.kickoffUpdate))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_Emit",
+                              rhi::ShaderStage::Compute, particleShaders.emit))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_Emit_FROMMESH",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.emitFromMesh))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_Simulate",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.simulate))
+    FailRet("RegisterParticleShader Failed.");
+
+  if (!RegisterParticleShader("CS_ParticleSystem_Grow",
+                              rhi::ShaderStage::Compute, particleShaders.grow))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_FinishUpdate",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.finishUpdate))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_SPH_Count",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.sphCount))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_SPH_Offsets",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.sphOffsets))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_SPH_Scatter",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.sphScatter))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_SPH_Density",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.sphDensity))
+    FailRet("RegisterParticleShader Failed.");
+  if (!RegisterParticleShader("CS_ParticleSystem_SPH_Force",
+                              rhi::ShaderStage::Compute,
+                              particleShaders.sphForce))
+    FailRet("RegisterParticleShader Failed.");
+
+  ParticleSystem::world.SetShaders(particleShaders);
 
   if (!RegisterShaderObjFile("VS_Default", "VS",
                              reinterpret_cast<ID3D11DeviceChild**>(
@@ -917,16 +896,4 @@ bool LoadShaders() {
 
   return true;
 }
-
-void GPUBarrier() {
-  const uint32_t numSRVs = D3D11_COMMONSHADER_INPUT_RESOURCE_REGISTER_COUNT;
-  ID3D11ShaderResourceView* nullSRV[numSRVs] = {nullptr};
-  g_context->CSSetShaderResources(0, numSRVs, nullSRV);
-  g_context->VSSetShaderResources(0, numSRVs, nullSRV);
-  g_context->GSSetShaderResources(0, numSRVs, nullSRV);
-
-  const uint32_t numUAVs = D3D11_PS_CS_UAV_REGISTER_COUNT;
-  ID3D11UnorderedAccessView* nullUAV[numUAVs] = {nullptr};
-  g_context->CSSetUnorderedAccessViews(0, numUAVs, nullUAV, nullptr);
-}
 }  // namespace my
\ No newline at end of file
@@ -7,14 +7,28 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
-#include <random>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Camera.h"
+#include "FixedTimestep.h"
 #include "GeometryGenerator.h"
 #include "Helper.h"
+#include "JobSystem.h"
 #include "Model.h"
+#include "ParticleBenchmark.h"
+#include "ParticleEmitterRegistry.h"
+#include "ParticleSystemGPU.h"
+#include "ParticleSystemTypes.h"
+#include "RHIConstantBufferCache.h"
+#include "RHID3D11.h"
+#include "RHIStateCache.h"
+#include "RenderGraph.h"
 #include "SimpleMath.h"
 #include "spdlog/spdlog.h"
 
@@ -24,131 +38,12 @@ using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
 
-using float4x4 = Matrix;
-using float2 = Vector2;
-using float3 = Vector3;
-using uint = uint32_t;
-
-struct Particle {
-  float3 position;
-  float mass;
-  float3 force;
-  float rotationalVelocity;
-  float3 velocity;
-  float maxLife;
-  float2 sizeBeginEnd;
-  float life;
-  uint color;
-};
-
-struct ParticleCounters {
-  uint aliveCount;
-  uint deadCount;
-  uint realEmitCount;
-  uint aliveCount_afterSimulation;
-};
-
-struct ParticleEmitter {
-  std::string meshName;
-
-  Matrix transform;
-  uint color = 0xffffffff;
-
-  float size = 1.0f;
-  float random_factor = 1.0f;
-  float normal_factor = 1.0f;
-  float count = 10.0f;
-  float life = 1.0f;
-  float random_life = 1.0f;
-  float scale = 1.0f;
-  float rotation = 0.0f;
-  float mass = 1.0f;
-  float random_color = 0;
-
-  // starting velocity of all new particles
-  float velocity[3] = {0.0f, 0.0f, 0.0f};
-
-  // constant gravity force
-  float gravity[3] = {0.0f, 0.0f, 0.0f};
-
-  // constant drag (per frame velocity multiplier, reducing it will make
-  // particles slow down over time)
-  float drag = 1.0f;
-
-  // if the particles have collision enabled, then after collision this is a
-  // multiplier for their bouncing velocities
-  float restitution = 0.98f;
-};
-
-struct alignas(16) ParticleSystemCB {
-  float4x4 xEmitterWorld;
-
-  uint xEmitCount;
-  uint xEmitterMeshIndexCount;
-  uint xEmitterMeshVertexPositionStride;
-  float xEmitterRandomness;
-
-  float xParticleSize;
-  float xParticleScaling;
-  float xParticleRotation;
-  uint xParticleColor;
-
-  float xParticleRandomFactor;
-  float xParticleNormalFactor;
-  float xParticleLifeSpan;
-  float xParticleLifeSpanRandomness;
-
-  float xParticleMass;
-  float xParticleMotionBlurAmount;
-  float xParticleRandomColorFactor;
-  uint xEmitterMaxParticleCount;
-
-  uint xEmitterFramesX;
-  uint xEmitterFramesY;
-  uint xEmitterFrameCount;
-  uint xEmitterFrameStart;
-
-  float2 xEmitterTexMul;
-  float xEmitterFrameRate;
-  uint xEmitterLayerMask;
-
-  float xSPH_h;      // smoothing radius
-  float xSPH_h_rcp;  // 1.0f / smoothing radius
-  float xSPH_h2;     // smoothing radius ^ 2
-  float xSPH_h3;     // smoothing radius ^ 3
-
-  float xSPH_poly6_constant;  // precomputed Poly6 kernel constant term
-  float xSPH_spiky_constant;  // precomputed Spiky kernel function constant term
-  float xSPH_visc_constant;   // precomputed viscosity kernel function constant
-                              // term
-  float xSPH_K;               // pressure constant
-
-  float xSPH_e;   // viscosity constant
-  float xSPH_p0;  // reference density
-  uint xEmitterOptions;
-  float xEmitterFixedTimestep;  // we can force a fixed timestep (>0) onto the
-                                // simulation to avoid blowing up
-
-  float3 xParticleGravity;
-  float xEmitterRestitution;
-
-  float3 xParticleVelocity;
-  float xParticleDrag;
-};
-
 struct PointLight {
   float3 position;
   float intensity;
   uint color;
 };
 
-struct alignas(16) FrameCB {
-  uint frame_count;
-  float time;
-  float time_previous;
-  float delta_time;
-};
-
 struct alignas(16) PostRenderer {
   float3 posCam;  // WS
   uint lightColor;
@@ -173,52 +68,66 @@ struct alignas(16) PostRenderer {
 
 namespace my {
 namespace ParticleSystem {
-ParticleCounters statistics = {};
-ComPtr<ID3D11Buffer> statisticsReadbackBuffer;
-
-ComPtr<ID3D11Buffer> particleBuffer;
-ComPtr<ID3D11Buffer> aliveList[2];
-ComPtr<ID3D11Buffer> deadList;
-ComPtr<ID3D11Buffer> counterBuffer;
-ComPtr<ID3D11Buffer> constantBuffer;
-
-ComPtr<ID3D11ShaderResourceView> particleBufferSRV;
-ComPtr<ID3D11UnorderedAccessView> particleBufferUAV;
-ComPtr<ID3D11ShaderResourceView> aliveListSRV[2];
-ComPtr<ID3D11UnorderedAccessView> aliveListUAV[2];
-ComPtr<ID3D11UnorderedAccessView> deadListUAV;
-ComPtr<ID3D11UnorderedAccessView> counterBufferUAV;
-
-ComPtr<ID3D11VertexShader> vertexShader;
-ComPtr<ID3D11GeometryShader> geometryShader;
-ComPtr<ID3D11PixelShader> pixelShader;
-ComPtr<ID3D11ComputeShader> kickoffUpdateCS;
-ComPtr<ID3D11ComputeShader> emitCS;
-ComPtr<ID3D11ComputeShader> emitCS_FROMMESH;
-ComPtr<ID3D11ComputeShader> simulateCS;
-
-float emit = 0.0f;
-
-const uint32_t MAX_PARTICLES = 1000;
-
-ParticleEmitter emitter;
-
-void CreateSelfBuffers();
-
-void UpdateCPU(float dt);
-
-void UpdateGPU(uint32_t instanceIndex, const std::shared_ptr<Mesh>& mesh);
-void Draw();
-
-extern "C" MY_API ParticleEmitter* GetParticleEmitter();
+// The particle world runs on the RHI; its D3D11 device wraps g_device and
+// g_context, which the rest of the engine keeps using directly. The world
+// binds through the state cache.
+std::unique_ptr<rhi::D3D11Device> device;
+std::unique_ptr<rhi::StateCache> stateCache;
+ParticleSystemGPU world;
+
+extern "C" MY_API EmitterID CreateEmitter();
+extern "C" MY_API void DestroyEmitter(EmitterID id);
+// nullptr when id is not a live emitter.
+extern "C" MY_API ParticleEmitter* GetEmitter(EmitterID id);
+// Live emitters, in slot order.
+extern "C" MY_API uint32_t GetEmitterCount();
+extern "C" MY_API EmitterID GetEmitterAt(uint32_t index);
+extern "C" MY_API ParticleWorldSettings* GetWorldSettings();
 extern "C" MY_API ParticleCounters GetStatistics();
+// Simulation steps run when the current statistics were captured.
+extern "C" MY_API uint32_t GetStatisticsFrame();
+// Binding work the state cache passed on and saved in the last frame.
+extern "C" MY_API rhi::StateCache::Counters GetStateCacheCounters();
 }  // namespace ParticleSystem
 
+// Constant buffer uploads made and skipped in the last frame.
+extern "C" MY_API rhi::ConstantBufferCache::Stats GetConstantBufferStats();
+
 extern "C" MY_API Camera* GetCamera();
 
 extern "C" MY_API void SetWireframe(bool value);
 extern "C" MY_API bool IsWireframe();
 
+// Whether particles collide with the baked distance fields of the models
+// rather than with their triangles; off by default. The fields are baked, or
+// read from ../assets/cache/, the first time it is turned on, and are only
+// right for closed meshes.
+extern "C" MY_API void SetDistanceCollision(bool value);
+extern "C" MY_API bool IsDistanceCollision();
+
+// Runs the CPU simulate scaling benchmark and logs one line per thread count.
+extern "C" MY_API void RunSimulateBenchmark(uint32_t particleCount,
+                                            uint32_t maxThreads);
+// Runs the CPU SPH fluid scaling benchmark and logs one line per thread
+// count.
+extern "C" MY_API void RunFluidBenchmark(uint32_t particleCount,
+                                         uint32_t maxThreads);
+// Runs the neighbor grid build and query benchmark from minParticles up to
+// maxParticles and logs one line per particle count.
+extern "C" MY_API void RunNeighborGridBenchmark(uint32_t minParticles,
+                                                uint32_t maxParticles);
+// Runs the mesh BVH build, refit and segment query benchmark and logs its
+// timings.
+extern "C" MY_API void RunMeshBVHBenchmark(uint32_t triangleCount,
+                                           uint32_t segmentCount);
+// Runs the distance collider bake, cache and query benchmark on tori of 1000
+// up to maxTriangles triangles and logs one line per triangle count.
+extern "C" MY_API void RunMeshSDFBenchmark(uint32_t maxTriangles,
+                                           uint32_t particleCount);
+// Runs the force field benchmark and logs the cost per particle of every
+// field type, and of one of each together.
+extern "C" MY_API void RunForceFieldBenchmark(uint32_t particleCount);
+
 extern "C" MY_API void SetFloorHeight(float value);
 extern "C" MY_API float GetFloorHeight();
 
@@ -235,6 +144,4 @@ extern "C" MY_API bool GetDX11SharedRenderTarget(
 extern "C" MY_API void DeinitEngine();
 
 extern "C" MY_API bool LoadShaders();
-
-static void GPUBarrier();
 }  // namespace my
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "NeighborGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "SIMD.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+namespace my {
+namespace {
+// Input particles one hashing or scattering job handles.
+const uint32_t kParticleGroupSize = 4096;
+
+// Buckets one counting, scan or bucket sort job handles.
+const uint32_t kBucketGroupSize = 4096;
+
+// How many particles ahead the counting pass fetches bucket counters.
+const uint32_t kPrefetchDistance = 16;
+
+// Locked increments wait for each other's cache misses; fetching the line
+// early lets the misses overlap.
+void Prefetch(const void* address) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+  __builtin_prefetch(address, 1);
+#else
+  (void)address;
+#endif
+}
+
+// The clamp keeps far away particles from overflowing the conversion.
+int32_t CellCoordinate(float position, float cellSizeRcp) {
+  const float cell = std::floor(position * cellSizeRcp);
+  return static_cast<int32_t>(std::min(std::max(cell, -1e9f), 1e9f));
+}
+}  // namespace
+
+void NeighborGrid::Build(const float* positionX, const float* positionY,
+                         const float* positionZ, const uint32_t* particles,
+                         uint32_t count, float cellSize,
+                         uint32_t bucketCount) {
+  uint32_t bucketBits = 0;
+  while (bucketBits < 31 && (1u << bucketBits) < bucketCount) bucketBits++;
+  bucketCount = 1u << bucketBits;
+
+  m_cellSize = cellSize;
+  m_cellSizeRcp = 1.0f / cellSize;
+  m_bucketMask = bucketCount - 1;
+  m_rowShift = 32 - bucketBits;
+  m_count = count;
+
+  if (m_bucketCounts.size() != bucketCount)
+    m_bucketCounts = std::vector<std::atomic<uint32_t>>(bucketCount);
+  m_bucketStart.resize(bucketCount + 1);
+
+  const uint32_t particleGroups =
+      JobSystem::GetGroupCount(count, kParticleGroupSize);
+  const uint32_t bucketGroups =
+      JobSystem::GetGroupCount(bucketCount, kBucketGroupSize);
+  auto groupEnd = [](uint32_t begin, uint32_t groupSize, uint32_t total) {
+    return std::min(begin + groupSize, total);
+  };
+
+  JobSystem::Dispatch(bucketGroups, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kBucketGroupSize;
+    const uint32_t end = groupEnd(begin, kBucketGroupSize, bucketCount);
+    for (uint32_t b = begin; b < end; b++)
+      m_bucketCounts[b].store(0, std::memory_order_relaxed);
+  });
+
+  // Count, remembering every particle's rank in its bucket. The positions
+  // are packed on the way, so the final gather reads one line per particle
+  // rather than three.
+  m_buckets.resize(count);
+  m_ranks.resize(count);
+  m_points.resize(count);
+  JobSystem::Dispatch(particleGroups, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kParticleGroupSize;
+    const uint32_t end = groupEnd(begin, kParticleGroupSize, count);
+    for (uint32_t i = begin; i < end; i++) {
+      const uint32_t slot = particles[i];
+      Point& point = m_points[i];
+      point.x = positionX[slot];
+      point.y = positionY[slot];
+      point.z = positionZ[slot];
+      point.slot = slot;
+      m_buckets[i] = GetBucket(GetCell(point.x, point.y, point.z));
+    }
+    for (uint32_t i = begin; i < end; i++) {
+      if (i + kPrefetchDistance < end)
+        Prefetch(&m_bucketCounts[m_buckets[i + kPrefetchDistance]]);
+      m_ranks[i] = m_bucketCounts[m_buckets[i]].fetch_add(
+          1, std::memory_order_relaxed);
+    }
+  });
+
+  // exclusive scan of the counts, a block of buckets per job:
+  m_blockSums.resize(bucketGroups);
+  JobSystem::Dispatch(bucketGroups, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kBucketGroupSize;
+    const uint32_t end = groupEnd(begin, kBucketGroupSize, bucketCount);
+    uint32_t sum = 0;
+    for (uint32_t b = begin; b < end; b++)
+      sum += m_bucketCounts[b].load(std::memory_order_relaxed);
+    m_blockSums[args.jobIndex] = sum;
+  });
+  uint32_t first = 0;
+  for (uint32_t& sum : m_blockSums) {
+    const uint32_t blockSum = sum;
+    sum = first;
+    first += blockSum;
+  }
+  JobSystem::Dispatch(bucketGroups, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kBucketGroupSize;
+    const uint32_t end = groupEnd(begin, kBucketGroupSize, bucketCount);
+    uint32_t start = m_blockSums[args.jobIndex];
+    for (uint32_t b = begin; b < end; b++) {
+      m_bucketStart[b] = start;
+      start += m_bucketCounts[b].load(std::memory_order_relaxed);
+    }
+  });
+  m_bucketStart[bucketCount] = count;
+
+  // Scatter the input indices. With several threads the ranks, and so the
+  // order inside a bucket, depend on timing; sorting every bucket by input
+  // index takes that back out.
+  m_particles.resize(count);
+  JobSystem::Dispatch(particleGroups, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kParticleGroupSize;
+    const uint32_t end = groupEnd(begin, kParticleGroupSize, count);
+    for (uint32_t i = begin; i < end; i++)
+      m_particles[m_bucketStart[m_buckets[i]] + m_ranks[i]] = i;
+  });
+  if (JobSystem::GetThreadCount() > 1) {
+    JobSystem::Dispatch(bucketGroups, 1, [&](JobArgs args) {
+      const uint32_t begin = args.jobIndex * kBucketGroupSize;
+      const uint32_t end = groupEnd(begin, kBucketGroupSize, bucketCount);
+      for (uint32_t b = begin; b < end; b++) {
+        uint32_t* bucket = &m_particles[m_bucketStart[b]];
+        const uint32_t size = m_bucketStart[b + 1] - m_bucketStart[b];
+        if (size > 32) {
+          std::sort(bucket, bucket + size);
+          continue;
+        }
+        for (uint32_t i = 1; i < size; i++) {
+          const uint32_t value = bucket[i];
+          uint32_t j = i;
+          for (; j > 0 && bucket[j - 1] > value; j--) bucket[j] = bucket[j - 1];
+          bucket[j] = value;
+        }
+      }
+    });
+  }
+
+  // input indices to slots, and the sorted copy of the positions:
+  const uint32_t padded = count + simd::kWidth;
+  m_cells.resize(count);
+  for (std::vector<float>* column : {&m_positionX, &m_positionY, &m_positionZ})
+    column->resize(padded, 0.0f);
+
+  JobSystem::Dispatch(particleGroups, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kParticleGroupSize;
+    const uint32_t end = groupEnd(begin, kParticleGroupSize, count);
+    for (uint32_t i = begin; i < end; i++) {
+      const Point& point = m_points[m_particles[i]];
+      m_particles[i] = point.slot;
+      m_positionX[i] = point.x;
+      m_positionY[i] = point.y;
+      m_positionZ[i] = point.z;
+      m_cells[i] = GetCell(point.x, point.y, point.z);
+    }
+  });
+}
+
+NeighborGrid::Cell NeighborGrid::GetCell(float x, float y, float z) const {
+  return {CellCoordinate(x, m_cellSizeRcp), CellCoordinate(y, m_cellSizeRcp),
+          CellCoordinate(z, m_cellSizeRcp)};
+}
+
+uint32_t NeighborGrid::GetBucket(const Cell& cell) const {
+  // The top bits of a multiplicative hash of the row, plus x. With 65536
+  // buckets this is sph_bucket() of hlsl/Header.hlsli.
+  const uint32_t row = (static_cast<uint32_t>(cell.y) * 73856093u ^
+                        static_cast<uint32_t>(cell.z) * 19349663u) *
+                       0x9E3779B1u;
+  const uint32_t rowBucket = m_rowShift < 32 ? row >> m_rowShift : 0;
+  return (rowBucket + static_cast<uint32_t>(cell.x)) & m_bucketMask;
+}
+
+uint32_t NeighborGrid::GatherNeighborhood(const Cell& cell,
+                                          Range ranges[MAX_RANGES]) const {
+  return GatherBox({cell.x - 1, cell.y - 1, cell.z - 1},
+                   {cell.x + 1, cell.y + 1, cell.z + 1}, ranges);
+}
+
+uint32_t NeighborGrid::GatherRanges(float x, float y, float z, float radius,
+                                    Range ranges[MAX_RANGES]) const {
+  const Cell lo = GetCell(x - radius, y - radius, z - radius);
+  Cell hi = GetCell(x + radius, y + radius, z + radius);
+  // a radius a bit larger than the cell size must not overrun ranges
+  hi.x = std::min(hi.x, lo.x + 2);
+  hi.y = std::min(hi.y, lo.y + 2);
+  hi.z = std::min(hi.z, lo.z + 2);
+  return GatherBox(lo, hi, ranges);
+}
+
+uint32_t NeighborGrid::GatherBox(const Cell& lo, const Cell& hi,
+                                 Range ranges[MAX_RANGES]) const {
+  if (m_count == 0) return 0;
+
+  // One run per row of cells, unless the row wraps around the table.
+  const uint32_t length = static_cast<uint32_t>(hi.x - lo.x) + 1;
+  const uint32_t bucketCount = m_bucketMask + 1;
+  uint32_t count = 0;
+  for (int32_t z = lo.z; z <= hi.z; z++) {
+    for (int32_t y = lo.y; y <= hi.y; y++) {
+      const uint32_t first = GetBucket({lo.x, y, z});
+      const bool wraps = first + length > bucketCount;
+      for (uint32_t run = 0; run < (wraps ? length : 1); run++) {
+        const uint32_t bucket = (first + run) & m_bucketMask;
+        const uint32_t begin = m_bucketStart[bucket];
+        const uint32_t end = m_bucketStart[bucket + (wraps ? 1 : length)];
+        if (begin == end) continue;
+        ranges[count].begin = begin;
+        ranges[count].end = end;
+        count++;
+      }
+    }
+  }
+
+  // Rows sharing buckets overlap, and a particle must be visited once.
+  for (uint32_t i = 1; i < count; i++) {
+    for (uint32_t j = i; j > 0 && ranges[j - 1].begin > ranges[j].begin; j--)
+      std::swap(ranges[j - 1], ranges[j]);
+  }
+  uint32_t merged = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (merged > 0 && ranges[i].begin <= ranges[merged - 1].end) {
+      ranges[merged - 1].end = std::max(ranges[merged - 1].end, ranges[i].end);
+    } else {
+      ranges[merged++] = ranges[i];
+    }
+  }
+  return merged;
+}
+}  // namespace my
\ No newline at end of file
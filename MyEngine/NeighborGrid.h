@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+namespace my {
+// Cell-hash grid over a set of particles for neighbor queries, rebuilt every
+// frame by a parallel counting sort.
+//
+// Space is cut into cubic cells and every cell is hashed into one of a
+// power of two number of buckets; cells along x land in consecutive buckets,
+// so a row of neighboring cells is one contiguous run of the sorted
+// particles. Build() sorts the particles by bucket and keeps a copy of their
+// positions and cells in that order, and the queries return runs of sorted
+// particles rather than single ones, for callers that want to read them a
+// SIMD vector at a time. Runs may hold particles of other cells that share
+// a bucket; those are farther away than the query reaches, so a distance
+// test rejects them.
+//
+// Within a bucket the particles keep the order they were given in, so the
+// result does not depend on the thread count.
+class NeighborGrid {
+ public:
+  struct Cell {
+    int32_t x, y, z;
+  };
+
+  // Sorted particles [begin, end).
+  struct Range {
+    uint32_t begin, end;
+  };
+
+  // Most runs a query returns.
+  static const uint32_t MAX_RANGES = 27;
+
+  // Sorts particles[0, count), pool slots whose positions are
+  // positionX[slot], positionY[slot] and positionZ[slot], by bucket. Cells
+  // are cellSize wide; bucketCount is rounded up to a power of two.
+  void Build(const float* positionX, const float* positionY,
+             const float* positionZ, const uint32_t* particles, uint32_t count,
+             float cellSize, uint32_t bucketCount);
+
+  Cell GetCell(float x, float y, float z) const;
+  uint32_t GetBucket(const Cell& cell) const;
+
+  // Sorted particles of a bucket.
+  Range GetBucketRange(uint32_t bucket) const {
+    return {m_bucketStart[bucket], m_bucketStart[bucket + 1]};
+  }
+
+  uint32_t GetCount() const { return m_count; }
+  uint32_t GetBucketCount() const { return m_bucketMask + 1; }
+  float GetCellSize() const { return m_cellSize; }
+
+  // Pool slots, cells and positions of the particles in sorted order. The
+  // positions are padded by a SIMD vector of zeros, so a run can be loaded
+  // past its end.
+  const uint32_t* GetParticles() const { return m_particles.data(); }
+  const Cell* GetCells() const { return m_cells.data(); }
+  const float* GetPositionX() const { return m_positionX.data(); }
+  const float* GetPositionY() const { return m_positionY.data(); }
+  const float* GetPositionZ() const { return m_positionZ.data(); }
+
+  // destination[i] = source[GetParticles()[i]] for every sorted particle,
+  // e.g. to bring another column of the pool into sorted order.
+  template <typename T>
+  void Reorder(const T* source, T* destination) const {
+    const uint32_t* particles = m_particles.data();
+    JobSystem::Dispatch(
+        JobSystem::GetGroupCount(m_count, kReorderGroupSize), 1,
+        [&](JobArgs args) {
+          const uint32_t begin = args.jobIndex * kReorderGroupSize;
+          const uint32_t end = begin + kReorderGroupSize < m_count
+                                   ? begin + kReorderGroupSize
+                                   : m_count;
+          for (uint32_t i = begin; i < end; i++)
+            destination[i] = source[particles[i]];
+        });
+  }
+
+  // Disjoint runs holding the 27 cells around cell; returns how many there
+  // are.
+  uint32_t GatherNeighborhood(const Cell& cell,
+                              Range ranges[MAX_RANGES]) const;
+
+  // Disjoint runs holding every particle within radius of (x, y, z), which
+  // must not be larger than the cell size; returns how many there are.
+  uint32_t GatherRanges(float x, float y, float z, float radius,
+                        Range ranges[MAX_RANGES]) const;
+
+  // Calls visit(sortedIndex, distanceSquared) for every particle closer
+  // than radius to (x, y, z); radius must not be larger than the cell size.
+  template <typename Visitor>
+  void QueryRadius(float x, float y, float z, float radius,
+                   Visitor&& visit) const {
+    Range ranges[MAX_RANGES];
+    const uint32_t rangeCount = GatherRanges(x, y, z, radius, ranges);
+    const float radius2 = radius * radius;
+    for (uint32_t r = 0; r < rangeCount; r++) {
+      for (uint32_t i = ranges[r].begin; i < ranges[r].end; i++) {
+        const float dx = m_positionX[i] - x;
+        const float dy = m_positionY[i] - y;
+        const float dz = m_positionZ[i] - z;
+        const float distance2 = dx * dx + dy * dy + dz * dz;
+        if (distance2 < radius2) visit(i, distance2);
+      }
+    }
+  }
+
+ private:
+  static const uint32_t kReorderGroupSize = 4096;
+
+  // Runs holding the cells lo..hi, at most three per axis.
+  uint32_t GatherBox(const Cell& lo, const Cell& hi,
+                     Range ranges[MAX_RANGES]) const;
+
+  float m_cellSize = 1.0f;
+  float m_cellSizeRcp = 1.0f;
+  uint32_t m_bucketMask = 0;
+  uint32_t m_rowShift = 32;  // keeps the top bits of a row's hash
+  uint32_t m_count = 0;
+
+  // Particles per bucket while sorting, then the first sorted particle of
+  // every bucket, plus the count at the end.
+  std::vector<std::atomic<uint32_t>> m_bucketCounts;
+  std::vector<uint32_t> m_bucketStart;
+  std::vector<uint32_t> m_blockSums;
+
+  // Position and slot of every input particle, its bucket and its place
+  // among the bucket's.
+  struct Point {
+    float x, y, z;
+    uint32_t slot;
+  };
+  std::vector<Point> m_points;
+  std::vector<uint32_t> m_buckets;
+  std::vector<uint32_t> m_ranks;
+
+  std::vector<uint32_t> m_particles;
+  std::vector<Cell> m_cells;
+  std::vector<float> m_positionX;
+  std::vector<float> m_positionY;
+  std::vector<float> m_positionZ;
+};
+}  // namespace my
\ No newline at end of file
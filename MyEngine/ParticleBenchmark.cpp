@@ -0,0 +1,723 @@
+#include "ParticleBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+
+#include "JobSystem.h"
+#include "MeshBVH.h"
+#include "MeshSDF.h"
+#include "MetaballRayMarcherCPU.h"
+#include "MetaballVolume.h"
+#include "NeighborGrid.h"
+#include "ParticleForceFields.h"
+#include "ParticleRasterizerCPU.h"
+#include "ParticleScenes.h"
+#include "ParticleSystemCPU.h"
+#include "ParticleSystemGPU.h"
+#include "RHIConstantBufferCache.h"
+#include "RHIStateCache.h"
+#include "Random.h"
+#include "RenderGraph.h"
+#include "SDFColliderSet.h"
+
+namespace my {
+namespace {
+const uint32_t kScalingWarmUpFrames = 2;
+
+// Times frame() frameCount times with 1, 2, 4, ... up to maxThreads threads
+// (maxThreads is always included) and restores the previous thread count
+// afterwards. setup() builds the fixture again for every thread count, then
+// a few frames warm up its buffers and the worker threads. metrics() adds
+// the benchmark's own numbers to each sample while the fixture still holds
+// the run it was timed on.
+template <typename Sample>
+std::vector<Sample> MeasureScaling(
+    uint32_t maxThreads, uint32_t frameCount,
+    const std::function<void()>& setup, const std::function<void()>& frame,
+    const std::function<void(Sample&)>& metrics) {
+  std::vector<Sample> samples;
+  const uint32_t previousThreadCount = JobSystem::GetThreadCount();
+
+  std::vector<uint32_t> threadCounts;
+  for (uint32_t t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+  threadCounts.push_back(maxThreads);
+
+  for (uint32_t threadCount : threadCounts) {
+    JobSystem::Initialize(threadCount);
+
+    setup();
+    for (uint32_t i = 0; i < kScalingWarmUpFrames; i++) frame();
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < frameCount; i++) frame();
+    const auto stop = std::chrono::high_resolution_clock::now();
+
+    Sample sample;
+    sample.threadCount = threadCount;
+    sample.millisecondsPerFrame =
+        std::chrono::duration<double, std::milli>(stop - start).count() /
+        frameCount;
+    sample.speedup =
+        samples.empty()
+            ? 1.0
+            : samples[0].millisecondsPerFrame / sample.millisecondsPerFrame;
+    metrics(sample);
+    samples.push_back(sample);
+  }
+
+  JobSystem::Initialize(previousThreadCount);
+
+  return samples;
+}
+
+// count rays 8 long from a pinhole looking down at the torus from above its
+// rim, row by row.
+void CreateCameraRays(uint32_t count, scenes::Segments& rays) {
+  rays.Resize(count);
+  const uint32_t width =
+      std::max(static_cast<uint32_t>(std::sqrt(static_cast<float>(count))), 1u);
+  const uint32_t height = (count + width - 1) / width;
+  const float axis = 0.70710678f;
+  for (uint32_t i = 0; i < count; i++) {
+    const float u = ((i % width + 0.5f) / width - 0.5f) * 1.6f;
+    const float v = ((i / width + 0.5f) / height - 0.5f) * 1.6f;
+    // forward (0, -1, 1), right (1, 0, 0) and up (0, 1, 1), the diagonals
+    // normalized
+    const float direction[3] = {u, (v - 1.0f) * axis, (v + 1.0f) * axis};
+    const float from[3] = {0.0f, 2.5f, -2.5f};
+    for (uint32_t c = 0; c < 3; c++) {
+      rays.from[c][i] = from[c];
+      rays.to[c][i] = from[c] + direction[c] * 8.0f;
+    }
+  }
+}
+
+// count steps of up to 0.05 per axis, starting anywhere around the torus,
+// like particles moving at a few meters per second.
+void CreateParticleSteps(uint32_t count, uint32_t seed,
+                         scenes::Segments& steps) {
+  steps.Resize(count);
+  const float extent[3] = {1.6f, 0.6f, 1.6f};
+  JobSystem::Dispatch(count, 4096, [&](JobArgs args) {
+    const uint32_t i = args.jobIndex;
+    RNG rng;
+    rng.init(seed, i, 0);
+    for (uint32_t c = 0; c < 3; c++) {
+      steps.from[c][i] = (rng.next_float() * 2 - 1) * extent[c];
+      steps.to[c][i] = steps.from[c][i] + (rng.next_float() - 0.5f) * 0.1f;
+    }
+  });
+}
+
+// Runs segments through bvh one at a time and as SIMD vectors, in parallel
+// batches.
+SegmentQueryRate MeasureSegments(const MeshBVH& bvh,
+                                 const scenes::Segments& segments) {
+  const uint32_t kSegmentGroupSize = 1024;
+  const uint32_t count = static_cast<uint32_t>(segments.from[0].size());
+  const uint32_t groupCount =
+      JobSystem::GetGroupCount(count, kSegmentGroupSize);
+  std::vector<SegmentHit> hits(count);
+
+  auto runScalar = [&]() {
+    JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+      const uint32_t begin = args.jobIndex * kSegmentGroupSize;
+      const uint32_t end = std::min(begin + kSegmentGroupSize, count);
+      for (uint32_t i = begin; i < end; i++) {
+        float3 from, to;
+        from.x = segments.from[0][i];
+        from.y = segments.from[1][i];
+        from.z = segments.from[2][i];
+        to.x = segments.to[0][i];
+        to.y = segments.to[1][i];
+        to.z = segments.to[2][i];
+        bvh.IntersectSegment(from, to, hits[i]);
+      }
+    });
+  };
+  auto runPacket = [&]() {
+    JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+      const uint32_t begin = args.jobIndex * kSegmentGroupSize;
+      const uint32_t end = std::min(begin + kSegmentGroupSize, count);
+      const float* const from[3] = {segments.from[0].data() + begin,
+                                    segments.from[1].data() + begin,
+                                    segments.from[2].data() + begin};
+      const float* const to[3] = {segments.to[0].data() + begin,
+                                  segments.to[1].data() + begin,
+                                  segments.to[2].data() + begin};
+      bvh.IntersectSegments(from, to, end - begin, hits.data() + begin);
+    });
+  };
+  auto megaRaysPerSecond = [&](const auto& run) {
+    run();  // warm up the caches and the worker threads
+    const auto start = std::chrono::high_resolution_clock::now();
+    run();
+    const auto stop = std::chrono::high_resolution_clock::now();
+    return count / std::chrono::duration<double, std::micro>(stop - start)
+                       .count();
+  };
+
+  SegmentQueryRate rate;
+  rate.scalarMegaRaysPerSecond = megaRaysPerSecond(runScalar);
+  rate.packetMegaRaysPerSecond = megaRaysPerSecond(runPacket);
+  uint32_t hitCount = 0;
+  for (const SegmentHit& hit : hits)
+    hitCount += hit.triangle != MeshBVH::NO_HIT;
+  rate.hitRate = count > 0 ? static_cast<double>(hitCount) / count : 0.0;
+  return rate;
+}
+
+// Nanoseconds per collision query of colliders at the ends of steps, in
+// parallel batches.
+double MeasureDistances(const SDFColliderSet& colliders,
+                        const scenes::Segments& steps) {
+  const uint32_t kQueryGroupSize = 1024;
+  const uint32_t count = static_cast<uint32_t>(steps.to[0].size());
+  const uint32_t groupCount = JobSystem::GetGroupCount(count, kQueryGroupSize);
+  std::vector<float> distances(count);
+
+  auto run = [&]() {
+    JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+      const uint32_t begin = args.jobIndex * kQueryGroupSize;
+      const uint32_t end = std::min(begin + kQueryGroupSize, count);
+      for (uint32_t i = begin; i < end; i++) {
+        float3 pos, normal;
+        pos.x = steps.to[0][i];
+        pos.y = steps.to[1][i];
+        pos.z = steps.to[2][i];
+        distances[i] = colliders.GetDistance(pos, &normal) + normal.y;
+      }
+    });
+  };
+  run();  // warm up the caches and the worker threads
+  const auto start = std::chrono::high_resolution_clock::now();
+  run();
+  const auto stop = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count() /
+         std::max(count, 1u);
+}
+}  // namespace
+
+std::vector<ScalingSample> ParticleBenchmark::RunSimulateScaling(
+    uint32_t particleCount, uint32_t frameCount, uint32_t maxThreads) {
+  if (particleCount == 0 || frameCount == 0 || maxThreads == 0) return {};
+
+  // Long-lived particles with no floor contact, so every frame simulates the
+  // whole pool and nothing is emitted after the first frame.
+  ParticleEmitter emitter;
+  emitter.life = 1e9f;
+  emitter.random_life = 0.0f;
+  emitter.normal_factor = 1.0f;
+
+  const ParticleWorldSettings settings;
+
+  std::vector<EmitterParams> emitTable(1);
+  BuildEmitterParams(emitter, particleCount, 0, 0, 0, 0, 0, emitTable[0]);
+  ParticleSystemCB emitCB;
+  BuildParticleSystemCB(settings, emitTable.data(), 1, particleCount, emitCB);
+
+  std::vector<EmitterParams> simulateTable = emitTable;
+  simulateTable[0].emitCount = 0;
+  ParticleSystemCB simulateCB;
+  BuildParticleSystemCB(settings, simulateTable.data(), 1, particleCount,
+                        simulateCB);
+
+  const float floorHeight = -1e9f;
+
+  std::unique_ptr<ParticleSystemCPU> system;
+  FrameCB frame;
+  return MeasureScaling<ScalingSample>(
+      maxThreads, frameCount,
+      [&]() {
+        system = std::make_unique<ParticleSystemCPU>();
+        system->Initialize(particleCount);
+        frame = {};
+        frame.delta_time = 1.0f / 60.0f;
+        system->Update(emitCB, emitTable, frame, floorHeight);
+      },
+      [&]() {
+        frame.frame_count++;
+        system->Update(simulateCB, simulateTable, frame, floorHeight);
+      },
+      [](ScalingSample& sample) {
+        sample.efficiency = sample.speedup / sample.threadCount;
+      });
+}
+
+std::vector<FluidSample> ParticleBenchmark::RunFluidScaling(
+    uint32_t particleCount, uint32_t frameCount, uint32_t maxThreads) {
+  if (particleCount == 0 || frameCount == 0 || maxThreads == 0) return {};
+
+  const float floorHeight = -1e9f;
+
+  std::unique_ptr<ParticleSystemCPU> system;
+  std::vector<EmitterParams> table;
+  ParticleSystemCB cb;
+  FrameCB frame;
+  return MeasureScaling<FluidSample>(
+      maxThreads, frameCount,
+      [&]() {
+        system = std::make_unique<ParticleSystemCPU>();
+        scenes::CreateFluidBlock(particleCount, *system, table, cb, frame);
+      },
+      [&]() {
+        frame.frame_count++;
+        system->Update(cb, table, frame, floorHeight);
+      },
+      [&](FluidSample& sample) {
+        const ParticleFluidCPU& fluid = system->GetFluid();
+        sample.neighborsPerParticle =
+            fluid.GetCount() == 0
+                ? 0.0
+                : static_cast<double>(fluid.GetNeighborCount()) /
+                      fluid.GetCount();
+      });
+}
+
+std::vector<GridSample> ParticleBenchmark::RunNeighborGrid(
+    uint32_t minParticles, uint32_t maxParticles, uint32_t buildCount,
+    uint32_t queryCount) {
+  std::vector<GridSample> samples;
+  if (minParticles == 0 || buildCount == 0 || queryCount == 0) return samples;
+
+  const uint32_t kQueryGroupSize = 256;
+
+  std::vector<float> x, y, z;
+  std::vector<uint32_t> slots;
+  for (uint64_t count = minParticles; count <= maxParticles; count *= 10) {
+    const uint32_t particleCount = static_cast<uint32_t>(count);
+    const float side = std::cbrt(particleCount / 8.0f);
+    scenes::ScatterPoints(particleCount, side, 0x6121D, x, y, z, slots);
+
+    // about four buckets per occupied cell
+    NeighborGrid grid;
+    const uint32_t bucketCount = std::max(particleCount / 2, 64u);
+    grid.Build(x.data(), y.data(), z.data(), slots.data(), particleCount,
+               1.0f, bucketCount);
+
+    const auto buildStart = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < buildCount; i++)
+      grid.Build(x.data(), y.data(), z.data(), slots.data(), particleCount,
+                 1.0f, bucketCount);
+    const auto buildStop = std::chrono::high_resolution_clock::now();
+
+    std::vector<uint32_t> found(queryCount);
+    const auto queryStart = std::chrono::high_resolution_clock::now();
+    JobSystem::Dispatch(
+        JobSystem::GetGroupCount(queryCount, kQueryGroupSize), 1,
+        [&](JobArgs args) {
+          const uint32_t begin = args.jobIndex * kQueryGroupSize;
+          const uint32_t end = std::min(begin + kQueryGroupSize, queryCount);
+          for (uint32_t q = begin; q < end; q++) {
+            const uint32_t i = static_cast<uint32_t>(
+                (static_cast<uint64_t>(q) * 2654435761u) % particleCount);
+            uint32_t neighbors = 0;
+            grid.QueryRadius(x[i], y[i], z[i], 1.0f,
+                             [&](uint32_t, float) { neighbors++; });
+            found[q] = neighbors;
+          }
+        });
+    const auto queryStop = std::chrono::high_resolution_clock::now();
+
+    uint64_t neighbors = 0;
+    for (uint32_t n : found) neighbors += n;
+
+    GridSample sample;
+    sample.particleCount = particleCount;
+    sample.bucketCount = grid.GetBucketCount();
+    sample.buildMilliseconds =
+        std::chrono::duration<double, std::milli>(buildStop - buildStart)
+            .count() /
+        buildCount;
+    sample.queryNanoseconds =
+        std::chrono::duration<double, std::nano>(queryStop - queryStart)
+            .count() /
+        queryCount;
+    sample.neighborsPerQuery = static_cast<double>(neighbors) / queryCount;
+    samples.push_back(sample);
+  }
+
+  return samples;
+}
+
+BVHSample ParticleBenchmark::RunMeshBVH(uint32_t triangleCount,
+                                        uint32_t segmentCount) {
+  const uint32_t kBuildCount = 3;
+  const uint32_t kRefitCount = 10;
+
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  scenes::CreateTorus(triangleCount, positions, indices);
+
+  MeshBVH bvh;
+  bvh.AddMesh(positions.data(), indices.data(),
+              static_cast<uint32_t>(indices.size()), float4x4());
+
+  const auto buildStart = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < kBuildCount; i++) bvh.Build();
+  const auto buildStop = std::chrono::high_resolution_clock::now();
+
+  const auto refitStart = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < kRefitCount; i++) {
+    bvh.SetTransform(0, scenes::RotationZ(0.05f * (i + 1), 0.0f));
+    bvh.Refit();
+  }
+  const auto refitStop = std::chrono::high_resolution_clock::now();
+
+  // the rays are timed against the refitted tree, as they would be while
+  // the models move
+  scenes::Segments rays, steps;
+  CreateCameraRays(segmentCount, rays);
+  CreateParticleSteps(segmentCount, 0x5E6, steps);
+
+  BVHSample sample;
+  sample.triangleCount = static_cast<uint32_t>(bvh.GetTriangles().size());
+  sample.nodeCount = static_cast<uint32_t>(bvh.GetNodes().size());
+  sample.buildMilliseconds =
+      std::chrono::duration<double, std::milli>(buildStop - buildStart)
+          .count() /
+      kBuildCount;
+  sample.refitMilliseconds =
+      std::chrono::duration<double, std::milli>(refitStop - refitStart)
+          .count() /
+      kRefitCount;
+  sample.cameraRays = MeasureSegments(bvh, rays);
+  sample.particleSteps = MeasureSegments(bvh, steps);
+  return sample;
+}
+
+std::vector<SDFSample> ParticleBenchmark::RunMeshSDF(
+    uint32_t minTriangles, uint32_t maxTriangles, uint32_t stepCount,
+    const std::string& cachePath) {
+  std::vector<SDFSample> samples;
+  scenes::Segments steps;
+  CreateParticleSteps(stepCount, 0x5DF, steps);
+
+  for (uint64_t count = minTriangles; count <= maxTriangles; count *= 10) {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    scenes::CreateTorus(static_cast<uint32_t>(count), positions, indices);
+    const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+    MeshSDF field;
+    field.AddMesh(positions.data(), indices.data(), indexCount);
+    const auto bakeStart = std::chrono::high_resolution_clock::now();
+    field.Build();
+    const auto bakeStop = std::chrono::high_resolution_clock::now();
+    field.Save(cachePath);
+
+    MeshSDF cached;
+    cached.AddMesh(positions.data(), indices.data(), indexCount);
+    const auto loadStart = std::chrono::high_resolution_clock::now();
+    const bool loaded = cached.Load(cachePath);
+    const auto loadStop = std::chrono::high_resolution_clock::now();
+
+    SDFColliderSet colliders;
+    colliders.Add(field, float4x4());
+    MeshBVH bvh;
+    bvh.AddMesh(positions.data(), indices.data(), indexCount, float4x4());
+    bvh.Build();
+
+    SDFSample sample;
+    sample.triangleCount = field.GetTriangleCount();
+    sample.brickCount = static_cast<uint32_t>(field.GetBricks().size());
+    sample.allocatedBricks = field.GetAllocatedBrickCount();
+    sample.megabytes = (field.GetBricks().size() * sizeof(SDFBrick) +
+                        field.GetSamples().size() * sizeof(float)) /
+                       (1024.0 * 1024.0);
+    sample.bakeMilliseconds =
+        std::chrono::duration<double, std::milli>(bakeStop - bakeStart)
+            .count();
+    sample.loadMilliseconds =
+        loaded ? std::chrono::duration<double, std::milli>(loadStop -
+                                                           loadStart)
+                     .count()
+               : 0.0;
+    sample.distanceNanoseconds = MeasureDistances(colliders, steps);
+    sample.bvhNanoseconds =
+        1000.0 / MeasureSegments(bvh, steps).scalarMegaRaysPerSecond;
+    samples.push_back(sample);
+  }
+
+  return samples;
+}
+
+std::vector<ForceFieldSample> ParticleBenchmark::RunForceFields(
+    uint32_t particleCount, uint32_t repeatCount) {
+  std::vector<ForceFieldSample> samples;
+  if (particleCount == 0 || repeatCount == 0) return samples;
+
+  const float side = 10.0f;
+  std::vector<float> x, y, z;
+  std::vector<uint32_t> slots;
+  scenes::ScatterPoints(particleCount, side, 0xF1E1D, x, y, z, slots);
+  std::vector<float> ax(particleCount), ay(particleCount), az(particleCount);
+  const float* const position[3] = {x.data(), y.data(), z.data()};
+  float* const acceleration[3] = {ax.data(), ay.data(), az.data()};
+
+  // every type on its own, then all of them
+  const std::vector<ForceFieldParams> fields = scenes::CreateForceFields(side);
+  for (uint32_t first = 0; first <= fields.size(); first++) {
+    const bool all = first == fields.size();
+    const ForceFieldParams* begin = all ? fields.data() : &fields[first];
+    const uint32_t count = all ? static_cast<uint32_t>(fields.size()) : 1;
+
+    EvaluateForceFields(begin, count, position, particleCount, acceleration);
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t r = 0; r < repeatCount; r++) {
+      EvaluateForceFields(begin, count, position, particleCount,
+                          acceleration);
+    }
+    const auto stop = std::chrono::high_resolution_clock::now();
+
+    ForceFieldSample sample;
+    sample.name = all ? "all" : scenes::ForceFieldName(begin->type);
+    sample.fieldCount = count;
+    sample.nanoseconds =
+        std::chrono::duration<double, std::nano>(stop - start).count() /
+        (static_cast<double>(repeatCount) * particleCount);
+    samples.push_back(sample);
+  }
+
+  return samples;
+}
+
+std::vector<FillRateSample> ParticleBenchmark::RunBillboardFillRate(
+    uint32_t particleCount, uint32_t width, uint32_t height,
+    uint32_t frameCount, uint32_t maxThreads) {
+  if (particleCount == 0 || width == 0 || height == 0 || frameCount == 0 ||
+      maxThreads == 0)
+    return {};
+
+  // Camera at the origin looking down +z with a 90 degree vertical field of
+  // view (XMMatrixPerspectiveFovLH), so the view matrix is the identity.
+  const float aspect = static_cast<float>(width) / height;
+  const float nearZ = 0.1f;
+  const float farZ = 100.0f;
+  BillboardCamera camera;
+  camera.viewProj.m[0][0] = 1.0f / aspect;
+  camera.viewProj.m[1][1] = 1.0f;
+  camera.viewProj.m[2][2] = farZ / (farZ - nearZ);
+  camera.viewProj.m[2][3] = 1.0f;
+  camera.viewProj.m[3][2] = -nearZ * farZ / (farZ - nearZ);
+  camera.viewProj.m[3][3] = 0.0f;
+
+  std::vector<Particle> particles(particleCount);
+  std::vector<uint32_t> aliveList(particleCount);
+  for (uint32_t i = 0; i < particleCount; i++) {
+    RNG rng;
+    rng.init(0x5EED, i, 0);
+
+    Particle& particle = particles[i];
+    const float z = 5.0f + rng.next_float() * 15.0f;
+    particle.position.x = (rng.next_float() * 2 - 1) * z * aspect;
+    particle.position.y = (rng.next_float() * 2 - 1) * z;
+    particle.position.z = z;
+    particle.positionPrev = particle.position;
+    particle.sizeBeginEnd.x = 0.05f + rng.next_float() * 0.25f;
+    particle.sizeBeginEnd.y = particle.sizeBeginEnd.x;
+    particle.rotationalVelocity = rng.next_float() * 6.0f;
+    particle.maxLife = 1.0f;
+    particle.life = 1.0f;
+    particle.color = (rng.next() & 0x00FFFFFF) | 0x80000000;
+    aliveList[i] = i;
+  }
+
+  ParticleRasterizerCPU rasterizer;
+  rasterizer.Resize(width, height);
+
+  return MeasureScaling<FillRateSample>(
+      maxThreads, frameCount, []() {},
+      [&]() {
+        rasterizer.Clear();
+        rasterizer.Draw(particles.data(), aliveList.data(), particleCount,
+                        camera);
+      },
+      [&](FillRateSample& sample) {
+        sample.megaFragmentsPerSecond = rasterizer.GetStats().fragments /
+                                        (sample.millisecondsPerFrame * 1000.0);
+      });
+}
+
+std::vector<RayMarchSample> ParticleBenchmark::RunMetaballRayMarch(
+    uint32_t sphereCount, float smoothing, uint32_t width, uint32_t height,
+    uint32_t frameCount, uint32_t maxThreads) {
+  if (sphereCount == 0 || width == 0 || height == 0 || frameCount == 0 ||
+      maxThreads == 0)
+    return {};
+
+  std::vector<Particle> particles;
+  std::vector<uint32_t> aliveList;
+  scenes::CreateMetaballBlob(sphereCount, particles, aliveList);
+
+  RayMarchView view;
+  view.boxCenter.x = view.boxCenter.y = view.boxCenter.z = 0.0f;
+  view.boxHalfSize = 1.0f;
+  MetaballGrid grid;
+  grid.Build(particles.data(), aliveList.data(), sphereCount, view.boxCenter,
+             view.boxHalfSize, smoothing);
+
+  // Camera at z = -3 looking down +z with the engine's lens: a 45 degree
+  // vertical field of view and the near plane at 1. clipToWorld is the
+  // inverse of the projection times the translation by +3 in z.
+  const float aspect = static_cast<float>(width) / height;
+  const float nearZ = 1.0f;
+  const float farZ = 1000.0f;
+  const float scaleY = 1.0f / std::tan(0.125f * 3.14159265f);
+  const float a = farZ / (farZ - nearZ);
+  const float b = -nearZ * farZ / (farZ - nearZ);
+  view.cameraPosition.x = view.cameraPosition.y = 0.0f;
+  view.cameraPosition.z = -3.0f;
+  view.clipToWorld.m[0][0] = aspect / scaleY;
+  view.clipToWorld.m[1][1] = 1.0f / scaleY;
+  view.clipToWorld.m[2][2] = -3.0f / b;
+  view.clipToWorld.m[2][3] = 1.0f / b;
+  view.clipToWorld.m[3][2] = 1.0f + 3.0f * a / b;
+  view.clipToWorld.m[3][3] = -a / b;
+  view.lightPosition.x = 2.0f;
+  view.lightPosition.y = 3.0f;
+  view.lightPosition.z = -3.0f;
+  view.lightIntensity = 1.0f;
+  view.lightColor = 0xFFFFFFFF;
+
+  MetaballRayMarcherCPU marcher;
+  marcher.Resize(width, height);
+
+  return MeasureScaling<RayMarchSample>(
+      maxThreads, frameCount, []() {}, [&]() { marcher.Render(grid, view); },
+      [&](RayMarchSample& sample) {
+        const MetaballRayMarcherCPU::Stats& stats = marcher.GetStats();
+        sample.megaRaysPerSecond =
+            stats.rays / (sample.millisecondsPerFrame * 1000.0);
+        sample.stepsPerRay =
+            stats.rays > 0 ? static_cast<double>(stats.steps) / stats.rays
+                           : 0.0;
+      });
+}
+
+MetaballSample ParticleBenchmark::RunMetaballEvaluation(
+    uint32_t sphereCount, uint32_t sampleCount, float smoothing,
+    uint32_t volumeResolution) {
+  MetaballSample result = {};
+  if (sphereCount == 0 || sampleCount == 0) return result;
+
+  std::vector<Particle> particles;
+  std::vector<uint32_t> aliveList;
+  scenes::CreateMetaballBlob(sphereCount, particles, aliveList);
+
+  std::vector<float3> samples(sampleCount);
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    RNG rng;
+    rng.init(0xBA11, i, 1);
+    samples[i].x = rng.next_float() * 2 - 1;
+    samples[i].y = rng.next_float() * 2 - 1;
+    samples[i].z = rng.next_float() * 2 - 1;
+  }
+
+  float3 boxCenter;
+  boxCenter.x = boxCenter.y = boxCenter.z = 0.0f;
+
+  MetaballGrid grid;
+  auto start = std::chrono::high_resolution_clock::now();
+  grid.Build(particles.data(), aliveList.data(), sphereCount, boxCenter, 1.0f,
+             smoothing);
+  auto stop = std::chrono::high_resolution_clock::now();
+  result.buildMilliseconds =
+      std::chrono::duration<double, std::milli>(stop - start).count();
+
+  std::vector<float> brute(sampleCount);
+  start = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < sampleCount; i++)
+    brute[i] = grid.GetDistanceBrute(samples[i]);
+  stop = std::chrono::high_resolution_clock::now();
+  result.bruteNanosecondsPerSample =
+      std::chrono::duration<double, std::nano>(stop - start).count() /
+      sampleCount;
+
+  std::vector<float> accelerated(sampleCount);
+  start = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < sampleCount; i++)
+    accelerated[i] = grid.GetDistance(samples[i]);
+  stop = std::chrono::high_resolution_clock::now();
+  result.gridNanosecondsPerSample =
+      std::chrono::duration<double, std::nano>(stop - start).count() /
+      sampleCount;
+
+  result.speedup =
+      result.bruteNanosecondsPerSample / result.gridNanosecondsPerSample;
+
+  uint64_t candidates = 0;
+  for (uint32_t i = 0; i < sampleCount; i++)
+    candidates += grid.GetCandidateCount(samples[i]);
+  result.averageCandidates = static_cast<double>(candidates) / sampleCount;
+
+  MetaballVolume volume;
+  volume.GetSettings().resolution = volumeResolution;
+  start = std::chrono::high_resolution_clock::now();
+  volume.Build(grid, boxCenter, 1.0f);
+  stop = std::chrono::high_resolution_clock::now();
+  result.volumeBuildMilliseconds =
+      std::chrono::duration<double, std::milli>(stop - start).count();
+  result.volumeBricks = volume.GetAllocatedBrickCount();
+
+  std::vector<float> baked(sampleCount);
+  start = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < sampleCount; i++)
+    baked[i] = volume.GetDistance(samples[i]);
+  stop = std::chrono::high_resolution_clock::now();
+  result.volumeNanosecondsPerSample =
+      std::chrono::duration<double, std::nano>(stop - start).count() /
+      sampleCount;
+
+  const float band =
+      volume.GetSettings().band * volume.GetConstants().voxelSize;
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    if (std::abs(brute[i]) >= band) continue;
+    result.maxError =
+        std::max(result.maxError, std::abs(accelerated[i] - brute[i]));
+    result.volumeMaxError =
+        std::max(result.volumeMaxError, std::abs(baked[i] - accelerated[i]));
+  }
+
+  return result;
+}
+
+rhi::NullDevice::Stats ParticleBenchmark::ProfileGPUFrames(
+    uint32_t maxParticles, uint32_t emitterCount, uint32_t frameCount,
+    bool useStateCache) {
+  rhi::NullDevice device;
+  rhi::StateCache stateCache(&device);
+
+  rhi::Device* worldDevice = &device;
+  if (useStateCache) worldDevice = &stateCache;
+
+  rhi::ConstantBufferCache constantBuffers(worldDevice);
+
+  ParticleSystemGPU world;
+  world.GetSettings().max_particles = maxParticles;
+  if (!world.Initialize(worldDevice, &constantBuffers, nullptr))
+    return rhi::NullDevice::Stats();
+
+  world.SetShaders(scenes::CreateNullShaders(device));
+
+  // the last emitter is a fluid, so the SPH passes are scheduled too
+  for (uint32_t i = 0; i < emitterCount; i++) {
+    const EmitterID id = world.GetRegistry().Create();
+    world.GetRegistry().Get(id)->sph = i > 0 && i + 1 == emitterCount;
+  }
+
+  // one step and one draw per frame, like DoTest() at the fixed rate
+  RenderGraph graph;
+  for (uint32_t frame = 0; frame <= frameCount; frame++) {
+    if (frame == 1) device.ResetRecording();
+
+    scenes::BuildFrame(graph, world, 1, frame);
+    graph.Execute(worldDevice);
+  }
+
+  return device.GetStats();
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RHINull.h"
+
+namespace my {
+struct ScalingSample {
+  uint32_t threadCount;
+  double millisecondsPerFrame;
+  double speedup;     // relative to the single thread run
+  double efficiency;  // speedup / threadCount
+};
+
+struct FluidSample {
+  uint32_t threadCount;
+  double millisecondsPerFrame;  // whole frames, simulate included
+  double speedup;               // relative to the single thread run
+  double neighborsPerParticle;  // closer than h, the particle included
+};
+
+struct GridSample {
+  uint32_t particleCount;
+  uint32_t bucketCount;
+  double buildMilliseconds;
+  double queryNanoseconds;  // per radius query, over a parallel batch
+  double neighborsPerQuery;
+};
+
+struct FillRateSample {
+  uint32_t threadCount;
+  double millisecondsPerFrame;
+  double speedup;  // relative to the single thread run
+  double megaFragmentsPerSecond;
+};
+
+struct MetaballSample {
+  double buildMilliseconds;
+  double bruteNanosecondsPerSample;  // every sphere, as the shader did
+  double gridNanosecondsPerSample;
+  double speedup;
+  double averageCandidates;  // spheres a grid sample visits
+  float maxError;            // of the grid against brute force, in the band
+
+  double volumeBuildMilliseconds;  // baking the MetaballVolume
+  double volumeNanosecondsPerSample;
+  uint32_t volumeBricks;  // with samples
+  float volumeMaxError;   // against the grid, in the band
+};
+
+struct RayMarchSample {
+  uint32_t threadCount;
+  double millisecondsPerFrame;
+  double speedup;  // relative to the single thread run
+  double megaRaysPerSecond;
+  double stepsPerRay;  // field evaluations
+};
+
+// Segment queries of one kind against a MeshBVH.
+struct SegmentQueryRate {
+  double scalarMegaRaysPerSecond;  // IntersectSegment(), one at a time
+  double packetMegaRaysPerSecond;  // IntersectSegments()
+  double hitRate;
+};
+
+struct BVHSample {
+  uint32_t triangleCount;
+  uint32_t nodeCount;
+  double buildMilliseconds;
+  double refitMilliseconds;  // after moving the whole mesh
+  SegmentQueryRate cameraRays;     // a pinhole image of the mesh
+  SegmentQueryRate particleSteps;  // short random segments around it
+};
+
+// A distance collider baked from a mesh and its collision queries, next to
+// the swept queries of a MeshBVH over the same mesh.
+struct SDFSample {
+  uint32_t triangleCount;
+  uint32_t brickCount;
+  uint32_t allocatedBricks;  // with samples
+  double megabytes;          // of bricks and samples
+  double bakeMilliseconds;
+  double loadMilliseconds;     // of the cached field
+  double distanceNanoseconds;  // SDFColliderSet::GetDistance() per particle
+  double bvhNanoseconds;       // MeshBVH::IntersectSegment() per particle
+};
+
+// Force fields evaluated at particles stored in coordinate columns.
+struct ForceFieldSample {
+  std::string name;  // of the field type, or "all" for one of each type
+  uint32_t fieldCount;
+  double nanoseconds;  // per particle, EvaluateForceFields() on one thread
+};
+
+// Timing harnesses for the CPU particle backend. They re-initialize the job
+// system for every thread count and restore the previous count afterwards,
+// so they must not be called from inside a job.
+class ParticleBenchmark {
+ public:
+  // Simulates particleCount immortal particles for frameCount frames with 1,
+  // 2, 4, ... up to maxThreads threads (maxThreads is always included).
+  static std::vector<ScalingSample> RunSimulateScaling(uint32_t particleCount,
+                                                       uint32_t frameCount,
+                                                       uint32_t maxThreads);
+
+  // Simulates particleCount immortal SPH fluid particles scattered over a
+  // cube at about the rest density, without gravity, for frameCount frames
+  // per thread count (1, 2, 4, ... up to maxThreads).
+  static std::vector<FluidSample> RunFluidScaling(uint32_t particleCount,
+                                                  uint32_t frameCount,
+                                                  uint32_t maxThreads);
+
+  // Builds a NeighborGrid over particles scattered uniformly over a cube,
+  // eight per cell, buildCount times, then runs queryCount radius queries of
+  // one cell size around random particles. Particle counts go from
+  // minParticles up to maxParticles by factors of ten, on the current job
+  // system.
+  static std::vector<GridSample> RunNeighborGrid(uint32_t minParticles,
+                                                 uint32_t maxParticles,
+                                                 uint32_t buildCount,
+                                                 uint32_t queryCount);
+
+  // Builds a MeshBVH over a torus of about triangleCount triangles, refits
+  // it after a rotation and runs segmentCount segments of two kinds through
+  // it in parallel batches on the current job system: camera rays through a
+  // pinhole image and short random steps like those of particles.
+  static BVHSample RunMeshBVH(uint32_t triangleCount, uint32_t segmentCount);
+
+  // Bakes the distance field of tori of minTriangles up to maxTriangles
+  // triangles, by factors of ten, saves it to cachePath and loads it back,
+  // then times stepCount collision queries at the ends of particle steps
+  // around it, and the same steps through a MeshBVH, on the current job
+  // system.
+  static std::vector<SDFSample> RunMeshSDF(uint32_t minTriangles,
+                                           uint32_t maxTriangles,
+                                           uint32_t stepCount,
+                                           const std::string& cachePath);
+
+  // Evaluates a force field of every type, then one of each together, at
+  // particleCount particles scattered over a cube, repeatCount times each
+  // on the calling thread. Attractor, vortex and wind fade out over the
+  // cube, the turbulence reaches everywhere.
+  static std::vector<ForceFieldSample> RunForceFields(uint32_t particleCount,
+                                                      uint32_t repeatCount);
+
+  // Rasterizes particleCount half transparent billboards scattered in front
+  // of the camera into a width x height image with ParticleRasterizerCPU,
+  // frameCount frames per thread count (1, 2, 4, ... up to maxThreads).
+  static std::vector<FillRateSample> RunBillboardFillRate(
+      uint32_t particleCount, uint32_t width, uint32_t height,
+      uint32_t frameCount, uint32_t maxThreads);
+
+  // Evaluates the metaball field of sphereCount spheres scattered in a ball
+  // inside a unit box at sampleCount random points: over all spheres, through
+  // a MetaballGrid (smoothing is the k of the smooth minimum) and through a
+  // MetaballVolume of volumeResolution voxels per axis baked from the grid.
+  // Errors are taken where the exact field is within the volume's band.
+  static MetaballSample RunMetaballEvaluation(uint32_t sphereCount,
+                                              uint32_t sampleCount,
+                                              float smoothing,
+                                              uint32_t volumeResolution = 64);
+
+  // Ray marches the blob of RunMetaballEvaluation() (sphereCount spheres,
+  // smoothing k) into a width x height image with MetaballRayMarcherCPU,
+  // frameCount frames per thread count (1, 2, 4, ... up to maxThreads). Rays
+  // are the ones that entered the box.
+  static std::vector<RayMarchSample> RunMetaballRayMarch(
+      uint32_t sphereCount, float smoothing, uint32_t width, uint32_t height,
+      uint32_t frameCount, uint32_t maxThreads);
+
+  // Runs frameCount steady-state frames of a GPU particle world with
+  // emitterCount default emitters on the null device and returns what they
+  // recorded: commands, redundant state changes, upload bytes and dispatch
+  // sizes. Creation and the first frame are not included. With
+  // useStateCache the world binds through an rhi::StateCache, as in the
+  // engine.
+  static rhi::NullDevice::Stats ProfileGPUFrames(uint32_t maxParticles,
+                                                 uint32_t emitterCount,
+                                                 uint32_t frameCount,
+                                                 bool useStateCache = true);
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "ParticleEmitterRegistry.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace my {
+EmitterID ParticleEmitterRegistry::Create(const ParticleEmitter& emitter) {
+  auto it = std::find_if(m_slots.begin(), m_slots.end(),
+                         [](const Slot& slot) { return !slot.used; });
+  if (it == m_slots.end()) it = m_slots.insert(m_slots.end(), Slot());
+
+  *it = Slot();
+  it->emitter = emitter;
+  it->alive = true;
+  it->used = true;
+
+  return static_cast<EmitterID>(it - m_slots.begin());
+}
+
+void ParticleEmitterRegistry::Destroy(EmitterID id) {
+  if (Get(id) == nullptr) return;
+
+  Slot& slot = m_slots[id];
+  slot.alive = false;
+
+  // longest life the emit kernel can hand out
+  const ParticleEmitter& e = slot.emitter;
+  slot.retireTime = e.life + e.life * 0.5f * std::abs(e.random_life);
+}
+
+ParticleEmitter* ParticleEmitterRegistry::Get(EmitterID id) {
+  if (id >= m_slots.size() || !m_slots[id].alive) return nullptr;
+  return &m_slots[id].emitter;
+}
+
+const ParticleEmitter* ParticleEmitterRegistry::Get(EmitterID id) const {
+  if (id >= m_slots.size() || !m_slots[id].alive) return nullptr;
+  return &m_slots[id].emitter;
+}
+
+std::vector<EmitterID> ParticleEmitterRegistry::GetEmitters() const {
+  std::vector<EmitterID> ids;
+  for (uint32_t i = 0; i < m_slots.size(); i++)
+    if (m_slots[i].alive) ids.push_back(i);
+  return ids;
+}
+
+void ParticleEmitterRegistry::Step(float dt,
+                                   std::vector<uint32_t>& emitCounts) {
+  for (Slot& slot : m_slots) {
+    if (slot.used && !slot.alive) {
+      // a particle is killed by the simulate step after its life runs out,
+      // so keep the slot for two more steps
+      slot.retireTime -= dt;
+      if (slot.retireTime < -2.0f * dt) slot.used = false;
+    }
+  }
+  // trailing free slots shrink the table
+  while (!m_slots.empty() && !m_slots.back().used) m_slots.pop_back();
+
+  emitCounts.assign(m_slots.size(), 0);
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    Slot& slot = m_slots[i];
+    if (!slot.alive) continue;
+
+    slot.emitAccumulator += std::max(0.0f, slot.emitter.count) * dt;
+    const float whole = std::floor(slot.emitAccumulator);
+    slot.emitAccumulator -= whole;
+    emitCounts[i] = static_cast<uint32_t>(whole);
+  }
+}
+
+void ParticleEmitterRegistry::BuildTable(
+    const std::vector<uint32_t>& emitCounts,
+    const GeometryResolver& resolveGeometry,
+    std::vector<EmitterParams>& table,
+    std::vector<ForceFieldParams>& forceFields) const {
+  table.resize(m_slots.size());
+  forceFields.clear();
+
+  uint32_t emitOffset = 0;
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    const Slot& slot = m_slots[i];
+    const uint32_t emitCount =
+        slot.alive && i < emitCounts.size() ? emitCounts[i] : 0;
+
+    EmitterGeometry geometry;
+    if (slot.alive && resolveGeometry)
+      geometry = resolveGeometry(static_cast<EmitterID>(i), slot.emitter);
+
+    BuildEmitterParams(slot.emitter, emitCount, emitOffset,
+                       geometry.indexOffset, geometry.vertexOffset,
+                       geometry.emissionSetOffset, geometry.emissionSetCount,
+                       table[i]);
+    emitOffset += emitCount;
+
+    // particles of a retiring slot keep feeling its fields
+    if (!slot.used) continue;
+    table[i].forceFieldOffset = static_cast<uint32_t>(forceFields.size());
+    table[i].forceFieldCount =
+        static_cast<uint32_t>(slot.emitter.force_fields.size());
+    for (const ParticleForceField& field : slot.emitter.force_fields) {
+      forceFields.emplace_back();
+      BuildForceFieldParams(field, forceFields.back());
+    }
+  }
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ParticleSystemTypes.h"
+
+namespace my {
+// Stable handle of an emitter; it is also the emitter's row in the emitter
+// table and the Particle::emitterIndex of everything it emits.
+using EmitterID = uint32_t;
+static const EmitterID INVALID_EMITTER = 0xffffffff;
+
+// Where an emitter's mesh lives in the pooled emission geometry, and which of
+// its triangles the emitter samples.
+struct EmitterGeometry {
+  uint32_t indexOffset = 0;
+  uint32_t vertexOffset = 0;
+  uint32_t emissionSetOffset = 0;
+  uint32_t emissionSetCount = 0;  // 0 emits from the emitter origin
+};
+
+// All emitters of one particle world. Emitters share one particle pool and
+// are simulated by one batched pass that reads their parameters from the
+// emitter table built here.
+//
+// A destroyed emitter keeps its slot, emitting nothing, until its longest
+// possible particle life has passed, so live particles never pick up the
+// parameters of an emitter that later reuses the slot.
+class ParticleEmitterRegistry {
+ public:
+  using GeometryResolver =
+      std::function<EmitterGeometry(EmitterID id,
+                                    const ParticleEmitter& emitter)>;
+
+  EmitterID Create(const ParticleEmitter& emitter = ParticleEmitter());
+  void Destroy(EmitterID id);
+
+  // nullptr when id is not a live emitter.
+  ParticleEmitter* Get(EmitterID id);
+  const ParticleEmitter* Get(EmitterID id) const;
+
+  // Live emitters in slot order.
+  std::vector<EmitterID> GetEmitters() const;
+
+  // Rows of the emitter table, including retiring slots.
+  uint32_t GetSlotCount() const {
+    return static_cast<uint32_t>(m_slots.size());
+  }
+
+  // Advances emission and slot retirement by one simulation step and
+  // returns the particles every slot emits in it.
+  void Step(float dt, std::vector<uint32_t>& emitCounts);
+
+  // One row per slot, emit ranges laid out back to back in slot order. The
+  // force fields of every slot in use, retiring ones included, are packed
+  // into forceFields in the same order and addressed by the rows.
+  void BuildTable(const std::vector<uint32_t>& emitCounts,
+                  const GeometryResolver& resolveGeometry,
+                  std::vector<EmitterParams>& table,
+                  std::vector<ForceFieldParams>& forceFields) const;
+
+ private:
+  struct Slot {
+    ParticleEmitter emitter;
+    float emitAccumulator = 0.0f;
+    float retireTime = 0.0f;  // seconds until a destroyed slot is free
+    bool alive = false;
+    bool used = false;  // alive or still retiring
+  };
+
+  std::vector<Slot> m_slots;
+};
+}  // namespace my
\ No newline at end of file
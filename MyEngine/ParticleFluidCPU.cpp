@@ -0,0 +1,243 @@
+#include "ParticleFluidCPU.h"
+
+#include <algorithm>
+#include <atomic>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "JobSystem.h"
+#include "SIMD.h"
+
+namespace my {
+namespace {
+// Sorted fluid particles one density or force job handles.
+const uint32_t kGroupSize = 256;
+
+// Fluid particles one reordering job handles.
+const uint32_t kCopyGroupSize = 4096;
+
+uint32_t PopCount(uint32_t x) {
+#ifdef _MSC_VER
+  return static_cast<uint32_t>(__popcnt(x));
+#else
+  return static_cast<uint32_t>(__builtin_popcount(x));
+#endif
+}
+
+float HorizontalSum(simd::vfloat v) {
+  float lanes[simd::kWidth];
+  simd::Store(lanes, v);
+  float sum = 0.0f;
+  for (uint32_t l = 0; l < simd::kWidth; l++) sum += lanes[l];
+  return sum;
+}
+
+// Lanes of the vector loaded at j that come before end.
+simd::vmask LanesBefore(uint32_t j, uint32_t end) {
+  const uint32_t left = end - j;
+  return simd::FromBits(left >= simd::kWidth ? (1u << simd::kWidth) - 1
+                                             : (1u << left) - 1);
+}
+}  // namespace
+
+void ParticleFluidCPU::Step(ParticleStorageSoA& storage,
+                            const uint32_t* aliveList, uint32_t aliveCount,
+                            const ParticleSystemCB& cb,
+                            const std::vector<EmitterParams>& emitters,
+                            float dt) {
+  using namespace simd;
+
+  BuildGrid(storage, aliveList, aliveCount, cb, emitters);
+
+  m_neighborCount = 0;
+  const uint32_t count = m_count;
+  if (count == 0) return;
+
+  const uint32_t groupCount = JobSystem::GetGroupCount(count, kGroupSize);
+  const float h = cb.xSPH_h;
+  const NeighborGrid::Cell* cells = m_grid.GetCells();
+  const float* positionX = m_grid.GetPositionX();
+  const float* positionY = m_grid.GetPositionY();
+  const float* positionZ = m_grid.GetPositionZ();
+
+  // density and pressure:
+  std::atomic<uint64_t> neighborCount(0);
+  JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kGroupSize;
+    const uint32_t end = std::min(begin + kGroupSize, count);
+    const vfloat h2 = Set1(cb.xSPH_h2);
+    const vfloat zero = Set1(0.0f);
+
+    // Consecutive particles mostly share a cell, and with it the ranges.
+    NeighborGrid::Range ranges[NeighborGrid::MAX_RANGES];
+    uint32_t rangeCount = 0;
+    uint64_t neighbors = 0;
+    for (uint32_t i = begin; i < end; i++) {
+      const NeighborGrid::Cell& cell = cells[i];
+      if (i == begin || cell.x != cells[i - 1].x || cell.y != cells[i - 1].y ||
+          cell.z != cells[i - 1].z)
+        rangeCount = m_grid.GatherNeighborhood(cell, ranges);
+
+      const vfloat x = Set1(positionX[i]);
+      const vfloat y = Set1(positionY[i]);
+      const vfloat z = Set1(positionZ[i]);
+
+      vfloat density = zero;
+      for (uint32_t r = 0; r < rangeCount; r++) {
+        for (uint32_t j = ranges[r].begin; j < ranges[r].end; j += kWidth) {
+          const vfloat dx = Load(&positionX[j]) - x;
+          const vfloat dy = Load(&positionY[j]) - y;
+          const vfloat dz = Load(&positionZ[j]) - z;
+          const vfloat r2 = dx * dx + dy * dy + dz * dz;
+          const vmask inside = LanesBefore(j, ranges[r].end) & (r2 < h2);
+
+          // poly6: (h^2 - r^2)^3
+          const vfloat w = h2 - r2;
+          density = density +
+                    Select(inside, w * w * w * Load(&m_mass[j]), zero);
+          neighbors += PopCount(MoveMask(inside));
+        }
+      }
+
+      // what the force pass needs of a neighbor: m / rho and m * p / rho
+      const float densitySum = HorizontalSum(density) * cb.xSPH_poly6_constant;
+      const float pressure = cb.xSPH_K * (densitySum - cb.xSPH_p0);
+      m_density[i] = densitySum;
+      m_massOverDensity[i] = densitySum > 0.0f ? m_mass[i] / densitySum : 0.0f;
+      m_pressureTerm[i] = m_massOverDensity[i] * pressure;
+    }
+    neighborCount += neighbors;
+  });
+  m_neighborCount = neighborCount;
+
+  // pressure and viscosity forces, applied to the pool right away since the
+  // passes only read the sorted copy:
+  JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kGroupSize;
+    const uint32_t end = std::min(begin + kGroupSize, count);
+    const vfloat vh = Set1(h);
+    const vfloat h2 = Set1(cb.xSPH_h2);
+    const vfloat zero = Set1(0.0f);
+    const vfloat half = Set1(0.5f);
+
+    NeighborGrid::Range ranges[NeighborGrid::MAX_RANGES];
+    uint32_t rangeCount = 0;
+    for (uint32_t i = begin; i < end; i++) {
+      const NeighborGrid::Cell& cell = cells[i];
+      if (i == begin || cell.x != cells[i - 1].x || cell.y != cells[i - 1].y ||
+          cell.z != cells[i - 1].z)
+        rangeCount = m_grid.GatherNeighborhood(cell, ranges);
+      if (!(m_density[i] > 0.0f)) continue;
+
+      const vfloat position[3] = {Set1(positionX[i]), Set1(positionY[i]),
+                                  Set1(positionZ[i])};
+      const vfloat velocity[3] = {Set1(m_velocityX[i]), Set1(m_velocityY[i]),
+                                  Set1(m_velocityZ[i])};
+      const vfloat pressure =
+          Set1(cb.xSPH_K * (m_density[i] - cb.xSPH_p0));
+
+      vfloat pressureSum[3] = {zero, zero, zero};
+      vfloat viscositySum[3] = {zero, zero, zero};
+      for (uint32_t r = 0; r < rangeCount; r++) {
+        for (uint32_t j = ranges[r].begin; j < ranges[r].end; j += kWidth) {
+          const vfloat d[3] = {position[0] - Load(&positionX[j]),
+                               position[1] - Load(&positionY[j]),
+                               position[2] - Load(&positionZ[j])};
+          const vfloat r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+
+          // the particle itself and ones at the same spot have no direction
+          const vmask inside =
+              LanesBefore(j, ranges[r].end) & (r2 < h2) & (r2 > zero);
+          if (MoveMask(inside) == 0) continue;
+
+          const vfloat distanceRcp = Rsqrt(r2);
+          const vfloat hr = vh - r2 * distanceRcp;
+          const vfloat massOverDensity = Load(&m_massOverDensity[j]);
+
+          // m / rho * (p_i + p_j) / 2 times the spiky gradient, (h - r)^2
+          // along the unit vector d / r
+          const vfloat pressureWeight =
+              (pressure * massOverDensity + Load(&m_pressureTerm[j])) * half *
+              hr * hr * distanceRcp;
+          // m / rho times the viscosity laplacian, h - r
+          const vfloat viscosityWeight = massOverDensity * hr;
+
+          const vfloat neighborVelocity[3] = {Load(&m_velocityX[j]),
+                                              Load(&m_velocityY[j]),
+                                              Load(&m_velocityZ[j])};
+          for (uint32_t c = 0; c < 3; c++) {
+            pressureSum[c] =
+                pressureSum[c] + Select(inside, pressureWeight * d[c], zero);
+            viscositySum[c] =
+                viscositySum[c] +
+                Select(inside,
+                       viscosityWeight * (neighborVelocity[c] - velocity[c]),
+                       zero);
+          }
+        }
+      }
+
+      float acceleration[3];
+      for (uint32_t c = 0; c < 3; c++) {
+        const float force =
+            -cb.xSPH_spiky_constant * HorizontalSum(pressureSum[c]) +
+            cb.xSPH_e * cb.xSPH_visc_constant * HorizontalSum(viscositySum[c]);
+        acceleration[c] = force / m_density[i];
+      }
+
+      const uint32_t slot = m_grid.GetParticles()[i];
+      storage.velocityX[slot] += acceleration[0] * dt;
+      storage.velocityY[slot] += acceleration[1] * dt;
+      storage.velocityZ[slot] += acceleration[2] * dt;
+    }
+  });
+}
+
+void ParticleFluidCPU::BuildGrid(const ParticleStorageSoA& storage,
+                                 const uint32_t* aliveList,
+                                 uint32_t aliveCount,
+                                 const ParticleSystemCB& cb,
+                                 const std::vector<EmitterParams>& emitters) {
+  m_unsorted.clear();
+  m_count = 0;
+  if (std::none_of(emitters.begin(), emitters.end(),
+                   [](const EmitterParams& row) { return row.sph != 0; }))
+    return;
+
+  // particles that die this step take no part, as on the GPU
+  for (uint32_t i = 0; i < aliveCount; i++) {
+    const uint32_t slot = aliveList[i];
+    if (emitters[storage.emitterIndex[slot]].sph != 0 &&
+        storage.life[slot] > 0)
+      m_unsorted.push_back(slot);
+  }
+  m_count = static_cast<uint32_t>(m_unsorted.size());
+  if (m_count == 0) return;
+
+  // the buckets of the CS_ParticleSystem_SPH_* kernels
+  m_grid.Build(storage.positionX.data(), storage.positionY.data(),
+               storage.positionZ.data(), m_unsorted.data(), m_count,
+               cb.xSPH_h, SPH_GRID_SIZE);
+
+  const uint32_t padded = m_count + simd::kWidth;
+  for (std::vector<float>* column :
+       {&m_velocityX, &m_velocityY, &m_velocityZ, &m_mass, &m_density,
+        &m_massOverDensity, &m_pressureTerm})
+    column->resize(padded, 0.0f);
+
+  m_grid.Reorder(storage.velocityX.data(), m_velocityX.data());
+  m_grid.Reorder(storage.velocityY.data(), m_velocityY.data());
+  m_grid.Reorder(storage.velocityZ.data(), m_velocityZ.data());
+
+  const uint32_t* particles = m_grid.GetParticles();
+  JobSystem::Dispatch(
+      JobSystem::GetGroupCount(m_count, kCopyGroupSize), 1, [&](JobArgs args) {
+        const uint32_t begin = args.jobIndex * kCopyGroupSize;
+        const uint32_t end = std::min(begin + kCopyGroupSize, m_count);
+        for (uint32_t i = begin; i < end; i++)
+          m_mass[i] = emitters[storage.emitterIndex[particles[i]]].mass;
+      });
+}
+}  // namespace my
\ No newline at end of file
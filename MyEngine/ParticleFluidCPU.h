@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "NeighborGrid.h"
+#include "ParticleStorageSoA.h"
+#include "ParticleSystemTypes.h"
+
+namespace my {
+// Headless port of the CS_ParticleSystem_SPH_* kernels: smoothed particle
+// hydrodynamics after Mueller et al. 2003 over the particles of every emitter
+// with sph set, which form one fluid with the parameters of the
+// ParticleSystemCB.
+//
+// Step() sorts the fluid particles into a NeighborGrid with the buckets the
+// kernels use (SPH_GRID_SIZE of them, cells one smoothing radius wide) and
+// copies their state into that order, so the neighbors of a particle are a
+// few contiguous runs the density and force passes read a SIMD vector at a
+// time.
+// Both passes run as jobs over the sorted particles and a job only writes
+// its own particles, so the result does not depend on the thread count.
+class ParticleFluidCPU {
+ public:
+  // Adds dt times the SPH acceleration to the velocity of every particle in
+  // aliveList[0, aliveCount) whose emitter row has sph set and whose life is
+  // not over. Nothing else is written.
+  void Step(ParticleStorageSoA& storage, const uint32_t* aliveList,
+            uint32_t aliveCount, const ParticleSystemCB& cb,
+            const std::vector<EmitterParams>& emitters, float dt);
+
+  // Fluid particles of the last Step(), their pool slots in bucket order,
+  // and their densities in the same order.
+  uint32_t GetCount() const { return m_count; }
+  const uint32_t* GetParticles() const { return m_grid.GetParticles(); }
+  const float* GetDensities() const { return m_density.data(); }
+
+  // Pairs closer than the smoothing radius the last Step() found, every
+  // particle counting itself once.
+  uint64_t GetNeighborCount() const { return m_neighborCount; }
+
+ private:
+  // Sorts the fluid particles into the grid and gathers the rest of their
+  // state.
+  void BuildGrid(const ParticleStorageSoA& storage, const uint32_t* aliveList,
+                 uint32_t aliveCount, const ParticleSystemCB& cb,
+                 const std::vector<EmitterParams>& emitters);
+
+  // Fluid particles in alive list order.
+  std::vector<uint32_t> m_unsorted;
+  uint32_t m_count = 0;
+
+  NeighborGrid m_grid;
+
+  // State of the fluid particles in grid order, next to the positions the
+  // grid keeps. The columns are padded by a SIMD vector so the passes can
+  // load past the last particle.
+  std::vector<float> m_velocityX;
+  std::vector<float> m_velocityY;
+  std::vector<float> m_velocityZ;
+  std::vector<float> m_mass;
+  std::vector<float> m_density;
+  std::vector<float> m_massOverDensity;
+  std::vector<float> m_pressureTerm;  // mass * pressure / density
+
+  uint64_t m_neighborCount = 0;
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "ParticleForceFields.h"
+
+namespace my {
+namespace {
+using simd::vfloat;
+
+// Squared distance below which a direction is not normalized any more, so
+// the center of an attractor or the axis of a vortex feels nothing.
+const float kMinDistanceSq = 1e-8f;
+
+vfloat Fract(vfloat x) { return x - simd::Floor(x); }
+
+vfloat Dot(const vfloat a[3], const vfloat b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Hoskins' hash33 (Hash without Sine) of the lattice point q: three values
+// in [0, 1).
+void Hash33(const vfloat q[3], vfloat h[3]) {
+  using namespace simd;
+  const vfloat x0 = Fract(q[0] * Set1(0.1031f));
+  const vfloat y0 = Fract(q[1] * Set1(0.1030f));
+  const vfloat z0 = Fract(q[2] * Set1(0.0973f));
+  const vfloat offset = Set1(33.33f);
+  const vfloat d = x0 * (y0 + offset) + y0 * (x0 + offset) +
+                   z0 * (z0 + offset);
+  const vfloat x = x0 + d;
+  const vfloat y = y0 + d;
+  const vfloat z = z0 + d;
+  h[0] = Fract((x + y) * z);
+  h[1] = Fract((x + x) * y);
+  h[2] = Fract((y + x) * x);
+}
+
+// Curl of three value noise potentials at p. Quintic interpolation keeps the
+// gradients continuous across cells; they come out of the interpolation in
+// the closed form of Quilez, with the lattice corner c = x + 2y + 4z.
+// Lattice values in [0, 1) rather than [-1, 1) halve the curl, which brings
+// its RMS length to about 0.94.
+void CurlNoise(const vfloat p[3], vfloat curl[3]) {
+  using namespace simd;
+
+  vfloat cell[3], u[3], du[3];
+  for (uint32_t c = 0; c < 3; c++) {
+    cell[c] = Floor(p[c]);
+    const vfloat f = p[c] - cell[c];
+    u[c] = f * f * f * (f * (f * Set1(6.0f) - Set1(15.0f)) + Set1(10.0f));
+    du[c] = Set1(30.0f) * f * f * (f * (f - Set1(2.0f)) + Set1(1.0f));
+  }
+
+  vfloat h[8][3];
+  for (uint32_t corner = 0; corner < 8; corner++) {
+    const vfloat q[3] = {corner & 1 ? cell[0] + Set1(1.0f) : cell[0],
+                         corner & 2 ? cell[1] + Set1(1.0f) : cell[1],
+                         corner & 4 ? cell[2] + Set1(1.0f) : cell[2]};
+    Hash33(q, h[corner]);
+  }
+
+  // gradient[k] of potential k
+  vfloat gradient[3][3];
+  const vfloat uxy = u[0] * u[1], uyz = u[1] * u[2], uzx = u[2] * u[0];
+  for (uint32_t k = 0; k < 3; k++) {
+    const vfloat a = h[0][k], b = h[1][k], c = h[2][k], d = h[3][k];
+    const vfloat e = h[4][k], f = h[5][k], g = h[6][k], i = h[7][k];
+    const vfloat k1 = b - a;
+    const vfloat k2 = c - a;
+    const vfloat k3 = e - a;
+    const vfloat k4 = a - b - c + d;
+    const vfloat k5 = a - c - e + g;
+    const vfloat k6 = a - b - e + f;
+    const vfloat k7 = b + c + e + i - a - d - f - g;
+    gradient[k][0] = du[0] * (k1 + k4 * u[1] + k6 * u[2] + k7 * uyz);
+    gradient[k][1] = du[1] * (k2 + k5 * u[2] + k4 * u[0] + k7 * uzx);
+    gradient[k][2] = du[2] * (k3 + k6 * u[0] + k5 * u[1] + k7 * uxy);
+  }
+
+  curl[0] = gradient[2][1] - gradient[1][2];
+  curl[1] = gradient[0][2] - gradient[2][0];
+  curl[2] = gradient[1][0] - gradient[0][1];
+}
+}  // namespace
+
+void AccumulateForceFields(const ForceFieldParams* fields, uint32_t count,
+                           const vfloat position[3], vfloat acceleration[3]) {
+  using namespace simd;
+
+  for (uint32_t i = 0; i < count; i++) {
+    const ForceFieldParams& field = fields[i];
+    const vfloat center[3] = {Set1(field.position.x), Set1(field.position.y),
+                              Set1(field.position.z)};
+    const vfloat axis[3] = {Set1(field.direction.x), Set1(field.direction.y),
+                            Set1(field.direction.z)};
+    vfloat offset[3];
+    for (uint32_t c = 0; c < 3; c++) offset[c] = position[c] - center[c];
+
+    // direction of the force and the distance its falloff is taken at
+    vfloat force[3];
+    vfloat distanceSq = Set1(0.0f);
+    switch (static_cast<ForceFieldType>(field.type)) {
+      case ForceFieldType::Attractor: {
+        distanceSq = Dot(offset, offset);
+        const vfloat scale =
+            Set1(0.0f) - Rsqrt(Max(distanceSq, Set1(kMinDistanceSq)));
+        for (uint32_t c = 0; c < 3; c++) force[c] = offset[c] * scale;
+        break;
+      }
+      case ForceFieldType::Vortex: {
+        const vfloat along = Dot(offset, axis);
+        vfloat radial[3];
+        for (uint32_t c = 0; c < 3; c++)
+          radial[c] = offset[c] - axis[c] * along;
+        distanceSq = Dot(radial, radial);
+        const vfloat scale = Rsqrt(Max(distanceSq, Set1(kMinDistanceSq)));
+        force[0] = (axis[1] * radial[2] - axis[2] * radial[1]) * scale;
+        force[1] = (axis[2] * radial[0] - axis[0] * radial[2]) * scale;
+        force[2] = (axis[0] * radial[1] - axis[1] * radial[0]) * scale;
+        break;
+      }
+      case ForceFieldType::Wind:
+        for (uint32_t c = 0; c < 3; c++) force[c] = axis[c];
+        if (field.rangeRcp > 0.0f) distanceSq = Dot(offset, offset);
+        break;
+      case ForceFieldType::Turbulence: {
+        const vfloat frequency = Set1(field.frequency);
+        const vfloat p[3] = {position[0] * frequency,
+                             position[1] * frequency,
+                             position[2] * frequency};
+        CurlNoise(p, force);
+        if (field.rangeRcp > 0.0f) distanceSq = Dot(offset, offset);
+        break;
+      }
+      default:
+        continue;
+    }
+
+    vfloat weight = Set1(field.strength);
+    if (field.rangeRcp > 0.0f) {
+      const vfloat fade = Saturate(
+          Set1(1.0f) - Sqrt(distanceSq) * Set1(field.rangeRcp));
+      weight = weight * fade * fade;
+    }
+    for (uint32_t c = 0; c < 3; c++)
+      acceleration[c] = MulAdd(force[c], weight, acceleration[c]);
+  }
+}
+
+void AccumulateForceFields(const ForceFieldParams* fields, uint32_t count,
+                           const float position[3], float acceleration[3]) {
+  using namespace simd;
+
+  const vfloat p[3] = {Set1(position[0]), Set1(position[1]),
+                       Set1(position[2])};
+  vfloat a[3] = {Set1(0.0f), Set1(0.0f), Set1(0.0f)};
+  AccumulateForceFields(fields, count, p, a);
+
+  float lanes[kWidth];
+  for (uint32_t c = 0; c < 3; c++) {
+    Store(lanes, a[c]);
+    acceleration[c] += lanes[0];
+  }
+}
+
+void EvaluateForceFields(const ForceFieldParams* fields, uint32_t count,
+                         const float* const position[3],
+                         uint32_t particleCount,
+                         float* const acceleration[3]) {
+  using namespace simd;
+
+  uint32_t i = 0;
+  for (; i + kWidth <= particleCount; i += kWidth) {
+    const vfloat p[3] = {Load(position[0] + i), Load(position[1] + i),
+                         Load(position[2] + i)};
+    vfloat a[3] = {Set1(0.0f), Set1(0.0f), Set1(0.0f)};
+    AccumulateForceFields(fields, count, p, a);
+    for (uint32_t c = 0; c < 3; c++) Store(acceleration[c] + i, a[c]);
+  }
+  for (; i < particleCount; i++) {
+    const float p[3] = {position[0][i], position[1][i], position[2][i]};
+    float a[3] = {0.0f, 0.0f, 0.0f};
+    AccumulateForceFields(fields, count, p, a);
+    for (uint32_t c = 0; c < 3; c++) acceleration[c][i] = a[c];
+  }
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ParticleSystemTypes.h"
+#include "SIMD.h"
+
+namespace my {
+// Headless twin of force_field_acceleration() in
+// CS_ParticleSystem_Simulate.hlsl: the acceleration a list of pooled force
+// fields gives particles at their positions (WS).
+//
+// Fields are evaluated for a SIMD vector of particles at a time, the fields
+// being the same for every lane. Turbulence is the curl of three value noise
+// potentials with analytic gradients, all three hashed at once per lattice
+// corner with Hoskins' hash33, which needs nothing but float arithmetic and
+// so runs the same on every lane and in the shader. The single particle
+// version evaluates a broadcast vector, so both agree exactly.
+//
+// Adds the acceleration of fields[0, count) at position to acceleration.
+void AccumulateForceFields(const ForceFieldParams* fields, uint32_t count,
+                           const simd::vfloat position[3],
+                           simd::vfloat acceleration[3]);
+void AccumulateForceFields(const ForceFieldParams* fields, uint32_t count,
+                           const float position[3], float acceleration[3]);
+
+// Acceleration of fields[0, count) at the positions of particles
+// [0, particleCount), given and written as coordinate columns, on the
+// calling thread.
+void EvaluateForceFields(const ForceFieldParams* fields, uint32_t count,
+                         const float* const position[3],
+                         uint32_t particleCount, float* const acceleration[3]);
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "ParticleRasterizerCPU.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "JobSystem.h"
+#include "ParticleSystemCPU.h"
+
+// The only stb_image_write implementation of the engine; tinygltf links
+// against it too.
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+namespace my {
+namespace {
+const float BILLBOARD[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+// Triangle strip order to clockwise polygon order.
+const uint32_t POLYGON_ORDER[4] = {0, 1, 3, 2};
+
+const int32_t SUBPIXEL_BITS = 8;
+const int32_t SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+const int32_t SUBPIXEL_HALF = SUBPIXEL_ONE / 2;
+
+// Farthest a snapped corner may be from the image, in pixels, so edge
+// functions stay well inside 64 bits.
+const float GUARD_BAND = 1 << 20;
+
+// pack_rgba/unpack_rgba of hlsl/Header.hlsli.
+float Unpack(uint32_t color, uint32_t shift) {
+  return static_cast<float>((color >> shift) & 0xFF) / 255.0f;
+}
+
+uint32_t Pack(float value, uint32_t shift) {
+  return static_cast<uint32_t>(value * 255.0f) << shift;
+}
+}  // namespace
+
+void ParticleRasterizerCPU::Resize(uint32_t width, uint32_t height) {
+  m_width = width;
+  m_height = height;
+  m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+  m_pixels.resize(static_cast<size_t>(width) * height);
+  m_tileFragments.resize(m_tilesX * m_tilesY);
+}
+
+void ParticleRasterizerCPU::Clear(uint32_t color) {
+  std::fill(m_pixels.begin(), m_pixels.end(), color);
+}
+
+void ParticleRasterizerCPU::Draw(const Particle* particles,
+                                 const uint32_t* aliveList,
+                                 uint32_t aliveCount,
+                                 const BillboardCamera& camera) {
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  m_stats = Stats();
+  const uint32_t tileCount = m_tilesX * m_tilesY;
+  if (tileCount == 0 || aliveCount == 0) return;
+
+  m_quads.resize(aliveCount);
+  SetupQuads(particles, aliveList, aliveCount, camera);
+
+  const uint32_t chunkCount = (aliveCount + BIN_CHUNK - 1) / BIN_CHUNK;
+  if (m_bins.size() < static_cast<size_t>(chunkCount) * tileCount)
+    m_bins.resize(static_cast<size_t>(chunkCount) * tileCount);
+  JobSystem::Dispatch(chunkCount, 1,
+                      [&](JobArgs args) { BinQuads(args.jobIndex); });
+
+  JobSystem::Dispatch(tileCount, 1, [&](JobArgs args) {
+    m_tileFragments[args.jobIndex] = RasterizeTile(args.jobIndex);
+  });
+
+  for (const Quad& quad : m_quads) {
+    if (quad.minX <= quad.maxX) m_stats.quads++;
+  }
+  for (size_t i = 0; i < static_cast<size_t>(chunkCount) * tileCount; i++)
+    m_stats.binEntries += m_bins[i].size();
+  for (uint64_t fragments : m_tileFragments) m_stats.fragments += fragments;
+
+  const auto stop = std::chrono::high_resolution_clock::now();
+  m_stats.milliseconds =
+      std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+void ParticleRasterizerCPU::Draw(const ParticleSystemCPU& system,
+                                 const BillboardCamera& camera) {
+  system.ExportParticles(m_exported);
+  Draw(m_exported.data(), system.GetAliveList().data(),
+       system.GetDrawArgs().vertexCountPerInstance, camera);
+}
+
+bool ParticleRasterizerCPU::WritePNG(const std::string& path) const {
+  if (m_pixels.empty()) return false;
+
+  // little endian: the packed pixels already are R, G, B, A bytes
+  return stbi_write_png(path.c_str(), m_width, m_height, 4, m_pixels.data(),
+                        m_width * sizeof(uint32_t)) != 0;
+}
+
+void ParticleRasterizerCPU::SetupQuads(const Particle* particles,
+                                       const uint32_t* aliveList,
+                                       uint32_t aliveCount,
+                                       const BillboardCamera& camera) {
+  const float (*view)[4] = camera.view.m;
+  const float (*viewProj)[4] = camera.viewProj.m;
+  const float t = camera.interpolation;
+  const float width = static_cast<float>(m_width);
+  const float height = static_cast<float>(m_height);
+
+  JobSystem::Dispatch(aliveCount, 256, [&](JobArgs args) {
+    const Particle& particle = particles[aliveList[args.jobIndex]];
+    Quad& quad = m_quads[args.jobIndex];
+    quad.minX = 1;
+    quad.maxX = 0;
+
+    // VS_ParticleSystem:
+    const float lifeLerp = 1 - particle.life / particle.maxLife;
+    const float size = particle.sizeBeginEnd.x +
+                       lifeLerp * (particle.sizeBeginEnd.y -
+                                   particle.sizeBeginEnd.x);
+    const float opacity = std::min(std::max(1 - lifeLerp, 0.0f), 1.0f);
+    const uint32_t color = particle.color;
+    quad.color = Pack(Unpack(color, 0), 0) | Pack(Unpack(color, 8), 8) |
+                 Pack(Unpack(color, 16), 16) |
+                 Pack(Unpack(color, 24) * opacity, 24);
+    if ((quad.color >> 24) == 0) return;
+
+    const float center[3] = {
+        particle.positionPrev.x + t * (particle.position.x -
+                                       particle.positionPrev.x),
+        particle.positionPrev.y + t * (particle.position.y -
+                                       particle.positionPrev.y),
+        particle.positionPrev.z + t * (particle.position.z -
+                                       particle.positionPrev.z)};
+    const float rotation = lifeLerp * particle.rotationalVelocity;
+    const float c = std::cos(rotation);
+    const float s = std::sin(rotation);
+
+    // GS_ParticleSystem:
+    float screen[4][2];
+    bool beyondFar = true;
+    for (uint32_t i = 0; i < 4; i++) {
+      const float qx = (BILLBOARD[i][0] * c + BILLBOARD[i][1] * s) * size;
+      const float qy = (-BILLBOARD[i][0] * s + BILLBOARD[i][1] * c) * size;
+
+      // the inverse view rotation maps x and y to the camera right and up
+      float world[3];
+      for (uint32_t k = 0; k < 3; k++)
+        world[k] = center[k] + view[k][0] * qx + view[k][1] * qy;
+
+      float clip[4];
+      for (uint32_t k = 0; k < 4; k++) {
+        clip[k] = world[0] * viewProj[0][k] + world[1] * viewProj[1][k] +
+                  world[2] * viewProj[2][k] + viewProj[3][k];
+      }
+      if (clip[3] <= 0 || clip[2] < 0) return;
+      beyondFar = beyondFar && clip[2] > clip[3];
+
+      screen[i][0] = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+      screen[i][1] = (0.5f - clip[1] / clip[3] * 0.5f) * height;
+      if (std::abs(screen[i][0]) > GUARD_BAND + width ||
+          std::abs(screen[i][1]) > GUARD_BAND + height)
+        return;
+    }
+    if (beyondFar) return;
+
+    int64_t area = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+      const float* corner = screen[POLYGON_ORDER[i]];
+      quad.x[i] = static_cast<int32_t>(std::lround(corner[0] * SUBPIXEL_ONE));
+      quad.y[i] = static_cast<int32_t>(std::lround(corner[1] * SUBPIXEL_ONE));
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+      const uint32_t j = (i + 1) % 4;
+      area += static_cast<int64_t>(quad.x[i]) * quad.y[j] -
+              static_cast<int64_t>(quad.x[j]) * quad.y[i];
+    }
+    // clockwise on screen (y down) is the front face
+    if (area <= 0) return;
+
+    const int32_t minX = *std::min_element(quad.x, quad.x + 4);
+    const int32_t maxX = *std::max_element(quad.x, quad.x + 4);
+    const int32_t minY = *std::min_element(quad.y, quad.y + 4);
+    const int32_t maxY = *std::max_element(quad.y, quad.y + 4);
+    quad.minX = std::max(minX >> SUBPIXEL_BITS, 0);
+    quad.maxX = std::min(maxX >> SUBPIXEL_BITS, int32_t(m_width) - 1);
+    quad.minY = std::max(minY >> SUBPIXEL_BITS, 0);
+    quad.maxY = std::min(maxY >> SUBPIXEL_BITS, int32_t(m_height) - 1);
+    if (quad.minY > quad.maxY) quad.maxX = quad.minX - 1;
+  });
+}
+
+void ParticleRasterizerCPU::BinQuads(uint32_t chunk) {
+  const uint32_t tileCount = m_tilesX * m_tilesY;
+  const int32_t tileSize = TILE_SIZE;
+  std::vector<uint32_t>* bins = &m_bins[static_cast<size_t>(chunk) * tileCount];
+  for (uint32_t i = 0; i < tileCount; i++) bins[i].clear();
+
+  const uint32_t begin = chunk * BIN_CHUNK;
+  const uint32_t end =
+      std::min(begin + BIN_CHUNK, static_cast<uint32_t>(m_quads.size()));
+  for (uint32_t i = begin; i < end; i++) {
+    const Quad& quad = m_quads[i];
+    if (quad.minX > quad.maxX) continue;
+
+    for (int32_t ty = quad.minY / tileSize; ty <= quad.maxY / tileSize; ty++) {
+      for (int32_t tx = quad.minX / tileSize; tx <= quad.maxX / tileSize; tx++)
+        bins[ty * m_tilesX + tx].push_back(i);
+    }
+  }
+}
+
+uint64_t ParticleRasterizerCPU::RasterizeTile(uint32_t tile) {
+  const uint32_t tileCount = m_tilesX * m_tilesY;
+  const int32_t tileX = (tile % m_tilesX) * TILE_SIZE;
+  const int32_t tileY = (tile / m_tilesX) * TILE_SIZE;
+  const int32_t tileMaxX = std::min(tileX + int(TILE_SIZE), int(m_width)) - 1;
+  const int32_t tileMaxY = std::min(tileY + int(TILE_SIZE), int(m_height)) - 1;
+
+  uint64_t fragments = 0;
+  const size_t chunkCount = (m_quads.size() + BIN_CHUNK - 1) / BIN_CHUNK;
+  for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+    for (uint32_t index : m_bins[chunk * tileCount + tile]) {
+      const Quad& quad = m_quads[index];
+      const int32_t x0 = std::max(quad.minX, tileX);
+      const int32_t x1 = std::min(quad.maxX, tileMaxX);
+      const int32_t y0 = std::max(quad.minY, tileY);
+      const int32_t y1 = std::min(quad.maxY, tileMaxY);
+
+      // Edge functions at the center of pixel (x0, y0) and their steps per
+      // pixel. A pixel is inside when all are >= 0; the bias makes centers
+      // exactly on an edge count only for top and left edges.
+      int64_t rowStart[4];
+      int64_t stepX[4];
+      int64_t stepY[4];
+      const int64_t px = int64_t(x0) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+      const int64_t py = int64_t(y0) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+      for (uint32_t i = 0; i < 4; i++) {
+        const uint32_t j = (i + 1) % 4;
+        const int64_t dx = int64_t(quad.x[j]) - quad.x[i];
+        const int64_t dy = int64_t(quad.y[j]) - quad.y[i];
+        const bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+        // corners snapped together leave an edge that bounds nothing
+        const int64_t bias = topLeft || (dx == 0 && dy == 0) ? 0 : -1;
+        rowStart[i] = dx * (py - quad.y[i]) - dy * (px - quad.x[i]) + bias;
+        stepX[i] = -dy * SUBPIXEL_ONE;
+        stepY[i] = dx * SUBPIXEL_ONE;
+      }
+
+      const float alpha = static_cast<float>(quad.color >> 24) / 255.0f;
+      const float src[3] = {Unpack(quad.color, 0) * alpha,
+                            Unpack(quad.color, 8) * alpha,
+                            Unpack(quad.color, 16) * alpha};
+      const float keep = (1 - alpha) / 255.0f;
+
+      for (int32_t y = y0; y <= y1; y++) {
+        int64_t e[4] = {rowStart[0], rowStart[1], rowStart[2], rowStart[3]};
+        uint32_t* row = &m_pixels[static_cast<size_t>(y) * m_width];
+        for (int32_t x = x0; x <= x1; x++) {
+          if ((e[0] | e[1] | e[2] | e[3]) >= 0) {
+            // src * SrcAlpha + dst * InvSrcAlpha, destination alpha kept
+            const uint32_t dst = row[x];
+            uint32_t result = dst & 0xFF000000;
+            for (uint32_t c = 0; c < 3; c++) {
+              const float value =
+                  src[c] + static_cast<float>((dst >> (c * 8)) & 0xFF) * keep;
+              result |= static_cast<uint32_t>(value * 255.0f + 0.5f)
+                        << (c * 8);
+            }
+            row[x] = result;
+            fragments++;
+          }
+          for (uint32_t i = 0; i < 4; i++) e[i] += stepX[i];
+        }
+        for (uint32_t i = 0; i < 4; i++) rowStart[i] += stepY[i];
+      }
+    }
+  }
+  return fragments;
+}
+}  // namespace my
\ No newline at end of file
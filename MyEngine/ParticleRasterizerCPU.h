@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ParticleSystemTypes.h"
+
+namespace my {
+class ParticleSystemCPU;
+
+// Matrices of the camera the billboards face, in the row-vector convention
+// of Camera (the CPU side of matWS2CS and matWS2PS before the transpose).
+struct BillboardCamera {
+  float4x4 view;      // world to view
+  float4x4 viewProj;  // world to clip
+  float interpolation = 1.0f;  // between positionPrev and position
+};
+
+// Headless twin of the particle draw (VS/GS/PS_ParticleSystem.hlsl with the
+// engine's blend and rasterizer state): every alive particle is expanded to
+// a rotated camera-facing quad and blended with SrcAlpha/InvSrcAlpha into an
+// RGBA8 image; the destination alpha is kept. Back faces are culled like
+// D3D11_CULL_BACK and edges follow the D3D top-left rule on a 1/256 pixel
+// grid. Quads reaching behind the near plane are dropped, not clipped.
+//
+// The image is split into TILE_SIZE tiles. Quads are binned in chunks of
+// the draw list and each tile is then rasterized by one job, walking the
+// chunks in order, so every pixel blends its quads in draw order and the
+// result does not depend on the thread count.
+class ParticleRasterizerCPU {
+ public:
+  static const uint32_t TILE_SIZE = 64;
+
+  struct Stats {
+    uint32_t quads = 0;        // quads that survived culling
+    uint64_t binEntries = 0;   // (quad, tile) pairs
+    uint64_t fragments = 0;    // pixels blended
+    double milliseconds = 0.0;  // of the last Draw()
+  };
+
+  // Resizes the image; its contents are undefined until the next Clear().
+  void Resize(uint32_t width, uint32_t height);
+
+  // color is packed like Particle::color, red in the low byte.
+  void Clear(uint32_t color = 0xFF000000);
+
+  // Blends particles[aliveList[i]] for i < aliveCount over the image.
+  void Draw(const Particle* particles, const uint32_t* aliveList,
+            uint32_t aliveCount, const BillboardCamera& camera);
+
+  // Draws the draw list of a CPU particle world.
+  void Draw(const ParticleSystemCPU& system, const BillboardCamera& camera);
+
+  uint32_t GetWidth() const { return m_width; }
+  uint32_t GetHeight() const { return m_height; }
+
+  // Rows top to bottom, one packed RGBA8 pixel each.
+  const std::vector<uint32_t>& GetPixels() const { return m_pixels; }
+
+  bool WritePNG(const std::string& path) const;
+
+  const Stats& GetStats() const { return m_stats; }
+
+ private:
+  // Screen-space quad on the 1/256 pixel grid, corners in clockwise order.
+  struct Quad {
+    int32_t x[4];
+    int32_t y[4];
+    int32_t minX, minY, maxX, maxY;  // inclusive pixel bounds, clamped
+    uint32_t color;
+  };
+
+  static const uint32_t BIN_CHUNK = 4096;
+
+  void SetupQuads(const Particle* particles, const uint32_t* aliveList,
+                  uint32_t aliveCount, const BillboardCamera& camera);
+  void BinQuads(uint32_t chunk);
+  uint64_t RasterizeTile(uint32_t tile);
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  uint32_t m_tilesX = 0;
+  uint32_t m_tilesY = 0;
+  std::vector<uint32_t> m_pixels;
+
+  // one per alive particle; culled ones have minX > maxX
+  std::vector<Quad> m_quads;
+  // quad indices of chunk c overlapping tile t: m_bins[c * tileCount + t]
+  std::vector<std::vector<uint32_t>> m_bins;
+  std::vector<uint64_t> m_tileFragments;
+  std::vector<Particle> m_exported;
+
+  Stats m_stats;
+};
+}  // namespace my
\ No newline at end of file
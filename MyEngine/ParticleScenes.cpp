@@ -0,0 +1,274 @@
+#include "ParticleScenes.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "JobSystem.h"
+#include "Random.h"
+
+namespace my {
+namespace scenes {
+ParticleShaders CreateNullShaders(rhi::NullDevice& device) {
+  using rhi::ShaderStage;
+
+  ParticleShaders shaders;
+  shaders.kickoffUpdate = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.emit = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.emitFromMesh = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.simulate = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.grow = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.finishUpdate = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.sphCount = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.sphOffsets = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.sphScatter = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.sphDensity = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.sphForce = device.CreateShader(ShaderStage::Compute, nullptr, 0);
+  shaders.vertex = device.CreateShader(ShaderStage::Vertex, nullptr, 0);
+  shaders.geometry = device.CreateShader(ShaderStage::Geometry, nullptr, 0);
+  shaders.pixel = device.CreateShader(ShaderStage::Pixel, nullptr, 0);
+  return shaders;
+}
+
+void BuildFrame(RenderGraph& graph, ParticleSystemGPU& world, uint32_t steps,
+                uint32_t frame) {
+  graph.Reset();
+  const RenderGraph::ResourceHandle frameConstants =
+      graph.ImportResource("frameCB");
+  const RenderGraph::ResourceHandle renderTarget =
+      graph.ImportResource("renderTarget");
+  world.ImportResources(graph);
+
+  graph.AddPass("Models", []() {}).Read(frameConstants).Write(renderTarget);
+
+  const float step = world.GetSettings().fixed_timestep;
+  for (uint32_t i = 0; i < steps; i++) {
+    graph.AddPass("Frame constants", []() {})
+        .Upload(frameConstants)
+        .SideEffect();
+    world.AddStepPasses(graph, step, frameConstants);
+  }
+  world.AddStatisticsPass(graph, steps > 0, frame);
+
+  graph.AddPass("Frame constants", []() {})
+      .Upload(frameConstants)
+      .SideEffect();
+  world.AddDrawPass(graph, frameConstants, renderTarget);
+
+  graph.Compile();
+}
+
+void ScatterPoints(uint32_t count, float side, uint32_t seed,
+                   std::vector<float>& x, std::vector<float>& y,
+                   std::vector<float>& z, std::vector<uint32_t>& slots) {
+  x.resize(count);
+  y.resize(count);
+  z.resize(count);
+  slots.resize(count);
+  JobSystem::Dispatch(count, 4096, [&](JobArgs args) {
+    const uint32_t i = args.jobIndex;
+    RNG rng;
+    rng.init(seed, i, 0);
+    x[i] = rng.next_float() * side;
+    y[i] = rng.next_float() * side;
+    z[i] = rng.next_float() * side;
+    slots[i] = i;
+  });
+}
+
+void CreateFluidBlock(uint32_t particleCount, ParticleSystemCPU& system,
+                      std::vector<EmitterParams>& table, ParticleSystemCB& cb,
+                      FrameCB& frame) {
+  const float pi = 3.14159265358979323846f;
+
+  ParticleWorldSettings settings;
+  const float h = settings.sph_h;
+  const float side = std::cbrt(static_cast<float>(particleCount)) * h / 2;
+
+  // The emit step has no fluid yet. Its random velocities carry the
+  // particles from the origin to every point of the cube in one step, and
+  // drag 0 stops them there.
+  ParticleEmitter emitter;
+  emitter.life = 1e9f;
+  emitter.random_life = 0.0f;
+  emitter.random_factor = 1.0f;
+  emitter.normal_factor = side / settings.fixed_timestep;
+  emitter.drag = 0.0f;
+
+  // Mean density of uniformly scattered particles: the particle itself plus
+  // the number density, as poly6 integrates to one.
+  settings.sph_p0 =
+      emitter.mass * (315.0f / (64.0f * pi * h * h * h) + 8.0f / (h * h * h));
+
+  std::vector<EmitterParams> emitTable(1);
+  BuildEmitterParams(emitter, particleCount, 0, 0, 0, 0, 0, emitTable[0]);
+  ParticleSystemCB emitCB;
+  BuildParticleSystemCB(settings, emitTable.data(), 1, particleCount, emitCB);
+
+  system.Initialize(particleCount);
+  frame = {};
+  frame.delta_time = settings.fixed_timestep;
+  system.Update(emitCB, emitTable, frame, -1e9f);
+
+  emitter.drag = 1.0f;
+  emitter.sph = true;
+  table.resize(1);
+  BuildEmitterParams(emitter, 0, 0, 0, 0, 0, 0, table[0]);
+  BuildParticleSystemCB(settings, table.data(), 1, particleCount, cb);
+}
+
+void CreateMetaballBlob(uint32_t sphereCount, std::vector<Particle>& particles,
+                        std::vector<uint32_t>& aliveList) {
+  particles.resize(sphereCount);
+  aliveList.resize(sphereCount);
+  for (uint32_t i = 0; i < sphereCount; i++) {
+    RNG rng;
+    rng.init(0xBA11, i, 0);
+
+    Particle& particle = particles[i];
+    float x, y, z;
+    do {
+      x = rng.next_float() * 2 - 1;
+      y = rng.next_float() * 2 - 1;
+      z = rng.next_float() * 2 - 1;
+    } while (x * x + y * y + z * z > 1.0f);
+    particle.position.x = x * 0.6f;
+    particle.position.y = y * 0.6f;
+    particle.position.z = z * 0.6f;
+    particle.sizeBeginEnd.x = 0.04f + rng.next_float() * 0.06f;
+    particle.sizeBeginEnd.y = particle.sizeBeginEnd.x;
+    particle.maxLife = 1.0f;
+    particle.life = 1.0f;
+    particle.color = rng.next();
+    aliveList[i] = i;
+  }
+}
+
+void CreateTorus(uint32_t triangleCount, std::vector<float>& positions,
+                 std::vector<uint32_t>& indices) {
+  const float pi = 3.14159265358979323846f;
+  const uint32_t rings = std::max(
+      static_cast<uint32_t>(std::sqrt(triangleCount / 2.0f) + 0.5f), 3u);
+
+  positions.clear();
+  indices.clear();
+  for (uint32_t i = 0; i < rings; i++) {
+    for (uint32_t j = 0; j < rings; j++) {
+      const float a = 2 * pi * i / rings;
+      const float b = 2 * pi * j / rings;
+      const float r = 1.0f + 0.4f * std::cos(b);
+      positions.insert(positions.end(),
+                       {r * std::cos(a), 0.4f * std::sin(b), r * std::sin(a)});
+
+      const uint32_t next = (i + 1) % rings * rings;
+      const uint32_t v0 = i * rings + j;
+      const uint32_t v1 = next + j;
+      const uint32_t v2 = next + (j + 1) % rings;
+      const uint32_t v3 = i * rings + (j + 1) % rings;
+      indices.insert(indices.end(), {v0, v1, v2, v0, v2, v3});
+    }
+  }
+}
+
+float4x4 RotationZ(float angle, float offset) {
+  float4x4 m;
+  m.m[0][0] = std::cos(angle);
+  m.m[0][1] = std::sin(angle);
+  m.m[1][0] = -std::sin(angle);
+  m.m[1][1] = std::cos(angle);
+  m.m[3][0] = offset;
+  return m;
+}
+
+std::vector<ForceFieldParams> CreateForceFields(float side) {
+  std::vector<ParticleForceField> fields(4);
+  fields[0].type = ForceFieldType::Attractor;
+  fields[0].strength = 4.0f;
+  fields[1].type = ForceFieldType::Vortex;
+  fields[1].direction[0] = 0.3f;
+  fields[1].strength = 2.0f;
+  fields[2].type = ForceFieldType::Wind;
+  fields[2].direction[0] = 1.0f;
+  fields[2].direction[1] = 0.0f;
+  fields[2].direction[2] = 0.5f;
+  fields[2].strength = 1.5f;
+  fields[3].type = ForceFieldType::Turbulence;
+  fields[3].strength = 3.0f;
+  fields[3].frequency = 0.5f;
+
+  std::vector<ForceFieldParams> params(fields.size());
+  for (size_t i = 0; i < fields.size(); i++) {
+    for (uint32_t c = 0; c < 3; c++) fields[i].position[c] = side / 2;
+    if (fields[i].type != ForceFieldType::Turbulence) fields[i].range = side;
+    BuildForceFieldParams(fields[i], params[i]);
+  }
+  return params;
+}
+
+const char* ForceFieldName(uint32_t type) {
+  switch (static_cast<ForceFieldType>(type)) {
+    case ForceFieldType::Attractor:
+      return "attractor";
+    case ForceFieldType::Vortex:
+      return "vortex";
+    case ForceFieldType::Wind:
+      return "wind";
+    case ForceFieldType::Turbulence:
+      return "turbulence";
+  }
+  return "unknown";
+}
+
+void RunEmitters(std::vector<ParticleEmitter> emitters,
+                 const std::vector<uint32_t>& emitCounts, uint32_t stepCount,
+                 float floorHeight, ParticleSceneCPU scene,
+                 ParticleSystemCPU& system) {
+  const ParticleWorldSettings settings;
+  const uint32_t emitterCount = static_cast<uint32_t>(emitters.size());
+  std::vector<EmitterParams> table(emitterCount);
+  std::vector<ForceFieldParams> forceFields;
+  uint32_t particleCount = 0;
+  for (uint32_t e = 0; e < emitterCount; e++) {
+    emitters[e].life = 1e9f;
+    emitters[e].random_life = 0.0f;
+    BuildEmitterParams(emitters[e], emitCounts[e], particleCount, 0, 0, 0, 0,
+                       table[e]);
+    particleCount += emitCounts[e];
+
+    table[e].forceFieldOffset = static_cast<uint32_t>(forceFields.size());
+    table[e].forceFieldCount =
+        static_cast<uint32_t>(emitters[e].force_fields.size());
+    for (const ParticleForceField& field : emitters[e].force_fields) {
+      forceFields.emplace_back();
+      BuildForceFieldParams(field, forceFields.back());
+    }
+  }
+  if (!forceFields.empty()) scene.forceFields = forceFields.data();
+
+  ParticleSystemCB cb;
+  BuildParticleSystemCB(settings, table.data(), emitterCount, particleCount,
+                        cb);
+  system.Initialize(particleCount);
+  FrameCB frame = {};
+  frame.delta_time = settings.fixed_timestep;
+  for (uint32_t f = 0; f < stepCount; f++) {
+    system.Update(cb, table, frame, floorHeight, nullptr, scene);
+    frame.frame_count++;
+    for (EmitterParams& row : table) row.emitCount = 0;
+    BuildParticleSystemCB(settings, table.data(), emitterCount, particleCount,
+                          cb);
+  }
+}
+
+void RainParticles(const float origin[3], float randomFactor,
+                   float floorHeight, const ParticleSceneCPU& scene,
+                   ParticleSystemCPU& system) {
+  ParticleEmitter emitter;
+  for (uint32_t c = 0; c < 3; c++) emitter.transform.m[3][c] = origin[c];
+  emitter.random_factor = randomFactor;
+  emitter.gravity[1] = -9.8f;
+  emitter.restitution = 0.5f;
+  RunEmitters({emitter}, {kRainParticleCount}, 240, floorHeight, scene,
+              system);
+}
+}  // namespace scenes
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ParticleForceFields.h"
+#include "ParticleSystemCPU.h"
+#include "ParticleSystemGPU.h"
+#include "ParticleSystemTypes.h"
+#include "RHINull.h"
+#include "RenderGraph.h"
+
+namespace my {
+// Scenes shared by ParticleBenchmark and ParticleValidation, so the checks
+// run on the very inputs the timings report. Builders that scatter points
+// seed the philox RNG, so every call returns the same scene.
+namespace scenes {
+// Shaders the null device accepts for every pass.
+ParticleShaders CreateNullShaders(rhi::NullDevice& device);
+
+// The passes DoTest() adds for one frame, with empty engine passes.
+void BuildFrame(RenderGraph& graph, ParticleSystemGPU& world, uint32_t steps,
+                uint32_t frame);
+
+// count positions scattered uniformly over the cube [0, side)^3, and the
+// slots 0..count-1 to build grids over.
+void ScatterPoints(uint32_t count, float side, uint32_t seed,
+                   std::vector<float>& x, std::vector<float>& y,
+                   std::vector<float>& z, std::vector<uint32_t>& slots);
+
+// particleCount immortal SPH particles scattered uniformly over a cube, eight
+// per h^3, and at rest: system runs the frame that emits and spreads them,
+// table and cb simulate them from then on.
+void CreateFluidBlock(uint32_t particleCount, ParticleSystemCPU& system,
+                      std::vector<EmitterParams>& table, ParticleSystemCB& cb,
+                      FrameCB& frame);
+
+// sphereCount particles in a blob of radius 0.6, like a fluid at rest.
+void CreateMetaballBlob(uint32_t sphereCount, std::vector<Particle>& particles,
+                        std::vector<uint32_t>& aliveList);
+
+// Torus around the y axis with radii 1 and 0.4, of about triangleCount
+// triangles.
+void CreateTorus(uint32_t triangleCount, std::vector<float>& positions,
+                 std::vector<uint32_t>& indices);
+
+// Rotation by angle about the z axis, then offset along x.
+float4x4 RotationZ(float angle, float offset);
+
+// Segments as coordinate columns, as MeshBVH::IntersectSegments() reads
+// them.
+struct Segments {
+  std::vector<float> from[3];
+  std::vector<float> to[3];
+
+  void Resize(uint32_t count) {
+    for (uint32_t c = 0; c < 3; c++) {
+      from[c].resize(count);
+      to[c].resize(count);
+    }
+  }
+};
+
+// A force field of every type for particles in a cube of side `side` at the
+// origin: attractor, vortex and wind fade out over it, the turbulence has
+// no range.
+std::vector<ForceFieldParams> CreateForceFields(float side);
+
+// Name of a ForceFieldType, for logs and messages.
+const char* ForceFieldName(uint32_t type);
+
+// Runs stepCount steps of emitters in system, emitter e emitting
+// emitCounts[e] immortal particles on the first step and none after. The
+// force fields of the emitters are pooled the way ParticleEmitterRegistry
+// pools them, and the particles collide with the floor and scene.
+void RunEmitters(std::vector<ParticleEmitter> emitters,
+                 const std::vector<uint32_t>& emitCounts, uint32_t stepCount,
+                 float floorHeight, ParticleSceneCPU scene,
+                 ParticleSystemCPU& system);
+
+const uint32_t kRainParticleCount = 4099;  // not a whole number of vectors
+
+// Rains kRainParticleCount immortal particles, which bounce off at half
+// speed, from origin onto the floor and scene for four seconds.
+// randomFactor scatters their starting velocities.
+void RainParticles(const float origin[3], float randomFactor,
+                   float floorHeight, const ParticleSceneCPU& scene,
+                   ParticleSystemCPU& system);
+}  // namespace scenes
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "ParticleStorageSoA.h"
+
+#include <algorithm>
+
+#include "JobSystem.h"
+
+namespace my {
+namespace {
+const uint32_t kTranscodeGroupSize = 4096;
+}  // namespace
+
+void ParticleStorageSoA::Resize(uint32_t capacity) {
+  m_capacity = capacity;
+
+  positionX.resize(capacity, 0.0f);
+  positionY.resize(capacity, 0.0f);
+  positionZ.resize(capacity, 0.0f);
+  positionPrevX.resize(capacity, 0.0f);
+  positionPrevY.resize(capacity, 0.0f);
+  positionPrevZ.resize(capacity, 0.0f);
+  velocityX.resize(capacity, 0.0f);
+  velocityY.resize(capacity, 0.0f);
+  velocityZ.resize(capacity, 0.0f);
+  life.resize(capacity, 0.0f);
+
+  maxLife.resize(capacity, 0.0f);
+  sizeBegin.resize(capacity, 0.0f);
+  sizeEnd.resize(capacity, 0.0f);
+  rotationalVelocity.resize(capacity, 0.0f);
+  emitterIndex.resize(capacity, 0);
+  color.resize(capacity, 0);
+}
+
+void ParticleStorageSoA::Write(uint32_t index, const Particle& particle) {
+  positionX[index] = particle.position.x;
+  positionY[index] = particle.position.y;
+  positionZ[index] = particle.position.z;
+  positionPrevX[index] = particle.positionPrev.x;
+  positionPrevY[index] = particle.positionPrev.y;
+  positionPrevZ[index] = particle.positionPrev.z;
+  velocityX[index] = particle.velocity.x;
+  velocityY[index] = particle.velocity.y;
+  velocityZ[index] = particle.velocity.z;
+  life[index] = particle.life;
+
+  maxLife[index] = particle.maxLife;
+  sizeBegin[index] = particle.sizeBeginEnd.x;
+  sizeEnd[index] = particle.sizeBeginEnd.y;
+  rotationalVelocity[index] = particle.rotationalVelocity;
+  emitterIndex[index] = particle.emitterIndex;
+  color[index] = particle.color;
+}
+
+Particle ParticleStorageSoA::Read(uint32_t index) const {
+  Particle particle;
+  particle.position.x = positionX[index];
+  particle.position.y = positionY[index];
+  particle.position.z = positionZ[index];
+  particle.emitterIndex = emitterIndex[index];
+  particle.positionPrev.x = positionPrevX[index];
+  particle.positionPrev.y = positionPrevY[index];
+  particle.positionPrev.z = positionPrevZ[index];
+  particle.rotationalVelocity = rotationalVelocity[index];
+  particle.velocity.x = velocityX[index];
+  particle.velocity.y = velocityY[index];
+  particle.velocity.z = velocityZ[index];
+  particle.maxLife = maxLife[index];
+  particle.sizeBeginEnd.x = sizeBegin[index];
+  particle.sizeBeginEnd.y = sizeEnd[index];
+  particle.life = life[index];
+  particle.color = color[index];
+  return particle;
+}
+
+void ParticleStorageSoA::ToAoS(Particle* particles, uint32_t first,
+                               uint32_t count) const {
+  JobSystem::Dispatch(
+      JobSystem::GetGroupCount(count, kTranscodeGroupSize), 1,
+      [&](JobArgs args) {
+        const uint32_t begin = args.jobIndex * kTranscodeGroupSize;
+        const uint32_t end = std::min(begin + kTranscodeGroupSize, count);
+        for (uint32_t i = begin; i < end; i++)
+          particles[i] = Read(first + i);
+      });
+}
+
+void ParticleStorageSoA::FromAoS(const Particle* particles, uint32_t first,
+                                 uint32_t count) {
+  JobSystem::Dispatch(
+      JobSystem::GetGroupCount(count, kTranscodeGroupSize), 1,
+      [&](JobArgs args) {
+        const uint32_t begin = args.jobIndex * kTranscodeGroupSize;
+        const uint32_t end = std::min(begin + kTranscodeGroupSize, count);
+        for (uint32_t i = begin; i < end; i++)
+          Write(first + i, particles[i]);
+      });
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ParticleSystemTypes.h"
+
+namespace my {
+// Structure-of-arrays particle pool. Hot columns are the ones simulate reads
+// and writes every frame; cold columns are written once at emit and only read
+// afterwards (simulate reads maxLife and sizeBeginEnd for the size lerp, and
+// emitterIndex to look up the per-emitter forces).
+class ParticleStorageSoA {
+ public:
+  void Resize(uint32_t capacity);
+  uint32_t GetCapacity() const { return m_capacity; }
+
+  void Write(uint32_t index, const Particle& particle);
+  Particle Read(uint32_t index) const;
+
+  // AoS <-> SoA transcoders for GPU upload and snapshot loading. Both run
+  // across the job system.
+  void ToAoS(Particle* particles, uint32_t first, uint32_t count) const;
+  void FromAoS(const Particle* particles, uint32_t first, uint32_t count);
+
+  // Hot columns.
+  std::vector<float> positionX;
+  std::vector<float> positionY;
+  std::vector<float> positionZ;
+  std::vector<float> positionPrevX;
+  std::vector<float> positionPrevY;
+  std::vector<float> positionPrevZ;
+  std::vector<float> velocityX;
+  std::vector<float> velocityY;
+  std::vector<float> velocityZ;
+  std::vector<float> life;
+
+  // Cold columns.
+  std::vector<float> maxLife;
+  std::vector<float> sizeBegin;
+  std::vector<float> sizeEnd;
+  std::vector<float> rotationalVelocity;
+  std::vector<uint32_t> emitterIndex;
+  std::vector<uint32_t> color;
+
+ private:
+  uint32_t m_capacity = 0;
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,820 @@
+#include "ParticleSystemCPU.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "JobSystem.h"
+#include "ParticleForceFields.h"
+#include "Random.h"
+#include "SIMD.h"
+
+namespace my {
+namespace {
+// Number of emit/simulate slots handled by one job. Each job reserves its
+// alive/dead list ranges with one atomic instead of one per particle.
+const uint32_t kGroupSize = 256;
+
+// 64 slots per mask word, so one job covers 16k pool slots when sorting.
+const uint32_t kSortWordsPerJob = 256;
+
+// Alive list entries checked or scattered into the mask by one sort job.
+const uint32_t kSortListPerJob = 16384;
+
+// Random blocks (4 words each) one emitted particle consumes: 3 words for the
+// mesh sample and 9 for the particle attributes.
+const uint32_t kEmitRandomBlocks = 3;
+
+// Simulate runs copied into the merged lists by one job.
+const uint32_t kMergeRunsPerJob = 64;
+
+uint32_t PopCount(uint64_t x) {
+#ifdef _MSC_VER
+  return static_cast<uint32_t>(__popcnt64(x));
+#else
+  return static_cast<uint32_t>(__builtin_popcountll(x));
+#endif
+}
+
+// x must not be zero.
+uint32_t CountTrailingZeros(uint64_t x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(x));
+#endif
+}
+
+struct Vec3 {
+  float x, y, z;
+};
+
+Vec3 operator+(Vec3 a, Vec3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+Vec3 operator-(Vec3 a, Vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+Vec3 operator*(Vec3 a, float b) { return {a.x * b, a.y * b, a.z * b}; }
+
+float Dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+Vec3 Cross(Vec3 a, Vec3 b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+Vec3 Normalize(Vec3 a) {
+  float len = std::sqrt(Dot(a, a));
+  return a * (1.0f / len);
+}
+
+Vec3 ToVec3(const float3& v) { return {v.x, v.y, v.z}; }
+
+// mul(float4(v, w), xEmitterWorld) as HLSL sees the transposed upload.
+Vec3 TransformCB(const float4x4& world, Vec3 v, float w) {
+  Vec3 r;
+  r.x = v.x * world.m[0][0] + v.y * world.m[0][1] + v.z * world.m[0][2] +
+        w * world.m[0][3];
+  r.y = v.x * world.m[1][0] + v.y * world.m[1][1] + v.z * world.m[1][2] +
+        w * world.m[1][3];
+  r.z = v.x * world.m[2][0] + v.y * world.m[2][1] + v.z * world.m[2][2] +
+        w * world.m[2][3];
+  return r;
+}
+
+float Lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+uint32_t PackRGBA(const float value[4]) {
+  uint32_t retVal = 0;
+  retVal |= static_cast<uint32_t>(value[0] * 255.0f) << 0u;
+  retVal |= static_cast<uint32_t>(value[1] * 255.0f) << 8u;
+  retVal |= static_cast<uint32_t>(value[2] * 255.0f) << 16u;
+  retVal |= static_cast<uint32_t>(value[3] * 255.0f) << 24u;
+  return retVal;
+}
+
+void UnpackRGBA(uint32_t value, float retVal[4]) {
+  retVal[0] = static_cast<float>((value >> 0u) & 0xFF) / 255.0f;
+  retVal[1] = static_cast<float>((value >> 8u) & 0xFF) / 255.0f;
+  retVal[2] = static_cast<float>((value >> 16u) & 0xFF) / 255.0f;
+  retVal[3] = static_cast<float>((value >> 24u) & 0xFF) / 255.0f;
+}
+
+// Body of CS_ParticleSystem_Emit for one dispatch thread. Every thread
+// emits: the direction filter is baked into the emission set.
+void EmitParticle(const EmitterParams& emitter, uint32_t emitterIndex,
+                  const EmitterMeshCPU* geometry, RNG& rng,
+                  Particle& particle) {
+  Vec3 emitPos = {0.0f, 0.0f, 0.0f};
+  Vec3 nor = {0.0f, 0.0f, 0.0f};
+  Vec3 velocity = ToVec3(emitter.velocity);
+  float baseColor[4];
+  UnpackRGBA(emitter.color, baseColor);
+
+  if (geometry != nullptr && emitter.emissionSetCount > 0) {
+    // random triangle of the emission set, proportional to its area:
+    float fraction;
+    const uint32_t bucket =
+        rng.next_uint_frac(emitter.emissionSetCount, fraction);
+    const uint32_t tri = SampleEmissionSet(
+        geometry->emissionSets + emitter.emissionSetOffset, bucket, fraction);
+
+    // load indices of triangle from index buffer
+    const uint32_t* indices = geometry->indices + emitter.meshIndexOffset;
+    const uint32_t i0 = emitter.meshVertexOffset + indices[tri * 3 + 0];
+    const uint32_t i1 = emitter.meshVertexOffset + indices[tri * 3 + 1];
+    const uint32_t i2 = emitter.meshVertexOffset + indices[tri * 3 + 2];
+
+    // load vertices of triangle from vertex buffer:
+    const float* p0 = geometry->positions + i0 * 3;
+    const float* p1 = geometry->positions + i1 * 3;
+    const float* p2 = geometry->positions + i2 * 3;
+    Vec3 pos0 = {p0[0], p0[1], p0[2]};
+    Vec3 pos1 = {p1[0], p1[1], p1[2]};
+    Vec3 pos2 = {p2[0], p2[1], p2[2]};
+
+    // random barycentric coords:
+    float f = rng.next_float();
+    float g = rng.next_float();
+    if (f + g > 1) {
+      f = 1 - f;
+      g = 1 - g;
+    }
+
+    // compute final surface position on triangle from barycentric coords:
+    emitPos = pos0 * (1 - f - g) + (pos1 * f + pos2 * g);
+    nor = Normalize(Cross(pos1 - pos0, pos2 - pos0));
+    nor = Normalize(TransformCB(emitter.world, nor, 0.0f));
+  }
+
+  Vec3 pos = TransformCB(emitter.world, emitPos, 1.0f);
+
+  float particleStartingSize =
+      emitter.size +
+      emitter.size * (rng.next_float() - 0.5f) * emitter.randomFactor;
+
+  Vec3 random;
+  random.x = rng.next_float();
+  random.y = rng.next_float();
+  random.z = rng.next_float();
+  Vec3 v = velocity +
+           (nor + (random - Vec3{0.5f, 0.5f, 0.5f}) * emitter.randomFactor) *
+               emitter.normalFactor;
+
+  // create new particle:
+  particle.position.x = pos.x;
+  particle.position.y = pos.y;
+  particle.position.z = pos.z;
+  particle.positionPrev = particle.position;
+  particle.emitterIndex = emitterIndex;
+  particle.velocity.x = v.x;
+  particle.velocity.y = v.y;
+  particle.velocity.z = v.z;
+  particle.rotationalVelocity =
+      emitter.rotation + (rng.next_float() - 0.5f) * emitter.randomFactor;
+  particle.maxLife = emitter.lifeSpan + emitter.lifeSpan *
+                                            (rng.next_float() - 0.5f) *
+                                            emitter.lifeSpanRandomness;
+  particle.life = particle.maxLife;
+  particle.sizeBeginEnd.x = particleStartingSize;
+  particle.sizeBeginEnd.y = particleStartingSize * emitter.scaling;
+
+  baseColor[0] *= Lerp(1, rng.next_float(), emitter.randomColorFactor);
+  baseColor[1] *= Lerp(1, rng.next_float(), emitter.randomColorFactor);
+  baseColor[2] *= Lerp(1, rng.next_float(), emitter.randomColorFactor);
+  particle.color = PackRGBA(baseColor);
+}
+
+// Emitter owning emit thread emitIndex: the last row whose range starts at or
+// before it (rows that emit nothing share their offset with the next row).
+uint32_t FindEmitter(const std::vector<EmitterParams>& emitters,
+                     uint32_t emitIndex) {
+  uint32_t lo = 0;
+  uint32_t hi = static_cast<uint32_t>(emitters.size());
+  while (lo + 1 < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    if (emitters[mid].emitOffset <= emitIndex)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Swept collision with the models, as in the simulate kernel: back to where
+// the step from -> position crossed a triangle, bouncing the velocity along
+// its normal.
+void Collide(const SegmentHit& hit, float restitution, Vec3 from,
+             Vec3& position, Vec3& velocity) {
+  const Vec3 normal = ToVec3(hit.normal);
+  position = from + (position - from) * hit.t +
+             normal * MeshBVH::COLLISION_SKIN;
+  const float approach = Dot(velocity, normal);
+  if (approach < 0.0f)
+    velocity = velocity - normal * ((1.0f + restitution) * approach);
+}
+
+// Collide() for the particles of a SIMD vector, those in lanes.
+void Collide(const MeshBVH& collider, uint32_t lanes,
+             const simd::vfloat restitution, const simd::vfloat from[3],
+             simd::vfloat position[3], simd::vfloat velocity[3]) {
+  using namespace simd;
+
+  float f[3][kWidth], p[3][kWidth], v[3][kWidth], e[kWidth];
+  for (uint32_t c = 0; c < 3; c++) {
+    Store(f[c], from[c]);
+    Store(p[c], position[c]);
+  }
+  const float* const fromColumns[3] = {f[0], f[1], f[2]};
+  const float* const toColumns[3] = {p[0], p[1], p[2]};
+  SegmentHit hits[kWidth];
+  collider.IntersectSegments(fromColumns, toColumns, kWidth, hits);
+
+  uint32_t hitLanes = 0;
+  for (uint32_t l = 0; l < kWidth; l++)
+    if ((lanes & (1u << l)) && hits[l].triangle != MeshBVH::NO_HIT)
+      hitLanes |= 1u << l;
+  if (hitLanes == 0) return;
+
+  for (uint32_t c = 0; c < 3; c++) Store(v[c], velocity[c]);
+  Store(e, restitution);
+  for (uint32_t l = 0; l < kWidth; l++) {
+    if ((hitLanes & (1u << l)) == 0) continue;
+    Vec3 lanePosition = {p[0][l], p[1][l], p[2][l]};
+    Vec3 laneVelocity = {v[0][l], v[1][l], v[2][l]};
+    Collide(hits[l], e[l], {f[0][l], f[1][l], f[2][l]}, lanePosition,
+            laneVelocity);
+    p[0][l] = lanePosition.x;
+    p[1][l] = lanePosition.y;
+    p[2][l] = lanePosition.z;
+    v[0][l] = laneVelocity.x;
+    v[1][l] = laneVelocity.y;
+    v[2][l] = laneVelocity.z;
+  }
+  for (uint32_t c = 0; c < 3; c++) {
+    position[c] = Load(p[c]);
+    velocity[c] = Load(v[c]);
+  }
+}
+
+// Collision with the distance fields, as in the simulate kernel: a particle
+// closer to a surface than the skin is pushed back out along its normal,
+// bouncing the velocity like the swept collision does.
+void Collide(const SDFColliderSet& colliders, float restitution,
+             Vec3& position, Vec3& velocity) {
+  float3 normal;
+  const float distance =
+      colliders.GetDistance({position.x, position.y, position.z}, &normal);
+  if (distance >= SDFColliderSet::COLLISION_SKIN) return;
+  const Vec3 n = ToVec3(normal);
+  position = position + n * (SDFColliderSet::COLLISION_SKIN - distance);
+  const float approach = Dot(velocity, n);
+  if (approach < 0.0f)
+    velocity = velocity - n * ((1.0f + restitution) * approach);
+}
+
+// Collide() with the distance fields for the particles of a SIMD vector,
+// those in lanes, one at a time.
+void Collide(const SDFColliderSet& colliders, uint32_t lanes,
+             const simd::vfloat restitution, simd::vfloat position[3],
+             simd::vfloat velocity[3]) {
+  using namespace simd;
+
+  float p[3][kWidth], v[3][kWidth], e[kWidth];
+  for (uint32_t c = 0; c < 3; c++) {
+    Store(p[c], position[c]);
+    Store(v[c], velocity[c]);
+  }
+  Store(e, restitution);
+  for (uint32_t l = 0; l < kWidth; l++) {
+    if ((lanes & (1u << l)) == 0) continue;
+    Vec3 lanePosition = {p[0][l], p[1][l], p[2][l]};
+    Vec3 laneVelocity = {v[0][l], v[1][l], v[2][l]};
+    Collide(colliders, e[l], lanePosition, laneVelocity);
+    p[0][l] = lanePosition.x;
+    p[1][l] = lanePosition.y;
+    p[2][l] = lanePosition.z;
+    v[0][l] = laneVelocity.x;
+    v[1][l] = laneVelocity.y;
+    v[2][l] = laneVelocity.z;
+  }
+  for (uint32_t c = 0; c < 3; c++) {
+    position[c] = Load(p[c]);
+    velocity[c] = Load(v[c]);
+  }
+}
+}  // namespace
+
+void ParticleSystemCPU::Initialize(uint32_t maxParticles) {
+  m_maxParticles = maxParticles;
+
+  m_storage.Resize(maxParticles);
+  m_aliveList[0].assign(maxParticles, 0);
+  m_aliveList[1].assign(maxParticles, 0);
+
+  m_deadList.resize(maxParticles);
+  for (uint32_t i = 0; i < maxParticles; i++) m_deadList[i] = i;
+
+  m_counters = {};
+  m_drawArgs = {};
+  m_counters.deadCount = maxParticles;
+}
+
+void ParticleSystemCPU::Grow(uint32_t maxParticles) {
+  if (maxParticles <= m_maxParticles) return;
+
+  const uint32_t oldCapacity = m_maxParticles;
+  m_maxParticles = maxParticles;
+
+  m_storage.Resize(maxParticles);
+  m_aliveList[0].resize(maxParticles, 0);
+  m_aliveList[1].resize(maxParticles, 0);
+
+  // Same as the grow kernel: the new slots go on top of the dead stack.
+  m_deadList.resize(maxParticles);
+  for (uint32_t i = oldCapacity; i < maxParticles; i++)
+    m_deadList[m_counters.deadCount++] = i;
+}
+
+void ParticleSystemCPU::Update(const ParticleSystemCB& cb,
+                               const std::vector<EmitterParams>& emitters,
+                               const FrameCB& frame, float floorHeight,
+                               const EmitterMeshCPU* geometry,
+                               const ParticleSceneCPU& scene) {
+  const float dt = cb.xEmitterFixedTimestep > 0 ? cb.xEmitterFixedTimestep
+                                                 : frame.delta_time;
+
+  Kickoff(cb);
+  Emit(emitters, frame.frame_count, geometry);
+  SimulateFluid(cb, emitters, dt);
+  Simulate(emitters, dt, floorHeight, scene);
+  FinishUpdate();
+  SwapAliveLists();
+}
+
+void ParticleSystemCPU::Kickoff(const ParticleSystemCB& cb) {
+  // we can not emit more than there are free slots in the dead list:
+  m_counters.realEmitCount = std::min(m_counters.deadCount, cb.xEmitTotal);
+
+  // copy new alivelistcount to current alivelistcount:
+  m_counters.aliveCount = m_counters.aliveCount_afterSimulation;
+
+  // reset new alivecount:
+  m_counters.aliveCount_afterSimulation = 0;
+}
+
+void ParticleSystemCPU::Emit(const std::vector<EmitterParams>& emitters,
+                             uint32_t frameCount,
+                             const EmitterMeshCPU* geometry) {
+  if (geometry != nullptr &&
+      (geometry->indexCount < 3 || geometry->positions == nullptr ||
+       geometry->emissionSets == nullptr))
+    geometry = nullptr;
+  if (emitters.empty()) {
+    m_counters.realEmitCount = 0;
+    return;
+  }
+
+  const uint32_t emitCount = m_counters.realEmitCount;
+  const uint32_t groupCount = JobSystem::GetGroupCount(emitCount, kGroupSize);
+
+  const uint32_t deadCount = m_counters.deadCount;
+  const uint32_t aliveCount = m_counters.aliveCount;
+
+  // Every emit thread yields a particle, so thread i pops dead list entry i
+  // from the top and pushes alive list entry i; slot assignment does not
+  // depend on which thread ran which job.
+  JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kGroupSize;
+    const uint32_t end = std::min(begin + kGroupSize, emitCount);
+
+    // The group may span several emitters; each run of one emitter gets its
+    // random streams in one SIMD pass.
+    uint32_t blocks[kGroupSize * kEmitRandomBlocks * 4];
+    for (uint32_t runBegin = begin; runBegin < end;) {
+      const uint32_t emitterIndex = FindEmitter(emitters, runBegin);
+      const EmitterParams& emitter = emitters[emitterIndex];
+      const uint32_t runEnd =
+          std::min(end, emitter.emitOffset + emitter.emitCount);
+
+      // streams are numbered per emitter, so adding or removing another
+      // emitter does not change this one's particles
+      const uint32_t firstSlot = runBegin - emitter.emitOffset;
+      philox::GenerateSlots(emitter.seed, frameCount, firstSlot,
+                            runEnd - runBegin, kEmitRandomBlocks, blocks);
+
+      for (uint32_t i = runBegin; i < runEnd; i++) {
+        RNG rng;
+        rng.init(emitter.seed, firstSlot + i - runBegin, frameCount,
+                 blocks + (i - runBegin) * kEmitRandomBlocks * 4,
+                 kEmitRandomBlocks);
+
+        Particle particle;
+        EmitParticle(emitter, emitterIndex, geometry, rng, particle);
+
+        // new particle index retrieved from dead list (pop):
+        const uint32_t newParticleIndex = m_deadList[deadCount - 1 - i];
+        m_storage.Write(newParticleIndex, particle);
+        // and add index to the alive list (push):
+        m_aliveList[0][aliveCount + i] = newParticleIndex;
+      }
+      runBegin = runEnd;
+    }
+  });
+
+  m_counters.deadCount = deadCount - emitCount;
+  m_counters.aliveCount = aliveCount + emitCount;
+}
+
+void ParticleSystemCPU::SimulateFluid(
+    const ParticleSystemCB& cb, const std::vector<EmitterParams>& emitters,
+    float dt) {
+  m_fluid.Step(m_storage, m_aliveList[0].data(), m_counters.aliveCount, cb,
+               emitters, dt);
+}
+
+void ParticleSystemCPU::SortAliveList() {
+  const uint32_t aliveCount = m_counters.aliveCount;
+  const uint32_t wordCount = (m_maxParticles + 63) / 64;
+
+  const uint32_t* indices = m_aliveList[0].data();
+  const uint32_t listGroupCount =
+      JobSystem::GetGroupCount(aliveCount, kSortListPerJob);
+
+  // Simulate keeps the list ascending, so only frames that emitted (new
+  // indices are appended at the end) need the rebuild.
+  std::atomic<bool> sorted(true);
+  JobSystem::Dispatch(listGroupCount, 1, [&](JobArgs args) {
+    const uint32_t begin = std::max(args.jobIndex * kSortListPerJob, 1u);
+    const uint32_t end = std::min(begin + kSortListPerJob, aliveCount);
+    for (uint32_t i = begin; i < end; i++) {
+      if (indices[i - 1] > indices[i]) {
+        sorted = false;
+        return;
+      }
+    }
+  });
+  if (sorted) return;
+
+  if (m_aliveMask.size() < wordCount)
+    m_aliveMask = std::vector<std::atomic<uint64_t>>(wordCount);
+  JobSystem::Dispatch(wordCount, kSortListPerJob, [&](JobArgs args) {
+    m_aliveMask[args.jobIndex].store(0, std::memory_order_relaxed);
+  });
+  JobSystem::Dispatch(listGroupCount, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kSortListPerJob;
+    const uint32_t end = std::min(begin + kSortListPerJob, aliveCount);
+    for (uint32_t i = begin; i < end; i++) {
+      const uint32_t index = indices[i];
+      m_aliveMask[index / 64].fetch_or(1ull << (index % 64),
+                                       std::memory_order_relaxed);
+    }
+  });
+
+  // Each job compacts a range of mask words; a prefix sum over the per-job
+  // popcounts gives the write offsets.
+  const uint32_t groupCount =
+      JobSystem::GetGroupCount(wordCount, kSortWordsPerJob);
+  std::vector<uint32_t> offsets(groupCount + 1, 0);
+
+  JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kSortWordsPerJob;
+    const uint32_t end = std::min(begin + kSortWordsPerJob, wordCount);
+    uint32_t count = 0;
+    for (uint32_t w = begin; w < end; w++)
+      count += PopCount(m_aliveMask[w].load(std::memory_order_relaxed));
+    offsets[args.jobIndex + 1] = count;
+  });
+  for (uint32_t i = 0; i < groupCount; i++) offsets[i + 1] += offsets[i];
+
+  JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kSortWordsPerJob;
+    const uint32_t end = std::min(begin + kSortWordsPerJob, wordCount);
+    uint32_t* out = m_aliveList[0].data() + offsets[args.jobIndex];
+    for (uint32_t w = begin; w < end; w++) {
+      uint64_t bits = m_aliveMask[w].load(std::memory_order_relaxed);
+      while (bits != 0) {
+        *out++ = w * 64 + CountTrailingZeros(bits);
+        bits &= bits - 1;
+      }
+    }
+  });
+}
+
+void ParticleSystemCPU::Simulate(const std::vector<EmitterParams>& emitters,
+                                 float dt, float floorHeight,
+                                 const ParticleSceneCPU& scene) {
+  using namespace simd;
+
+  // Walk the pool in slot order so the column loads stream through memory
+  // instead of touching one cache line per column per particle.
+  SortAliveList();
+  const MeshBVH* collider = scene.collider;
+  const SDFColliderSet* distanceColliders = scene.distanceColliders;
+  const ForceFieldParams* forceFields = scene.forceFields;
+  if (collider != nullptr && collider->IsEmpty()) collider = nullptr;
+  if (distanceColliders != nullptr && distanceColliders->IsEmpty())
+    distanceColliders = nullptr;
+
+  const uint32_t aliveCount = m_counters.aliveCount;
+  const uint32_t groupCount = JobSystem::GetGroupCount(aliveCount, kGroupSize);
+
+  // Survivors and dead indices are appended to per-thread lists instead of
+  // bumping two shared counters. Every job records where its run landed, so
+  // the merge below can restore job order whichever thread ran the job.
+  const uint32_t threadCount = JobSystem::GetThreadCount();
+  if (m_threadLists.size() < threadCount) m_threadLists.resize(threadCount);
+  for (ThreadLists& lists : m_threadLists) {
+    lists.alive.clear();
+    lists.dead.clear();
+  }
+  m_simulateRuns.resize(groupCount);
+
+  ParticleStorageSoA& s = m_storage;
+  float* const hot[10] = {s.positionX.data(),     s.positionY.data(),
+                          s.positionZ.data(),     s.velocityX.data(),
+                          s.velocityY.data(),     s.velocityZ.data(),
+                          s.life.data(),          s.positionPrevX.data(),
+                          s.positionPrevY.data(), s.positionPrevZ.data()};
+
+  // Per-emitter forces are gathered straight out of the table rows.
+  const uint32_t paramsStride = sizeof(EmitterParams) / sizeof(float);
+  const float* const params[5] = {
+      emitters.empty() ? nullptr : &emitters[0].gravity.x,
+      emitters.empty() ? nullptr : &emitters[0].gravity.y,
+      emitters.empty() ? nullptr : &emitters[0].gravity.z,
+      emitters.empty() ? nullptr : &emitters[0].drag,
+      emitters.empty() ? nullptr : &emitters[0].restitution};
+
+  JobSystem::Dispatch(groupCount, 1, [&](JobArgs args) {
+    const uint32_t begin = args.jobIndex * kGroupSize;
+    const uint32_t end = std::min(begin + kGroupSize, aliveCount);
+    const uint32_t* indices = m_aliveList[0].data();
+
+    uint32_t alive[kGroupSize];
+    uint32_t dead[kGroupSize];
+    uint32_t aliveNum = 0;
+    uint32_t deadNum = 0;
+
+    const vfloat vdt = Set1(dt);
+    const vfloat floor = Set1(floorHeight);
+
+    uint32_t i = begin;
+    for (; i + kWidth <= end; i += kWidth) {
+      const uint32_t* lane = indices + i;
+
+      // Sorted and unique, so equal span means a contiguous run of slots.
+      const bool contiguous = lane[kWidth - 1] - lane[0] == kWidth - 1;
+      auto load = [&](const float* column) {
+        return contiguous ? Load(column + lane[0]) : Gather(column, lane, 1);
+      };
+
+      // emitter rows of the lanes; one row for the whole vector is the
+      // common case and needs no gather
+      uint32_t emitterIds[kWidth];
+      bool uniform = true;
+      for (uint32_t l = 0; l < kWidth; l++) {
+        emitterIds[l] = s.emitterIndex[lane[l]];
+        uniform &= emitterIds[l] == emitterIds[0];
+      }
+      auto param = [&](uint32_t p) {
+        return uniform ? Set1(params[p][emitterIds[0] * paramsStride])
+                       : Gather(params[p], emitterIds, paramsStride);
+      };
+      vfloat acceleration[3] = {param(0), param(1), param(2)};
+      const vfloat drag = param(3);
+      const vfloat restitution = param(4);
+
+      vfloat position[3], positionPrev[3], velocity[3];
+      for (uint32_t c = 0; c < 3; c++) {
+        position[c] = load(hot[c]);
+        velocity[c] = load(hot[3 + c]);
+
+        // keep the previous state for render interpolation:
+        positionPrev[c] = position[c];
+      }
+
+      // force fields, once per emitter of the vector:
+      if (forceFields != nullptr) {
+        uint32_t pending = (1u << kWidth) - 1;
+        while (pending != 0) {
+          const uint32_t id = emitterIds[CountTrailingZeros(pending)];
+          const EmitterParams& emitter = emitters[id];
+          uint32_t lanes = 0;
+          for (uint32_t l = 0; l < kWidth; l++)
+            if (emitterIds[l] == id) lanes |= 1u << l;
+          pending &= ~lanes;
+          if (emitter.forceFieldCount == 0) continue;
+
+          const ForceFieldParams* fields =
+              forceFields + emitter.forceFieldOffset;
+          if (lanes == (1u << kWidth) - 1) {
+            AccumulateForceFields(fields, emitter.forceFieldCount, position,
+                                  acceleration);
+            continue;
+          }
+          vfloat field[3] = {Set1(0.0f), Set1(0.0f), Set1(0.0f)};
+          AccumulateForceFields(fields, emitter.forceFieldCount, position,
+                                field);
+          const vmask mask = FromBits(lanes);
+          for (uint32_t c = 0; c < 3; c++) {
+            acceleration[c] =
+                Select(mask, acceleration[c] + field[c], acceleration[c]);
+          }
+        }
+      }
+
+      for (uint32_t c = 0; c < 3; c++) {
+        // integrate:
+        velocity[c] = MulAdd(acceleration[c], vdt, velocity[c]);
+        position[c] = MulAdd(velocity[c], vdt, position[c]);
+
+        // drag:
+        velocity[c] = velocity[c] * drag;
+      }
+
+      vfloat life = load(hot[6]);
+      const vfloat lifeLerp = Set1(1.0f) - life / load(s.maxLife.data());
+      const vfloat particleSize =
+          Lerp(load(s.sizeBegin.data()), load(s.sizeEnd.data()), lifeLerp);
+
+      const vmask isAlive = life > Set1(0.0f);
+
+      if (collider != nullptr)
+        Collide(*collider, MoveMask(isAlive), restitution, positionPrev,
+                position, velocity);
+      if (distanceColliders != nullptr)
+        Collide(*distanceColliders, MoveMask(isAlive), restitution, position,
+                velocity);
+
+      // floor collision:
+      const vmask collide = isAlive & (position[1] - particleSize < floor);
+      position[1] = Select(collide, particleSize + floor, position[1]);
+      velocity[1] = Select(
+          collide, velocity[1] * (Set1(0.0f) - restitution), velocity[1]);
+
+      life = life - vdt;
+
+      const uint32_t aliveMask = MoveMask(isAlive);
+      const uint32_t allAlive = (1u << kWidth) - 1;
+
+      if (contiguous && aliveMask == allAlive) {
+        for (uint32_t c = 0; c < 3; c++) {
+          Store(hot[c] + lane[0], position[c]);
+          Store(hot[3 + c] + lane[0], velocity[c]);
+          Store(hot[7 + c] + lane[0], positionPrev[c]);
+        }
+        Store(hot[6] + lane[0], life);
+      } else {
+        float out[10][kWidth];
+        for (uint32_t c = 0; c < 3; c++) {
+          Store(out[c], position[c]);
+          Store(out[3 + c], velocity[c]);
+          Store(out[7 + c], positionPrev[c]);
+        }
+        Store(out[6], life);
+
+        // write back simulated particles only:
+        for (uint32_t l = 0; l < kWidth; l++) {
+          if ((aliveMask & (1u << l)) == 0) continue;
+          for (uint32_t c = 0; c < 10; c++) hot[c][lane[l]] = out[c][l];
+        }
+      }
+
+      for (uint32_t l = 0; l < kWidth; l++) {
+        if (aliveMask & (1u << l))
+          alive[aliveNum++] = lane[l];
+        else
+          dead[deadNum++] = lane[l];
+      }
+    }
+
+    // remainder, same math one particle at a time:
+    for (; i < end; i++) {
+      const uint32_t p = indices[i];
+      const EmitterParams& emitter = emitters[s.emitterIndex[p]];
+
+      const float lifeLerp = 1 - s.life[p] / s.maxLife[p];
+      const float particleSize = Lerp(s.sizeBegin[p], s.sizeEnd[p], lifeLerp);
+
+      float acceleration[3] = {emitter.gravity.x, emitter.gravity.y,
+                               emitter.gravity.z};
+      if (forceFields != nullptr && emitter.forceFieldCount > 0) {
+        const float position[3] = {s.positionX[p], s.positionY[p],
+                                   s.positionZ[p]};
+        AccumulateForceFields(forceFields + emitter.forceFieldOffset,
+                              emitter.forceFieldCount, position,
+                              acceleration);
+      }
+
+      Vec3 velocity = Vec3{s.velocityX[p], s.velocityY[p], s.velocityZ[p]} +
+                      Vec3{acceleration[0], acceleration[1], acceleration[2]} *
+                          dt;
+      Vec3 position =
+          Vec3{s.positionX[p], s.positionY[p], s.positionZ[p]} + velocity * dt;
+      velocity = velocity * emitter.drag;
+
+      if (s.life[p] > 0) {
+        const Vec3 from = {s.positionX[p], s.positionY[p], s.positionZ[p]};
+        SegmentHit hit;
+        if (collider != nullptr &&
+            collider->IntersectSegment({from.x, from.y, from.z},
+                                       {position.x, position.y, position.z},
+                                       hit))
+          Collide(hit, emitter.restitution, from, position, velocity);
+        if (distanceColliders != nullptr)
+          Collide(*distanceColliders, emitter.restitution, position,
+                  velocity);
+
+        if (position.y - particleSize < floorHeight) {
+          position.y = particleSize + floorHeight;
+          velocity.y *= -emitter.restitution;
+        }
+
+        s.positionPrevX[p] = s.positionX[p];
+        s.positionPrevY[p] = s.positionY[p];
+        s.positionPrevZ[p] = s.positionZ[p];
+        s.positionX[p] = position.x;
+        s.positionY[p] = position.y;
+        s.positionZ[p] = position.z;
+        s.velocityX[p] = velocity.x;
+        s.velocityY[p] = velocity.y;
+        s.velocityZ[p] = velocity.z;
+        s.life[p] -= dt;
+        alive[aliveNum++] = p;
+      } else {
+        dead[deadNum++] = p;
+      }
+    }
+
+    ThreadLists& lists = m_threadLists[args.threadIndex];
+    SimulateRun& run = m_simulateRuns[args.jobIndex];
+    run.threadIndex = args.threadIndex;
+    run.aliveBegin = static_cast<uint32_t>(lists.alive.size());
+    run.aliveCount = aliveNum;
+    run.deadBegin = static_cast<uint32_t>(lists.dead.size());
+    run.deadCount = deadNum;
+    lists.alive.insert(lists.alive.end(), alive, alive + aliveNum);
+    lists.dead.insert(lists.dead.end(), dead, dead + deadNum);
+  });
+
+  // Exclusive prefix sum over the runs gives every job its write offset in
+  // the new alive list and on top of the dead list.
+  uint32_t aliveOffset = m_counters.aliveCount_afterSimulation;
+  uint32_t deadOffset = m_counters.deadCount;
+  for (SimulateRun& run : m_simulateRuns) {
+    run.aliveOffset = aliveOffset;
+    run.deadOffset = deadOffset;
+    aliveOffset += run.aliveCount;
+    deadOffset += run.deadCount;
+  }
+
+  JobSystem::Dispatch(groupCount, kMergeRunsPerJob, [&](JobArgs args) {
+    const SimulateRun& run = m_simulateRuns[args.jobIndex];
+    const ThreadLists& lists = m_threadLists[run.threadIndex];
+    // add to new alive list:
+    std::copy_n(lists.alive.begin() + run.aliveBegin, run.aliveCount,
+                m_aliveList[1].begin() + run.aliveOffset);
+    // kill:
+    std::copy_n(lists.dead.begin() + run.deadBegin, run.deadCount,
+                m_deadList.begin() + run.deadOffset);
+  });
+
+  m_counters.aliveCount_afterSimulation = aliveOffset;
+  m_counters.deadCount = deadOffset;
+}
+
+void ParticleSystemCPU::FinishUpdate() {
+  // the NEW alive list holds exactly the survivors of the simulate pass, so
+  // it doubles as the draw list; draw one point per entry:
+  m_drawArgs.vertexCountPerInstance = m_counters.aliveCount_afterSimulation;
+  m_drawArgs.instanceCount = 1;
+  m_drawArgs.startVertexLocation = 0;
+  m_drawArgs.startInstanceLocation = 0;
+}
+
+void ParticleSystemCPU::SwapAliveLists() {
+  std::swap(m_aliveList[0], m_aliveList[1]);
+}
+
+void ParticleSystemCPU::ExportParticles(std::vector<Particle>& particles) const {
+  particles.resize(m_maxParticles);
+  m_storage.ToAoS(particles.data(), 0, m_maxParticles);
+}
+
+void ParticleSystemCPU::UpdateBatch(const std::vector<BatchItem>& items,
+                                    const FrameCB& frame, float floorHeight) {
+  JobSystem::Dispatch(static_cast<uint32_t>(items.size()), 1,
+                      [&](JobArgs args) {
+                        const BatchItem& item = items[args.jobIndex];
+                        if (item.system == nullptr || item.cb == nullptr ||
+                            item.emitters == nullptr)
+                          return;
+                        item.system->Update(*item.cb, *item.emitters, frame,
+                                            floorHeight, item.geometry,
+                                            item.scene);
+                      });
+}
+}  // namespace my
\ No newline at end of file
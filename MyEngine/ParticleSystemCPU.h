@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "EmissionSet.h"
+#include "MeshBVH.h"
+#include "ParticleFluidCPU.h"
+#include "ParticleStorageSoA.h"
+#include "ParticleSystemTypes.h"
+#include "SDFColliderSet.h"
+
+namespace my {
+// CPU-side view of the pooled emitter geometry, laid out like the raw
+// vertex/index buffers the emit compute shader reads (tightly packed float3
+// positions). Emitter table rows address it with their mesh offsets.
+struct EmitterMeshCPU {
+  const float* positions = nullptr;
+  uint32_t vertexCount = 0;
+  const uint32_t* indices = nullptr;
+  uint32_t indexCount = 0;
+
+  // Emission sets of all emitters back to back, addressed by the
+  // emissionSetOffset/Count of each table row.
+  const EmissionEntry* emissionSets = nullptr;
+};
+
+// What the particles of a world meet besides the floor and each other: the
+// collider and the distance colliders they bounce off, nullptr for none, and
+// the pooled force fields the emitter table rows address, nullptr for none.
+struct ParticleSceneCPU {
+  const MeshBVH* collider = nullptr;
+  const SDFColliderSet* distanceColliders = nullptr;
+  const ForceFieldParams* forceFields = nullptr;
+};
+
+// Headless port of the CS_ParticleSystem_KickoffUpdate / Emit / SPH_* /
+// Simulate / FinishUpdate kernels. The buffers and counters follow the GPU
+// semantics exactly: a particle pool, double-buffered alive index lists, a
+// dead index stack and ParticleCounters, driven by the same ParticleSystemCB
+// and emitter table. Every particle's emitterIndex must be a valid row of the
+// table it is simulated with.
+class ParticleSystemCPU {
+ public:
+  struct BatchItem {
+    ParticleSystemCPU* system = nullptr;
+    const ParticleSystemCB* cb = nullptr;
+    const std::vector<EmitterParams>* emitters = nullptr;
+    const EmitterMeshCPU* geometry = nullptr;
+    ParticleSceneCPU scene;
+  };
+
+  void Initialize(uint32_t maxParticles);
+
+  // Enlarges the pool, keeping every live particle in place.
+  void Grow(uint32_t maxParticles);
+
+  // One full frame: kickoff, emit, SPH fluid, simulate, finish and alive
+  // list swap. Particles collide with the floor and with the scene.
+  void Update(const ParticleSystemCB& cb,
+              const std::vector<EmitterParams>& emitters, const FrameCB& frame,
+              float floorHeight, const EmitterMeshCPU* geometry = nullptr,
+              const ParticleSceneCPU& scene = ParticleSceneCPU());
+
+  void Kickoff(const ParticleSystemCB& cb);
+  void Emit(const std::vector<EmitterParams>& emitters, uint32_t frameCount,
+            const EmitterMeshCPU* geometry);
+  // SPH forces of the particles of emitters with sph set (ParticleFluidCPU);
+  // does nothing when there are none.
+  void SimulateFluid(const ParticleSystemCB& cb,
+                     const std::vector<EmitterParams>& emitters, float dt);
+  void Simulate(const std::vector<EmitterParams>& emitters, float dt,
+                float floorHeight,
+                const ParticleSceneCPU& scene = ParticleSceneCPU());
+  void FinishUpdate();
+  void SwapAliveLists();
+
+  // Updates many particle worlds at once, one world per job.
+  static void UpdateBatch(const std::vector<BatchItem>& items,
+                          const FrameCB& frame, float floorHeight);
+
+  uint32_t GetMaxParticles() const { return m_maxParticles; }
+  const ParticleCounters& GetStatistics() const { return m_counters; }
+  const ParticleStorageSoA& GetStorage() const { return m_storage; }
+  const ParticleFluidCPU& GetFluid() const { return m_fluid; }
+
+  // Transcodes the whole pool to the GPU Particle layout (for upload).
+  void ExportParticles(std::vector<Particle>& particles) const;
+
+  // Draw list the next Draw would read (the CURRENT alive list after a swap):
+  // its first GetDrawArgs().vertexCountPerInstance entries are the particles
+  // that survived the last simulate step.
+  const std::vector<uint32_t>& GetAliveList() const { return m_aliveList[0]; }
+  const DrawIndirectArgs& GetDrawArgs() const { return m_drawArgs; }
+
+ private:
+  // Rewrites the CURRENT alive list in ascending slot order.
+  void SortAliveList();
+
+  uint32_t m_maxParticles = 0;
+
+  ParticleStorageSoA m_storage;
+  ParticleFluidCPU m_fluid;
+  std::vector<uint32_t> m_aliveList[2];
+  std::vector<uint32_t> m_deadList;
+  std::vector<std::atomic<uint64_t>> m_aliveMask;
+
+  // Simulate append buffers, one per job system thread. Padded so two
+  // threads never write to the same cache line.
+  struct alignas(64) ThreadLists {
+    std::vector<uint32_t> alive;
+    std::vector<uint32_t> dead;
+  };
+  std::vector<ThreadLists> m_threadLists;
+
+  // Where each simulate job's survivors and dead indices were appended.
+  struct SimulateRun {
+    uint32_t threadIndex;
+    uint32_t aliveBegin;
+    uint32_t aliveCount;
+    uint32_t aliveOffset;
+    uint32_t deadBegin;
+    uint32_t deadCount;
+    uint32_t deadOffset;
+  };
+  std::vector<SimulateRun> m_simulateRuns;
+
+  ParticleCounters m_counters = {};
+  DrawIndirectArgs m_drawArgs = {};
+};
+}  // namespace my
\ No newline at end of file
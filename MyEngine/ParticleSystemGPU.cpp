@@ -0,0 +1,1085 @@
+#include "ParticleSystemGPU.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace my {
+namespace {
+rhi::BufferViewDesc WholeBuffer(uint32_t numElements, bool raw = false) {
+  rhi::BufferViewDesc desc;
+  desc.numElements = numElements;
+  desc.raw = raw;
+  return desc;
+}
+
+// Default structured buffer of count elements for the simulation passes.
+rhi::BufferDesc StructuredDesc(uint32_t stride, uint32_t count,
+                               uint32_t bindFlags) {
+  rhi::BufferDesc desc;
+  desc.size = stride * count;
+  desc.stride = stride;
+  desc.bindFlags = bindFlags;
+  desc.miscFlags = rhi::MISC_STRUCTURED;
+  return desc;
+}
+
+// CPU-written structured buffer the passes read.
+rhi::BufferDesc DynamicStructuredDesc(uint32_t stride, uint32_t count) {
+  rhi::BufferDesc desc =
+      StructuredDesc(stride, count, rhi::BIND_SHADER_RESOURCE);
+  desc.usage = rhi::Usage::Dynamic;
+  return desc;
+}
+
+void Upload(rhi::Device* device, const rhi::BufferPtr& buffer,
+            const void* data, size_t size) {
+  void* mapped = device->Map(buffer, rhi::MapMode::WriteDiscard);
+  if (mapped == nullptr) return;
+  memcpy(mapped, data, size);
+  device->Unmap(buffer);
+}
+}  // namespace
+
+bool ParticleSystemGPU::Initialize(
+    rhi::Device* device, rhi::ConstantBufferCache* constantBuffers,
+    const MeshLookup& lookupMesh,
+    const std::shared_ptr<spdlog::logger>& logger) {
+  m_device = device;
+  m_constantBuffers = constantBuffers;
+  m_lookupMesh = lookupMesh;
+  m_logger = logger;
+
+  // Particle System constant buffer:
+  m_constantBuffer = m_constantBuffers->Create(sizeof(ParticleSystemCB));
+  if (m_constantBuffer == nullptr) return false;
+
+  return CreateSelfBuffers(m_settings.max_particles) && CreateEmitterTable(1);
+}
+
+void ParticleSystemGPU::Reset() {
+  m_statisticsReadbackDevice.Reset();
+  m_statisticsReadback.Initialize(nullptr, 1, 0);
+  m_statistics = {};
+  m_statisticsFrame = 0;
+
+  m_particleBuffer.reset();
+  m_aliveList[0].reset();
+  m_aliveList[1].reset();
+  m_deadList.reset();
+  m_counterBuffer.reset();
+  m_indirectBuffer.reset();
+  m_constantBuffer.reset();
+  m_particleBufferSRV.reset();
+  m_particleBufferUAV.reset();
+  m_aliveListSRV[0].reset();
+  m_aliveListSRV[1].reset();
+  m_aliveListUAV[0].reset();
+  m_aliveListUAV[1].reset();
+  m_deadListUAV.reset();
+  m_counterBufferUAV.reset();
+  m_indirectBufferUAV.reset();
+
+  m_sphCellCountBuffer.reset();
+  m_sphCellStartBuffer.reset();
+  m_sphRankBuffer.reset();
+  m_sphCellCountUAV.reset();
+  m_sphCellStartSRV.reset();
+  m_sphCellStartUAV.reset();
+  m_sphRankSRV.reset();
+  m_sphRankUAV.reset();
+  m_sphSortedBuffer.reset();
+  m_sphDensityBuffer.reset();
+  m_sphForceBuffer.reset();
+  m_sphSortedSRV.reset();
+  m_sphSortedUAV.reset();
+  m_sphDensitySRV.reset();
+  m_sphDensityUAV.reset();
+  m_sphForceSRV.reset();
+  m_sphForceUAV.reset();
+
+  m_emitterTableBuffer.reset();
+  m_emitterTableSRV.reset();
+  m_emitterTableCapacity = 0;
+  m_geometryVertexBuffer.reset();
+  m_geometryIndexBuffer.reset();
+  m_geometryVertexBufferSRV.reset();
+  m_geometryIndexBufferSRV.reset();
+  m_geometryMeshNames.clear();
+  m_geometryLayout.clear();
+  m_emissionSetBuffer.reset();
+  m_emissionSetSRV.reset();
+  m_emissionSetCapacity = 0;
+  m_emissionSetCache.clear();
+  m_emissionSets.clear();
+  m_emissionSetOffsets.clear();
+  m_emissionSetsDirty = false;
+  m_forceFieldBuffer.reset();
+  m_forceFieldSRV.reset();
+  m_forceFieldCapacity = 0;
+  m_forceFields.clear();
+  m_colliderNodeBuffer.reset();
+  m_colliderTriangleBuffer.reset();
+  m_colliderNodeSRV.reset();
+  m_colliderTriangleSRV.reset();
+  m_colliderNodeCapacity = 0;
+  m_colliderTriangleCapacity = 0;
+  m_colliderVersion = 0;
+  m_colliderNodeCount = 0;
+  m_distanceInstanceBuffer.reset();
+  m_distanceBrickBuffer.reset();
+  m_distanceSampleBuffer.reset();
+  m_distanceInstanceSRV.reset();
+  m_distanceBrickSRV.reset();
+  m_distanceSampleSRV.reset();
+  m_distanceInstanceCapacity = 0;
+  m_distanceBrickCapacity = 0;
+  m_distanceSampleCapacity = 0;
+  m_distanceColliderVersion = 0;
+  m_distanceFieldVersion = 0;
+  m_distanceColliderCount = 0;
+
+  m_shaders = ParticleShaders();
+  m_capacity = 0;
+  m_growOffset = 0;
+  m_growCount = 0;
+
+  m_device = nullptr;
+  m_constantBuffers = nullptr;
+}
+
+bool ParticleSystemGPU::CreatePoolBuffers(uint32_t maxParticles) {
+  const uint32_t readWrite =
+      rhi::BIND_SHADER_RESOURCE | rhi::BIND_UNORDERED_ACCESS;
+
+  // Particle buffer:
+  m_particleBuffer = m_device->CreateBuffer(
+      StructuredDesc(sizeof(Particle), maxParticles, readWrite));
+  m_particleBufferSRV = m_device->CreateShaderResourceView(
+      m_particleBuffer, WholeBuffer(maxParticles));
+  m_particleBufferUAV = m_device->CreateUnorderedAccessView(
+      m_particleBuffer, WholeBuffer(maxParticles));
+
+  // Alive index lists (double buffered):
+  for (uint32_t i = 0; i < 2; i++) {
+    m_aliveList[i] = m_device->CreateBuffer(
+        StructuredDesc(sizeof(uint32_t), maxParticles, readWrite));
+    m_aliveListSRV[i] = m_device->CreateShaderResourceView(
+        m_aliveList[i], WholeBuffer(maxParticles));
+    m_aliveListUAV[i] = m_device->CreateUnorderedAccessView(
+        m_aliveList[i], WholeBuffer(maxParticles));
+  }
+
+  // Dead index list:
+  m_deadList = m_device->CreateBuffer(StructuredDesc(
+      sizeof(uint32_t), maxParticles, rhi::BIND_UNORDERED_ACCESS));
+  m_deadListUAV = m_device->CreateUnorderedAccessView(
+      m_deadList, WholeBuffer(maxParticles));
+
+  // SPH state per alive list entry and per slot, rebuilt by every step:
+  m_sphRankBuffer = m_device->CreateBuffer(
+      StructuredDesc(sizeof(uint32_t) * 2, maxParticles, readWrite));
+  m_sphRankSRV = m_device->CreateShaderResourceView(
+      m_sphRankBuffer, WholeBuffer(maxParticles));
+  m_sphRankUAV = m_device->CreateUnorderedAccessView(
+      m_sphRankBuffer, WholeBuffer(maxParticles));
+
+  m_sphSortedBuffer = m_device->CreateBuffer(
+      StructuredDesc(sizeof(uint32_t), maxParticles, readWrite));
+  m_sphSortedSRV = m_device->CreateShaderResourceView(
+      m_sphSortedBuffer, WholeBuffer(maxParticles));
+  m_sphSortedUAV = m_device->CreateUnorderedAccessView(
+      m_sphSortedBuffer, WholeBuffer(maxParticles));
+
+  m_sphDensityBuffer = m_device->CreateBuffer(
+      StructuredDesc(sizeof(float), maxParticles, readWrite));
+  m_sphDensitySRV = m_device->CreateShaderResourceView(
+      m_sphDensityBuffer, WholeBuffer(maxParticles));
+  m_sphDensityUAV = m_device->CreateUnorderedAccessView(
+      m_sphDensityBuffer, WholeBuffer(maxParticles));
+
+  m_sphForceBuffer = m_device->CreateBuffer(
+      StructuredDesc(sizeof(float) * 4, maxParticles, readWrite));
+  m_sphForceSRV = m_device->CreateShaderResourceView(
+      m_sphForceBuffer, WholeBuffer(maxParticles));
+  m_sphForceUAV = m_device->CreateUnorderedAccessView(
+      m_sphForceBuffer, WholeBuffer(maxParticles));
+
+  if (!m_particleBufferSRV || !m_particleBufferUAV || !m_aliveListSRV[0] ||
+      !m_aliveListUAV[0] || !m_aliveListSRV[1] || !m_aliveListUAV[1] ||
+      !m_deadListUAV || !m_sphRankSRV || !m_sphRankUAV || !m_sphSortedSRV ||
+      !m_sphSortedUAV || !m_sphDensitySRV || !m_sphDensityUAV ||
+      !m_sphForceSRV || !m_sphForceUAV) {
+    if (m_logger) m_logger->error("Particle pool creation failed.");
+    return false;
+  }
+
+  m_capacity = maxParticles;
+  return true;
+}
+
+bool ParticleSystemGPU::CreateSelfBuffers(uint32_t maxParticles) {
+  if (!CreatePoolBuffers(maxParticles)) return false;
+
+  // Every slot starts out free:
+  {
+    std::vector<uint32_t> indices(maxParticles);
+    for (uint32_t i = 0; i < maxParticles; i++) indices[i] = i;
+    m_device->UpdateBuffer(m_deadList, indices.data(), 0,
+                           sizeof(uint32_t) * maxParticles);
+  }
+
+  // Particle System statistics:
+  {
+    ParticleCounters counters = {};
+    counters.aliveCount = 0;
+    counters.deadCount = maxParticles;
+    counters.realEmitCount = 0;
+    counters.aliveCount_afterSimulation = 0;
+
+    rhi::BufferDesc desc;
+    desc.size = sizeof(counters);
+    desc.bindFlags = rhi::BIND_UNORDERED_ACCESS;
+    desc.miscFlags = rhi::MISC_RAW_VIEWS;
+
+    m_counterBuffer = m_device->CreateBuffer(desc, &counters);
+    m_counterBufferUAV = m_device->CreateUnorderedAccessView(
+        m_counterBuffer,
+        WholeBuffer(sizeof(counters) / sizeof(uint32_t), true));
+    if (m_counterBufferUAV == nullptr) return false;
+  }
+
+  // Indirect dispatch arguments written by the kickoff pass and draw
+  // arguments written by the finish pass:
+  {
+    // nothing is drawn before the first update
+    const uint32_t args[ARGUMENTBUFFER_SIZE / sizeof(uint32_t)] = {};
+
+    rhi::BufferDesc desc;
+    desc.size = ARGUMENTBUFFER_SIZE;
+    desc.bindFlags = rhi::BIND_UNORDERED_ACCESS;
+    desc.miscFlags = rhi::MISC_INDIRECT_ARGS | rhi::MISC_RAW_VIEWS;
+
+    m_indirectBuffer = m_device->CreateBuffer(desc, args);
+    m_indirectBufferUAV = m_device->CreateUnorderedAccessView(
+        m_indirectBuffer,
+        WholeBuffer(ARGUMENTBUFFER_SIZE / sizeof(uint32_t), true));
+    if (m_indirectBufferUAV == nullptr) return false;
+  }
+
+  // SPH bucket counts, which the offsets pass clears after every step, and
+  // bucket starts:
+  {
+    const uint32_t readWrite =
+        rhi::BIND_SHADER_RESOURCE | rhi::BIND_UNORDERED_ACCESS;
+    const std::vector<uint32_t> zeros(SPH_GRID_SIZE + 1, 0);
+
+    m_sphCellCountBuffer = m_device->CreateBuffer(
+        StructuredDesc(sizeof(uint32_t), SPH_GRID_SIZE,
+                       rhi::BIND_UNORDERED_ACCESS),
+        zeros.data());
+    m_sphCellCountUAV = m_device->CreateUnorderedAccessView(
+        m_sphCellCountBuffer, WholeBuffer(SPH_GRID_SIZE));
+
+    m_sphCellStartBuffer = m_device->CreateBuffer(
+        StructuredDesc(sizeof(uint32_t), SPH_GRID_SIZE + 1, readWrite),
+        zeros.data());
+    m_sphCellStartSRV = m_device->CreateShaderResourceView(
+        m_sphCellStartBuffer, WholeBuffer(SPH_GRID_SIZE + 1));
+    m_sphCellStartUAV = m_device->CreateUnorderedAccessView(
+        m_sphCellStartBuffer, WholeBuffer(SPH_GRID_SIZE + 1));
+    if (!m_sphCellCountUAV || !m_sphCellStartSRV || !m_sphCellStartUAV)
+      return false;
+  }
+
+  // Debug information CPU-readback ring:
+  {
+    if (!m_statisticsReadbackDevice.Initialize(m_device, m_counterBuffer,
+                                               STATISTICS_READBACK_DEPTH))
+      return false;
+
+    m_statisticsReadback.Initialize(&m_statisticsReadbackDevice,
+                                    STATISTICS_READBACK_DEPTH,
+                                    sizeof(ParticleCounters));
+  }
+
+  return true;
+}
+
+bool ParticleSystemGPU::Grow(uint32_t maxParticles) {
+  if (maxParticles <= m_capacity) return true;
+
+  const uint32_t oldCapacity = m_capacity;
+
+  rhi::BufferPtr oldParticleBuffer = m_particleBuffer;
+  rhi::BufferPtr oldAliveList[2] = {m_aliveList[0], m_aliveList[1]};
+  rhi::BufferPtr oldDeadList = m_deadList;
+
+  if (!CreatePoolBuffers(maxParticles)) return false;
+
+  // Keep live particles, both alive lists and the free slots; the counters
+  // are untouched because every stored index is still valid.
+  m_device->CopyBuffer(m_particleBuffer, 0, oldParticleBuffer, 0,
+                       sizeof(Particle) * oldCapacity);
+  m_device->CopyBuffer(m_aliveList[0], 0, oldAliveList[0], 0,
+                       sizeof(uint32_t) * oldCapacity);
+  m_device->CopyBuffer(m_aliveList[1], 0, oldAliveList[1], 0,
+                       sizeof(uint32_t) * oldCapacity);
+  m_device->CopyBuffer(m_deadList, 0, oldDeadList, 0,
+                       sizeof(uint32_t) * oldCapacity);
+
+  // The new slots are pushed onto the dead list by the grow pass, since only
+  // the GPU knows the current dead count.
+  m_growOffset = oldCapacity;
+  m_growCount = maxParticles - oldCapacity;
+
+  if (m_logger)
+    m_logger->info("Particle pool grown from {} to {} particles.",
+                   oldCapacity, maxParticles);
+  return true;
+}
+
+bool ParticleSystemGPU::CreateEmitterTable(uint32_t emitterCount) {
+  m_emitterTableBuffer = m_device->CreateBuffer(
+      DynamicStructuredDesc(sizeof(EmitterParams), emitterCount));
+  m_emitterTableSRV = m_device->CreateShaderResourceView(
+      m_emitterTableBuffer, WholeBuffer(emitterCount));
+  if (m_emitterTableSRV == nullptr) return false;
+
+  m_emitterTableCapacity = emitterCount;
+  return true;
+}
+
+void ParticleSystemGPU::UpdateGeometryPool() {
+  std::vector<std::string> meshNames;
+  std::vector<EmitterMeshCPU> meshes;
+  for (EmitterID id : m_registry.GetEmitters()) {
+    const std::string& name = m_registry.Get(id)->meshName;
+    if (std::find(meshNames.begin(), meshNames.end(), name) !=
+        meshNames.end())
+      continue;
+
+    EmitterMeshCPU mesh;
+    if (!m_lookupMesh || !m_lookupMesh(name, mesh) || mesh.indexCount < 3)
+      continue;
+    meshNames.push_back(name);
+    meshes.push_back(mesh);
+  }
+
+  if (meshNames == m_geometryMeshNames) return;
+
+  m_geometryMeshNames = meshNames;
+  m_geometryLayout.clear();
+  m_geometryVertexBuffer.reset();
+  m_geometryIndexBuffer.reset();
+  m_geometryVertexBufferSRV.reset();
+  m_geometryIndexBufferSRV.reset();
+
+  if (meshNames.empty()) return;
+
+  // Both pools hold the meshes back to back: float3 positions and 32 bit
+  // indices local to each mesh, padded to whole triangles since emission
+  // sets address triangles of the pool.
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  for (size_t i = 0; i < meshNames.size(); i++) {
+    const EmitterMeshCPU& mesh = meshes[i];
+
+    EmitterGeometry geometry;
+    geometry.indexOffset = static_cast<uint32_t>(indices.size());
+    geometry.vertexOffset = static_cast<uint32_t>(positions.size() / 3);
+    m_geometryLayout[meshNames[i]] = geometry;
+
+    positions.insert(positions.end(), mesh.positions,
+                     mesh.positions + mesh.vertexCount * 3);
+    indices.insert(indices.end(), mesh.indices,
+                   mesh.indices + mesh.indexCount);
+    indices.resize(geometry.indexOffset + (mesh.indexCount + 2) / 3 * 3, 0);
+  }
+
+  const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+  const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+  rhi::BufferDesc desc;
+  desc.size = sizeof(float) * 3 * vertexCount;
+  desc.bindFlags = rhi::BIND_SHADER_RESOURCE;
+  desc.miscFlags = rhi::MISC_RAW_VIEWS;
+
+  m_geometryVertexBuffer = m_device->CreateBuffer(desc, positions.data());
+  m_geometryVertexBufferSRV = m_device->CreateShaderResourceView(
+      m_geometryVertexBuffer, WholeBuffer(vertexCount * 3, true));
+
+  desc.size = sizeof(uint32_t) * indexCount;
+
+  m_geometryIndexBuffer = m_device->CreateBuffer(desc, indices.data());
+  m_geometryIndexBufferSRV = m_device->CreateShaderResourceView(
+      m_geometryIndexBuffer, WholeBuffer(indexCount, true));
+
+  if (m_logger)
+    m_logger->info("Emitter geometry pool rebuilt: {} meshes, {} vertices.",
+                   meshNames.size(), vertexCount);
+}
+
+bool ParticleSystemGPU::CreateEmissionSetBuffer(uint32_t entryCount) {
+  m_emissionSetBuffer = m_device->CreateBuffer(
+      DynamicStructuredDesc(sizeof(EmissionEntry), entryCount));
+  m_emissionSetSRV = m_device->CreateShaderResourceView(
+      m_emissionSetBuffer, WholeBuffer(entryCount));
+  if (m_emissionSetSRV == nullptr) return false;
+
+  m_emissionSetCapacity = entryCount;
+  return true;
+}
+
+bool ParticleSystemGPU::CreateForceFieldBuffer(uint32_t fieldCount) {
+  m_forceFieldBuffer = m_device->CreateBuffer(
+      DynamicStructuredDesc(sizeof(ForceFieldParams), fieldCount));
+  m_forceFieldSRV = m_device->CreateShaderResourceView(
+      m_forceFieldBuffer, WholeBuffer(fieldCount));
+  if (m_forceFieldSRV == nullptr) return false;
+
+  m_forceFieldCapacity = fieldCount;
+  return true;
+}
+
+bool ParticleSystemGPU::CreateColliderBuffers(uint32_t nodeCount,
+                                              uint32_t triangleCount) {
+  m_colliderNodeBuffer = m_device->CreateBuffer(
+      DynamicStructuredDesc(sizeof(BVHNode), nodeCount));
+  m_colliderNodeSRV = m_device->CreateShaderResourceView(
+      m_colliderNodeBuffer, WholeBuffer(nodeCount));
+  m_colliderTriangleBuffer = m_device->CreateBuffer(
+      DynamicStructuredDesc(sizeof(BVHTriangle), triangleCount));
+  m_colliderTriangleSRV = m_device->CreateShaderResourceView(
+      m_colliderTriangleBuffer, WholeBuffer(triangleCount));
+  if (m_colliderNodeSRV == nullptr || m_colliderTriangleSRV == nullptr)
+    return false;
+
+  m_colliderNodeCapacity = nodeCount;
+  m_colliderTriangleCapacity = triangleCount;
+  return true;
+}
+
+bool ParticleSystemGPU::CreateDistanceColliderBuffers(uint32_t instanceCount,
+                                                      uint32_t brickCount,
+                                                      uint32_t sampleCount) {
+  m_distanceInstanceBuffer = m_device->CreateBuffer(
+      DynamicStructuredDesc(sizeof(SDFInstance), instanceCount));
+  m_distanceInstanceSRV = m_device->CreateShaderResourceView(
+      m_distanceInstanceBuffer, WholeBuffer(instanceCount));
+  m_distanceBrickBuffer = m_device->CreateBuffer(
+      DynamicStructuredDesc(sizeof(SDFBrick), brickCount));
+  m_distanceBrickSRV = m_device->CreateShaderResourceView(
+      m_distanceBrickBuffer, WholeBuffer(brickCount));
+  m_distanceSampleBuffer = m_device->CreateBuffer(
+      DynamicStructuredDesc(sizeof(float), sampleCount));
+  m_distanceSampleSRV = m_device->CreateShaderResourceView(
+      m_distanceSampleBuffer, WholeBuffer(sampleCount));
+  if (m_distanceInstanceSRV == nullptr || m_distanceBrickSRV == nullptr ||
+      m_distanceSampleSRV == nullptr)
+    return false;
+
+  m_distanceInstanceCapacity = instanceCount;
+  m_distanceBrickCapacity = brickCount;
+  m_distanceSampleCapacity = sampleCount;
+  return true;
+}
+
+void ParticleSystemGPU::UpdateEmissionSets() {
+  const uint32_t slotCount = m_registry.GetSlotCount();
+  if (m_emissionSetCache.size() != slotCount) {
+    m_emissionSetCache.resize(slotCount);
+    m_emissionSetsDirty = true;
+  }
+
+  for (EmitterID id = 0; id < slotCount; id++) {
+    EmissionSetCache& cache = m_emissionSetCache[id];
+    const ParticleEmitter* emitter = m_registry.Get(id);
+
+    EmitterMeshCPU mesh;
+    if (emitter == nullptr || m_geometryLayout.count(emitter->meshName) == 0 ||
+        !m_lookupMesh(emitter->meshName, mesh)) {
+      // no mesh to emit from
+      if (cache.valid || !cache.entries.empty()) m_emissionSetsDirty = true;
+      cache = EmissionSetCache();
+      continue;
+    }
+
+    if (cache.valid && cache.meshName == emitter->meshName &&
+        memcmp(&cache.transform, &emitter->transform, sizeof(float4x4)) ==
+            0 &&
+        std::equal(cache.velocity, cache.velocity + 3, emitter->velocity))
+      continue;
+
+    cache.meshName = emitter->meshName;
+    cache.transform = emitter->transform;
+    std::copy(emitter->velocity, emitter->velocity + 3, cache.velocity);
+    cache.valid = true;
+
+    BuildEmissionSet(mesh.positions, mesh.indices, mesh.indexCount,
+                     emitter->transform, emitter->velocity, cache.entries);
+    m_emissionSetsDirty = true;
+  }
+
+  if (!m_emissionSetsDirty) return;
+
+  // pack in slot order; triangle ids stay local to the mesh, the emit kernel
+  // adds the emitter's meshIndexOffset
+  m_emissionSets.clear();
+  m_emissionSetOffsets.assign(slotCount, 0);
+  for (EmitterID id = 0; id < slotCount; id++) {
+    const EmissionSetCache& cache = m_emissionSetCache[id];
+    m_emissionSetOffsets[id] = static_cast<uint32_t>(m_emissionSets.size());
+    m_emissionSets.insert(m_emissionSets.end(), cache.entries.begin(),
+                          cache.entries.end());
+  }
+}
+
+void ParticleSystemGPU::UpdateCPU(float dt) {
+  m_registry.Step(dt, m_emitCounts);
+
+  UpdateGeometryPool();
+  UpdateEmissionSets();
+
+  // a mesh emitter whose direction filter rejected every triangle has
+  // nowhere to emit from
+  for (EmitterID id = 0; id < m_emitCounts.size(); id++) {
+    const EmissionSetCache& cache = m_emissionSetCache[id];
+    if (cache.valid && cache.entries.empty()) m_emitCounts[id] = 0;
+  }
+
+  m_registry.BuildTable(
+      m_emitCounts,
+      [this](EmitterID id, const ParticleEmitter& emitter) {
+        auto it = m_geometryLayout.find(emitter.meshName);
+        if (it == m_geometryLayout.end()) return EmitterGeometry();
+
+        EmitterGeometry geometry = it->second;
+        geometry.emissionSetOffset = m_emissionSetOffsets[id];
+        geometry.emissionSetCount =
+            static_cast<uint32_t>(m_emissionSetCache[id].entries.size());
+        return geometry;
+      },
+      m_emitterTable, m_forceFields);
+}
+
+void ParticleSystemGPU::ImportResources(RenderGraph& graph) {
+  GraphResources& r = m_graphResources;
+  r.particles = graph.ImportResource("particleBuffer");
+  r.aliveList[0] = graph.ImportResource("aliveList[0]");
+  r.aliveList[1] = graph.ImportResource("aliveList[1]");
+  r.deadList = graph.ImportResource("deadList");
+  r.counters = graph.ImportResource("counterBuffer");
+  r.indirectArgs = graph.ImportResource("indirectBuffer");
+  r.constants = graph.ImportResource("particleSystemCB");
+  r.emitterTable = graph.ImportResource("emitterTable");
+  r.geometry = graph.ImportResource("emitterGeometry");
+  r.emissionSets = graph.ImportResource("emissionSets");
+  r.collider = graph.ImportResource("collider");
+  r.distanceColliders = graph.ImportResource("distanceColliders");
+  r.forceFields = graph.ImportResource("forceFields");
+  r.sphCells = graph.ImportResource("sphCells");
+  r.sphRanks = graph.ImportResource("sphRanks");
+  r.sphSorted = graph.ImportResource("sphSorted");
+  r.sphDensities = graph.ImportResource("sphDensities");
+  r.sphForces = graph.ImportResource("sphForces");
+}
+
+void ParticleSystemGPU::AddStepPasses(
+    RenderGraph& graph, float dt, RenderGraph::ResourceHandle frameConstants) {
+  GraphResources& r = m_graphResources;
+
+  // Growing replaces the pool buffers and copies the old contents over, so
+  // the step's uploads write them too.
+  const bool grow = m_settings.max_particles > m_capacity || m_growCount > 0;
+
+  RenderGraph::PassBuilder prepare =
+      graph.AddPass("Particle upload", [this, dt]() {
+        m_stepReady = PrepareStep(dt);
+      });
+  prepare.Upload(r.constants)
+      .Upload(r.emitterTable)
+      .Upload(r.geometry)
+      .Upload(r.emissionSets)
+      .Upload(r.collider)
+      .Upload(r.distanceColliders)
+      .Upload(r.forceFields)
+      .SideEffect();
+  if (grow) {
+    prepare.Write(r.particles)
+        .Write(r.aliveList[0])
+        .Write(r.aliveList[1])
+        .Write(r.deadList)
+        .Write(r.sphRanks)
+        .Write(r.sphSorted)
+        .Write(r.sphDensities)
+        .Write(r.sphForces);
+
+    graph.AddPass("Particle grow", [this]() { GrowPass(); })
+        .Read(r.constants)
+        .Read(r.emitterTable)
+        .Write(r.deadList)
+        .Write(r.counters);
+  }
+
+  graph.AddPass("Particle kickoff", [this]() { KickoffPass(); })
+      .Read(r.constants)
+      .Read(r.emitterTable)
+      .Write(r.counters)
+      .Write(r.indirectArgs);
+
+  graph.AddPass("Particle emit", [this]() { EmitPass(); })
+      .Read(frameConstants)
+      .Read(r.constants)
+      .Read(r.emitterTable)
+      .Read(r.geometry)
+      .Read(r.emissionSets)
+      .IndirectArgs(r.indirectArgs)
+      .Write(r.particles)
+      .Write(r.aliveList[0])
+      .Write(r.aliveList[1])
+      .Write(r.deadList)
+      .Write(r.counters);
+
+  // SPH: the neighbor grid over the fluid particles emit left alive, then
+  // their densities and forces, which the simulation integrates.
+  bool fluid = false;
+  for (EmitterID id : m_registry.GetEmitters())
+    fluid = fluid || m_registry.Get(id)->sph;
+  if (fluid) {
+    graph.AddPass("Particle SPH count", [this]() { SPHCountPass(); })
+        .Read(r.constants)
+        .Read(r.emitterTable)
+        .Read(r.particles)
+        .Read(r.aliveList[0])
+        .IndirectArgs(r.indirectArgs)
+        .Write(r.counters)
+        .Write(r.sphCells)
+        .Write(r.sphRanks);
+
+    graph.AddPass("Particle SPH offsets", [this]() { SPHOffsetsPass(); })
+        .Write(r.sphCells);
+
+    graph.AddPass("Particle SPH scatter", [this]() { SPHScatterPass(); })
+        .Read(r.aliveList[0])
+        .Read(r.sphCells)
+        .Read(r.sphRanks)
+        .IndirectArgs(r.indirectArgs)
+        .Write(r.counters)
+        .Write(r.sphSorted);
+
+    graph.AddPass("Particle SPH density", [this]() { SPHDensityPass(); })
+        .Read(r.constants)
+        .Read(r.emitterTable)
+        .Read(r.particles)
+        .Read(r.sphCells)
+        .Read(r.sphSorted)
+        .IndirectArgs(r.indirectArgs)
+        .Write(r.sphDensities);
+
+    graph.AddPass("Particle SPH force", [this]() { SPHForcePass(); })
+        .Read(r.constants)
+        .Read(r.emitterTable)
+        .Read(r.particles)
+        .Read(r.sphCells)
+        .Read(r.sphSorted)
+        .Read(r.sphDensities)
+        .IndirectArgs(r.indirectArgs)
+        .Write(r.sphForces);
+  }
+
+  graph.AddPass("Particle simulate", [this]() { SimulatePass(); })
+      .Read(frameConstants)
+      .Read(r.constants)
+      .Read(r.emitterTable)
+      .Read(r.sphForces)
+      .Read(r.collider)
+      .Read(r.distanceColliders)
+      .Read(r.forceFields)
+      .IndirectArgs(r.indirectArgs)
+      .Write(r.particles)
+      .Write(r.aliveList[0])
+      .Write(r.aliveList[1])
+      .Write(r.deadList)
+      .Write(r.counters);
+
+  // also swaps the alive lists, on the CPU; every later pass using them
+  // depends on the counters or the arguments it writes
+  graph.AddPass("Particle finish", [this]() { FinishPass(); })
+      .Read(r.constants)
+      .Read(r.emitterTable)
+      .Write(r.counters)
+      .Write(r.indirectArgs);
+
+  std::swap(r.aliveList[0], r.aliveList[1]);
+}
+
+void ParticleSystemGPU::AddStatisticsPass(RenderGraph& graph, bool stepped,
+                                          uint32_t frame) {
+  graph
+      .AddPass("Particle statistics",
+               [this, stepped, frame]() { UpdateStatistics(stepped, frame); })
+      .Read(m_graphResources.counters)
+      .SideEffect();
+}
+
+void ParticleSystemGPU::AddDrawPass(
+    RenderGraph& graph, RenderGraph::ResourceHandle frameConstants,
+    RenderGraph::ResourceHandle renderTarget) {
+  const GraphResources& r = m_graphResources;
+  graph.AddPass("Particle draw", [this]() { DrawPass(); })
+      .Read(frameConstants)
+      .Read(r.particles)
+      .Read(r.aliveList[0])
+      .IndirectArgs(r.indirectArgs)
+      .Write(renderTarget);
+}
+
+bool ParticleSystemGPU::PrepareStep(float dt) {
+  if (m_settings.max_particles > m_capacity &&
+      !Grow(m_settings.max_particles)) {
+    if (m_logger) m_logger->error("Particle pool growth failed.");
+    return false;
+  }
+
+  UpdateCPU(dt);
+  if (!UploadCollider() || !UploadDistanceColliders()) return false;
+
+  // Upload the emitter table, one row per registry slot.
+  {
+    const uint32_t emitterCount = static_cast<uint32_t>(m_emitterTable.size());
+    if ((emitterCount > m_emitterTableCapacity || !m_emitterTableBuffer) &&
+        !CreateEmitterTable(std::max(emitterCount, 1u)))
+      return false;
+
+    if (emitterCount > 0)
+      Upload(m_device, m_emitterTableBuffer, m_emitterTable.data(),
+             sizeof(EmitterParams) * emitterCount);
+  }
+
+  // Upload the force fields the rows address.
+  {
+    const uint32_t fieldCount = static_cast<uint32_t>(m_forceFields.size());
+    if ((fieldCount > m_forceFieldCapacity || !m_forceFieldBuffer) &&
+        !CreateForceFieldBuffer(std::max(fieldCount, 1u)))
+      return false;
+
+    if (fieldCount > 0)
+      Upload(m_device, m_forceFieldBuffer, m_forceFields.data(),
+             sizeof(ForceFieldParams) * fieldCount);
+  }
+
+  // Update particle system constant buffer; most steps leave it as it was.
+  {
+    ParticleSystemCB cb;
+    BuildParticleSystemCB(m_settings, m_emitterTable.data(),
+                          static_cast<uint32_t>(m_emitterTable.size()),
+                          m_capacity, cb);
+    cb.xEmitterGrowOffset = m_growOffset;
+    cb.xEmitterGrowCount = m_growCount;
+    cb.xColliderNodeCount = m_colliderNodeCount;
+    cb.xDistanceColliderCount = m_distanceColliderCount;
+
+    m_constantBuffers->Update(m_constantBuffer, &cb);
+  }
+
+  // Upload the emission sets when any of them was rebuilt.
+  if (m_emissionSetsDirty) {
+    const uint32_t entryCount = static_cast<uint32_t>(m_emissionSets.size());
+    if ((entryCount > m_emissionSetCapacity || !m_emissionSetBuffer) &&
+        !CreateEmissionSetBuffer(std::max(entryCount, 1u)))
+      return false;
+
+    if (entryCount > 0)
+      Upload(m_device, m_emissionSetBuffer, m_emissionSets.data(),
+             sizeof(EmissionEntry) * entryCount);
+    m_emissionSetsDirty = false;
+  }
+
+  return true;
+}
+
+bool ParticleSystemGPU::UploadCollider() {
+  if (m_collider == nullptr || m_collider->IsEmpty()) {
+    m_colliderNodeCount = 0;
+    m_colliderVersion = 0;
+    return true;
+  }
+  if (m_collider->GetVersion() == m_colliderVersion) return true;
+
+  const std::vector<BVHNode>& nodes = m_collider->GetNodes();
+  const std::vector<BVHTriangle>& triangles = m_collider->GetTriangles();
+  const uint32_t nodeCount = static_cast<uint32_t>(nodes.size());
+  const uint32_t triangleCount = static_cast<uint32_t>(triangles.size());
+  m_colliderNodeCount = 0;
+  if ((nodeCount > m_colliderNodeCapacity ||
+       triangleCount > m_colliderTriangleCapacity) &&
+      !CreateColliderBuffers(
+          std::max(nodeCount, m_colliderNodeCapacity),
+          std::max(triangleCount, m_colliderTriangleCapacity)))
+    return false;
+
+  Upload(m_device, m_colliderNodeBuffer, nodes.data(),
+         sizeof(BVHNode) * nodeCount);
+  Upload(m_device, m_colliderTriangleBuffer, triangles.data(),
+         sizeof(BVHTriangle) * triangleCount);
+  m_colliderNodeCount = nodeCount;
+  m_colliderVersion = m_collider->GetVersion();
+  return true;
+}
+
+bool ParticleSystemGPU::UploadDistanceColliders() {
+  const SDFColliderSet* set = m_distanceColliders;
+  if (set == nullptr || set->IsEmpty()) {
+    m_distanceColliderCount = 0;
+    m_distanceColliderVersion = 0;
+    m_distanceFieldVersion = 0;
+    return true;
+  }
+  if (set->GetVersion() == m_distanceColliderVersion) return true;
+
+  const std::vector<SDFInstance>& instances = set->GetInstances();
+  const std::vector<SDFBrick>& bricks = set->GetBricks();
+  const std::vector<float>& samples = set->GetSamples();
+  const uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+  const uint32_t brickCount = static_cast<uint32_t>(bricks.size());
+  // a field may be all inside or outside and have no samples at all
+  const uint32_t sampleCount = std::max(static_cast<uint32_t>(samples.size()),
+                                        1u);
+  m_distanceColliderCount = 0;
+  if (instanceCount > m_distanceInstanceCapacity ||
+      brickCount > m_distanceBrickCapacity ||
+      sampleCount > m_distanceSampleCapacity) {
+    if (!CreateDistanceColliderBuffers(
+            std::max(instanceCount, m_distanceInstanceCapacity),
+            std::max(brickCount, m_distanceBrickCapacity),
+            std::max(sampleCount, m_distanceSampleCapacity)))
+      return false;
+    m_distanceFieldVersion = 0;
+  }
+
+  Upload(m_device, m_distanceInstanceBuffer, instances.data(),
+         sizeof(SDFInstance) * instanceCount);
+  if (set->GetFieldVersion() != m_distanceFieldVersion) {
+    Upload(m_device, m_distanceBrickBuffer, bricks.data(),
+           sizeof(SDFBrick) * brickCount);
+    if (!samples.empty())
+      Upload(m_device, m_distanceSampleBuffer, samples.data(),
+             sizeof(float) * samples.size());
+    m_distanceFieldVersion = set->GetFieldVersion();
+  }
+  m_distanceColliderCount = instanceCount;
+  m_distanceColliderVersion = set->GetVersion();
+  return true;
+}
+
+void ParticleSystemGPU::BindComputeInputs() {
+  m_device->SetConstantBuffer(rhi::ShaderStage::Compute, 1, m_constantBuffer);
+  m_device->SetShaderResource(rhi::ShaderStage::Compute, 2,
+                              m_emitterTableSRV);
+}
+
+// push slots added by Grow() onto the dead list
+void ParticleSystemGPU::GrowPass() {
+  if (!m_stepReady || m_growCount == 0) return;
+
+  BindComputeInputs();
+  m_device->SetShader(rhi::ShaderStage::Compute, m_shaders.grow);
+  m_device->SetUnorderedAccess(3, m_deadListUAV);
+  m_device->SetUnorderedAccess(4, m_counterBufferUAV);
+  m_device->Dispatch((m_growCount + THREADCOUNT_EMIT - 1) / THREADCOUNT_EMIT,
+                     1, 1);
+
+  m_growOffset = 0;
+  m_growCount = 0;
+}
+
+// kick off updating, set up state
+void ParticleSystemGPU::KickoffPass() {
+  if (!m_stepReady) return;
+
+  BindComputeInputs();
+  m_device->SetShader(rhi::ShaderStage::Compute, m_shaders.kickoffUpdate);
+  m_device->SetUnorderedAccess(4, m_counterBufferUAV);
+  m_device->SetUnorderedAccess(5, m_indirectBufferUAV);
+  m_device->Dispatch(1, 1, 1);
+}
+
+// emit the required amount if there are free slots in dead list
+void ParticleSystemGPU::EmitPass() {
+  using rhi::ShaderStage;
+
+  if (!m_stepReady) return;
+
+  const bool fromMesh =
+      m_geometryVertexBufferSRV != nullptr && m_emissionSetSRV != nullptr;
+  BindComputeInputs();
+  m_device->SetShader(ShaderStage::Compute,
+                      fromMesh ? m_shaders.emitFromMesh : m_shaders.emit);
+  m_device->SetUnorderedAccess(0, m_particleBufferUAV);
+  m_device->SetUnorderedAccess(1, m_aliveListUAV[0]);
+  m_device->SetUnorderedAccess(2, m_aliveListUAV[1]);
+  m_device->SetUnorderedAccess(3, m_deadListUAV);
+  m_device->SetUnorderedAccess(4, m_counterBufferUAV);
+
+  if (fromMesh) {
+    m_device->SetShaderResource(ShaderStage::Compute, 0,
+                                m_geometryVertexBufferSRV);
+    m_device->SetShaderResource(ShaderStage::Compute, 1,
+                                m_geometryIndexBufferSRV);
+    m_device->SetShaderResource(ShaderStage::Compute, 3, m_emissionSetSRV);
+  }
+
+  m_device->DispatchIndirect(m_indirectBuffer,
+                             ARGUMENTBUFFER_OFFSET_DISPATCHEMIT);
+}
+
+// bucket and rank in the SPH grid of every alive fluid particle
+void ParticleSystemGPU::SPHCountPass() {
+  using rhi::ShaderStage;
+
+  if (!m_stepReady) return;
+
+  BindComputeInputs();
+  m_device->SetShader(ShaderStage::Compute, m_shaders.sphCount);
+  m_device->SetShaderResource(ShaderStage::Compute, 0, m_particleBufferSRV);
+  m_device->SetShaderResource(ShaderStage::Compute, 1, m_aliveListSRV[0]);
+  m_device->SetUnorderedAccess(0, m_sphCellCountUAV);
+  m_device->SetUnorderedAccess(1, m_sphRankUAV);
+  m_device->SetUnorderedAccess(4, m_counterBufferUAV);
+  m_device->DispatchIndirect(m_indirectBuffer,
+                             ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION);
+}
+
+// bucket starts from the counts, in one group
+void ParticleSystemGPU::SPHOffsetsPass() {
+  if (!m_stepReady) return;
+
+  m_device->SetShader(rhi::ShaderStage::Compute, m_shaders.sphOffsets);
+  m_device->SetUnorderedAccess(0, m_sphCellCountUAV);
+  m_device->SetUnorderedAccess(1, m_sphCellStartUAV);
+  m_device->Dispatch(1, 1, 1);
+}
+
+// alive fluid particles into bucket order
+void ParticleSystemGPU::SPHScatterPass() {
+  using rhi::ShaderStage;
+
+  if (!m_stepReady) return;
+
+  m_device->SetShader(ShaderStage::Compute, m_shaders.sphScatter);
+  m_device->SetShaderResource(ShaderStage::Compute, 1, m_aliveListSRV[0]);
+  m_device->SetShaderResource(ShaderStage::Compute, 4, m_sphRankSRV);
+  m_device->SetShaderResource(ShaderStage::Compute, 5, m_sphCellStartSRV);
+  m_device->SetUnorderedAccess(0, m_sphSortedUAV);
+  m_device->SetUnorderedAccess(4, m_counterBufferUAV);
+  m_device->DispatchIndirect(m_indirectBuffer,
+                             ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION);
+}
+
+void ParticleSystemGPU::SPHDensityPass() {
+  using rhi::ShaderStage;
+
+  if (!m_stepReady) return;
+
+  BindComputeInputs();
+  m_device->SetShader(ShaderStage::Compute, m_shaders.sphDensity);
+  m_device->SetShaderResource(ShaderStage::Compute, 0, m_particleBufferSRV);
+  m_device->SetShaderResource(ShaderStage::Compute, 4, m_sphSortedSRV);
+  m_device->SetShaderResource(ShaderStage::Compute, 5, m_sphCellStartSRV);
+  m_device->SetUnorderedAccess(0, m_sphDensityUAV);
+  m_device->DispatchIndirect(m_indirectBuffer,
+                             ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION);
+}
+
+void ParticleSystemGPU::SPHForcePass() {
+  using rhi::ShaderStage;
+
+  if (!m_stepReady) return;
+
+  BindComputeInputs();
+  m_device->SetShader(ShaderStage::Compute, m_shaders.sphForce);
+  m_device->SetShaderResource(ShaderStage::Compute, 0, m_particleBufferSRV);
+  m_device->SetShaderResource(ShaderStage::Compute, 4, m_sphSortedSRV);
+  m_device->SetShaderResource(ShaderStage::Compute, 5, m_sphCellStartSRV);
+  m_device->SetShaderResource(ShaderStage::Compute, 6, m_sphDensitySRV);
+  m_device->SetUnorderedAccess(0, m_sphForceUAV);
+  m_device->DispatchIndirect(m_indirectBuffer,
+                             ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION);
+}
+
+// update CURRENT alive list, write NEW alive list
+void ParticleSystemGPU::SimulatePass() {
+  using rhi::ShaderStage;
+
+  if (!m_stepReady) return;
+
+  BindComputeInputs();
+  m_device->SetShader(ShaderStage::Compute, m_shaders.simulate);
+  m_device->SetShaderResource(ShaderStage::Compute, 3, m_sphForceSRV);
+  if (m_colliderNodeCount > 0) {
+    m_device->SetShaderResource(ShaderStage::Compute, 4, m_colliderNodeSRV);
+    m_device->SetShaderResource(ShaderStage::Compute, 5,
+                                m_colliderTriangleSRV);
+  }
+  if (m_distanceColliderCount > 0) {
+    m_device->SetShaderResource(ShaderStage::Compute, 6,
+                                m_distanceInstanceSRV);
+    m_device->SetShaderResource(ShaderStage::Compute, 7, m_distanceBrickSRV);
+    m_device->SetShaderResource(ShaderStage::Compute, 8, m_distanceSampleSRV);
+  }
+  m_device->SetShaderResource(ShaderStage::Compute, 9, m_forceFieldSRV);
+  m_device->SetUnorderedAccess(0, m_particleBufferUAV);
+  m_device->SetUnorderedAccess(1, m_aliveListUAV[0]);
+  m_device->SetUnorderedAccess(2, m_aliveListUAV[1]);
+  m_device->SetUnorderedAccess(3, m_deadListUAV);
+  m_device->SetUnorderedAccess(4, m_counterBufferUAV);
+  m_device->DispatchIndirect(m_indirectBuffer,
+                             ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION);
+}
+
+// size the draw to the NEW alive list, which becomes the draw list
+void ParticleSystemGPU::FinishPass() {
+  if (!m_stepReady) return;
+
+  BindComputeInputs();
+  m_device->SetShader(rhi::ShaderStage::Compute, m_shaders.finishUpdate);
+  m_device->SetUnorderedAccess(4, m_counterBufferUAV);
+  m_device->SetUnorderedAccess(5, m_indirectBufferUAV);
+  m_device->Dispatch(1, 1, 1);
+
+  // Swap CURRENT alivelist with NEW alivelist
+  std::swap(m_aliveList[0], m_aliveList[1]);
+  std::swap(m_aliveListSRV[0], m_aliveListSRV[1]);
+  std::swap(m_aliveListUAV[0], m_aliveListUAV[1]);
+}
+
+void ParticleSystemGPU::UpdateStatistics(bool stepped, uint32_t frame) {
+  // take whatever copies have landed first, which also frees their slots
+  if (m_statisticsReadback.Poll()) {
+    memcpy(&m_statistics, m_statisticsReadback.GetResult(),
+           sizeof(m_statistics));
+    m_statisticsFrame =
+        static_cast<uint32_t>(m_statisticsReadback.GetResultFrame());
+  }
+
+  if (stepped) m_statisticsReadback.Push(frame);
+}
+
+void ParticleSystemGPU::DrawPass() {
+  using rhi::ShaderStage;
+
+  m_device->ClearVertexInput();
+
+  m_device->SetShader(ShaderStage::Vertex, m_shaders.vertex);
+  m_device->SetShader(ShaderStage::Geometry, m_shaders.geometry);
+  m_device->SetShader(ShaderStage::Pixel, m_shaders.pixel);
+
+  m_device->SetPrimitiveTopology(rhi::PrimitiveTopology::PointList);
+  m_device->SetShaderResource(ShaderStage::Vertex, 0, m_particleBufferSRV);
+  m_device->SetShaderResource(ShaderStage::Vertex, 1, m_aliveListSRV[0]);
+  m_device->DrawInstancedIndirect(m_indirectBuffer,
+                                  ARGUMENTBUFFER_OFFSET_DRAWPARTICLES);
+
+  m_device->Flush();
+}
+}  // namespace my
\ No newline at end of file
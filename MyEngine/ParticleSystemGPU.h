@@ -0,0 +1,338 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "EmissionSet.h"
+#include "MeshBVH.h"
+#include "ParticleEmitterRegistry.h"
+#include "ParticleSystemCPU.h"
+#include "ParticleSystemTypes.h"
+#include "RHI.h"
+#include "RHIConstantBufferCache.h"
+#include "RHIReadback.h"
+#include "ReadbackRing.h"
+#include "RenderGraph.h"
+#include "SDFColliderSet.h"
+#include "spdlog/spdlog.h"
+
+namespace my {
+// Compiled particle shaders, created on the device the world runs on.
+struct ParticleShaders {
+  rhi::ShaderPtr kickoffUpdate;
+  rhi::ShaderPtr emit;
+  rhi::ShaderPtr emitFromMesh;
+  rhi::ShaderPtr simulate;
+  rhi::ShaderPtr grow;
+  rhi::ShaderPtr finishUpdate;
+  rhi::ShaderPtr sphCount;
+  rhi::ShaderPtr sphOffsets;
+  rhi::ShaderPtr sphScatter;
+  rhi::ShaderPtr sphDensity;
+  rhi::ShaderPtr sphForce;
+  rhi::ShaderPtr vertex;
+  rhi::ShaderPtr geometry;
+  rhi::ShaderPtr pixel;
+};
+
+// GPU particle world: the pool, alive/dead lists, counters, emitter table,
+// pooled emitter geometry, emission sets and collider, and the kickoff / emit /
+// simulate / finish passes over them, with the SPH passes between emit and
+// simulate while an emitter has sph set. It only talks to an rhi::Device, so
+// the same frame runs on D3D11 or on the recording null device.
+//
+// The passes are added to the engine's RenderGraph with the buffers they
+// read and write; the graph orders them and places the barriers. They run
+// later, in RenderGraph::Execute(), so everything a pass needs is decided
+// when it executes, not when it is added.
+//
+// The engine owns the frame (b0) and post renderer (b2) constant buffers and
+// the output merger state; the world binds its own constant buffer to b1.
+class ParticleSystemGPU {
+ public:
+  // Fills mesh with the CPU copy of model `name`; false when there is none.
+  // Only positions, vertexCount, indices and indexCount are used.
+  using MeshLookup =
+      std::function<bool(const std::string& name, EmitterMeshCPU& mesh)>;
+
+  // Creates the buffers for settings.max_particles particles on a fresh or
+  // Reset() world. The constant buffer is created and uploaded through
+  // constantBuffers, which must work on device. logger may be nullptr.
+  bool Initialize(rhi::Device* device,
+                  rhi::ConstantBufferCache* constantBuffers,
+                  const MeshLookup& lookupMesh,
+                  const std::shared_ptr<spdlog::logger>& logger = nullptr);
+  // Releases every device object and the shaders; settings and emitters are
+  // kept.
+  void Reset();
+
+  void SetShaders(const ParticleShaders& shaders) { m_shaders = shaders; }
+
+  // Mesh the particles collide with besides the floor, or nullptr. It must
+  // outlive the world or the next SetCollider(); its nodes and triangles are
+  // uploaded whenever its version changes.
+  void SetCollider(const MeshBVH* collider) { m_collider = collider; }
+  // Baked distance fields the particles collide with, or nullptr. The set
+  // must outlive the world or the next SetDistanceColliders(); its instances
+  // are uploaded whenever they move, its bricks and samples whenever fields
+  // are added.
+  void SetDistanceColliders(const SDFColliderSet* colliders) {
+    m_distanceColliders = colliders;
+  }
+
+  // Declares the world's buffers in graph; once per frame, before the passes
+  // below are added to it.
+  void ImportResources(RenderGraph& graph);
+  // Passes of one simulation step of dt: emission and uploads, pool growth,
+  // kickoff, emit, SPH, simulate and finish. frameConstants is the engine's b0.
+  void AddStepPasses(RenderGraph& graph, float dt,
+                     RenderGraph::ResourceHandle frameConstants);
+  // Collects finished statistics readbacks and, when steps ran this frame,
+  // queues a copy of the counters after the last one, tagged with frame.
+  void AddStatisticsPass(RenderGraph& graph, bool stepped, uint32_t frame);
+  void AddDrawPass(RenderGraph& graph,
+                   RenderGraph::ResourceHandle frameConstants,
+                   RenderGraph::ResourceHandle renderTarget);
+
+  ParticleEmitterRegistry& GetRegistry() { return m_registry; }
+  ParticleWorldSettings& GetSettings() { return m_settings; }
+
+  // Latest counters the readback ring delivered, and the frame they were
+  // captured at. They trail the simulation by a few frames.
+  const ParticleCounters& GetStatistics() const { return m_statistics; }
+  uint32_t GetStatisticsFrame() const { return m_statisticsFrame; }
+
+  // Models packed into the pooled geometry, in pool order.
+  const std::vector<std::string>& GetGeometryMeshNames() const {
+    return m_geometryMeshNames;
+  }
+
+  uint32_t GetCapacity() const { return m_capacity; }
+
+ private:
+  bool CreatePoolBuffers(uint32_t maxParticles);
+  bool CreateSelfBuffers(uint32_t maxParticles);
+  bool CreateEmitterTable(uint32_t emitterCount);
+  bool CreateEmissionSetBuffer(uint32_t entryCount);
+  bool CreateForceFieldBuffer(uint32_t fieldCount);
+  bool CreateColliderBuffers(uint32_t nodeCount, uint32_t triangleCount);
+  bool CreateDistanceColliderBuffers(uint32_t instanceCount,
+                                     uint32_t brickCount,
+                                     uint32_t sampleCount);
+  bool Grow(uint32_t maxParticles);
+
+  // Repacks the pooled geometry when the set of emitter meshes changed.
+  void UpdateGeometryPool();
+
+  // Rebuilds the emission sets of emitters whose mesh, transform or velocity
+  // changed and repacks them when any did.
+  void UpdateEmissionSets();
+
+  // Emission of one simulation step: registry step, geometry pool, emission
+  // sets and emitter table.
+  void UpdateCPU(float dt);
+  // Grows the pool if the settings ask for it, runs UpdateCPU() and uploads
+  // the step; false when a buffer could not be created, which skips the
+  // GPU passes of the step.
+  bool PrepareStep(float dt);
+  // Uploads the collider when it changed; false when its buffers could not
+  // be created.
+  bool UploadCollider();
+  // The same for the distance colliders.
+  bool UploadDistanceColliders();
+  void UpdateStatistics(bool stepped, uint32_t frame);
+
+  // Bodies of the graph passes.
+  void BindComputeInputs();
+  void GrowPass();
+  void KickoffPass();
+  void EmitPass();
+  void SPHCountPass();
+  void SPHOffsetsPass();
+  void SPHScatterPass();
+  void SPHDensityPass();
+  void SPHForcePass();
+  void SimulatePass();
+  void FinishPass();
+  void DrawPass();
+
+  rhi::Device* m_device = nullptr;
+  rhi::ConstantBufferCache* m_constantBuffers = nullptr;
+  MeshLookup m_lookupMesh;
+
+  // The world's buffers in the graph being built. aliveList[0] is the
+  // CURRENT list of the step being added; it flips with every step, like
+  // m_aliveList does when the finish pass runs.
+  struct GraphResources {
+    RenderGraph::ResourceHandle particles;
+    RenderGraph::ResourceHandle aliveList[2];
+    RenderGraph::ResourceHandle deadList;
+    RenderGraph::ResourceHandle counters;
+    RenderGraph::ResourceHandle indirectArgs;
+    RenderGraph::ResourceHandle constants;
+    RenderGraph::ResourceHandle emitterTable;
+    RenderGraph::ResourceHandle geometry;
+    RenderGraph::ResourceHandle emissionSets;
+    RenderGraph::ResourceHandle collider;  // BVH nodes and triangles
+    RenderGraph::ResourceHandle distanceColliders;
+    RenderGraph::ResourceHandle forceFields;
+    RenderGraph::ResourceHandle sphCells;  // bucket counts and starts
+    RenderGraph::ResourceHandle sphRanks;
+    RenderGraph::ResourceHandle sphSorted;
+    RenderGraph::ResourceHandle sphDensities;
+    RenderGraph::ResourceHandle sphForces;
+  };
+  GraphResources m_graphResources = {};
+
+  // Whether the step being executed was prepared.
+  bool m_stepReady = false;
+  std::shared_ptr<spdlog::logger> m_logger;
+  ParticleShaders m_shaders;
+
+  ParticleCounters m_statistics = {};
+  uint32_t m_statisticsFrame = 0;
+
+  // Staging slots of the statistics readback; as deep as the frames the
+  // driver may queue, so reading never waits for the GPU.
+  static const uint32_t STATISTICS_READBACK_DEPTH = 3;
+  RHIReadbackDevice m_statisticsReadbackDevice;
+  ReadbackRing m_statisticsReadback;
+
+  rhi::BufferPtr m_particleBuffer;
+  rhi::BufferPtr m_aliveList[2];
+  rhi::BufferPtr m_deadList;
+  rhi::BufferPtr m_counterBuffer;
+  rhi::BufferPtr m_indirectBuffer;
+  rhi::BufferPtr m_constantBuffer;
+
+  rhi::SRVPtr m_particleBufferSRV;
+  rhi::UAVPtr m_particleBufferUAV;
+  rhi::SRVPtr m_aliveListSRV[2];
+  rhi::UAVPtr m_aliveListUAV[2];
+  rhi::UAVPtr m_deadListUAV;
+  rhi::UAVPtr m_counterBufferUAV;
+  rhi::UAVPtr m_indirectBufferUAV;
+
+  // Emitter table, one EmitterParams row per registry slot (t2 of the emit
+  // and simulate kernels).
+  rhi::BufferPtr m_emitterTableBuffer;
+  rhi::SRVPtr m_emitterTableSRV;
+  uint32_t m_emitterTableCapacity = 0;
+
+  // Every emitter mesh concatenated into one vertex and one index buffer, so
+  // a single emit dispatch can sample any of them (t0/t1 of the emit kernel).
+  rhi::BufferPtr m_geometryVertexBuffer;
+  rhi::BufferPtr m_geometryIndexBuffer;
+  rhi::SRVPtr m_geometryVertexBufferSRV;
+  rhi::SRVPtr m_geometryIndexBufferSRV;
+
+  // Emission sets of all registry slots back to back (t3 of the emit
+  // kernel).
+  rhi::BufferPtr m_emissionSetBuffer;
+  rhi::SRVPtr m_emissionSetSRV;
+  uint32_t m_emissionSetCapacity = 0;
+
+  // Force fields of all registry slots back to back (t9 of the simulate
+  // kernel).
+  rhi::BufferPtr m_forceFieldBuffer;
+  rhi::SRVPtr m_forceFieldSRV;
+  uint32_t m_forceFieldCapacity = 0;
+
+  // Nodes and triangles of the collider BVH (t4/t5 of the simulate kernel),
+  // the collider version they hold, 0 for none, and the node count the
+  // kernel sees.
+  const MeshBVH* m_collider = nullptr;
+  rhi::BufferPtr m_colliderNodeBuffer;
+  rhi::BufferPtr m_colliderTriangleBuffer;
+  rhi::SRVPtr m_colliderNodeSRV;
+  rhi::SRVPtr m_colliderTriangleSRV;
+  uint32_t m_colliderNodeCapacity = 0;
+  uint32_t m_colliderTriangleCapacity = 0;
+  uint32_t m_colliderVersion = 0;
+  uint32_t m_colliderNodeCount = 0;
+
+  // Instances, bricks and samples of the distance colliders (t6/t7/t8 of
+  // the simulate kernel), the versions of the set they hold, 0 for none,
+  // and the instance count the kernel sees.
+  const SDFColliderSet* m_distanceColliders = nullptr;
+  rhi::BufferPtr m_distanceInstanceBuffer;
+  rhi::BufferPtr m_distanceBrickBuffer;
+  rhi::BufferPtr m_distanceSampleBuffer;
+  rhi::SRVPtr m_distanceInstanceSRV;
+  rhi::SRVPtr m_distanceBrickSRV;
+  rhi::SRVPtr m_distanceSampleSRV;
+  uint32_t m_distanceInstanceCapacity = 0;
+  uint32_t m_distanceBrickCapacity = 0;
+  uint32_t m_distanceSampleCapacity = 0;
+  uint32_t m_distanceColliderVersion = 0;
+  uint32_t m_distanceFieldVersion = 0;
+  uint32_t m_distanceColliderCount = 0;
+
+  // SPH neighbor grid: particles per bucket, the first sorted particle of
+  // every bucket (plus the total), and the bucket and rank of every alive
+  // list entry; the count and offsets passes build them.
+  rhi::BufferPtr m_sphCellCountBuffer;
+  rhi::BufferPtr m_sphCellStartBuffer;
+  rhi::BufferPtr m_sphRankBuffer;
+  rhi::UAVPtr m_sphCellCountUAV;
+  rhi::SRVPtr m_sphCellStartSRV;
+  rhi::UAVPtr m_sphCellStartUAV;
+  rhi::SRVPtr m_sphRankSRV;
+  rhi::UAVPtr m_sphRankUAV;
+
+  // Pool slots of the fluid particles in bucket order, and the density and
+  // acceleration of every slot (t3 of the simulate kernel).
+  rhi::BufferPtr m_sphSortedBuffer;
+  rhi::BufferPtr m_sphDensityBuffer;
+  rhi::BufferPtr m_sphForceBuffer;
+  rhi::SRVPtr m_sphSortedSRV;
+  rhi::UAVPtr m_sphSortedUAV;
+  rhi::SRVPtr m_sphDensitySRV;
+  rhi::UAVPtr m_sphDensityUAV;
+  rhi::SRVPtr m_sphForceSRV;
+  rhi::UAVPtr m_sphForceUAV;
+
+  // Current size of the particle pool, alive lists and dead list.
+  uint32_t m_capacity = 0;
+
+  // Slots added by the last Grow(), handed to the grow pass on the next
+  // update.
+  uint32_t m_growOffset = 0;
+  uint32_t m_growCount = 0;
+
+  ParticleWorldSettings m_settings;
+  ParticleEmitterRegistry m_registry;
+
+  // Particles every registry slot emits in the current step, the table
+  // built from them and the force fields its rows address.
+  std::vector<uint32_t> m_emitCounts;
+  std::vector<EmitterParams> m_emitterTable;
+  std::vector<ForceFieldParams> m_forceFields;
+
+  // Models packed into the pooled geometry, in pool order, and where each
+  // one landed.
+  std::vector<std::string> m_geometryMeshNames;
+  std::unordered_map<std::string, EmitterGeometry> m_geometryLayout;
+
+  // Emission set of one registry slot and the emitter state it was built
+  // from; it is only rebuilt when the mesh, transform or velocity changes.
+  struct EmissionSetCache {
+    std::string meshName;
+    float4x4 transform;
+    float velocity[3] = {0.0f, 0.0f, 0.0f};
+    bool valid = false;
+    std::vector<EmissionEntry> entries;
+  };
+  std::vector<EmissionSetCache> m_emissionSetCache;
+
+  // The cached sets packed in slot order, where each slot's set starts, and
+  // whether the packed sets still have to be uploaded.
+  std::vector<EmissionEntry> m_emissionSets;
+  std::vector<uint32_t> m_emissionSetOffsets;
+  bool m_emissionSetsDirty = false;
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "ParticleSystemTypes.h"
+
+#include <cmath>
+
+namespace my {
+void BuildEmitterParams(const ParticleEmitter& emitter, uint32_t emitCount,
+                        uint32_t emitOffset, uint32_t meshIndexOffset,
+                        uint32_t meshVertexOffset, uint32_t emissionSetOffset,
+                        uint32_t emissionSetCount, EmitterParams& params) {
+  const float pi = 3.14159265358979323846f;
+
+  params = {};
+
+  // HLSL reads the matrix column-major, so upload it transposed.
+  for (int r = 0; r < 4; r++)
+    for (int c = 0; c < 4; c++)
+      params.world.m[r][c] = emitter.transform.m[c][r];
+
+  params.emitCount = emitCount;
+  params.emitOffset = emitOffset;
+  params.meshIndexOffset = meshIndexOffset;
+  params.meshVertexOffset = meshVertexOffset;
+  params.emissionSetOffset = emissionSetOffset;
+  params.emissionSetCount = emissionSetCount;
+  params.seed = emitter.seed;
+  params.color = emitter.color;
+  params.size = emitter.size;
+  params.scaling = emitter.scale;
+  params.rotation = emitter.rotation * pi * 60;
+  params.randomFactor = emitter.random_factor;
+  params.normalFactor = emitter.normal_factor;
+  params.lifeSpan = emitter.life;
+  params.lifeSpanRandomness = emitter.random_life;
+  params.randomColorFactor = emitter.random_color;
+  params.gravity.x = emitter.gravity[0];
+  params.gravity.y = emitter.gravity[1];
+  params.gravity.z = emitter.gravity[2];
+  params.restitution = emitter.restitution;
+  params.velocity.x = emitter.velocity[0];
+  params.velocity.y = emitter.velocity[1];
+  params.velocity.z = emitter.velocity[2];
+  params.drag = emitter.drag;
+  params.mass = emitter.mass;
+  params.sph = emitter.sph ? 1 : 0;
+}
+
+void BuildForceFieldParams(const ParticleForceField& field,
+                           ForceFieldParams& params) {
+  params = {};
+  params.position.x = field.position[0];
+  params.position.y = field.position[1];
+  params.position.z = field.position[2];
+  params.type = static_cast<uint>(field.type);
+
+  const float* d = field.direction;
+  const float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+  params.direction.x = d[0] * scale;
+  params.direction.y = d[1] * scale;
+  params.direction.z = d[2] * scale;
+
+  params.strength = field.strength;
+  params.rangeRcp = field.range > 0.0f ? 1.0f / field.range : 0.0f;
+  params.frequency = field.frequency;
+}
+
+void BuildParticleSystemCB(const ParticleWorldSettings& settings,
+                           const EmitterParams* emitters,
+                           uint32_t emitterCount, uint32_t maxParticles,
+                           ParticleSystemCB& cb) {
+  cb = {};
+
+  cb.xEmitterCount = emitterCount;
+  for (uint32_t i = 0; i < emitterCount; i++)
+    cb.xEmitTotal += emitters[i].emitCount;
+  cb.xEmitterMaxParticleCount = maxParticles;
+  cb.xEmitterFixedTimestep = settings.fixed_timestep;
+
+  const float pi = 3.14159265358979323846f;
+  const float h = settings.sph_h;
+  const float h3 = h * h * h;
+  cb.xSPH_h = h;
+  cb.xSPH_h_rcp = 1.0f / h;
+  cb.xSPH_h2 = h * h;
+  cb.xSPH_h3 = h3;
+  cb.xSPH_poly6_constant = 315.0f / (64.0f * pi * h3 * h3 * h3);
+  cb.xSPH_spiky_constant = -45.0f / (pi * h3 * h3);
+  cb.xSPH_visc_constant = 45.0f / (pi * h3 * h3);
+  cb.xSPH_K = settings.sph_K;
+  cb.xSPH_e = settings.sph_e;
+  cb.xSPH_p0 = settings.sph_p0;
+}
+}  // namespace my
\ No newline at end of file
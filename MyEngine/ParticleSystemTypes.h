@@ -0,0 +1,299 @@
+#pragma once
+
+// Particle system data shared by the GPU path (ParticleSystemGPU) and the
+// portable CPU backend (ParticleSystemCPU). The layouts mirror
+// hlsl/Header.hlsli, so keep both sides in sync. Nothing in here may depend
+// on Win32/D3D headers unless they are available.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include "SimpleMath.h"
+
+using float4x4 = DirectX::SimpleMath::Matrix;
+using float2 = DirectX::SimpleMath::Vector2;
+using float3 = DirectX::SimpleMath::Vector3;
+#else
+struct float2 {
+  float x = 0.0f;
+  float y = 0.0f;
+};
+
+struct float3 {
+  float x = 0.0f;
+  float y = 0.0f;
+  float z = 0.0f;
+};
+
+struct float4x4 {
+  float m[4][4] = {{1.0f, 0.0f, 0.0f, 0.0f},
+                   {0.0f, 1.0f, 0.0f, 0.0f},
+                   {0.0f, 0.0f, 1.0f, 0.0f},
+                   {0.0f, 0.0f, 0.0f, 1.0f}};
+};
+#endif
+
+using uint = uint32_t;
+
+// Must match the numthreads of the emit/simulate/grow kernels.
+static const uint32_t THREADCOUNT_EMIT = 256;
+static const uint32_t THREADCOUNT_SIMULATION = 256;
+
+// Must match the numthreads of CS_ParticleSystem_SPH_Offsets and the bucket
+// count of the hashed SPH neighbor grid in hlsl/Header.hlsli.
+static const uint32_t THREADCOUNT_SPH_OFFSETS = 1024;
+static const uint32_t SPH_GRID_SIZE = 65536;
+
+// Byte offsets of the dispatch arguments written by the kickoff kernel and of
+// the draw arguments written by the finish kernel.
+static const uint32_t ARGUMENTBUFFER_OFFSET_DISPATCHEMIT = 0;
+static const uint32_t ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION =
+    ARGUMENTBUFFER_OFFSET_DISPATCHEMIT + 3 * sizeof(uint32_t);
+static const uint32_t ARGUMENTBUFFER_OFFSET_DRAWPARTICLES =
+    ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION + 3 * sizeof(uint32_t);
+static const uint32_t ARGUMENTBUFFER_SIZE =
+    ARGUMENTBUFFER_OFFSET_DRAWPARTICLES + 4 * sizeof(uint32_t);
+
+struct Particle {
+  float3 position;
+  uint emitterIndex;  // slot of the emitter in the emitter table
+  float3 positionPrev;  // position before the last simulation step
+  float rotationalVelocity;
+  float3 velocity;
+  float maxLife;
+  float2 sizeBeginEnd;
+  float life;
+  uint color;
+};
+static_assert(sizeof(Particle) == 64, "Particle must match the HLSL layout.");
+
+struct ParticleCounters {
+  uint aliveCount;
+  uint deadCount;
+  uint realEmitCount;
+  uint aliveCount_afterSimulation;
+};
+
+// Same layout as D3D11_DRAW_INSTANCED_INDIRECT_ARGS.
+struct DrawIndirectArgs {
+  uint vertexCountPerInstance;
+  uint instanceCount;
+  uint startVertexLocation;
+  uint startInstanceLocation;
+};
+
+enum class ForceFieldType : uint32_t {
+  Attractor,   // pulls towards position, pushes away with negative strength
+  Vortex,      // swirls around the axis through position along direction
+  Wind,        // pushes along direction
+  Turbulence,  // curl noise: divergence free, so it stirs without clumping
+};
+
+// A force acting on the particles of one emitter, evaluated at every
+// particle's position each simulation step.
+struct ParticleForceField {
+  ForceFieldType type = ForceFieldType::Attractor;
+
+  // WS; the attractor's target, a point on the vortex axis, and the center
+  // of the falloff of every type
+  float position[3] = {0.0f, 0.0f, 0.0f};
+  // vortex axis or wind direction, normalized when the table is built
+  float direction[3] = {0.0f, 1.0f, 0.0f};
+
+  // acceleration in m/s^2 at full weight; turbulence scales a noise curl of
+  // about unit length by it
+  float strength = 1.0f;
+
+  // the weight fades as (1 - d / range)^2 with the distance d from position
+  // (from the axis for vortices), 0 reaches everywhere at full weight
+  float range = 0.0f;
+
+  // turbulence: noise cells per meter
+  float frequency = 1.0f;
+};
+
+struct ParticleEmitter {
+  std::string meshName;
+
+  float4x4 transform;
+  uint color = 0xffffffff;
+
+  float size = 1.0f;
+  float random_factor = 1.0f;
+  float normal_factor = 1.0f;
+  float count = 10.0f;
+  float life = 1.0f;
+  float random_life = 1.0f;
+  float scale = 1.0f;
+  float rotation = 0.0f;
+  float mass = 1.0f;
+  float random_color = 0;
+
+  // starting velocity of all new particles
+  float velocity[3] = {0.0f, 0.0f, 0.0f};
+
+  // constant gravity force
+  float gravity[3] = {0.0f, 0.0f, 0.0f};
+
+  // constant drag (per frame velocity multiplier, reducing it will make
+  // particles slow down over time)
+  float drag = 1.0f;
+
+  // if the particles have collision enabled, then after collision this is a
+  // multiplier for their bouncing velocities
+  float restitution = 0.98f;
+
+  // key of the emission random stream; the same seed replays the same
+  // particles for the same frames
+  uint32_t seed = 0;
+
+  // the particles are part of the world's SPH fluid (see
+  // ParticleWorldSettings), each one carrying `mass`
+  bool sph = false;
+
+  // forces added to gravity, in order
+  std::vector<ParticleForceField> force_fields;
+};
+
+// Settings shared by every emitter of a particle world.
+struct ParticleWorldSettings {
+  // length of one simulation step in seconds, and the most steps one frame
+  // may run to catch up
+  float fixed_timestep = 1.0f / 60.0f;
+  uint32_t max_substeps = 4;
+
+  // size of the shared particle pool; can be raised at runtime, live
+  // particles are kept when the pool grows
+  uint32_t max_particles = 1000;
+
+  // SPH fluid of the particles of every emitter with sph set: smoothing
+  // radius, pressure stiffness, rest density and viscosity
+  float sph_h = 1.0f;
+  float sph_K = 250.0f;
+  float sph_p0 = 1.0f;
+  float sph_e = 0.018f;
+};
+
+// One row of the emitter table (StructuredBuffer<EmitterParams> on the GPU).
+// Emitters are laid out back to back in the batched emit dispatch: emitter i
+// owns emit threads [emitOffset, emitOffset + emitCount).
+struct alignas(16) EmitterParams {
+  float4x4 world;
+
+  uint emitCount;
+  uint emitOffset;
+  uint meshIndexOffset;   // first index in the pooled geometry
+  uint meshVertexOffset;  // added to every index of the mesh
+
+  uint emissionSetOffset;  // first bucket in the pooled emission sets
+  uint emissionSetCount;   // 0 emits from the emitter origin
+  uint seed;
+  uint color;
+
+  float size;
+  float scaling;
+  float rotation;
+  float randomFactor;
+
+  float normalFactor;
+  float lifeSpan;
+  float lifeSpanRandomness;
+  float randomColorFactor;
+
+  float3 gravity;
+  float restitution;
+
+  float3 velocity;
+  float drag;
+
+  float mass;
+  uint sph;  // 1 when the particles are part of the SPH fluid
+  uint forceFieldOffset;  // first field in the pooled force fields
+  uint forceFieldCount;
+};
+static_assert(sizeof(EmitterParams) == 176,
+              "EmitterParams must match the HLSL layout.");
+
+// One pooled force field (StructuredBuffer<ForceFieldParams> on the GPU),
+// built from a ParticleForceField.
+struct alignas(16) ForceFieldParams {
+  float3 position;
+  uint type;  // ForceFieldType
+
+  float3 direction;  // unit length
+  float strength;
+
+  float rangeRcp;  // 0 without falloff
+  float frequency;
+  uint padding[2];
+};
+static_assert(sizeof(ForceFieldParams) == 48,
+              "ForceFieldParams must match the HLSL layout.");
+
+struct alignas(16) ParticleSystemCB {
+  uint xEmitterCount;  // rows in the emitter table
+  uint xEmitTotal;     // sum of emitCount over all emitters
+  uint xEmitterMaxParticleCount;
+  float xParticleMotionBlurAmount;
+
+  uint xEmitterFramesX;
+  uint xEmitterFramesY;
+  uint xEmitterFrameCount;
+  uint xEmitterFrameStart;
+
+  float2 xEmitterTexMul;
+  float xEmitterFrameRate;
+  uint xEmitterLayerMask;
+
+  float xSPH_h;      // smoothing radius
+  float xSPH_h_rcp;  // 1.0f / smoothing radius
+  float xSPH_h2;     // smoothing radius ^ 2
+  float xSPH_h3;     // smoothing radius ^ 3
+
+  float xSPH_poly6_constant;  // precomputed Poly6 kernel constant term
+  float xSPH_spiky_constant;  // precomputed Spiky kernel function constant term
+  float xSPH_visc_constant;   // precomputed viscosity kernel function constant
+                              // term
+  float xSPH_K;               // pressure constant
+
+  float xSPH_e;   // viscosity constant
+  float xSPH_p0;  // reference density
+  uint xEmitterOptions;
+  float xEmitterFixedTimestep;  // we can force a fixed timestep (>0) onto the
+                                // simulation to avoid blowing up
+
+  uint xEmitterGrowOffset;  // first slot added by the last pool growth
+  uint xEmitterGrowCount;   // number of slots to push onto the dead list
+  uint xColliderNodeCount;  // nodes of the collider BVH, 0 without one
+  uint xDistanceColliderCount;  // baked distance colliders, 0 without any
+};
+
+struct alignas(16) FrameCB {
+  uint frame_count;
+  float time;
+  float time_previous;
+  float delta_time;
+
+  float interpolation;  // blend from positionPrev to position when drawing
+  uint frame_padding[3];
+};
+
+namespace my {
+// Fills one emitter table row the same way for the GPU and CPU paths.
+void BuildEmitterParams(const ParticleEmitter& emitter, uint32_t emitCount,
+                        uint32_t emitOffset, uint32_t meshIndexOffset,
+                        uint32_t meshVertexOffset, uint32_t emissionSetOffset,
+                        uint32_t emissionSetCount, EmitterParams& params);
+
+// Converts a force field to its pooled form.
+void BuildForceFieldParams(const ParticleForceField& field,
+                           ForceFieldParams& params);
+
+// Fills the batch constant buffer from a finished emitter table.
+void BuildParticleSystemCB(const ParticleWorldSettings& settings,
+                           const EmitterParams* emitters,
+                           uint32_t emitterCount, uint32_t maxParticles,
+                           ParticleSystemCB& cb);
+}  // namespace my
\ No newline at end of file
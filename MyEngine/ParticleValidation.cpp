@@ -0,0 +1,818 @@
+#include "ParticleValidation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "JobSystem.h"
+#include "MeshBVH.h"
+#include "MeshSDF.h"
+#include "MetaballGrid.h"
+#include "NeighborGrid.h"
+#include "ParticleForceFields.h"
+#include "ParticleScenes.h"
+#include "ParticleSystemCPU.h"
+#include "ParticleSystemGPU.h"
+#include "Random.h"
+#include "RenderGraph.h"
+#include "SDFColliderSet.h"
+
+namespace my {
+namespace {
+// Exact signed distance from p to the closed mesh of positions and indices,
+// over every triangle: negative where a ray from p crosses the mesh an odd
+// number of times. direction is the unit vector from the closest point to
+// p, flipped inside, so it points away from the mesh.
+float MeshDistance(const std::vector<float>& positions,
+                   const std::vector<uint32_t>& indices, const float p[3],
+                   float direction[3] = nullptr) {
+  auto dot = [](const double x[3], const double y[3]) {
+    return x[0] * y[0] + x[1] * y[1] + x[2] * y[2];
+  };
+  auto cross = [](const double x[3], const double y[3], double r[3]) {
+    r[0] = x[1] * y[2] - x[2] * y[1];
+    r[1] = x[2] * y[0] - x[0] * y[2];
+    r[2] = x[0] * y[1] - x[1] * y[0];
+  };
+  // skewed, so the ray misses the edges of the grid-aligned torus
+  const double ray[3] = {0.8, 0.1234, 0.0567};
+
+  double nearestSq = 1e30;
+  double nearest[3] = {0.0, 0.0, 0.0};
+  uint32_t crossings = 0;
+  for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+    double v[3][3];
+    for (uint32_t k = 0; k < 3; k++)
+      for (uint32_t c = 0; c < 3; c++)
+        v[k][c] = positions[indices[t + k] * 3 + c];
+    const double ab[3] = {v[1][0] - v[0][0], v[1][1] - v[0][1],
+                          v[1][2] - v[0][2]};
+    const double ac[3] = {v[2][0] - v[0][0], v[2][1] - v[0][1],
+                          v[2][2] - v[0][2]};
+    const double ap[3] = {p[0] - v[0][0], p[1] - v[0][1], p[2] - v[0][2]};
+
+    // closest point: the projection onto the plane when it falls inside
+    // the triangle, otherwise the closest point of its edges
+    double n[3];
+    cross(ab, ac, n);
+    const double nn = dot(n, n);
+    if (nn <= 0.0) continue;
+    double closest[3];
+    const double height = dot(ap, n) / nn;
+    for (uint32_t c = 0; c < 3; c++) closest[c] = p[c] - n[c] * height;
+    double e0[3], e1[3], q[3];
+    bool inside = true;
+    for (uint32_t k = 0; k < 3 && inside; k++) {
+      for (uint32_t c = 0; c < 3; c++) {
+        e0[c] = v[(k + 1) % 3][c] - v[k][c];
+        e1[c] = closest[c] - v[k][c];
+      }
+      cross(e0, e1, q);
+      inside = dot(q, n) >= 0.0;
+    }
+    if (!inside) {
+      // nearest point over the three edges
+      double best = 1e30;
+      for (uint32_t k = 0; k < 3; k++) {
+        const double* a = v[k];
+        const double* b = v[(k + 1) % 3];
+        const double edge[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const double offset[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+        const double s = std::min(
+            std::max(dot(offset, edge) / dot(edge, edge), 0.0), 1.0);
+        double point[3], d[3];
+        for (uint32_t c = 0; c < 3; c++) {
+          point[c] = a[c] + edge[c] * s;
+          d[c] = p[c] - point[c];
+        }
+        if (dot(d, d) < best) {
+          best = dot(d, d);
+          for (uint32_t c = 0; c < 3; c++) closest[c] = point[c];
+        }
+      }
+    }
+    const double d[3] = {p[0] - closest[0], p[1] - closest[1],
+                         p[2] - closest[2]};
+    if (dot(d, d) < nearestSq) {
+      nearestSq = dot(d, d);
+      for (uint32_t c = 0; c < 3; c++) nearest[c] = closest[c];
+    }
+
+    // Moeller-Trumbore crossing of the ray
+    double h[3], r[3];
+    cross(ray, ac, h);
+    const double det = dot(ab, h);
+    if (det * det < 1e-30) continue;
+    const double u = dot(ap, h) / det;
+    cross(ap, ab, r);
+    const double w = dot(ray, r) / det;
+    if (u >= 0.0 && w >= 0.0 && u + w <= 1.0 && dot(ac, r) / det > 0.0)
+      crossings++;
+  }
+
+  const double distance = std::sqrt(nearestSq);
+  const double sign = crossings % 2 == 1 ? -1.0 : 1.0;
+  if (direction != nullptr) {
+    for (uint32_t c = 0; c < 3; c++)
+      direction[c] = distance > 0.0
+                         ? static_cast<float>(sign * (p[c] - nearest[c]) /
+                                              distance)
+                         : 0.0f;
+  }
+  return static_cast<float>(sign * distance);
+}
+
+// Acceleration an attractor, vortex or wind field gives a particle at p, by
+// the definition of the field.
+void ExpectedForce(const ForceFieldParams& field, const float p[3],
+                   double acceleration[3]) {
+  const double axis[3] = {field.direction.x, field.direction.y,
+                          field.direction.z};
+  const double offset[3] = {p[0] - field.position.x, p[1] - field.position.y,
+                            p[2] - field.position.z};
+  double direction[3];
+  double distance;
+  if (field.type == static_cast<uint32_t>(ForceFieldType::Vortex)) {
+    const double along =
+        offset[0] * axis[0] + offset[1] * axis[1] + offset[2] * axis[2];
+    double radial[3];
+    for (uint32_t c = 0; c < 3; c++) radial[c] = offset[c] - axis[c] * along;
+    distance = std::sqrt(radial[0] * radial[0] + radial[1] * radial[1] +
+                         radial[2] * radial[2]);
+    direction[0] = (axis[1] * radial[2] - axis[2] * radial[1]) / distance;
+    direction[1] = (axis[2] * radial[0] - axis[0] * radial[2]) / distance;
+    direction[2] = (axis[0] * radial[1] - axis[1] * radial[0]) / distance;
+  } else {
+    distance = std::sqrt(offset[0] * offset[0] + offset[1] * offset[1] +
+                         offset[2] * offset[2]);
+    const bool attractor =
+        field.type == static_cast<uint32_t>(ForceFieldType::Attractor);
+    for (uint32_t c = 0; c < 3; c++)
+      direction[c] = attractor ? -offset[c] / distance : axis[c];
+  }
+  const double fade =
+      std::min(std::max(1.0 - distance * field.rangeRcp, 0.0), 1.0);
+  for (uint32_t c = 0; c < 3; c++)
+    acceleration[c] = direction[c] * field.strength * fade * fade;
+}
+}  // namespace
+
+std::string ParticleValidation::ValidateGPUFrames(uint32_t maxParticles,
+                                                  uint32_t emitterCount,
+                                                  uint32_t frameCount,
+                                                  uint32_t stepsPerFrame) {
+  using rhi::NullDevice;
+
+  // small colliders, so their uploads are scheduled too
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  scenes::CreateTorus(64, positions, indices);
+  MeshBVH collider;
+  collider.AddMesh(positions.data(), indices.data(),
+                   static_cast<uint32_t>(indices.size()), float4x4());
+  collider.Build();
+  MeshSDF field;
+  field.GetSettings().resolution = 16;
+  field.AddMesh(positions.data(), indices.data(),
+                static_cast<uint32_t>(indices.size()));
+  field.Build();
+  SDFColliderSet distanceColliders;
+  distanceColliders.Add(field, float4x4());
+
+  NullDevice device;
+  rhi::ConstantBufferCache constantBuffers(&device);
+  ParticleSystemGPU world;
+  world.GetSettings().max_particles = maxParticles;
+  if (!world.Initialize(&device, &constantBuffers, nullptr))
+    return "initialization failed";
+  world.SetShaders(scenes::CreateNullShaders(device));
+  world.SetCollider(&collider);
+  world.SetDistanceColliders(&distanceColliders);
+
+  // the last emitter is a fluid, so the SPH passes are scheduled too, and
+  // the first one stirs its particles with force fields
+  for (uint32_t i = 0; i < emitterCount; i++) {
+    const EmitterID id = world.GetRegistry().Create();
+    ParticleEmitter* emitter = world.GetRegistry().Get(id);
+    emitter->sph = i > 0 && i + 1 == emitterCount;
+    if (i == 0) {
+      emitter->force_fields.resize(2);
+      emitter->force_fields[0].type = ForceFieldType::Vortex;
+      emitter->force_fields[1].type = ForceFieldType::Turbulence;
+    }
+  }
+
+  RenderGraph graph;
+  uint32_t simulated = 0;
+  for (uint32_t frame = 0; frame < frameCount; frame++) {
+    // grow halfway through, so the grow pass is part of one schedule
+    if (frame == frameCount / 2) world.GetSettings().max_particles *= 2;
+    // the colliders move every frame, so every frame uploads them
+    collider.SetTransform(0, scenes::RotationZ(0.1f * frame, 0.0f));
+    collider.Refit();
+    distanceColliders.SetTransform(0, scenes::RotationZ(0.1f * frame, 0.0f));
+
+    simulated += stepsPerFrame;
+    scenes::BuildFrame(graph, world, stepsPerFrame, simulated);
+
+    std::string error = graph.Validate();
+    if (error.empty()) {
+      const NullDevice::CommandType barrier = NullDevice::CommandType::Barrier;
+      const uint64_t before = device.GetStats().GetCount(barrier);
+      graph.Execute(&device);
+      const uint64_t recorded = device.GetStats().GetCount(barrier) - before;
+      if (recorded != graph.GetBarrierCount())
+        error = std::to_string(recorded) + " barriers recorded, " +
+                std::to_string(graph.GetBarrierCount()) + " compiled";
+    }
+    if (!error.empty()) return "frame " + std::to_string(frame) + ": " + error;
+  }
+
+  return std::string();
+}
+
+std::string ParticleValidation::ValidateMetaballSurface(
+    uint32_t sphereCount, uint32_t sampleCount, float smoothing) {
+  std::vector<Particle> particles;
+  std::vector<uint32_t> aliveList;
+  scenes::CreateMetaballBlob(sphereCount, particles, aliveList);
+
+  float3 boxCenter;
+  boxCenter.x = boxCenter.y = boxCenter.z = 0.0f;
+  MetaballGrid grid;
+  grid.Build(particles.data(), aliveList.data(), sphereCount, boxCenter, 1.0f,
+             smoothing);
+
+  // GetNormal() steps 0.01 to one side, too coarse for the creases between
+  // small spheres at a large k, so the reference gradient takes central
+  // differences of GetDistance() a tenth of that apart. The band keeps the
+  // samples where the shader shades.
+  const float band = 0.01f;
+  const float epsilon = 1e-3f;
+  const float distanceTolerance = 1e-5f;
+  const float colorTolerance = 1e-4f;
+  const float normalTolerance = 0.999f;  // cosine of the angle between them
+  const float minSlope = 0.25f;  // of the field, for the normal to count
+
+  uint32_t checked = 0;
+  for (uint32_t i = 0; checked < sampleCount && i < sampleCount * 1000; i++) {
+    RNG rng;
+    rng.init(0x5EED, i, 0);
+    float3 pos;
+    // away from the box, where the field drops to cutoff
+    pos.x = (rng.next_float() * 2 - 1) * 0.9f;
+    pos.y = (rng.next_float() * 2 - 1) * 0.9f;
+    pos.z = (rng.next_float() * 2 - 1) * 0.9f;
+    const float distance = grid.GetDistance(pos);
+    if (std::abs(distance) >= band) continue;
+    checked++;
+
+    const MetaballSurface surface = grid.GetSurface(pos);
+    float3 normal;
+    float* axes[3] = {&normal.x, &normal.y, &normal.z};
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      float3 lo = pos, hi = pos;
+      float* loAxes[3] = {&lo.x, &lo.y, &lo.z};
+      float* hiAxes[3] = {&hi.x, &hi.y, &hi.z};
+      *loAxes[axis] -= epsilon;
+      *hiAxes[axis] += epsilon;
+      *axes[axis] = grid.GetDistance(hi) - grid.GetDistance(lo);
+    }
+    const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y +
+                                   normal.z * normal.z);
+    const float3 color = grid.GetColor(pos);
+    const std::string at = "sample " + std::to_string(i) + ": ";
+
+    if (std::abs(surface.distance - distance) >
+        distanceTolerance * std::max(1.0f, std::abs(distance)))
+      return at + "distance " + std::to_string(surface.distance) + " vs " +
+             std::to_string(distance);
+
+    // In the saddles between spheres the field is nearly flat, and the steps
+    // the cutoff leaves in it outweigh the differences; neither direction
+    // means much there.
+    const float cosine = (surface.normal.x * normal.x +
+                          surface.normal.y * normal.y +
+                          surface.normal.z * normal.z) /
+                         length;
+    if (length >= 2 * epsilon * minSlope && !(cosine >= normalTolerance))
+      return at + "normals " + std::to_string(cosine) + " apart";
+
+    const float colorError =
+        std::max(std::abs(surface.color.x - color.x),
+                 std::max(std::abs(surface.color.y - color.y),
+                          std::abs(surface.color.z - color.z)));
+    if (colorError > colorTolerance)
+      return at + "color off by " + std::to_string(colorError);
+  }
+  if (checked < sampleCount)
+    return "only " + std::to_string(checked) + " samples near the surface";
+
+  return std::string();
+}
+
+std::string ParticleValidation::ValidateFluidDensity(uint32_t particleCount) {
+  ParticleSystemCPU system;
+  std::vector<EmitterParams> table;
+  ParticleSystemCB cb;
+  FrameCB frame;
+  scenes::CreateFluidBlock(particleCount, system, table, cb, frame);
+
+  // one step of the fluid, so it has moved off the emitted positions
+  frame.frame_count++;
+  system.Update(cb, table, frame, -1e9f);
+
+  // the fluid step alone leaves the positions as they are
+  frame.frame_count++;
+  system.Kickoff(cb);
+  system.Emit(table, frame.frame_count, nullptr);
+  system.SimulateFluid(cb, table, cb.xEmitterFixedTimestep);
+
+  const ParticleFluidCPU& fluid = system.GetFluid();
+  const uint32_t* particles = fluid.GetParticles();
+  const uint32_t count = fluid.GetCount();
+  if (count != system.GetStatistics().aliveCount)
+    return std::to_string(count) + " of " +
+           std::to_string(system.GetStatistics().aliveCount) +
+           " particles in the fluid";
+
+  const ParticleStorageSoA& s = system.GetStorage();
+  const double h2 = static_cast<double>(cb.xSPH_h) * cb.xSPH_h;
+  const double mass = table[0].mass;
+  const float tolerance = 1e-4f;  // relative, for the float sums
+
+  for (uint32_t i = 0; i < count; i++) {
+    const uint32_t a = particles[i];
+    double expected = 0.0;
+    for (uint32_t j = 0; j < count; j++) {
+      const uint32_t b = particles[j];
+      const double dx = s.positionX[b] - s.positionX[a];
+      const double dy = s.positionY[b] - s.positionY[a];
+      const double dz = s.positionZ[b] - s.positionZ[a];
+      const double r2 = dx * dx + dy * dy + dz * dz;
+      if (r2 < h2) expected += mass * (h2 - r2) * (h2 - r2) * (h2 - r2);
+    }
+    expected *= cb.xSPH_poly6_constant;
+
+    const double density = fluid.GetDensities()[i];
+    if (std::abs(density - expected) > tolerance * expected)
+      return "particle " + std::to_string(a) + ": density " +
+             std::to_string(density) + " vs " + std::to_string(expected);
+  }
+
+  return std::string();
+}
+
+std::string ParticleValidation::ValidateNeighborGrid(uint32_t particleCount,
+                                                    uint32_t queryCount) {
+  const float side = std::cbrt(particleCount / 8.0f) + 1.0f;
+  std::vector<float> x, y, z;
+  std::vector<uint32_t> slots;
+  scenes::ScatterPoints(particleCount, side, 0x6121D, x, y, z, slots);
+
+  // Every other slot only, so the sorted particles are not the pool.
+  std::vector<uint32_t> particles;
+  for (uint32_t i = 0; i < particleCount; i += 2) particles.push_back(i);
+  const uint32_t count = static_cast<uint32_t>(particles.size());
+
+  // The small table puts many rows into every bucket and wraps rows around
+  // its end.
+  for (uint32_t bucketCount : {64u, 1u << 16}) {
+    NeighborGrid grid;
+    grid.Build(x.data(), y.data(), z.data(), particles.data(), count, 1.0f,
+               bucketCount);
+
+    std::vector<uint32_t> sorted(grid.GetParticles(),
+                                 grid.GetParticles() + count);
+    std::sort(sorted.begin(), sorted.end());
+    if (sorted != particles)
+      return std::to_string(bucketCount) +
+             " buckets: the sorted particles are not the input";
+
+    for (uint32_t q = 0; q < queryCount; q++) {
+      RNG rng;
+      rng.init(0x9E1, q, 0);
+      const float qx = rng.next_float() * side;
+      const float qy = rng.next_float() * side;
+      const float qz = rng.next_float() * side;
+      const float radius = rng.next_float();
+
+      std::vector<uint32_t> found;
+      grid.QueryRadius(qx, qy, qz, radius, [&](uint32_t i, float) {
+        found.push_back(grid.GetParticles()[i]);
+      });
+      std::sort(found.begin(), found.end());
+
+      std::vector<uint32_t> expected;
+      for (uint32_t slot : particles) {
+        const float dx = x[slot] - qx;
+        const float dy = y[slot] - qy;
+        const float dz = z[slot] - qz;
+        if (dx * dx + dy * dy + dz * dz < radius * radius)
+          expected.push_back(slot);
+      }
+
+      if (found != expected)
+        return std::to_string(bucketCount) + " buckets, query " +
+               std::to_string(q) + ": " + std::to_string(found.size()) +
+               " particles found, " + std::to_string(expected.size()) +
+               " expected";
+    }
+  }
+
+  return std::string();
+}
+
+std::string ParticleValidation::ValidateMeshBVH(uint32_t triangleCount,
+                                                uint32_t segmentCount) {
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  scenes::CreateTorus(triangleCount, positions, indices);
+
+  MeshBVH bvh;
+  bvh.AddMesh(positions.data(), indices.data(),
+              static_cast<uint32_t>(indices.size()), float4x4());
+  bvh.Build();
+
+  // Nearest crossing over every triangle, Moeller-Trumbore as in the BVH;
+  // 1 when there is none.
+  auto scan = [&](uint32_t i, const scenes::Segments& segments) {
+    const std::vector<BVHTriangle>& triangles = bvh.GetTriangles();
+    float a[3], d[3];
+    for (uint32_t c = 0; c < 3; c++) {
+      a[c] = segments.from[c][i];
+      d[c] = segments.to[c][i] - a[c];
+    }
+    auto cross = [](const float x[3], const float y[3], float r[3]) {
+      r[0] = x[1] * y[2] - x[2] * y[1];
+      r[1] = x[2] * y[0] - x[0] * y[2];
+      r[2] = x[0] * y[1] - x[1] * y[0];
+    };
+    auto dot = [](const float x[3], const float y[3]) {
+      return x[0] * y[0] + x[1] * y[1] + x[2] * y[2];
+    };
+    float nearest = 1.0f;
+    for (const BVHTriangle& triangle : triangles) {
+      const float v0[3] = {triangle.v0.x, triangle.v0.y, triangle.v0.z};
+      const float e1[3] = {triangle.v1.x - v0[0], triangle.v1.y - v0[1],
+                           triangle.v1.z - v0[2]};
+      const float e2[3] = {triangle.v2.x - v0[0], triangle.v2.y - v0[1],
+                           triangle.v2.z - v0[2]};
+      float p[3], q[3];
+      cross(d, e2, p);
+      const float det = dot(e1, p);
+      if (det * det < 1e-30f) continue;
+      const float inverse = 1.0f / det;
+      const float s[3] = {a[0] - v0[0], a[1] - v0[1], a[2] - v0[2]};
+      const float u = dot(s, p) * inverse;
+      cross(s, e1, q);
+      const float v = dot(d, q) * inverse;
+      const float t = dot(e2, q) * inverse;
+      if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < nearest)
+        nearest = t;
+    }
+    return nearest;
+  };
+
+  // long random segments through the torus and short ones around it
+  scenes::Segments segments;
+  segments.Resize(segmentCount);
+  for (uint32_t i = 0; i < segmentCount; i++) {
+    RNG rng;
+    rng.init(0xB74, i, 0);
+    const float length = i % 2 == 0 ? 4.0f : 0.1f;
+    for (uint32_t c = 0; c < 3; c++) {
+      segments.from[c][i] = (rng.next_float() * 2 - 1) * 2.0f;
+      segments.to[c][i] =
+          segments.from[c][i] + (rng.next_float() - 0.5f) * length;
+    }
+  }
+
+  std::vector<SegmentHit> hits(segmentCount);
+  for (const char* pass : {"built", "refitted"}) {
+    if (pass[0] == 'r') {
+      bvh.SetTransform(0, scenes::RotationZ(0.7f, 0.3f));
+      if (!bvh.Refit()) return "the refit did not see the move";
+    }
+
+    const float* const from[3] = {segments.from[0].data(),
+                                  segments.from[1].data(),
+                                  segments.from[2].data()};
+    const float* const to[3] = {segments.to[0].data(), segments.to[1].data(),
+                                segments.to[2].data()};
+    bvh.IntersectSegments(from, to, segmentCount, hits.data());
+
+    for (uint32_t i = 0; i < segmentCount; i++) {
+      float3 a, b;
+      a.x = from[0][i];
+      a.y = from[1][i];
+      a.z = from[2][i];
+      b.x = to[0][i];
+      b.y = to[1][i];
+      b.z = to[2][i];
+      SegmentHit hit;
+      const bool scalarHit = bvh.IntersectSegment(a, b, hit);
+      const bool packetHit = hits[i].triangle != MeshBVH::NO_HIT;
+
+      const float expected = scan(i, segments);
+      const bool expectedHit = expected < 1.0f;
+      if (scalarHit != expectedHit || packetHit != expectedHit ||
+          (expectedHit && (std::abs(hit.t - expected) > 1e-5f ||
+                           std::abs(hits[i].t - expected) > 1e-5f)))
+        return std::string(pass) + " tree, segment " + std::to_string(i) +
+               ": t " + std::to_string(hit.t) + " one at a time, " +
+               std::to_string(hits[i].t) + " as a vector, " +
+               std::to_string(expected) + " expected";
+    }
+  }
+
+  // Particles rain onto a triangle covering [-20, 20]^2 at y = 0 and must
+  // bounce off or come to rest on it, never fall through.
+  const float ground[9] = {-40.0f, 0.0f, -40.0f, 80.0f, 0.0f,
+                           -40.0f, -40.0f, 0.0f, 80.0f};
+  const uint32_t groundIndices[3] = {0, 1, 2};
+  MeshBVH collider;
+  collider.AddMesh(ground, groundIndices, 3, float4x4());
+  collider.Build();
+
+  ParticleSceneCPU scene;
+  scene.collider = &collider;
+  const float origin[3] = {0.0f, 2.0f, 0.0f};
+  ParticleSystemCPU system;
+  scenes::RainParticles(origin, 4.0f, -1e9f, scene, system);
+
+  const ParticleStorageSoA& storage = system.GetStorage();
+  for (uint32_t p = 0; p < scenes::kRainParticleCount; p++) {
+    if (storage.life[p] <= 0.0f)
+      return "particle " + std::to_string(p) + " died";
+    if (storage.positionY[p] < 0.0f)
+      return "particle " + std::to_string(p) + " fell through to " +
+             std::to_string(storage.positionY[p]);
+  }
+
+  return std::string();
+}
+
+std::string ParticleValidation::ValidateMeshSDF(uint32_t triangleCount,
+                                                uint32_t sampleCount,
+                                                const std::string& cachePath) {
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  scenes::CreateTorus(triangleCount, positions, indices);
+  const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+  MeshSDF field;
+  field.AddMesh(positions.data(), indices.data(), indexCount);
+  field.Build();
+  if (field.IsEmpty()) return "nothing was baked";
+  const float voxelSize = field.GetConstants().voxelSize;
+  const float band = field.GetConstants().band;
+
+  // the field rotated, moved and scaled up twice, so world distances are
+  // twice the local ones
+  const float kScale = 2.0f;
+  float4x4 transform = scenes::RotationZ(0.7f, 0.3f);
+  for (uint32_t r = 0; r < 3; r++)
+    for (uint32_t c = 0; c < 3; c++) transform.m[r][c] *= kScale;
+  SDFColliderSet colliders;
+  colliders.Add(field, transform);
+
+  const float pi = 3.14159265358979323846f;
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    RNG rng;
+    rng.init(0x5DF, i, 0);
+
+    // every other point near the surface, the rest anywhere around it
+    float local[3], normal[3];
+    if (i % 2 == 0) {
+      const float a = 2 * pi * rng.next_float();
+      const float b = 2 * pi * rng.next_float();
+      const float offset = (rng.next_float() * 2 - 1) * 2 * band;
+      const float r = 1.0f + (0.4f + offset) * std::cos(b);
+      local[0] = r * std::cos(a);
+      local[1] = (0.4f + offset) * std::sin(b);
+      local[2] = r * std::sin(a);
+    } else {
+      local[0] = (rng.next_float() * 2 - 1) * 1.6f;
+      local[1] = (rng.next_float() * 2 - 1) * 0.6f;
+      local[2] = (rng.next_float() * 2 - 1) * 1.6f;
+    }
+    const float expected = MeshDistance(positions, indices, local, normal);
+
+    float3 world, worldNormal;
+    float expectedNormal[3];
+    world.x = transform.m[3][0];
+    world.y = transform.m[3][1];
+    world.z = transform.m[3][2];
+    for (uint32_t c = 0; c < 3; c++) expectedNormal[c] = 0.0f;
+    for (uint32_t r = 0; r < 3; r++) {
+      world.x += local[r] * transform.m[r][0];
+      world.y += local[r] * transform.m[r][1];
+      world.z += local[r] * transform.m[r][2];
+      for (uint32_t c = 0; c < 3; c++)
+        expectedNormal[c] += normal[r] * transform.m[r][c] / kScale;
+    }
+    const float distance = colliders.GetDistance(world, &worldNormal) / kScale;
+
+    // A voxel away the direction from the mesh turns where the closest
+    // points lie on different faces. The field interpolates across that
+    // crease, so its distance is only good to a voxel there and its
+    // gradient need not follow the direction.
+    auto nearCrease = [&]() {
+      for (uint32_t c = 0; c < 6; c++) {
+        float offset[3] = {local[0], local[1], local[2]};
+        offset[c / 2] += c % 2 == 0 ? voxelSize : -voxelSize;
+        float direction[3];
+        MeshDistance(positions, indices, offset, direction);
+        if (direction[0] * normal[0] + direction[1] * normal[1] +
+                direction[2] * normal[2] <
+            0.95f)
+          return true;
+      }
+      return false;
+    };
+
+    // well inside the band the field is close to exact and its gradient
+    // points away from the surface; beyond it, it is the band with the
+    // right sign
+    std::string error;
+    if (std::abs(expected) < band - 2 * voxelSize) {
+      const float alignment = worldNormal.x * expectedNormal[0] +
+                              worldNormal.y * expectedNormal[1] +
+                              worldNormal.z * expectedNormal[2];
+      const float distanceError = std::abs(distance - expected);
+      if (distanceError > 0.3f * voxelSize &&
+          (distanceError > voxelSize || !nearCrease()))
+        error = "distance " + std::to_string(distance);
+      else if (alignment < 0.9f && !nearCrease())
+        error = "normal off by " + std::to_string(std::acos(alignment));
+    } else if (std::abs(expected) > band + 2 * voxelSize &&
+               std::abs(distance - std::copysign(band, expected)) > 1e-4f) {
+      error = "distance " + std::to_string(distance);
+    }
+    if (!error.empty())
+      return "point " + std::to_string(i) + ": " + error + ", " +
+             std::to_string(expected) + " expected";
+  }
+
+  // a cache file is only taken for the same meshes and settings
+  if (!field.Save(cachePath)) return "could not write " + cachePath;
+  MeshSDF cached;
+  cached.AddMesh(positions.data(), indices.data(), indexCount);
+  if (!cached.Load(cachePath)) return "could not load " + cachePath;
+  if (cached.GetBricks().size() != field.GetBricks().size() ||
+      cached.GetSamples() != field.GetSamples() ||
+      memcmp(cached.GetBricks().data(), field.GetBricks().data(),
+             field.GetBricks().size() * sizeof(SDFBrick)) != 0 ||
+      memcmp(&cached.GetConstants(), &field.GetConstants(),
+             sizeof(SDFInstance)) != 0)
+    return "the loaded field differs from the saved one";
+  MeshSDF coarser;
+  coarser.AddMesh(positions.data(), indices.data(), indexCount);
+  coarser.GetSettings().resolution /= 2;
+  if (coarser.Load(cachePath))
+    return "a field of other settings was loaded";
+
+  // Particles rain onto the torus where it is, and must bounce off it or
+  // slide down, never end up inside. They fall less than the band per step.
+  SDFColliderSet placed;
+  placed.Add(field, float4x4());
+  ParticleSceneCPU scene;
+  scene.distanceColliders = &placed;
+  const float origin[3] = {1.0f, 1.0f, 0.0f};
+  ParticleSystemCPU system;
+  scenes::RainParticles(origin, 1.0f, -2.0f, scene, system);
+
+  const ParticleStorageSoA& storage = system.GetStorage();
+  for (uint32_t p = 0; p < scenes::kRainParticleCount; p++) {
+    const float position[3] = {storage.positionX[p], storage.positionY[p],
+                               storage.positionZ[p]};
+    const float distance = MeshDistance(positions, indices, position);
+    if (storage.life[p] <= 0.0f)
+      return "particle " + std::to_string(p) + " died";
+    if (distance < -0.25f * voxelSize)
+      return "particle " + std::to_string(p) + " ended up " +
+             std::to_string(-distance) + " inside";
+  }
+
+  return std::string();
+}
+
+std::string ParticleValidation::ValidateForceFields(uint32_t sampleCount) {
+  // points over the cube and around it, so every falloff reaches zero
+  const float side = 10.0f;
+  const std::vector<ForceFieldParams> fields = scenes::CreateForceFields(side);
+  const uint32_t fieldCount = static_cast<uint32_t>(fields.size());
+  std::vector<float> x, y, z;
+  std::vector<uint32_t> slots;
+  scenes::ScatterPoints(sampleCount, 2 * side, 0xF1E1D, x, y, z, slots);
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    x[i] -= side / 2;
+    y[i] -= side / 2;
+    z[i] -= side / 2;
+  }
+  std::vector<float> ax(sampleCount), ay(sampleCount), az(sampleCount);
+  const float* const position[3] = {x.data(), y.data(), z.data()};
+  float* const acceleration[3] = {ax.data(), ay.data(), az.data()};
+  EvaluateForceFields(fields.data(), fieldCount, position, sampleCount,
+                      acceleration);
+
+  double curlSq = 0.0;
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    const float p[3] = {x[i], y[i], z[i]};
+    float single[3] = {0.0f, 0.0f, 0.0f};
+    AccumulateForceFields(fields.data(), fieldCount, p, single);
+    if (std::abs(single[0] - ax[i]) > 1e-5f ||
+        std::abs(single[1] - ay[i]) > 1e-5f ||
+        std::abs(single[2] - az[i]) > 1e-5f)
+      return "point " + std::to_string(i) + ": " + std::to_string(ax[i]) +
+             " in a vector, " + std::to_string(single[0]) + " alone";
+
+    for (const ForceFieldParams& field : fields) {
+      float a[3] = {0.0f, 0.0f, 0.0f};
+      AccumulateForceFields(&field, 1, p, a);
+
+      std::string error;
+      if (field.type == static_cast<uint32_t>(ForceFieldType::Turbulence)) {
+        // over a hundredth of a noise cell
+        const float h = 0.01f / field.frequency;
+        double divergence = 0.0;
+        for (uint32_t c = 0; c < 3; c++) {
+          float ahead[3] = {p[0], p[1], p[2]};
+          float behind[3] = {p[0], p[1], p[2]};
+          ahead[c] += h;
+          behind[c] -= h;
+          float aheadForce[3] = {0.0f, 0.0f, 0.0f};
+          float behindForce[3] = {0.0f, 0.0f, 0.0f};
+          AccumulateForceFields(&field, 1, ahead, aheadForce);
+          AccumulateForceFields(&field, 1, behind, behindForce);
+          divergence += (aheadForce[c] - behindForce[c]) / (2.0 * h);
+        }
+        if (std::abs(divergence) > 0.02 * field.strength * field.frequency)
+          error = "divergence " + std::to_string(divergence);
+        curlSq += (a[0] * a[0] + a[1] * a[1] + a[2] * a[2]) /
+                  (field.strength * field.strength);
+      } else {
+        double expected[3];
+        ExpectedForce(field, p, expected);
+        for (uint32_t c = 0; c < 3 && error.empty(); c++) {
+          if (std::abs(a[c] - expected[c]) > 1e-4 * std::abs(field.strength))
+            error = std::to_string(a[c]) + " vs " +
+                    std::to_string(expected[c]);
+        }
+      }
+      if (!error.empty())
+        return "point " + std::to_string(i) + ", " +
+               scenes::ForceFieldName(field.type) + ": " + error;
+    }
+  }
+  const double rms = std::sqrt(curlSq / sampleCount);
+  if (rms < 0.5 || rms > 1.5)
+    return "turbulence of RMS length " + std::to_string(rms);
+
+  // Two emitters whose winds blow opposite ways; their emit ranges meet
+  // inside a vector, and 33 particles leave a remainder. Against a step
+  // without the winds, every velocity must change by the wind of its
+  // emitter.
+  const float strengths[2] = {3.0f, -3.0f};
+  const std::vector<uint32_t> emitCounts = {13, 20};
+  const uint32_t particleCount = emitCounts[0] + emitCounts[1];
+  std::vector<ParticleEmitter> emitters(2);
+  for (uint32_t e = 0; e < 2; e++) {
+    ParticleForceField wind;
+    wind.type = ForceFieldType::Wind;
+    wind.direction[0] = 1.0f;
+    wind.direction[1] = 0.0f;
+    wind.strength = strengths[e];
+    emitters[e].force_fields.push_back(wind);
+  }
+  ParticleSystemCPU system;
+  scenes::RunEmitters(emitters, emitCounts, 1, -1e9f, ParticleSceneCPU(),
+                      system);
+  for (ParticleEmitter& emitter : emitters) emitter.force_fields.clear();
+  ParticleSystemCPU still;
+  scenes::RunEmitters(emitters, emitCounts, 1, -1e9f, ParticleSceneCPU(),
+                      still);
+
+  if (system.GetStatistics().aliveCount_afterSimulation != particleCount)
+    return std::to_string(system.GetStatistics().aliveCount_afterSimulation) +
+           " of " + std::to_string(particleCount) + " particles alive";
+  const ParticleStorageSoA& s = system.GetStorage();
+  const ParticleStorageSoA& before = still.GetStorage();
+  const float dt = ParticleWorldSettings().fixed_timestep;
+  for (uint32_t p = 0; p < particleCount; p++) {
+    const float expected = strengths[s.emitterIndex[p]] * dt;
+    const float pushed[3] = {s.velocityX[p] - before.velocityX[p],
+                             s.velocityY[p] - before.velocityY[p],
+                             s.velocityZ[p] - before.velocityZ[p]};
+    if (std::abs(pushed[0] - expected) > 1e-4f ||
+        std::abs(pushed[1]) > 1e-4f || std::abs(pushed[2]) > 1e-4f)
+      return "particle " + std::to_string(p) + " of emitter " +
+             std::to_string(s.emitterIndex[p]) + " pushed by " +
+             std::to_string(pushed[0]) + ", " + std::to_string(expected) +
+             " expected";
+  }
+
+  return std::string();
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace my {
+// Correctness checks for the particle backends and the structures they
+// build on, against brute-force references over the scenes ParticleBenchmark
+// times. Each returns an empty string on success, otherwise what went wrong
+// first. They run on the current job system, so they must not be called
+// from inside a job.
+class ParticleValidation {
+ public:
+  // Builds frameCount frames of stepsPerFrame steps each, shaped like
+  // DoTest() with a collider that moves every frame, compiles them and
+  // replays every schedule on the null device without a state cache. Fails
+  // when RenderGraph::Validate() does, or when the barriers recorded differ
+  // from the compiled ones, naming the frame.
+  static std::string ValidateGPUFrames(uint32_t maxParticles,
+                                       uint32_t emitterCount,
+                                       uint32_t frameCount,
+                                       uint32_t stepsPerFrame);
+
+  // Checks MetaballGrid::GetSurface() against GetDistance(), GetColor() and
+  // finite differences of GetDistance() at sampleCount random points near
+  // the surface of scenes::CreateMetaballBlob(). Fails on the first sample
+  // off by more than the tolerance.
+  static std::string ValidateMetaballSurface(uint32_t sphereCount,
+                                             uint32_t sampleCount,
+                                             float smoothing);
+
+  // Checks the densities ParticleFluidCPU finds through its neighbor grid
+  // against sums over every pair, for scenes::CreateFluidBlock() with
+  // particleCount particles after one step. Fails on the first particle off
+  // by more than the tolerance.
+  static std::string ValidateFluidDensity(uint32_t particleCount);
+
+  // Checks NeighborGrid radius queries against a scan of every particle, for
+  // particleCount particles scattered over a cube and queryCount random
+  // queries, with a small and a large bucket table. Fails on the first query
+  // that differs.
+  static std::string ValidateNeighborGrid(uint32_t particleCount,
+                                          uint32_t queryCount);
+
+  // Checks MeshBVH segment queries, one at a time and as SIMD vectors,
+  // against a scan of every triangle, for scenes::CreateTorus() and
+  // segmentCount random segments, before and after a refit. Then drops
+  // particles onto a triangle with ParticleSystemCPU and checks none ends
+  // up below it.
+  static std::string ValidateMeshBVH(uint32_t triangleCount,
+                                     uint32_t segmentCount);
+
+  // Checks the distance field baked from scenes::CreateTorus() against the
+  // exact distance to its triangles, so any triangleCount works, at
+  // sampleCount random points, in the band and out of it, placed by an
+  // SDFColliderSet that rotates, moves and scales it. Then saves and loads
+  // it through cachePath, and drops particles onto it with
+  // ParticleSystemCPU, checking none ends up inside.
+  static std::string ValidateMeshSDF(uint32_t triangleCount,
+                                     uint32_t sampleCount,
+                                     const std::string& cachePath);
+
+  // Checks scenes::CreateForceFields() at sampleCount random points: SIMD
+  // vectors against single particles, attractor, vortex and wind against
+  // their closed forms, and the turbulence for being divergence free by
+  // central differences. Then simulates two emitters whose winds blow
+  // opposite ways with ParticleSystemCPU, with vectors holding particles of
+  // both, and checks every particle was pushed by its own emitter's field.
+  static std::string ValidateForceFields(uint32_t sampleCount);
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+
+// Thin render hardware interface over the parts of D3D11 the particle system
+// uses: buffers, buffer views, shaders, binding, dispatch, draw and map. The
+// D3D11 backend (RHID3D11.h) drives the real GPU, the null backend (RHINull.h)
+// records the command stream so engine logic can run and be measured without
+// one. Nothing in here may depend on Win32/D3D headers.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace my {
+namespace rhi {
+enum class Usage : uint8_t {
+  Default,  // GPU read/write, updated with UpdateBuffer or copies
+  Dynamic,  // CPU writes with Map(WriteDiscard), GPU reads
+  Staging,  // GPU copies into it, CPU reads with Map(Read)
+};
+
+// Combinable BufferDesc::bindFlags.
+enum BindFlag : uint32_t {
+  BIND_VERTEX_BUFFER = 1 << 0,
+  BIND_INDEX_BUFFER = 1 << 1,
+  BIND_CONSTANT_BUFFER = 1 << 2,
+  BIND_SHADER_RESOURCE = 1 << 3,
+  BIND_UNORDERED_ACCESS = 1 << 4,
+};
+
+// Combinable BufferDesc::miscFlags.
+enum MiscFlag : uint32_t {
+  MISC_STRUCTURED = 1 << 0,     // StructuredBuffer with BufferDesc::stride
+  MISC_RAW_VIEWS = 1 << 1,      // ByteAddressBuffer views are allowed
+  MISC_INDIRECT_ARGS = 1 << 2,  // arguments of indirect dispatches and draws
+};
+
+struct BufferDesc {
+  uint32_t size = 0;    // in bytes
+  uint32_t stride = 0;  // structured buffers only
+  Usage usage = Usage::Default;
+  uint32_t bindFlags = 0;
+  uint32_t miscFlags = 0;
+};
+
+// Elements a view covers: structures of a structured buffer, 32 bit words of
+// a raw view.
+struct BufferViewDesc {
+  uint32_t firstElement = 0;
+  uint32_t numElements = 0;
+  bool raw = false;
+};
+
+enum class ShaderStage : uint8_t { Vertex, Geometry, Pixel, Compute };
+static const uint32_t SHADER_STAGE_COUNT = 4;
+
+enum class PrimitiveTopology : uint8_t { PointList, TriangleList };
+
+enum class MapMode : uint8_t { Read, WriteDiscard };
+
+// Resources are owned through shared pointers, like the ComPtrs they wrap:
+// the last reference releases the backend object.
+class Buffer {
+ public:
+  explicit Buffer(const BufferDesc& desc) : m_desc(desc) {}
+  virtual ~Buffer() = default;
+
+  const BufferDesc& GetDesc() const { return m_desc; }
+
+ private:
+  BufferDesc m_desc;
+};
+
+// Views keep the buffer they view alive and report it, so binding trackers
+// can tell two views of one buffer apart from views of different ones.
+class ShaderResourceView {
+ public:
+  explicit ShaderResourceView(const std::shared_ptr<Buffer>& buffer)
+      : m_buffer(buffer) {}
+  virtual ~ShaderResourceView() = default;
+
+  const Buffer* GetBuffer() const { return m_buffer.get(); }
+
+ private:
+  std::shared_ptr<Buffer> m_buffer;
+};
+
+class UnorderedAccessView {
+ public:
+  explicit UnorderedAccessView(const std::shared_ptr<Buffer>& buffer)
+      : m_buffer(buffer) {}
+  virtual ~UnorderedAccessView() = default;
+
+  const Buffer* GetBuffer() const { return m_buffer.get(); }
+
+ private:
+  std::shared_ptr<Buffer> m_buffer;
+};
+
+class Shader {
+ public:
+  explicit Shader(ShaderStage stage) : m_stage(stage) {}
+  virtual ~Shader() = default;
+
+  ShaderStage GetStage() const { return m_stage; }
+
+ private:
+  ShaderStage m_stage;
+};
+
+using BufferPtr = std::shared_ptr<Buffer>;
+using SRVPtr = std::shared_ptr<ShaderResourceView>;
+using UAVPtr = std::shared_ptr<UnorderedAccessView>;
+using ShaderPtr = std::shared_ptr<Shader>;
+
+// Device and immediate context in one, with D3D11 semantics: commands execute
+// in order, and a resource bound for writing must be unbound (Barrier())
+// before a later command reads it.
+class Device {
+ public:
+  virtual ~Device() = default;
+
+  // Resources; nullptr on failure. initData covers the whole buffer.
+  virtual BufferPtr CreateBuffer(const BufferDesc& desc,
+                                 const void* initData = nullptr) = 0;
+  virtual SRVPtr CreateShaderResourceView(const BufferPtr& buffer,
+                                          const BufferViewDesc& desc) = 0;
+  virtual UAVPtr CreateUnorderedAccessView(const BufferPtr& buffer,
+                                           const BufferViewDesc& desc) = 0;
+  virtual ShaderPtr CreateShader(ShaderStage stage, const void* byteCode,
+                                 size_t byteCodeSize) = 0;
+
+  // Whole-buffer CPU access. With doNotWait, a read of a buffer the GPU has
+  // not finished with returns nullptr instead of stalling.
+  virtual void* Map(const BufferPtr& buffer, MapMode mode,
+                    bool doNotWait = false) = 0;
+  virtual void Unmap(const BufferPtr& buffer) = 0;
+
+  // Writes size bytes at offset of a Default buffer.
+  virtual void UpdateBuffer(const BufferPtr& buffer, const void* data,
+                            uint32_t offset, uint32_t size) = 0;
+  virtual void CopyBuffer(const BufferPtr& dst, uint32_t dstOffset,
+                          const BufferPtr& src, uint32_t srcOffset,
+                          uint32_t size) = 0;
+
+  // Binding; nullptr unbinds. UAVs are bound to the compute stage.
+  virtual void SetShader(ShaderStage stage, const ShaderPtr& shader) = 0;
+  virtual void SetConstantBuffer(ShaderStage stage, uint32_t slot,
+                                 const BufferPtr& buffer) = 0;
+  virtual void SetShaderResource(ShaderStage stage, uint32_t slot,
+                                 const SRVPtr& view) = 0;
+  virtual void SetUnorderedAccess(uint32_t slot, const UAVPtr& view) = 0;
+  virtual void SetPrimitiveTopology(PrimitiveTopology topology) = 0;
+  // No input layout and no vertex or index buffers: vertex shaders fetch
+  // their data with SV_VertexID.
+  virtual void ClearVertexInput() = 0;
+
+  // Unbinds every shader resource and unordered access view, so the next
+  // pass may read what the last one wrote. Marks the end of a pass; the
+  // StateCache resolves hazards when views are bound instead and skips it.
+  virtual void Barrier() = 0;
+
+  virtual void Dispatch(uint32_t x, uint32_t y, uint32_t z) = 0;
+  virtual void DispatchIndirect(const BufferPtr& args, uint32_t offset) = 0;
+  virtual void Draw(uint32_t vertexCount, uint32_t startVertex) = 0;
+  virtual void DrawInstancedIndirect(const BufferPtr& args,
+                                     uint32_t offset) = 0;
+
+  virtual void Flush() = 0;
+};
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "RHIConstantBufferCache.h"
+
+#include <cstring>
+
+namespace my {
+namespace rhi {
+BufferPtr ConstantBufferCache::Create(uint32_t size, const void* initData) {
+  BufferDesc desc;
+  desc.size = (size + 15) & ~15u;
+  desc.usage = Usage::Dynamic;
+  desc.bindFlags = BIND_CONSTANT_BUFFER;
+
+  // initData covers the whole buffer
+  std::vector<uint8_t> contents;
+  if (initData != nullptr && desc.size != size) {
+    contents.assign(desc.size, 0);
+    memcpy(contents.data(), initData, size);
+    initData = contents.data();
+  }
+
+  BufferPtr buffer = m_device->CreateBuffer(desc, initData);
+  if (buffer == nullptr) return nullptr;
+
+  const uint32_t index = AllocateShadow(desc.size);
+  Shadow& shadow = m_shadows[index];
+  shadow.buffer = buffer;
+  shadow.valid = initData != nullptr;
+  if (shadow.valid) memcpy(&m_arena[shadow.offset], initData, desc.size);
+
+  m_shadowOf[buffer.get()] = index;
+  return buffer;
+}
+
+bool ConstantBufferCache::Update(const BufferPtr& buffer, const void* data) {
+  const uint32_t size = buffer->GetDesc().size;
+
+  Shadow* shadow = nullptr;
+  auto it = m_shadowOf.find(buffer.get());
+  if (it != m_shadowOf.end() && m_shadows[it->second].buffer.lock() == buffer)
+    shadow = &m_shadows[it->second];
+
+  if (shadow != nullptr && shadow->valid &&
+      memcmp(&m_arena[shadow->offset], data, size) == 0) {
+    m_stats.skippedBytes += size;
+    m_stats.skippedUploads++;
+    return false;
+  }
+
+  void* mapped = m_device->Map(buffer, MapMode::WriteDiscard);
+  if (mapped == nullptr) return false;
+  memcpy(mapped, data, size);
+  m_device->Unmap(buffer);
+
+  if (shadow != nullptr) {
+    memcpy(&m_arena[shadow->offset], data, size);
+    shadow->valid = true;
+  }
+
+  m_stats.uploadedBytes += size;
+  m_stats.uploads++;
+  return true;
+}
+
+void ConstantBufferCache::Invalidate(const BufferPtr& buffer) {
+  auto it = m_shadowOf.find(buffer.get());
+  if (it != m_shadowOf.end()) m_shadows[it->second].valid = false;
+}
+
+void ConstantBufferCache::EndFrame() {
+  m_lastFrame = m_stats;
+  m_stats = Stats();
+}
+
+uint32_t ConstantBufferCache::AllocateShadow(uint32_t size) {
+  for (uint32_t i = 0; i < m_shadows.size(); i++) {
+    Shadow& shadow = m_shadows[i];
+    if (shadow.size != size || !shadow.buffer.expired()) continue;
+
+    // the address of a released buffer may come back, for another buffer
+    for (auto it = m_shadowOf.begin(); it != m_shadowOf.end();) {
+      if (it->second == i)
+        it = m_shadowOf.erase(it);
+      else
+        ++it;
+    }
+    shadow.valid = false;
+    return i;
+  }
+
+  Shadow shadow;
+  shadow.offset = static_cast<uint32_t>(m_arena.size());
+  shadow.size = size;
+  m_arena.resize(m_arena.size() + size);
+  m_shadows.push_back(shadow);
+  return static_cast<uint32_t>(m_shadows.size() - 1);
+}
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "RHI.h"
+
+namespace my {
+namespace rhi {
+// Uploads to dynamic constant buffers that skip unchanged contents. Every
+// buffer created here has a shadow of what was last uploaded to it, and
+// Update() only maps the buffer when the new contents differ. The shadows
+// are suballocated from one arena, 16 byte aligned like the buffers.
+//
+// D3D11 at feature level 11_0 can neither bind a constant buffer at an
+// offset nor map one with NO_OVERWRITE, so each constant buffer stays its
+// own Map(WriteDiscard) target; the arena only holds the CPU side.
+class ConstantBufferCache {
+ public:
+  struct Stats {
+    uint64_t uploadedBytes = 0;
+    uint64_t skippedBytes = 0;  // unchanged, not uploaded
+    uint32_t uploads = 0;
+    uint32_t skippedUploads = 0;
+  };
+
+  explicit ConstantBufferCache(Device* device) : m_device(device) {}
+
+  // Dynamic constant buffer of size bytes, rounded up to 16. With initData
+  // it starts out with (and remembers) those contents. nullptr on failure.
+  BufferPtr Create(uint32_t size, const void* initData = nullptr);
+
+  // Uploads the whole buffer from data unless it already holds exactly
+  // that; true when it uploaded. Buffers not created here are always
+  // uploaded.
+  bool Update(const BufferPtr& buffer, const void* data);
+
+  // The next Update() of buffer uploads, e.g. after something else wrote it.
+  void Invalidate(const BufferPtr& buffer);
+
+  // Stats of the frame in progress; EndFrame() moves them to
+  // GetLastFrameStats() and starts over.
+  const Stats& GetStats() const { return m_stats; }
+  const Stats& GetLastFrameStats() const { return m_lastFrame; }
+  void EndFrame();
+
+  // Bytes of the shadow arena, including slots of released buffers waiting
+  // for a buffer of the same size.
+  size_t GetArenaSize() const { return m_arena.size(); }
+
+ private:
+  struct Shadow {
+    std::weak_ptr<Buffer> buffer;
+    uint32_t offset = 0;  // in m_arena
+    uint32_t size = 0;
+    bool valid = false;   // the arena holds the buffer's contents
+  };
+
+  // Shadow slot of size bytes, reusing one of a released buffer.
+  uint32_t AllocateShadow(uint32_t size);
+
+  Device* m_device;
+
+  std::vector<uint8_t> m_arena;
+  std::vector<Shadow> m_shadows;
+  std::unordered_map<const Buffer*, uint32_t> m_shadowOf;
+
+  Stats m_stats;
+  Stats m_lastFrame;
+};
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
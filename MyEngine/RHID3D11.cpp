@@ -0,0 +1,337 @@
+#include "RHID3D11.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace my {
+namespace rhi {
+namespace {
+class D3D11Buffer : public Buffer {
+ public:
+  using Buffer::Buffer;
+
+  ComPtr<ID3D11Buffer> buffer;
+};
+
+class D3D11ShaderResourceView : public ShaderResourceView {
+ public:
+  using ShaderResourceView::ShaderResourceView;
+
+  ComPtr<ID3D11ShaderResourceView> view;
+};
+
+class D3D11UnorderedAccessView : public UnorderedAccessView {
+ public:
+  using UnorderedAccessView::UnorderedAccessView;
+
+  ComPtr<ID3D11UnorderedAccessView> view;
+};
+
+class D3D11Shader : public Shader {
+ public:
+  using Shader::Shader;
+
+  ComPtr<ID3D11VertexShader> vertexShader;
+  ComPtr<ID3D11GeometryShader> geometryShader;
+  ComPtr<ID3D11PixelShader> pixelShader;
+  ComPtr<ID3D11ComputeShader> computeShader;
+};
+
+D3D11_BUFFER_DESC ToD3D11(const BufferDesc& desc) {
+  D3D11_BUFFER_DESC bd = {};
+  bd.ByteWidth = desc.size;
+  bd.StructureByteStride = desc.stride;
+
+  switch (desc.usage) {
+    case Usage::Default:
+      bd.Usage = D3D11_USAGE_DEFAULT;
+      break;
+    case Usage::Dynamic:
+      bd.Usage = D3D11_USAGE_DYNAMIC;
+      bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+      break;
+    case Usage::Staging:
+      bd.Usage = D3D11_USAGE_STAGING;
+      bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+      break;
+  }
+
+  if (desc.bindFlags & BIND_VERTEX_BUFFER)
+    bd.BindFlags |= D3D11_BIND_VERTEX_BUFFER;
+  if (desc.bindFlags & BIND_INDEX_BUFFER)
+    bd.BindFlags |= D3D11_BIND_INDEX_BUFFER;
+  if (desc.bindFlags & BIND_CONSTANT_BUFFER)
+    bd.BindFlags |= D3D11_BIND_CONSTANT_BUFFER;
+  if (desc.bindFlags & BIND_SHADER_RESOURCE)
+    bd.BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+  if (desc.bindFlags & BIND_UNORDERED_ACCESS)
+    bd.BindFlags |= D3D11_BIND_UNORDERED_ACCESS;
+
+  if (desc.miscFlags & MISC_STRUCTURED)
+    bd.MiscFlags |= D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+  if (desc.miscFlags & MISC_RAW_VIEWS)
+    bd.MiscFlags |= D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+  if (desc.miscFlags & MISC_INDIRECT_ARGS)
+    bd.MiscFlags |= D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+
+  return bd;
+}
+
+D3D11Shader* ToD3D11(const ShaderPtr& shader) {
+  return static_cast<D3D11Shader*>(shader.get());
+}
+}  // namespace
+
+D3D11Device::D3D11Device(const ComPtr<ID3D11Device>& device,
+                         const ComPtr<ID3D11DeviceContext>& context)
+    : m_device(device), m_context(context) {}
+
+BufferPtr D3D11Device::CreateBuffer(const BufferDesc& desc,
+                                    const void* initData) {
+  const D3D11_BUFFER_DESC bd = ToD3D11(desc);
+
+  D3D11_SUBRESOURCE_DATA data = {};
+  data.pSysMem = initData;
+
+  auto buffer = std::make_shared<D3D11Buffer>(desc);
+  HRESULT hr = m_device->CreateBuffer(&bd, initData ? &data : nullptr,
+                                      buffer->buffer.GetAddressOf());
+  if (FAILED(hr)) return nullptr;
+  return buffer;
+}
+
+SRVPtr D3D11Device::CreateShaderResourceView(const BufferPtr& buffer,
+                                             const BufferViewDesc& desc) {
+  if (buffer == nullptr) return nullptr;
+
+  D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+  if (desc.raw) {
+    srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+    srvDesc.BufferEx.FirstElement = desc.firstElement;
+    srvDesc.BufferEx.NumElements = desc.numElements;
+    srvDesc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+  } else {
+    srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    srvDesc.Buffer.FirstElement = desc.firstElement;
+    srvDesc.Buffer.NumElements = desc.numElements;
+  }
+
+  auto view = std::make_shared<D3D11ShaderResourceView>(buffer);
+  HRESULT hr = m_device->CreateShaderResourceView(
+      GetNative(buffer), &srvDesc, view->view.GetAddressOf());
+  if (FAILED(hr)) return nullptr;
+  return view;
+}
+
+UAVPtr D3D11Device::CreateUnorderedAccessView(const BufferPtr& buffer,
+                                              const BufferViewDesc& desc) {
+  if (buffer == nullptr) return nullptr;
+
+  D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+  uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+  uavDesc.Buffer.FirstElement = desc.firstElement;
+  uavDesc.Buffer.NumElements = desc.numElements;
+  if (desc.raw) {
+    uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+  } else {
+    uavDesc.Format = DXGI_FORMAT_UNKNOWN;
+  }
+
+  auto view = std::make_shared<D3D11UnorderedAccessView>(buffer);
+  HRESULT hr = m_device->CreateUnorderedAccessView(
+      GetNative(buffer), &uavDesc, view->view.GetAddressOf());
+  if (FAILED(hr)) return nullptr;
+  return view;
+}
+
+ShaderPtr D3D11Device::CreateShader(ShaderStage stage, const void* byteCode,
+                                    size_t byteCodeSize) {
+  auto shader = std::make_shared<D3D11Shader>(stage);
+
+  HRESULT hr = E_FAIL;
+  switch (stage) {
+    case ShaderStage::Vertex:
+      hr = m_device->CreateVertexShader(byteCode, byteCodeSize, nullptr,
+                                        shader->vertexShader.GetAddressOf());
+      break;
+    case ShaderStage::Geometry:
+      hr = m_device->CreateGeometryShader(
+          byteCode, byteCodeSize, nullptr,
+          shader->geometryShader.GetAddressOf());
+      break;
+    case ShaderStage::Pixel:
+      hr = m_device->CreatePixelShader(byteCode, byteCodeSize, nullptr,
+                                       shader->pixelShader.GetAddressOf());
+      break;
+    case ShaderStage::Compute:
+      hr = m_device->CreateComputeShader(byteCode, byteCodeSize, nullptr,
+                                         shader->computeShader.GetAddressOf());
+      break;
+  }
+  if (FAILED(hr)) return nullptr;
+  return shader;
+}
+
+void* D3D11Device::Map(const BufferPtr& buffer, MapMode mode, bool doNotWait) {
+  D3D11_MAPPED_SUBRESOURCE mappedResource = {};
+  HRESULT hr = m_context->Map(
+      GetNative(buffer), 0,
+      mode == MapMode::Read ? D3D11_MAP_READ : D3D11_MAP_WRITE_DISCARD,
+      doNotWait ? D3D11_MAP_FLAG_DO_NOT_WAIT : 0, &mappedResource);
+  if (FAILED(hr)) return nullptr;  // DXGI_ERROR_WAS_STILL_DRAWING
+  return mappedResource.pData;
+}
+
+void D3D11Device::Unmap(const BufferPtr& buffer) {
+  m_context->Unmap(GetNative(buffer), 0);
+}
+
+void D3D11Device::UpdateBuffer(const BufferPtr& buffer, const void* data,
+                               uint32_t offset, uint32_t size) {
+  D3D11_BOX box = {};
+  box.left = offset;
+  box.right = offset + size;
+  box.bottom = 1;
+  box.back = 1;
+  m_context->UpdateSubresource(GetNative(buffer), 0, &box, data, 0, 0);
+}
+
+void D3D11Device::CopyBuffer(const BufferPtr& dst, uint32_t dstOffset,
+                             const BufferPtr& src, uint32_t srcOffset,
+                             uint32_t size) {
+  D3D11_BOX box = {};
+  box.left = srcOffset;
+  box.right = srcOffset + size;
+  box.bottom = 1;
+  box.back = 1;
+  m_context->CopySubresourceRegion(GetNative(dst), 0, dstOffset, 0, 0,
+                                   GetNative(src), 0, &box);
+}
+
+void D3D11Device::SetShader(ShaderStage stage, const ShaderPtr& shader) {
+  D3D11Shader* native = ToD3D11(shader);
+  switch (stage) {
+    case ShaderStage::Vertex:
+      m_context->VSSetShader(native ? native->vertexShader.Get() : nullptr,
+                             nullptr, 0);
+      break;
+    case ShaderStage::Geometry:
+      m_context->GSSetShader(native ? native->geometryShader.Get() : nullptr,
+                             nullptr, 0);
+      break;
+    case ShaderStage::Pixel:
+      m_context->PSSetShader(native ? native->pixelShader.Get() : nullptr,
+                             nullptr, 0);
+      break;
+    case ShaderStage::Compute:
+      m_context->CSSetShader(native ? native->computeShader.Get() : nullptr,
+                             nullptr, 0);
+      break;
+  }
+}
+
+void D3D11Device::SetConstantBuffer(ShaderStage stage, uint32_t slot,
+                                    const BufferPtr& buffer) {
+  ID3D11Buffer* native = GetNative(buffer);
+  switch (stage) {
+    case ShaderStage::Vertex:
+      m_context->VSSetConstantBuffers(slot, 1, &native);
+      break;
+    case ShaderStage::Geometry:
+      m_context->GSSetConstantBuffers(slot, 1, &native);
+      break;
+    case ShaderStage::Pixel:
+      m_context->PSSetConstantBuffers(slot, 1, &native);
+      break;
+    case ShaderStage::Compute:
+      m_context->CSSetConstantBuffers(slot, 1, &native);
+      break;
+  }
+}
+
+void D3D11Device::SetShaderResource(ShaderStage stage, uint32_t slot,
+                                    const SRVPtr& view) {
+  ID3D11ShaderResourceView* native = GetNative(view);
+  switch (stage) {
+    case ShaderStage::Vertex:
+      m_context->VSSetShaderResources(slot, 1, &native);
+      break;
+    case ShaderStage::Geometry:
+      m_context->GSSetShaderResources(slot, 1, &native);
+      break;
+    case ShaderStage::Pixel:
+      m_context->PSSetShaderResources(slot, 1, &native);
+      break;
+    case ShaderStage::Compute:
+      m_context->CSSetShaderResources(slot, 1, &native);
+      break;
+  }
+}
+
+void D3D11Device::SetUnorderedAccess(uint32_t slot, const UAVPtr& view) {
+  ID3D11UnorderedAccessView* native = GetNative(view);
+  m_context->CSSetUnorderedAccessViews(slot, 1, &native, nullptr);
+}
+
+void D3D11Device::SetPrimitiveTopology(PrimitiveTopology topology) {
+  m_context->IASetPrimitiveTopology(
+      topology == PrimitiveTopology::PointList
+          ? D3D11_PRIMITIVE_TOPOLOGY_POINTLIST
+          : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void D3D11Device::ClearVertexInput() {
+  m_context->IASetInputLayout(nullptr);
+  m_context->IASetVertexBuffers(0, 0, nullptr, nullptr, nullptr);
+  m_context->IASetIndexBuffer(nullptr, DXGI_FORMAT_UNKNOWN, 0);
+}
+
+void D3D11Device::Barrier() {
+  const uint32_t numSRVs = D3D11_COMMONSHADER_INPUT_RESOURCE_REGISTER_COUNT;
+  ID3D11ShaderResourceView* nullSRV[numSRVs] = {nullptr};
+  m_context->CSSetShaderResources(0, numSRVs, nullSRV);
+  m_context->VSSetShaderResources(0, numSRVs, nullSRV);
+  m_context->GSSetShaderResources(0, numSRVs, nullSRV);
+
+  const uint32_t numUAVs = D3D11_PS_CS_UAV_REGISTER_COUNT;
+  ID3D11UnorderedAccessView* nullUAV[numUAVs] = {nullptr};
+  m_context->CSSetUnorderedAccessViews(0, numUAVs, nullUAV, nullptr);
+}
+
+void D3D11Device::Dispatch(uint32_t x, uint32_t y, uint32_t z) {
+  m_context->Dispatch(x, y, z);
+}
+
+void D3D11Device::DispatchIndirect(const BufferPtr& args, uint32_t offset) {
+  m_context->DispatchIndirect(GetNative(args), offset);
+}
+
+void D3D11Device::Draw(uint32_t vertexCount, uint32_t startVertex) {
+  m_context->Draw(vertexCount, startVertex);
+}
+
+void D3D11Device::DrawInstancedIndirect(const BufferPtr& args,
+                                        uint32_t offset) {
+  m_context->DrawInstancedIndirect(GetNative(args), offset);
+}
+
+void D3D11Device::Flush() { m_context->Flush(); }
+
+ID3D11Buffer* D3D11Device::GetNative(const BufferPtr& buffer) {
+  return buffer ? static_cast<D3D11Buffer*>(buffer.get())->buffer.Get()
+                : nullptr;
+}
+
+ID3D11ShaderResourceView* D3D11Device::GetNative(const SRVPtr& view) {
+  return view ? static_cast<D3D11ShaderResourceView*>(view.get())->view.Get()
+              : nullptr;
+}
+
+ID3D11UnorderedAccessView* D3D11Device::GetNative(const UAVPtr& view) {
+  return view ? static_cast<D3D11UnorderedAccessView*>(view.get())->view.Get()
+              : nullptr;
+}
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
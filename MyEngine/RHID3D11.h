@@ -0,0 +1,62 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "RHI.h"
+
+namespace my {
+namespace rhi {
+// Backend over a D3D11 device and its immediate context. Engine code that is
+// not ported to the RHI keeps using the same context, and reaches the native
+// objects of RHI resources through the GetNative() accessors.
+class D3D11Device : public Device {
+ public:
+  D3D11Device(const Microsoft::WRL::ComPtr<ID3D11Device>& device,
+              const Microsoft::WRL::ComPtr<ID3D11DeviceContext>& context);
+
+  BufferPtr CreateBuffer(const BufferDesc& desc,
+                         const void* initData = nullptr) override;
+  SRVPtr CreateShaderResourceView(const BufferPtr& buffer,
+                                  const BufferViewDesc& desc) override;
+  UAVPtr CreateUnorderedAccessView(const BufferPtr& buffer,
+                                   const BufferViewDesc& desc) override;
+  ShaderPtr CreateShader(ShaderStage stage, const void* byteCode,
+                         size_t byteCodeSize) override;
+
+  void* Map(const BufferPtr& buffer, MapMode mode,
+            bool doNotWait = false) override;
+  void Unmap(const BufferPtr& buffer) override;
+  void UpdateBuffer(const BufferPtr& buffer, const void* data, uint32_t offset,
+                    uint32_t size) override;
+  void CopyBuffer(const BufferPtr& dst, uint32_t dstOffset,
+                  const BufferPtr& src, uint32_t srcOffset,
+                  uint32_t size) override;
+
+  void SetShader(ShaderStage stage, const ShaderPtr& shader) override;
+  void SetConstantBuffer(ShaderStage stage, uint32_t slot,
+                         const BufferPtr& buffer) override;
+  void SetShaderResource(ShaderStage stage, uint32_t slot,
+                         const SRVPtr& view) override;
+  void SetUnorderedAccess(uint32_t slot, const UAVPtr& view) override;
+  void SetPrimitiveTopology(PrimitiveTopology topology) override;
+  void ClearVertexInput() override;
+  void Barrier() override;
+
+  void Dispatch(uint32_t x, uint32_t y, uint32_t z) override;
+  void DispatchIndirect(const BufferPtr& args, uint32_t offset) override;
+  void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+  void DrawInstancedIndirect(const BufferPtr& args, uint32_t offset) override;
+
+  void Flush() override;
+
+  static ID3D11Buffer* GetNative(const BufferPtr& buffer);
+  static ID3D11ShaderResourceView* GetNative(const SRVPtr& view);
+  static ID3D11UnorderedAccessView* GetNative(const UAVPtr& view);
+
+ private:
+  Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+  Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+};
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
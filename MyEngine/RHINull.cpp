@@ -0,0 +1,209 @@
+#include "RHINull.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace my {
+namespace rhi {
+namespace {
+class NullBuffer : public Buffer {
+ public:
+  explicit NullBuffer(const BufferDesc& desc)
+      : Buffer(desc), contents(desc.size, 0) {}
+
+  std::vector<uint8_t> contents;
+};
+
+class NullShaderResourceView : public ShaderResourceView {
+ public:
+  using ShaderResourceView::ShaderResourceView;
+};
+
+class NullUnorderedAccessView : public UnorderedAccessView {
+ public:
+  using UnorderedAccessView::UnorderedAccessView;
+};
+
+class NullShader : public Shader {
+ public:
+  using Shader::Shader;
+};
+
+NullBuffer* ToNull(const BufferPtr& buffer) {
+  return static_cast<NullBuffer*>(buffer.get());
+}
+}  // namespace
+
+BufferPtr NullDevice::CreateBuffer(const BufferDesc& desc,
+                                   const void* initData) {
+  auto buffer = std::make_shared<NullBuffer>(desc);
+  if (initData != nullptr) {
+    memcpy(buffer->contents.data(), initData, desc.size);
+    m_stats.uploadBytes += desc.size;
+  }
+  m_stats.allocatedBytes += desc.size;
+  Record(CommandType::CreateBuffer, desc.size);
+  return buffer;
+}
+
+SRVPtr NullDevice::CreateShaderResourceView(const BufferPtr& buffer,
+                                            const BufferViewDesc& /*desc*/) {
+  if (buffer == nullptr) return nullptr;
+  Record(CommandType::CreateView);
+  return std::make_shared<NullShaderResourceView>(buffer);
+}
+
+UAVPtr NullDevice::CreateUnorderedAccessView(const BufferPtr& buffer,
+                                             const BufferViewDesc& /*desc*/) {
+  if (buffer == nullptr) return nullptr;
+  Record(CommandType::CreateView);
+  return std::make_shared<NullUnorderedAccessView>(buffer);
+}
+
+ShaderPtr NullDevice::CreateShader(ShaderStage stage,
+                                   const void* /*byteCode*/,
+                                   size_t byteCodeSize) {
+  Record(CommandType::CreateShader, static_cast<uint32_t>(byteCodeSize),
+         static_cast<uint32_t>(stage));
+  return std::make_shared<NullShader>(stage);
+}
+
+// Copies complete immediately, so a read never has to wait.
+void* NullDevice::Map(const BufferPtr& buffer, MapMode mode,
+                      bool /*doNotWait*/) {
+  NullBuffer* nullBuffer = ToNull(buffer);
+  const uint32_t size = buffer->GetDesc().size;
+  if (mode == MapMode::Read)
+    m_stats.readbackBytes += size;
+  else
+    m_stats.uploadBytes += size;
+  Record(CommandType::Map, size);
+  return nullBuffer->contents.data();
+}
+
+void NullDevice::Unmap(const BufferPtr& /*buffer*/) {
+  Record(CommandType::Unmap);
+}
+
+void NullDevice::UpdateBuffer(const BufferPtr& buffer, const void* data,
+                              uint32_t offset, uint32_t size) {
+  memcpy(ToNull(buffer)->contents.data() + offset, data, size);
+  m_stats.uploadBytes += size;
+  Record(CommandType::UpdateBuffer, size);
+}
+
+void NullDevice::CopyBuffer(const BufferPtr& dst, uint32_t dstOffset,
+                            const BufferPtr& src, uint32_t srcOffset,
+                            uint32_t size) {
+  memmove(ToNull(dst)->contents.data() + dstOffset,
+          ToNull(src)->contents.data() + srcOffset, size);
+  m_stats.copyBytes += size;
+  Record(CommandType::CopyBuffer, size);
+}
+
+void NullDevice::SetShader(ShaderStage stage, const ShaderPtr& shader) {
+  const uint32_t s = static_cast<uint32_t>(stage);
+  RecordBinding(CommandType::SetShader, m_bindings[s].shader, shader.get(), s,
+                0);
+}
+
+void NullDevice::SetConstantBuffer(ShaderStage stage, uint32_t slot,
+                                   const BufferPtr& buffer) {
+  const uint32_t s = static_cast<uint32_t>(stage);
+  RecordBinding(CommandType::SetConstantBuffer,
+                m_bindings[s].constantBuffers[slot], buffer.get(), s, slot);
+}
+
+void NullDevice::SetShaderResource(ShaderStage stage, uint32_t slot,
+                                   const SRVPtr& view) {
+  const uint32_t s = static_cast<uint32_t>(stage);
+  RecordBinding(CommandType::SetShaderResource,
+                m_bindings[s].shaderResources[slot], view.get(), s, slot);
+}
+
+void NullDevice::SetUnorderedAccess(uint32_t slot, const UAVPtr& view) {
+  RecordBinding(CommandType::SetUnorderedAccess, m_unorderedAccess[slot],
+                view.get(), static_cast<uint32_t>(ShaderStage::Compute),
+                slot);
+}
+
+void NullDevice::SetPrimitiveTopology(PrimitiveTopology topology) {
+  if (m_topologySet && m_topology == topology)
+    m_stats.redundantStateChanges++;
+  m_topology = topology;
+  m_topologySet = true;
+  Record(CommandType::SetPrimitiveTopology);
+}
+
+void NullDevice::ClearVertexInput() {
+  if (m_vertexInputCleared) m_stats.redundantStateChanges++;
+  m_vertexInputCleared = true;
+  Record(CommandType::ClearVertexInput);
+}
+
+void NullDevice::Barrier() {
+  for (Bindings& bindings : m_bindings)
+    std::fill(std::begin(bindings.shaderResources),
+              std::end(bindings.shaderResources), nullptr);
+  std::fill(std::begin(m_unorderedAccess), std::end(m_unorderedAccess),
+            nullptr);
+  Record(CommandType::Barrier);
+}
+
+void NullDevice::Dispatch(uint32_t x, uint32_t y, uint32_t z) {
+  const uint32_t groups = x * y * z;
+  m_stats.dispatchGroups += groups;
+  Record(CommandType::Dispatch, 0, static_cast<uint32_t>(ShaderStage::Compute),
+         0, groups);
+}
+
+void NullDevice::DispatchIndirect(const BufferPtr& /*args*/,
+                                  uint32_t /*offset*/) {
+  Record(CommandType::DispatchIndirect, 0,
+         static_cast<uint32_t>(ShaderStage::Compute));
+}
+
+void NullDevice::Draw(uint32_t vertexCount, uint32_t /*startVertex*/) {
+  m_stats.drawVertices += vertexCount;
+  Record(CommandType::Draw);
+}
+
+void NullDevice::DrawInstancedIndirect(const BufferPtr& /*args*/,
+                                       uint32_t /*offset*/) {
+  Record(CommandType::DrawInstancedIndirect);
+}
+
+void NullDevice::Flush() { Record(CommandType::Flush); }
+
+const std::vector<uint8_t>& NullDevice::GetContents(
+    const BufferPtr& buffer) const {
+  return ToNull(buffer)->contents;
+}
+
+void NullDevice::ResetRecording() {
+  m_commands.clear();
+  m_stats = Stats();
+}
+
+void NullDevice::Record(CommandType type, uint32_t bytes, uint32_t stage,
+                        uint32_t slot, uint32_t groups) {
+  Command command;
+  command.type = type;
+  command.stage = static_cast<uint8_t>(stage);
+  command.slot = static_cast<uint16_t>(slot);
+  command.bytes = bytes;
+  command.groups = groups;
+  m_commands.push_back(command);
+
+  m_stats.commandCounts[static_cast<uint32_t>(type)]++;
+}
+
+void NullDevice::RecordBinding(CommandType type, const void*& bound,
+                               const void* value, uint32_t stage,
+                               uint32_t slot) {
+  if (bound == value) m_stats.redundantStateChanges++;
+  bound = value;
+  Record(type, 0, stage, slot);
+}
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "RHI.h"
+
+namespace my {
+namespace rhi {
+// Backend without a GPU. Buffers live in CPU memory, so uploads, copies and
+// maps behave as usual, but shaders never run: indirect arguments and
+// anything a kernel would write keep their uploaded contents. Every command
+// is appended to a stream and summed into Stats, which makes redundant state
+// changes, upload volume and dispatch sizes measurable headlessly.
+class NullDevice : public Device {
+ public:
+  enum class CommandType : uint8_t {
+    CreateBuffer,
+    CreateView,
+    CreateShader,
+    Map,
+    Unmap,
+    UpdateBuffer,
+    CopyBuffer,
+    SetShader,
+    SetConstantBuffer,
+    SetShaderResource,
+    SetUnorderedAccess,
+    SetPrimitiveTopology,
+    ClearVertexInput,
+    Barrier,
+    Dispatch,
+    DispatchIndirect,
+    Draw,
+    DrawInstancedIndirect,
+    Flush,
+    Count
+  };
+  static const uint32_t COMMAND_TYPE_COUNT =
+      static_cast<uint32_t>(CommandType::Count);
+
+  struct Command {
+    CommandType type;
+    uint8_t stage;    // ShaderStage of stage-specific commands
+    uint16_t slot;    // binding slot of Set* commands
+    uint32_t bytes;   // payload of uploads, copies, maps and creations
+    uint32_t groups;  // thread groups of a direct dispatch
+  };
+
+  struct Stats {
+    uint64_t commandCounts[COMMAND_TYPE_COUNT] = {};
+    // Set* calls that bind what the slot already holds
+    uint64_t redundantStateChanges = 0;
+    // initial data, Map(WriteDiscard) and UpdateBuffer bytes
+    uint64_t uploadBytes = 0;
+    // Map(Read) bytes
+    uint64_t readbackBytes = 0;
+    uint64_t copyBytes = 0;
+    uint64_t allocatedBytes = 0;
+    // thread groups of direct dispatches; indirect ones read their counts
+    // from GPU-written arguments and are only counted as commands
+    uint64_t dispatchGroups = 0;
+    uint64_t drawVertices = 0;
+
+    uint64_t GetCount(CommandType type) const {
+      return commandCounts[static_cast<uint32_t>(type)];
+    }
+  };
+
+  BufferPtr CreateBuffer(const BufferDesc& desc,
+                         const void* initData = nullptr) override;
+  SRVPtr CreateShaderResourceView(const BufferPtr& buffer,
+                                  const BufferViewDesc& desc) override;
+  UAVPtr CreateUnorderedAccessView(const BufferPtr& buffer,
+                                   const BufferViewDesc& desc) override;
+  ShaderPtr CreateShader(ShaderStage stage, const void* byteCode,
+                         size_t byteCodeSize) override;
+
+  void* Map(const BufferPtr& buffer, MapMode mode,
+            bool doNotWait = false) override;
+  void Unmap(const BufferPtr& buffer) override;
+  void UpdateBuffer(const BufferPtr& buffer, const void* data, uint32_t offset,
+                    uint32_t size) override;
+  void CopyBuffer(const BufferPtr& dst, uint32_t dstOffset,
+                  const BufferPtr& src, uint32_t srcOffset,
+                  uint32_t size) override;
+
+  void SetShader(ShaderStage stage, const ShaderPtr& shader) override;
+  void SetConstantBuffer(ShaderStage stage, uint32_t slot,
+                         const BufferPtr& buffer) override;
+  void SetShaderResource(ShaderStage stage, uint32_t slot,
+                         const SRVPtr& view) override;
+  void SetUnorderedAccess(uint32_t slot, const UAVPtr& view) override;
+  void SetPrimitiveTopology(PrimitiveTopology topology) override;
+  void ClearVertexInput() override;
+  void Barrier() override;
+
+  void Dispatch(uint32_t x, uint32_t y, uint32_t z) override;
+  void DispatchIndirect(const BufferPtr& args, uint32_t offset) override;
+  void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+  void DrawInstancedIndirect(const BufferPtr& args, uint32_t offset) override;
+
+  void Flush() override;
+
+  // Contents of a buffer as the CPU side last left them.
+  const std::vector<uint8_t>& GetContents(const BufferPtr& buffer) const;
+
+  const std::vector<Command>& GetCommands() const { return m_commands; }
+  const Stats& GetStats() const { return m_stats; }
+
+  // Clears the command stream and the stats; bindings are kept, so the
+  // next frame's redundant rebinds still count.
+  void ResetRecording();
+
+ private:
+  static const uint32_t kMaxConstantBuffers = 14;
+  static const uint32_t kMaxShaderResources = 128;
+  static const uint32_t kMaxUnorderedAccess = 8;
+
+  void Record(CommandType type, uint32_t bytes = 0, uint32_t stage = 0,
+              uint32_t slot = 0, uint32_t groups = 0);
+  // Records a Set* call and counts it as redundant when nothing changes.
+  void RecordBinding(CommandType type, const void*& bound, const void* value,
+                     uint32_t stage, uint32_t slot);
+
+  struct Bindings {
+    const void* shader = nullptr;
+    const void* constantBuffers[kMaxConstantBuffers] = {};
+    const void* shaderResources[kMaxShaderResources] = {};
+  };
+  Bindings m_bindings[SHADER_STAGE_COUNT];
+  const void* m_unorderedAccess[kMaxUnorderedAccess] = {};
+  PrimitiveTopology m_topology = PrimitiveTopology::PointList;
+  bool m_topologySet = false;
+  bool m_vertexInputCleared = false;
+
+  std::vector<Command> m_commands;
+  Stats m_stats;
+};
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "RHIReadback.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace my {
+bool RHIReadbackDevice::Initialize(rhi::Device* device,
+                                   const rhi::BufferPtr& source,
+                                   uint32_t depth) {
+  Reset();
+
+  m_device = device;
+  m_source = source;
+
+  rhi::BufferDesc desc;
+  desc.size = source->GetDesc().size;
+  desc.usage = rhi::Usage::Staging;
+
+  m_staging.resize(depth);
+  for (rhi::BufferPtr& staging : m_staging) {
+    staging = device->CreateBuffer(desc);
+    if (staging == nullptr) {
+      Reset();
+      return false;
+    }
+  }
+  return true;
+}
+
+void RHIReadbackDevice::Reset() {
+  m_staging.clear();
+  m_source.reset();
+  m_device = nullptr;
+}
+
+void RHIReadbackDevice::CopyToSlot(uint32_t slot) {
+  m_device->CopyBuffer(m_staging[slot], 0, m_source, 0,
+                       m_source->GetDesc().size);
+}
+
+bool RHIReadbackDevice::TryReadSlot(uint32_t slot, void* data,
+                                    uint32_t size) {
+  const void* mapped =
+      m_device->Map(m_staging[slot], rhi::MapMode::Read, true);
+  if (mapped == nullptr) return false;
+
+  memcpy(data, mapped, std::min(size, m_staging[slot]->GetDesc().size));
+  m_device->Unmap(m_staging[slot]);
+  return true;
+}
+}  // namespace my
\ No newline at end of file
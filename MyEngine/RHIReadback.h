@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+#include "RHI.h"
+#include "ReadbackRing.h"
+
+namespace my {
+// ReadbackDevice over RHI staging buffers. Reads map with doNotWait, so a
+// slot the GPU has not copied yet is refused instead of stalling the CPU.
+class RHIReadbackDevice : public ReadbackDevice {
+ public:
+  // Creates `depth` staging copies of source.
+  bool Initialize(rhi::Device* device, const rhi::BufferPtr& source,
+                  uint32_t depth);
+  void Reset();
+
+  void CopyToSlot(uint32_t slot) override;
+  bool TryReadSlot(uint32_t slot, void* data, uint32_t size) override;
+
+ private:
+  rhi::Device* m_device = nullptr;
+  rhi::BufferPtr m_source;
+  std::vector<rhi::BufferPtr> m_staging;
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "RHIStateCache.h"
+
+#include <algorithm>
+
+namespace my {
+namespace rhi {
+BufferPtr StateCache::CreateBuffer(const BufferDesc& desc,
+                                   const void* initData) {
+  return m_device->CreateBuffer(desc, initData);
+}
+
+SRVPtr StateCache::CreateShaderResourceView(const BufferPtr& buffer,
+                                            const BufferViewDesc& desc) {
+  return m_device->CreateShaderResourceView(buffer, desc);
+}
+
+UAVPtr StateCache::CreateUnorderedAccessView(const BufferPtr& buffer,
+                                             const BufferViewDesc& desc) {
+  return m_device->CreateUnorderedAccessView(buffer, desc);
+}
+
+ShaderPtr StateCache::CreateShader(ShaderStage stage, const void* byteCode,
+                                   size_t byteCodeSize) {
+  return m_device->CreateShader(stage, byteCode, byteCodeSize);
+}
+
+void* StateCache::Map(const BufferPtr& buffer, MapMode mode, bool doNotWait) {
+  return m_device->Map(buffer, mode, doNotWait);
+}
+
+void StateCache::Unmap(const BufferPtr& buffer) { m_device->Unmap(buffer); }
+
+void StateCache::UpdateBuffer(const BufferPtr& buffer, const void* data,
+                              uint32_t offset, uint32_t size) {
+  m_device->UpdateBuffer(buffer, data, offset, size);
+}
+
+void StateCache::CopyBuffer(const BufferPtr& dst, uint32_t dstOffset,
+                            const BufferPtr& src, uint32_t srcOffset,
+                            uint32_t size) {
+  m_device->CopyBuffer(dst, dstOffset, src, srcOffset, size);
+}
+
+void StateCache::SetShader(ShaderStage stage, const ShaderPtr& shader) {
+  Stage& s = m_stages[static_cast<uint32_t>(stage)];
+  if (s.shaderKnown && s.shader == shader) {
+    m_counters.redundantBindings++;
+    return;
+  }
+  s.shader = shader;
+  s.shaderKnown = true;
+  m_device->SetShader(stage, shader);
+  m_counters.forwardedBindings++;
+}
+
+void StateCache::SetConstantBuffer(ShaderStage stage, uint32_t slot,
+                                   const BufferPtr& buffer) {
+  Stage& s = m_stages[static_cast<uint32_t>(stage)];
+  if (s.constantBuffersKnown[slot] && s.constantBuffers[slot] == buffer) {
+    m_counters.redundantBindings++;
+    return;
+  }
+  s.constantBuffers[slot] = buffer;
+  s.constantBuffersKnown[slot] = true;
+  m_device->SetConstantBuffer(stage, slot, buffer);
+  m_counters.forwardedBindings++;
+}
+
+void StateCache::SetShaderResource(ShaderStage stage, uint32_t slot,
+                                   const SRVPtr& view) {
+  Stage& s = m_stages[static_cast<uint32_t>(stage)];
+  if (s.shaderResources[slot] == view) {
+    m_counters.redundantBindings++;
+    return;
+  }
+
+  // a buffer being read must not stay bound for writing
+  if (view != nullptr)
+    UnbindUnorderedAccess(view->GetBuffer(), kMaxUnorderedAccess);
+
+  s.shaderResources[slot] = view;
+  if (view != nullptr)
+    s.shaderResourceEnd = std::max(s.shaderResourceEnd, slot + 1);
+  m_device->SetShaderResource(stage, slot, view);
+  m_counters.forwardedBindings++;
+}
+
+void StateCache::SetUnorderedAccess(uint32_t slot, const UAVPtr& view) {
+  if (m_unorderedAccess[slot] == view) {
+    m_counters.redundantBindings++;
+    return;
+  }
+
+  // a buffer being written must not be bound anywhere else
+  if (view != nullptr) {
+    UnbindUnorderedAccess(view->GetBuffer(), slot);
+    UnbindShaderResources(view->GetBuffer());
+  }
+
+  m_unorderedAccess[slot] = view;
+  m_device->SetUnorderedAccess(slot, view);
+  m_counters.forwardedBindings++;
+}
+
+void StateCache::SetPrimitiveTopology(PrimitiveTopology topology) {
+  if (m_topologyKnown && m_topology == topology) {
+    m_counters.redundantBindings++;
+    return;
+  }
+  m_topology = topology;
+  m_topologyKnown = true;
+  m_device->SetPrimitiveTopology(topology);
+  m_counters.forwardedBindings++;
+}
+
+void StateCache::ClearVertexInput() {
+  if (m_vertexInputCleared) {
+    m_counters.redundantBindings++;
+    return;
+  }
+  m_vertexInputCleared = true;
+  m_device->ClearVertexInput();
+  m_counters.forwardedBindings++;
+}
+
+void StateCache::Barrier() { m_counters.skippedBarriers++; }
+
+void StateCache::Dispatch(uint32_t x, uint32_t y, uint32_t z) {
+  m_device->Dispatch(x, y, z);
+}
+
+void StateCache::DispatchIndirect(const BufferPtr& args, uint32_t offset) {
+  UnbindUnorderedAccess(args.get(), kMaxUnorderedAccess);
+  m_device->DispatchIndirect(args, offset);
+}
+
+void StateCache::Draw(uint32_t vertexCount, uint32_t startVertex) {
+  m_device->Draw(vertexCount, startVertex);
+}
+
+void StateCache::DrawInstancedIndirect(const BufferPtr& args,
+                                       uint32_t offset) {
+  UnbindUnorderedAccess(args.get(), kMaxUnorderedAccess);
+  m_device->DrawInstancedIndirect(args, offset);
+}
+
+void StateCache::Flush() { m_device->Flush(); }
+
+void StateCache::Invalidate() {
+  for (Stage& s : m_stages) {
+    s.shader.reset();
+    s.shaderKnown = false;
+    for (uint32_t slot = 0; slot < kMaxConstantBuffers; slot++) {
+      s.constantBuffers[slot].reset();
+      s.constantBuffersKnown[slot] = false;
+    }
+  }
+  m_topologyKnown = false;
+  m_vertexInputCleared = false;
+}
+
+void StateCache::EndFrame() {
+  m_lastFrame = m_counters;
+  m_counters = Counters();
+}
+
+void StateCache::UnbindUnorderedAccess(const Buffer* buffer,
+                                       uint32_t keepSlot) {
+  for (uint32_t slot = 0; slot < kMaxUnorderedAccess; slot++) {
+    if (slot == keepSlot || m_unorderedAccess[slot] == nullptr ||
+        m_unorderedAccess[slot]->GetBuffer() != buffer)
+      continue;
+    m_unorderedAccess[slot].reset();
+    m_device->SetUnorderedAccess(slot, nullptr);
+    m_counters.hazardUnbinds++;
+  }
+}
+
+void StateCache::UnbindShaderResources(const Buffer* buffer) {
+  for (uint32_t stage = 0; stage < SHADER_STAGE_COUNT; stage++) {
+    Stage& s = m_stages[stage];
+    for (uint32_t slot = 0; slot < s.shaderResourceEnd; slot++) {
+      if (s.shaderResources[slot] == nullptr ||
+          s.shaderResources[slot]->GetBuffer() != buffer)
+        continue;
+      s.shaderResources[slot].reset();
+      m_device->SetShaderResource(static_cast<ShaderStage>(stage), slot,
+                                  nullptr);
+      m_counters.hazardUnbinds++;
+    }
+  }
+}
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+
+#include "RHI.h"
+
+namespace my {
+namespace rhi {
+// Binding tracker in front of another device. It drops Set* calls that bind
+// what a slot already holds, and replaces the brute-force Barrier() with
+// hazard checks when views are bound: a buffer bound for writing is unbound
+// from every other slot first, and a buffer bound for reading or used for
+// indirect arguments is unbound from the UAV slots. Barrier() is then
+// never passed on; D3D11 already orders dispatches that write the same UAV.
+//
+// Views stay bound, and alive, until something else takes their slot.
+class StateCache : public Device {
+ public:
+  struct Counters {
+    uint64_t forwardedBindings = 0;  // Set* calls passed on
+    uint64_t redundantBindings = 0;  // Set* calls dropped
+    uint64_t hazardUnbinds = 0;      // views unbound to resolve a hazard
+    uint64_t skippedBarriers = 0;    // Barrier() calls dropped
+
+    // Device calls saved, net of the unbinds issued in their place.
+    int64_t GetAvoidedCalls() const {
+      return static_cast<int64_t>(redundantBindings + skippedBarriers) -
+             static_cast<int64_t>(hazardUnbinds);
+    }
+  };
+
+  explicit StateCache(Device* device) : m_device(device) {}
+
+  BufferPtr CreateBuffer(const BufferDesc& desc,
+                         const void* initData = nullptr) override;
+  SRVPtr CreateShaderResourceView(const BufferPtr& buffer,
+                                  const BufferViewDesc& desc) override;
+  UAVPtr CreateUnorderedAccessView(const BufferPtr& buffer,
+                                   const BufferViewDesc& desc) override;
+  ShaderPtr CreateShader(ShaderStage stage, const void* byteCode,
+                         size_t byteCodeSize) override;
+
+  void* Map(const BufferPtr& buffer, MapMode mode,
+            bool doNotWait = false) override;
+  void Unmap(const BufferPtr& buffer) override;
+  void UpdateBuffer(const BufferPtr& buffer, const void* data, uint32_t offset,
+                    uint32_t size) override;
+  void CopyBuffer(const BufferPtr& dst, uint32_t dstOffset,
+                  const BufferPtr& src, uint32_t srcOffset,
+                  uint32_t size) override;
+
+  void SetShader(ShaderStage stage, const ShaderPtr& shader) override;
+  void SetConstantBuffer(ShaderStage stage, uint32_t slot,
+                         const BufferPtr& buffer) override;
+  void SetShaderResource(ShaderStage stage, uint32_t slot,
+                         const SRVPtr& view) override;
+  void SetUnorderedAccess(uint32_t slot, const UAVPtr& view) override;
+  void SetPrimitiveTopology(PrimitiveTopology topology) override;
+  void ClearVertexInput() override;
+  void Barrier() override;
+
+  void Dispatch(uint32_t x, uint32_t y, uint32_t z) override;
+  void DispatchIndirect(const BufferPtr& args, uint32_t offset) override;
+  void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+  void DrawInstancedIndirect(const BufferPtr& args, uint32_t offset) override;
+
+  void Flush() override;
+
+  // Forgets the shaders, constant buffers, topology and vertex input, which
+  // code driving the device directly may have changed; the next Set* of
+  // each is passed on. Shader resource and unordered access views must only
+  // be bound through the cache, so they stay tracked.
+  void Invalidate();
+
+  // Counters of the frame in progress; EndFrame() moves them to
+  // GetLastFrameCounters() and starts over.
+  const Counters& GetCounters() const { return m_counters; }
+  const Counters& GetLastFrameCounters() const { return m_lastFrame; }
+  void EndFrame();
+
+ private:
+  static const uint32_t kMaxConstantBuffers = 14;
+  static const uint32_t kMaxShaderResources = 128;
+  static const uint32_t kMaxUnorderedAccess = 8;
+
+  // Unbinds the views of buffer from the UAV slots, except `keepSlot`.
+  void UnbindUnorderedAccess(const Buffer* buffer, uint32_t keepSlot);
+  // Unbinds the views of buffer from the shader resource slots of every
+  // stage.
+  void UnbindShaderResources(const Buffer* buffer);
+
+  Device* m_device;
+
+  struct Stage {
+    ShaderPtr shader;
+    bool shaderKnown = false;
+    BufferPtr constantBuffers[kMaxConstantBuffers];
+    bool constantBuffersKnown[kMaxConstantBuffers] = {};
+    SRVPtr shaderResources[kMaxShaderResources];
+    uint32_t shaderResourceEnd = 0;  // past the highest bound slot
+  };
+  Stage m_stages[SHADER_STAGE_COUNT];
+  UAVPtr m_unorderedAccess[kMaxUnorderedAccess];
+  PrimitiveTopology m_topology = PrimitiveTopology::PointList;
+  bool m_topologyKnown = false;
+  bool m_vertexInputCleared = false;
+
+  Counters m_counters;
+  Counters m_lastFrame;
+};
+}  // namespace rhi
+}  // namespace my
\ No newline at end of file
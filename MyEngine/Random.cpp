@@ -0,0 +1,190 @@
+#include "Random.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "SIMD.h"
+
+namespace my {
+namespace philox {
+namespace {
+void MulHiLo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+  const uint64_t product = static_cast<uint64_t>(a) * b;
+  hi = static_cast<uint32_t>(product >> 32);
+  lo = static_cast<uint32_t>(product);
+}
+
+#if defined(MY_SIMD_AVX2)
+const uint32_t kLanes = 8;
+using vuint = __m256i;
+
+inline vuint Set1(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+inline vuint Xor(vuint a, vuint b) { return _mm256_xor_si256(a, b); }
+inline vuint Add(vuint a, vuint b) { return _mm256_add_epi32(a, b); }
+inline vuint SlotIndices(uint32_t first) {
+  return Add(Set1(first), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+inline void Store(uint32_t* p, vuint a) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a);
+}
+
+// 32x32 -> 64 bit products of every lane, split into high and low words.
+inline void MulHiLo(vuint a, vuint b, vuint& hi, vuint& lo) {
+  const vuint even = _mm256_mul_epu32(a, b);
+  const vuint odd =
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+  const vuint e = _mm256_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 2, 0));
+  const vuint o = _mm256_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 2, 0));
+  lo = _mm256_unpacklo_epi32(e, o);
+  hi = _mm256_unpackhi_epi32(e, o);
+}
+#elif defined(MY_SIMD_SSE2)
+const uint32_t kLanes = 4;
+using vuint = __m128i;
+
+inline vuint Set1(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+inline vuint Xor(vuint a, vuint b) { return _mm_xor_si128(a, b); }
+inline vuint Add(vuint a, vuint b) { return _mm_add_epi32(a, b); }
+inline vuint SlotIndices(uint32_t first) {
+  return Add(Set1(first), _mm_setr_epi32(0, 1, 2, 3));
+}
+inline void Store(uint32_t* p, vuint a) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a);
+}
+
+// 32x32 -> 64 bit products of every lane, split into high and low words.
+inline void MulHiLo(vuint a, vuint b, vuint& hi, vuint& lo) {
+  const vuint even = _mm_mul_epu32(a, b);
+  const vuint odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  const vuint e = _mm_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 2, 0));
+  const vuint o = _mm_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 2, 0));
+  lo = _mm_unpacklo_epi32(e, o);
+  hi = _mm_unpackhi_epi32(e, o);
+}
+#endif
+
+#if defined(MY_SIMD_AVX2) || defined(MY_SIMD_SSE2)
+// kLanes slots of one block; c[w] holds counter word w of every lane.
+void GenerateLanes(vuint c[4], uint32_t k0, uint32_t k1) {
+  const vuint m0 = Set1(kMultiplier0);
+  const vuint m1 = Set1(kMultiplier1);
+  for (int round = 0; round < 10; round++) {
+    vuint hi0, lo0, hi1, lo1;
+    MulHiLo(m0, c[0], hi0, lo0);
+    MulHiLo(m1, c[2], hi1, lo1);
+    const vuint c1 = c[1];
+    const vuint c3 = c[3];
+    c[0] = Xor(Xor(hi1, c1), Set1(k0));
+    c[1] = lo1;
+    c[2] = Xor(Xor(hi0, c3), Set1(k1));
+    c[3] = lo0;
+    k0 += kWeyl0;
+    k1 += kWeyl1;
+  }
+}
+#endif
+}  // namespace
+
+void Generate(const uint32_t counter[4], const uint32_t key[2],
+              uint32_t out[4]) {
+  uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+  uint32_t k0 = key[0];
+  uint32_t k1 = key[1];
+  for (int round = 0; round < 10; round++) {
+    uint32_t hi0, lo0, hi1, lo1;
+    MulHiLo(kMultiplier0, c[0], hi0, lo0);
+    MulHiLo(kMultiplier1, c[2], hi1, lo1);
+    const uint32_t c1 = c[1];
+    const uint32_t c3 = c[3];
+    c[0] = hi1 ^ c1 ^ k0;
+    c[1] = lo1;
+    c[2] = hi0 ^ c3 ^ k1;
+    c[3] = lo0;
+    k0 += kWeyl0;
+    k1 += kWeyl1;
+  }
+  std::memcpy(out, c, sizeof(c));
+}
+
+void GenerateSlots(uint32_t seed, uint32_t frameIndex, uint32_t firstSlot,
+                   uint32_t count, uint32_t blockCount, uint32_t* out) {
+  const uint32_t key[2] = {seed, 0};
+  uint32_t i = 0;
+
+#if defined(MY_SIMD_AVX2) || defined(MY_SIMD_SSE2)
+  for (; i + kLanes <= count; i += kLanes) {
+    for (uint32_t block = 0; block < blockCount; block++) {
+      vuint c[4] = {SlotIndices(firstSlot + i), Set1(frameIndex), Set1(block),
+                    Set1(0)};
+      GenerateLanes(c, key[0], key[1]);
+
+      uint32_t words[4][kLanes];
+      for (uint32_t w = 0; w < 4; w++) Store(words[w], c[w]);
+      for (uint32_t l = 0; l < kLanes; l++) {
+        uint32_t* dst = out + ((i + l) * blockCount + block) * 4;
+        for (uint32_t w = 0; w < 4; w++) dst[w] = words[w][l];
+      }
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    for (uint32_t block = 0; block < blockCount; block++) {
+      const uint32_t counter[4] = {firstSlot + i, frameIndex, block, 0};
+      Generate(counter, key, out + (i * blockCount + block) * 4);
+    }
+  }
+}
+}  // namespace philox
+
+void RNG::init(uint32_t seed, uint32_t slot, uint32_t frameIndex) {
+  init(seed, slot, frameIndex, nullptr, 0);
+}
+
+void RNG::init(uint32_t seed, uint32_t slot, uint32_t frameIndex,
+               const uint32_t* blocks, uint32_t blockCount) {
+  m_counter[0] = slot;
+  m_counter[1] = frameIndex;
+  m_counter[2] = 0;
+  m_counter[3] = 0;
+  m_key[0] = seed;
+  m_key[1] = 0;
+  m_used = 4;
+  m_preloaded = blocks;
+  m_preloadedBlocks = blockCount;
+}
+
+uint32_t RNG::next() {
+  if (m_used == 4) {
+    if (m_counter[2] < m_preloadedBlocks)
+      std::memcpy(m_block, m_preloaded + m_counter[2] * 4, sizeof(m_block));
+    else
+      philox::Generate(m_counter, m_key, m_block);
+    m_counter[2]++;
+    m_used = 0;
+  }
+  return m_block[m_used++];
+}
+
+float RNG::next_float() {
+  uint32_t u = 0x3f800000 | (next() >> 9);
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f - 1.0f;
+}
+
+uint32_t RNG::next_uint(uint32_t nmax) {
+  float f = next_float();
+  return static_cast<uint32_t>(std::floor(f * nmax));
+}
+
+uint32_t RNG::next_uint_frac(uint32_t nmax, float& frac) {
+  uint32_t hi, lo;
+  philox::MulHiLo(next(), nmax, hi, lo);
+
+  uint32_t u = 0x3f800000 | (lo >> 9);
+  std::memcpy(&frac, &u, sizeof(frac));
+  frac -= 1.0f;
+  return hi;
+}
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random
+// Numbers: As Easy as 1, 2, 3"), twin of the RNG struct in hlsl/Header.hlsli.
+// A stream is keyed by the emitter seed and counted by (slot, frame, block),
+// so the numbers a particle gets never depend on which thread or dispatch
+// produced them. Both sides produce the same bits for the same inputs.
+
+#include <cstdint>
+
+namespace my {
+namespace philox {
+const uint32_t kMultiplier0 = 0xD2511F53;
+const uint32_t kMultiplier1 = 0xCD9E8D57;
+const uint32_t kWeyl0 = 0x9E3779B9;
+const uint32_t kWeyl1 = 0xBB67AE85;
+
+// One 128-bit output block for the given counter and key.
+void Generate(const uint32_t counter[4], const uint32_t key[2],
+              uint32_t out[4]);
+
+// Blocks [0, blockCount) of the streams of count consecutive slots, SIMD
+// across slots. Written as out[(slot * blockCount + block) * 4 + word].
+void GenerateSlots(uint32_t seed, uint32_t frameIndex, uint32_t firstSlot,
+                   uint32_t count, uint32_t blockCount, uint32_t* out);
+}  // namespace philox
+
+// Sequential view of one (seed, slot, frame) stream, four words per block.
+class RNG {
+ public:
+  void init(uint32_t seed, uint32_t slot, uint32_t frameIndex);
+
+  // Starts the stream from blocks produced by philox::GenerateSlots for this
+  // slot; blocks past blockCount are generated on demand.
+  void init(uint32_t seed, uint32_t slot, uint32_t frameIndex,
+            const uint32_t* blocks, uint32_t blockCount);
+
+  uint32_t next();
+  float next_float();
+  uint32_t next_uint(uint32_t nmax);
+
+  // Uniform index in [0, nmax) plus a uniform fraction within it, both from
+  // one word: the high and low halves of next() * nmax.
+  uint32_t next_uint_frac(uint32_t nmax, float& frac);
+
+ private:
+  uint32_t m_counter[4];
+  uint32_t m_key[2];
+  uint32_t m_block[4];
+  uint32_t m_used = 4;
+
+  const uint32_t* m_preloaded = nullptr;
+  uint32_t m_preloadedBlocks = 0;
+};
+}  // namespace my
\ No newline at end of file
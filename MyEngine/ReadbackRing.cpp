@@ -0,0 +1,87 @@
+#include "ReadbackRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace my {
+void ReadbackRing::Initialize(ReadbackDevice* device, uint32_t depth,
+                              uint32_t size) {
+  m_device = device;
+  m_size = size;
+
+  m_slotFrames.assign(std::max(1u, depth), 0);
+  m_oldest = 0;
+  m_pendingCount = 0;
+  m_droppedCount = 0;
+
+  m_result.assign(size, 0);
+  m_resultFrame = 0;
+  m_hasResult = false;
+}
+
+bool ReadbackRing::Push(uint64_t frame) {
+  const uint32_t depth = static_cast<uint32_t>(m_slotFrames.size());
+  if (m_device == nullptr || m_pendingCount == depth) {
+    m_droppedCount++;
+    return false;
+  }
+
+  const uint32_t slot = (m_oldest + m_pendingCount) % depth;
+  m_device->CopyToSlot(slot);
+  m_slotFrames[slot] = frame;
+  m_pendingCount++;
+  return true;
+}
+
+bool ReadbackRing::Poll() {
+  const uint32_t depth = static_cast<uint32_t>(m_slotFrames.size());
+
+  // the GPU finishes copies in order, so stop at the first one in flight
+  bool arrived = false;
+  while (m_pendingCount > 0 &&
+         m_device->TryReadSlot(m_oldest, m_result.data(), m_size)) {
+    m_resultFrame = m_slotFrames[m_oldest];
+    m_hasResult = true;
+    arrived = true;
+
+    m_oldest = (m_oldest + 1) % depth;
+    m_pendingCount--;
+  }
+  return arrived;
+}
+
+RecordingReadbackDevice::RecordingReadbackDevice(uint32_t depth, uint32_t size,
+                                                 uint32_t latency)
+    : m_source(size, 0), m_slots(depth), m_latency(latency) {
+  for (Slot& slot : m_slots) slot.data.assign(size, 0);
+}
+
+void RecordingReadbackDevice::SetSource(const void* data) {
+  memcpy(m_source.data(), data, m_source.size());
+}
+
+void RecordingReadbackDevice::Advance() {
+  for (Slot& slot : m_slots)
+    if (slot.pending && slot.framesLeft > 0) slot.framesLeft--;
+}
+
+void RecordingReadbackDevice::CopyToSlot(uint32_t slot) {
+  m_slots[slot].data = m_source;
+  m_slots[slot].framesLeft = m_latency;
+  m_slots[slot].pending = true;
+  m_copyCount++;
+}
+
+bool RecordingReadbackDevice::TryReadSlot(uint32_t slot, void* data,
+                                          uint32_t size) {
+  Slot& s = m_slots[slot];
+  if (s.pending && s.framesLeft > 0) {
+    m_busyReadCount++;
+    return false;
+  }
+
+  memcpy(data, s.data.data(), std::min<size_t>(size, s.data.size()));
+  s.pending = false;
+  return true;
+}
+}  // namespace my
\ No newline at end of file
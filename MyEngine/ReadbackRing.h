@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace my {
+// GPU side of a readback: copies one source buffer into numbered staging
+// slots and reads a slot back only when the GPU is done with it.
+class ReadbackDevice {
+ public:
+  virtual ~ReadbackDevice() = default;
+
+  // Queues a copy of the source buffer into staging slot `slot`.
+  virtual void CopyToSlot(uint32_t slot) = 0;
+
+  // Copies `size` bytes of the slot to data and returns true when its copy
+  // has finished; returns false at once while it is still in flight.
+  virtual bool TryReadSlot(uint32_t slot, void* data, uint32_t size) = 0;
+};
+
+// Latency-tolerant readback of a small GPU buffer through a ring of staging
+// slots. Push() queues a copy tagged with a frame, Poll() collects the copies
+// that have landed, oldest first, without ever waiting on the GPU. When every
+// slot is still in flight a push is dropped instead of stalling.
+class ReadbackRing {
+ public:
+  void Initialize(ReadbackDevice* device, uint32_t depth, uint32_t size);
+
+  // false when the push was dropped because the ring is full.
+  bool Push(uint64_t frame);
+
+  // true when a newer result arrived.
+  bool Poll();
+
+  bool HasResult() const { return m_hasResult; }
+  // Frame the latest result was pushed for, and its `size` bytes.
+  uint64_t GetResultFrame() const { return m_resultFrame; }
+  const void* GetResult() const { return m_result.data(); }
+
+  uint32_t GetPendingCount() const { return m_pendingCount; }
+  uint64_t GetDroppedCount() const { return m_droppedCount; }
+
+ private:
+  ReadbackDevice* m_device = nullptr;
+  uint32_t m_size = 0;
+
+  // frame of every slot; the pending ones start at m_oldest
+  std::vector<uint64_t> m_slotFrames;
+  uint32_t m_oldest = 0;
+  uint32_t m_pendingCount = 0;
+  uint64_t m_droppedCount = 0;
+
+  std::vector<uint8_t> m_result;
+  uint64_t m_resultFrame = 0;
+  bool m_hasResult = false;
+};
+
+// Null device for running a ReadbackRing without a GPU. Every copy captures
+// the current source contents and lands `latency` Advance() calls later;
+// reads of a slot still in flight are refused and counted, never waited on.
+class RecordingReadbackDevice : public ReadbackDevice {
+ public:
+  RecordingReadbackDevice(uint32_t depth, uint32_t size, uint32_t latency);
+
+  // Contents the following copies capture (`size` bytes).
+  void SetSource(const void* data);
+
+  // One GPU frame passes.
+  void Advance();
+
+  void CopyToSlot(uint32_t slot) override;
+  bool TryReadSlot(uint32_t slot, void* data, uint32_t size) override;
+
+  uint64_t GetCopyCount() const { return m_copyCount; }
+  uint64_t GetBusyReadCount() const { return m_busyReadCount; }
+
+ private:
+  struct Slot {
+    std::vector<uint8_t> data;
+    uint32_t framesLeft = 0;
+    bool pending = false;
+  };
+
+  std::vector<uint8_t> m_source;
+  std::vector<Slot> m_slots;
+  uint32_t m_latency = 0;
+
+  uint64_t m_copyCount = 0;
+  uint64_t m_busyReadCount = 0;
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,369 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+namespace my {
+namespace {
+bool SameDesc(const rhi::BufferDesc& a, const rhi::BufferDesc& b) {
+  return a.size == b.size && a.stride == b.stride && a.usage == b.usage &&
+         a.bindFlags == b.bindFlags && a.miscFlags == b.miscFlags;
+}
+
+const char* AccessName(RenderGraph::Access access) {
+  switch (access) {
+    case RenderGraph::Access::Read:
+      return "read";
+    case RenderGraph::Access::Write:
+      return "write";
+    case RenderGraph::Access::IndirectArgs:
+      return "indirect args";
+    case RenderGraph::Access::Upload:
+      return "upload";
+  }
+  return "?";
+}
+
+void AddUnique(std::vector<uint32_t>& list, uint32_t value) {
+  if (std::find(list.begin(), list.end(), value) == list.end())
+    list.push_back(value);
+}
+}  // namespace
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(
+    ResourceHandle resource) {
+  m_graph->AddAccess(m_pass, resource, Access::Read);
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(
+    ResourceHandle resource) {
+  m_graph->AddAccess(m_pass, resource, Access::Write);
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::IndirectArgs(
+    ResourceHandle resource) {
+  m_graph->AddAccess(m_pass, resource, Access::IndirectArgs);
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Upload(
+    ResourceHandle resource) {
+  m_graph->AddAccess(m_pass, resource, Access::Upload);
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SideEffect() {
+  m_graph->m_passes[m_pass].sideEffect = true;
+  return *this;
+}
+
+bool RenderGraph::NeedsBarrier(Access before, Access after) {
+  if (before == Access::Write)
+    return after == Access::Read || after == Access::IndirectArgs;
+  return before == Access::Read && after == Access::Write;
+}
+
+void RenderGraph::Reset() {
+  for (Resource& resource : m_resources)
+    if (resource.buffer != nullptr) m_pool.push_back(resource.buffer);
+  m_resources.clear();
+  m_passes.clear();
+  m_schedule.clear();
+  m_scheduledAccess.clear();
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportResource(
+    const std::string& name) {
+  Resource resource;
+  resource.name = name;
+  m_resources.push_back(resource);
+  return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTransientBuffer(
+    const std::string& name, const rhi::BufferDesc& desc) {
+  Resource resource;
+  resource.name = name;
+  resource.transient = true;
+  resource.desc = desc;
+  m_resources.push_back(resource);
+  return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(const std::string& name,
+                                              std::function<void()> execute) {
+  Pass pass;
+  pass.name = name;
+  pass.execute = std::move(execute);
+  m_passes.push_back(std::move(pass));
+  return PassBuilder(this, static_cast<PassHandle>(m_passes.size() - 1));
+}
+
+void RenderGraph::AddAccess(PassHandle pass, ResourceHandle resource,
+                            Access access) {
+  // one entry per resource and pass; a write covers anything else the pass
+  // does with it
+  for (ResourceAccess& entry : m_passes[pass].accesses) {
+    if (entry.resource != resource) continue;
+    if (access == Access::Write || access == Access::Upload ||
+        entry.access == Access::Read)
+      entry.access = entry.access == Access::Write ? Access::Write : access;
+    return;
+  }
+  m_passes[pass].accesses.push_back({resource, access});
+}
+
+bool RenderGraph::GetInitialAccess(ResourceHandle resource,
+                                   Access& access) const {
+  if (m_resources[resource].transient) return false;
+  auto it = m_importedAccess.find(m_resources[resource].name);
+  if (it == m_importedAccess.end()) return false;
+  access = it->second;
+  return true;
+}
+
+void RenderGraph::Compile() {
+  const uint32_t passCount = static_cast<uint32_t>(m_passes.size());
+  const uint32_t resourceCount = static_cast<uint32_t>(m_resources.size());
+  m_scheduledAccess.clear();
+
+  // Dependencies in declaration order: a use of a resource waits for its
+  // last writer, a write also for the uses since then.
+  {
+    std::vector<PassHandle> lastWriter(resourceCount, INVALID_HANDLE);
+    std::vector<std::vector<PassHandle>> users(resourceCount);
+    for (PassHandle p = 0; p < passCount; p++) {
+      Pass& pass = m_passes[p];
+      pass.dependencies.clear();
+      pass.producers.clear();
+      for (const ResourceAccess& entry : pass.accesses) {
+        const ResourceHandle r = entry.resource;
+        if (lastWriter[r] != INVALID_HANDLE) {
+          AddUnique(pass.dependencies, lastWriter[r]);
+          AddUnique(pass.producers, lastWriter[r]);
+        }
+
+        const bool writes =
+            entry.access == Access::Write || entry.access == Access::Upload;
+        if (!writes) {
+          users[r].push_back(p);
+          continue;
+        }
+        for (PassHandle user : users[r]) AddUnique(pass.dependencies, user);
+        users[r].clear();
+        lastWriter[r] = p;
+      }
+    }
+  }
+
+  // Culling: keep passes with side effects or writing imported resources,
+  // and whatever produced what they use.
+  std::vector<bool> needed(passCount, false);
+  for (PassHandle p = passCount; p-- > 0;) {
+    const Pass& pass = m_passes[p];
+    bool keep = needed[p] || pass.sideEffect;
+    for (const ResourceAccess& entry : pass.accesses)
+      keep |= !m_resources[entry.resource].transient &&
+              (entry.access == Access::Write || entry.access == Access::Upload);
+    if (!keep) continue;
+    needed[p] = true;
+    for (PassHandle producer : pass.producers) needed[producer] = true;
+  }
+
+  // Schedule: of the ready passes, the first one needing no barrier, else the
+  // first one.
+  std::vector<uint32_t> waiting(passCount, 0);
+  std::vector<std::vector<PassHandle>> dependents(passCount);
+  for (PassHandle p = 0; p < passCount; p++) {
+    if (!needed[p]) continue;
+    for (PassHandle dependency : m_passes[p].dependencies) {
+      if (!needed[dependency]) continue;
+      waiting[p]++;
+      dependents[dependency].push_back(p);
+    }
+  }
+
+  std::vector<PassHandle> ready;
+  for (PassHandle p = 0; p < passCount; p++)
+    if (needed[p] && waiting[p] == 0) ready.push_back(p);
+
+  std::vector<bool> bound(resourceCount, false);
+  std::vector<Access> current(resourceCount, Access::Read);
+  for (ResourceHandle r = 0; r < resourceCount; r++)
+    bound[r] = GetInitialAccess(r, current[r]);
+
+  auto transitionsOf = [&](PassHandle p) {
+    std::vector<Transition> transitions;
+    for (const ResourceAccess& entry : m_passes[p].accesses) {
+      const ResourceHandle r = entry.resource;
+      if (bound[r] && NeedsBarrier(current[r], entry.access))
+        transitions.push_back({r, current[r], entry.access});
+    }
+    return transitions;
+  };
+
+  m_schedule.clear();
+  std::vector<uint32_t> lastStep(resourceCount, INVALID_HANDLE);
+  while (!ready.empty()) {
+    std::sort(ready.begin(), ready.end());
+    size_t pick = 0;
+    for (size_t i = 0; i < ready.size(); i++) {
+      if (transitionsOf(ready[i]).empty()) {
+        pick = i;
+        break;
+      }
+    }
+    const PassHandle p = ready[pick];
+    ready.erase(ready.begin() + pick);
+
+    Step step;
+    step.pass = p;
+    step.transitions = transitionsOf(p);
+    // the barrier unbinds everything, not only what this pass needs
+    if (!step.transitions.empty()) bound.assign(resourceCount, false);
+    for (const ResourceAccess& entry : m_passes[p].accesses) {
+      const ResourceHandle r = entry.resource;
+      if (m_resources[r].transient && lastStep[r] == INVALID_HANDLE)
+        step.allocate.push_back(r);
+      lastStep[r] = static_cast<uint32_t>(m_schedule.size());
+      bound[r] = true;
+      current[r] = entry.access;
+    }
+    m_schedule.push_back(step);
+
+    for (PassHandle dependent : dependents[p])
+      if (--waiting[dependent] == 0) ready.push_back(dependent);
+  }
+
+  for (ResourceHandle r = 0; r < resourceCount; r++) {
+    if (m_resources[r].transient && lastStep[r] != INVALID_HANDLE)
+      m_schedule[lastStep[r]].release.push_back(r);
+    // what is still bound after the last barrier
+    if (!m_resources[r].transient && bound[r])
+      m_scheduledAccess[m_resources[r].name] = current[r];
+  }
+}
+
+void RenderGraph::Execute(rhi::Device* device) {
+  for (const Step& step : m_schedule) {
+    if (!step.transitions.empty()) device->Barrier();
+
+    for (ResourceHandle r : step.allocate) {
+      Resource& resource = m_resources[r];
+      auto it = std::find_if(m_pool.begin(), m_pool.end(),
+                             [&resource](const rhi::BufferPtr& buffer) {
+                               return SameDesc(buffer->GetDesc(),
+                                               resource.desc);
+                             });
+      if (it != m_pool.end()) {
+        resource.buffer = *it;
+        m_pool.erase(it);
+      } else {
+        resource.buffer = device->CreateBuffer(resource.desc);
+      }
+    }
+
+    m_passes[step.pass].execute();
+
+    for (ResourceHandle r : step.release) {
+      Resource& resource = m_resources[r];
+      if (resource.buffer != nullptr) m_pool.push_back(resource.buffer);
+      resource.buffer.reset();
+    }
+  }
+
+  // a barrier unbound whatever the schedule does not leave bound
+  if (GetBarrierCount() > 0) m_importedAccess.clear();
+  for (const auto& it : m_scheduledAccess)
+    m_importedAccess[it.first] = it.second;
+}
+
+std::string RenderGraph::Validate() const {
+  const uint32_t resourceCount = static_cast<uint32_t>(m_resources.size());
+
+  std::vector<uint32_t> stepOf(m_passes.size(), INVALID_HANDLE);
+  for (uint32_t s = 0; s < m_schedule.size(); s++) {
+    if (stepOf[m_schedule[s].pass] != INVALID_HANDLE)
+      return "pass " + GetPassName(m_schedule[s].pass) + " scheduled twice";
+    stepOf[m_schedule[s].pass] = s;
+  }
+
+  std::vector<bool> accessed(resourceCount, false);
+  std::vector<Access> current(resourceCount, Access::Read);
+  for (ResourceHandle r = 0; r < resourceCount; r++)
+    accessed[r] = GetInitialAccess(r, current[r]);
+  std::vector<bool> bound = accessed;
+  std::vector<bool> allocated(resourceCount, false);
+  std::vector<bool> released(resourceCount, false);
+
+  for (uint32_t s = 0; s < m_schedule.size(); s++) {
+    const Step& step = m_schedule[s];
+    const Pass& pass = m_passes[step.pass];
+
+    for (PassHandle dependency : pass.dependencies) {
+      const bool producer =
+          std::find(pass.producers.begin(), pass.producers.end(),
+                    dependency) != pass.producers.end();
+      if (stepOf[dependency] == INVALID_HANDLE && !producer) continue;
+      if (stepOf[dependency] == INVALID_HANDLE || stepOf[dependency] > s)
+        return "pass " + pass.name + " runs before " +
+               GetPassName(dependency) + ", which it depends on";
+    }
+
+    for (ResourceHandle r : step.allocate) {
+      if (allocated[r] || released[r])
+        return "transient " + GetResourceName(r) + " allocated twice";
+      allocated[r] = true;
+    }
+
+    if (!step.transitions.empty()) bound.assign(resourceCount, false);
+
+    for (const ResourceAccess& entry : pass.accesses) {
+      const ResourceHandle r = entry.resource;
+      const std::string where =
+          GetResourceName(r) + " in pass " + pass.name + " (" +
+          AccessName(entry.access) + ")";
+
+      if (m_resources[r].transient) {
+        if (!allocated[r] || released[r])
+          return "transient " + where + " used outside its lifetime";
+        if (!accessed[r] && entry.access != Access::Write &&
+            entry.access != Access::Upload)
+          return "transient " + where + " read before it is written";
+      }
+
+      if (bound[r] && NeedsBarrier(current[r], entry.access))
+        return "missing barrier for " + where + " after " +
+               AccessName(current[r]);
+      accessed[r] = true;
+      bound[r] = true;
+      current[r] = entry.access;
+    }
+
+    for (ResourceHandle r : step.release) {
+      if (!allocated[r] || released[r])
+        return "transient " + GetResourceName(r) + " released twice";
+      released[r] = true;
+    }
+  }
+
+  for (ResourceHandle r = 0; r < resourceCount; r++)
+    if (allocated[r] && !released[r])
+      return "transient " + GetResourceName(r) + " never released";
+
+  return std::string();
+}
+
+const rhi::BufferPtr& RenderGraph::GetTransientBuffer(
+    ResourceHandle resource) const {
+  return m_resources[resource].buffer;
+}
+
+uint32_t RenderGraph::GetBarrierCount() const {
+  uint32_t count = 0;
+  for (const Step& step : m_schedule)
+    if (!step.transitions.empty()) count++;
+  return count;
+}
+}  // namespace my
\ No newline at end of file
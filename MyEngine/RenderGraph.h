@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RHI.h"
+
+namespace my {
+// Declarative frame: passes state which resources they read and write, and
+// Compile() derives the schedule from that. Passes run after everything
+// they depend on; among the passes that are ready, one that needs no barrier
+// goes first, then declaration order. A pass whose results nobody uses is
+// culled unless it has side effects, a barrier is placed only where a
+// buffer still bound for writing is read or one still bound for reading is
+// written (rhi::Device::Barrier() unbinds everything, so it clears every
+// pending hazard at once), and transient buffers live from their first to
+// their last use.
+//
+// Imported resources stand for anything the graph does not own (persistent
+// buffers, the render target); the graph only tracks how they are used, and
+// remembers their last access from one frame to the next.
+// Transient buffers are created on the device when the schedule first needs
+// them and go back to a pool after their last use, where later transients
+// with the same description pick them up, within the frame and across
+// frames.
+class RenderGraph {
+ public:
+  using ResourceHandle = uint32_t;
+  using PassHandle = uint32_t;
+  static const uint32_t INVALID_HANDLE = 0xffffffff;
+
+  enum class Access : uint8_t {
+    Read,          // shader resource, constant buffer or copy source
+    Write,         // unordered access (read-modify-write), render target or
+                   // copy destination
+    IndirectArgs,  // arguments of an indirect dispatch or draw
+    Upload,        // CPU writes through Map() or UpdateBuffer(), or creation
+  };
+
+  // Whether D3D11 needs the buffer unbound between the two accesses: a
+  // buffer bound for writing cannot be read, nor a bound one written.
+  // Uploads and indirect arguments never leave the buffer bound.
+  static bool NeedsBarrier(Access before, Access after);
+
+  // Collects the accesses of one pass.
+  class PassBuilder {
+   public:
+    PassBuilder(RenderGraph* graph, PassHandle pass)
+        : m_graph(graph), m_pass(pass) {}
+
+    PassBuilder& Read(ResourceHandle resource);
+    PassBuilder& Write(ResourceHandle resource);
+    PassBuilder& IndirectArgs(ResourceHandle resource);
+    PassBuilder& Upload(ResourceHandle resource);
+    // Never culled, e.g. because it changes CPU state or reads back.
+    PassBuilder& SideEffect();
+
+    PassHandle GetHandle() const { return m_pass; }
+
+   private:
+    RenderGraph* m_graph;
+    PassHandle m_pass;
+  };
+
+  struct Transition {
+    ResourceHandle resource;
+    Access before;
+    Access after;
+  };
+
+  // One entry of the compiled schedule.
+  struct Step {
+    PassHandle pass;
+    std::vector<Transition> transitions;  // a barrier runs first if any
+    std::vector<ResourceHandle> allocate;  // transients first used here
+    std::vector<ResourceHandle> release;   // transients last used here
+  };
+
+  // Drops the passes and resources of the last frame; the transient pool and
+  // the last access of every imported resource are kept.
+  void Reset();
+
+  ResourceHandle ImportResource(const std::string& name);
+  ResourceHandle CreateTransientBuffer(const std::string& name,
+                                       const rhi::BufferDesc& desc);
+
+  PassBuilder AddPass(const std::string& name, std::function<void()> execute);
+
+  void Compile();
+
+  // Runs the compiled schedule, with device->Barrier() only before the steps
+  // that have transitions. Transients are created on device.
+  void Execute(rhi::Device* device);
+
+  // Replays the compiled schedule against the declared accesses: every
+  // dependency runs first, no hazard is left without a barrier, transients are
+  // written before they are read and only used while allocated. Returns an
+  // empty string when the schedule is sound, otherwise what went wrong.
+  std::string Validate() const;
+
+  // Buffer behind a transient during the execution of the passes using it.
+  const rhi::BufferPtr& GetTransientBuffer(ResourceHandle resource) const;
+
+  const std::vector<Step>& GetSchedule() const { return m_schedule; }
+  uint32_t GetBarrierCount() const;
+  uint32_t GetCulledPassCount() const {
+    return static_cast<uint32_t>(m_passes.size() - m_schedule.size());
+  }
+  const std::string& GetPassName(PassHandle pass) const {
+    return m_passes[pass].name;
+  }
+  const std::string& GetResourceName(ResourceHandle resource) const {
+    return m_resources[resource].name;
+  }
+
+ private:
+  struct Resource {
+    std::string name;
+    bool transient = false;
+    rhi::BufferDesc desc;
+    rhi::BufferPtr buffer;  // transients, while allocated
+  };
+
+  struct ResourceAccess {
+    ResourceHandle resource;
+    Access access;
+  };
+
+  struct Pass {
+    std::string name;
+    std::function<void()> execute;
+    std::vector<ResourceAccess> accesses;
+    bool sideEffect = false;
+    std::vector<PassHandle> dependencies;  // must run before this pass
+    std::vector<PassHandle> producers;     // wrote what this pass uses
+  };
+
+  void AddAccess(PassHandle pass, ResourceHandle resource, Access access);
+  // Access of resource before the first pass: what the last executed frame
+  // left an imported resource in, nothing for a transient.
+  bool GetInitialAccess(ResourceHandle resource, Access& access) const;
+
+  std::vector<Resource> m_resources;
+  std::vector<Pass> m_passes;
+  std::vector<Step> m_schedule;
+
+  // Transient buffers not in use, reused by equal descriptions.
+  std::vector<rhi::BufferPtr> m_pool;
+
+  // Last access of each imported resource, by name, after the last
+  // Execute(), and what the compiled schedule will leave them in.
+  std::unordered_map<std::string, Access> m_importedAccess;
+  std::unordered_map<std::string, Access> m_scheduledAccess;
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "SDFColliderSet.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace my {
+namespace {
+// Inverse of the affine transform m, p' = p * A + t for its 3x3 part A and
+// translation t, transposed as the shaders read it.
+float4x4 InverseTransposed(const float4x4& m) {
+  const float a = m.m[0][0], b = m.m[0][1], c = m.m[0][2];
+  const float d = m.m[1][0], e = m.m[1][1], f = m.m[1][2];
+  const float g = m.m[2][0], h = m.m[2][1], i = m.m[2][2];
+  const float cofactor[3][3] = {{e * i - f * h, c * h - b * i, b * f - c * e},
+                                {f * g - d * i, a * i - c * g, c * d - a * f},
+                                {d * h - e * g, b * g - a * h, a * e - b * d}};
+  const float determinant = a * cofactor[0][0] + b * cofactor[1][0] +
+                            c * cofactor[2][0];
+  const float scale = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+
+  float inverse[4][3];
+  for (uint32_t r = 0; r < 3; r++)
+    for (uint32_t col = 0; col < 3; col++)
+      inverse[r][col] = cofactor[r][col] * scale;
+  for (uint32_t col = 0; col < 3; col++) {
+    inverse[3][col] = -(m.m[3][0] * inverse[0][col] +
+                        m.m[3][1] * inverse[1][col] +
+                        m.m[3][2] * inverse[2][col]);
+  }
+
+  float4x4 result;
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t col = 0; col < 3; col++) result.m[col][r] = inverse[r][col];
+    result.m[3][r] = r == 3 ? 1.0f : 0.0f;
+  }
+  return result;
+}
+
+void Place(SDFInstance& instance, const float4x4& transform) {
+  instance.worldToLocal = InverseTransposed(transform);
+  instance.distanceScale =
+      std::sqrt(transform.m[0][0] * transform.m[0][0] +
+                transform.m[0][1] * transform.m[0][1] +
+                transform.m[0][2] * transform.m[0][2]);
+}
+}  // namespace
+
+void SDFColliderSet::Clear() {
+  m_transforms.clear();
+  m_instances.clear();
+  m_bricks.clear();
+  m_samples.clear();
+  m_version++;
+  m_fieldVersion++;
+}
+
+uint32_t SDFColliderSet::Add(const MeshSDF& field, const float4x4& transform) {
+  SDFInstance instance = field.GetConstants();
+  instance.brickOffset = static_cast<uint32_t>(m_bricks.size());
+  Place(instance, transform);
+
+  // the field's brick indices, moved past the samples already packed
+  const uint32_t sampleBrickOffset =
+      static_cast<uint32_t>(m_samples.size() / MeshSDF::SAMPLES_PER_BRICK);
+  for (SDFBrick brick : field.GetBricks()) {
+    if (brick.index != MeshSDF::NO_SAMPLES) brick.index += sampleBrickOffset;
+    m_bricks.push_back(brick);
+  }
+  const std::vector<float>& samples = field.GetSamples();
+  m_samples.insert(m_samples.end(), samples.begin(), samples.end());
+
+  m_transforms.push_back(transform);
+  m_instances.push_back(instance);
+  m_version++;
+  m_fieldVersion++;
+  return static_cast<uint32_t>(m_instances.size() - 1);
+}
+
+bool SDFColliderSet::SetTransform(uint32_t collider,
+                                  const float4x4& transform) {
+  float4x4& target = m_transforms[collider];
+  if (memcmp(&target, &transform, sizeof(float4x4)) == 0) return false;
+  target = transform;
+  Place(m_instances[collider], transform);
+  m_version++;
+  return true;
+}
+
+float SDFColliderSet::GetDistance(const float3& pos, float3* normal) const {
+  float nearest = INFINITY;
+  float direction[3] = {0, 0, 0};
+  for (const SDFInstance& instance : m_instances) {
+    const float4x4& w = instance.worldToLocal;
+    float local[3];
+    for (uint32_t r = 0; r < 3; r++) {
+      local[r] = w.m[r][0] * pos.x + w.m[r][1] * pos.y + w.m[r][2] * pos.z +
+                 w.m[r][3];
+    }
+    float gradient[3];
+    const float distance =
+        SampleSDF(instance, m_bricks.data(), m_samples.data(), local,
+                  gradient) *
+        instance.distanceScale;
+    if (distance >= nearest) continue;
+    nearest = distance;
+
+    // the gradient by world position, through the transposed worldToLocal
+    for (uint32_t c = 0; c < 3; c++) {
+      direction[c] = w.m[0][c] * gradient[0] + w.m[1][c] * gradient[1] +
+                     w.m[2][c] * gradient[2];
+    }
+  }
+  if (normal != nullptr) {
+    const float length =
+        std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] +
+                  direction[2] * direction[2]);
+    const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    normal->x = direction[0] * scale;
+    normal->y = direction[1] * scale;
+    normal->z = direction[2] * scale;
+  }
+  return nearest;
+}
+}  // namespace my
\ No newline at end of file
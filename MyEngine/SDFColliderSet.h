@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MeshSDF.h"
+#include "ParticleSystemTypes.h"
+
+namespace my {
+// Baked distance fields placed in the world, which particles collide with.
+// The fields are packed back to back into one table of instances, bricks and
+// samples, exactly as CS_ParticleSystem_Simulate.hlsl reads them; moving a
+// field only rewrites its instance.
+//
+// Transforms may rotate, translate and scale uniformly. A particle closer to
+// a surface than COLLISION_SKIN is pushed back out along the field's
+// gradient, so a collision costs a few trilinear samples whatever the
+// triangle count. Steps longer than the band of a field can tunnel through
+// it, and particles deeper inside than the band are left alone.
+class SDFColliderSet {
+ public:
+  // A collided particle is put back this far in front of the surface.
+  static constexpr float COLLISION_SKIN = 1e-3f;
+
+  void Clear();
+
+  // Adds a copy of the built field placed with transform and returns its
+  // index.
+  uint32_t Add(const MeshSDF& field, const float4x4& transform);
+  // Places collider with transform; false when that is where it already was.
+  bool SetTransform(uint32_t collider, const float4x4& transform);
+
+  // Distance from pos (WS) to the nearest surface, negative inside, and the
+  // unit direction away from that surface, zero where the fields are flat.
+  // Reads the band of the nearest field where no field reaches.
+  float GetDistance(const float3& pos, float3* normal = nullptr) const;
+
+  bool IsEmpty() const { return m_instances.empty(); }
+  const std::vector<SDFInstance>& GetInstances() const { return m_instances; }
+  const std::vector<SDFBrick>& GetBricks() const { return m_bricks; }
+  const std::vector<float>& GetSamples() const { return m_samples; }
+
+  // Changes with every Add() and SetTransform() that moved something, so
+  // copies of the instances know when to update; GetFieldVersion() only with
+  // the bricks and samples.
+  uint32_t GetVersion() const { return m_version; }
+  uint32_t GetFieldVersion() const { return m_fieldVersion; }
+
+ private:
+  std::vector<float4x4> m_transforms;
+  std::vector<SDFInstance> m_instances;
+  std::vector<SDFBrick> m_bricks;
+  std::vector<float> m_samples;
+
+  uint32_t m_version = 0;
+  uint32_t m_fieldVersion = 0;
+};
+}  // namespace my
\ No newline at end of file
@@ -0,0 +1,269 @@
+#pragma once
+
+// Thin SIMD wrapper for the CPU backends. AVX2 gives 8 lanes, SSE2 (always
+// present on x64) gives 4, and anything else falls back to a 4-wide scalar
+// emulation so the same kernels build on every farm node.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define MY_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MY_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace my {
+namespace simd {
+#if defined(MY_SIMD_AVX2)
+constexpr uint32_t kWidth = 8;
+
+struct vfloat {
+  __m256 v;
+};
+struct vmask {
+  __m256 v;
+};
+
+inline vfloat Set1(float x) { return {_mm256_set1_ps(x)}; }
+inline vfloat Load(const float* p) { return {_mm256_loadu_ps(p)}; }
+inline void Store(float* p, vfloat a) { _mm256_storeu_ps(p, a.v); }
+
+// Loads base[indices[i] * stride] into lane i.
+inline vfloat Gather(const float* base, const uint32_t* indices,
+                     uint32_t stride) {
+  __m256i idx =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+  idx = _mm256_mullo_epi32(idx, _mm256_set1_epi32(static_cast<int>(stride)));
+  return {_mm256_i32gather_ps(base, idx, 4)};
+}
+
+inline vfloat operator+(vfloat a, vfloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline vfloat operator-(vfloat a, vfloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline vfloat operator*(vfloat a, vfloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline vfloat operator/(vfloat a, vfloat b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline vfloat Min(vfloat a, vfloat b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline vfloat Max(vfloat a, vfloat b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline vfloat Sqrt(vfloat a) { return {_mm256_sqrt_ps(a.v)}; }
+inline vfloat Floor(vfloat a) { return {_mm256_floor_ps(a.v)}; }
+// about 12 bits; see Rsqrt()
+inline vfloat RsqrtEstimate(vfloat a) { return {_mm256_rsqrt_ps(a.v)}; }
+
+inline vmask operator<(vfloat a, vfloat b) {
+  return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)};
+}
+inline vmask operator>(vfloat a, vfloat b) {
+  return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)};
+}
+inline vmask operator&(vmask a, vmask b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline vmask operator|(vmask a, vmask b) { return {_mm256_or_ps(a.v, b.v)}; }
+
+// Lanes where mask is set take a, the others take b.
+inline vfloat Select(vmask mask, vfloat a, vfloat b) {
+  return {_mm256_blendv_ps(b.v, a.v, mask.v)};
+}
+inline uint32_t MoveMask(vmask mask) {
+  return static_cast<uint32_t>(_mm256_movemask_ps(mask.v));
+}
+// Lane i is set when bit i of bits is; the inverse of MoveMask.
+inline vmask FromBits(uint32_t bits) {
+  const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256i set = _mm256_and_si256(
+      _mm256_set1_epi32(static_cast<int>(bits)), lanes);
+  return {_mm256_castsi256_ps(_mm256_cmpeq_epi32(set, lanes))};
+}
+
+// e^x by the Cephes expf polynomial, within 2 ulp; x is clamped to the
+// range where the result is a normal float.
+inline vfloat Exp(vfloat x) {
+  __m256 a = _mm256_min_ps(_mm256_max_ps(x.v, _mm256_set1_ps(-87.3f)),
+                           _mm256_set1_ps(88.3f));
+  const __m256i n = _mm256_cvtps_epi32(
+      _mm256_mul_ps(a, _mm256_set1_ps(1.44269504089f)));
+  const __m256 nf = _mm256_cvtepi32_ps(n);
+  a = _mm256_sub_ps(a, _mm256_mul_ps(nf, _mm256_set1_ps(0.693359375f)));
+  a = _mm256_sub_ps(a, _mm256_mul_ps(nf, _mm256_set1_ps(-2.12194440e-4f)));
+
+  __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(1.3981999507e-3f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(8.3334519073e-3f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(4.1665795894e-2f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(1.6666665459e-1f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(5.0000001201e-1f));
+  p = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, a), a),
+                    _mm256_add_ps(a, _mm256_set1_ps(1.0f)));
+
+  const __m256i scale =
+      _mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23);
+  return {_mm256_mul_ps(p, _mm256_castsi256_ps(scale))};
+}
+#elif defined(MY_SIMD_SSE2)
+constexpr uint32_t kWidth = 4;
+
+struct vfloat {
+  __m128 v;
+};
+struct vmask {
+  __m128 v;
+};
+
+inline vfloat Set1(float x) { return {_mm_set1_ps(x)}; }
+inline vfloat Load(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void Store(float* p, vfloat a) { _mm_storeu_ps(p, a.v); }
+
+inline vfloat Gather(const float* base, const uint32_t* indices,
+                     uint32_t stride) {
+  return {_mm_setr_ps(base[indices[0] * stride], base[indices[1] * stride],
+                      base[indices[2] * stride], base[indices[3] * stride])};
+}
+
+inline vfloat operator+(vfloat a, vfloat b) { return {_mm_add_ps(a.v, b.v)}; }
+inline vfloat operator-(vfloat a, vfloat b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline vfloat operator*(vfloat a, vfloat b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline vfloat operator/(vfloat a, vfloat b) { return {_mm_div_ps(a.v, b.v)}; }
+inline vfloat Min(vfloat a, vfloat b) { return {_mm_min_ps(a.v, b.v)}; }
+inline vfloat Max(vfloat a, vfloat b) { return {_mm_max_ps(a.v, b.v)}; }
+inline vfloat Sqrt(vfloat a) { return {_mm_sqrt_ps(a.v)}; }
+// SSE2 has no rounding modes; truncates, so |a| must stay below 2^31
+inline vfloat Floor(vfloat a) {
+  const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+  return {_mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)))};
+}
+inline vfloat RsqrtEstimate(vfloat a) { return {_mm_rsqrt_ps(a.v)}; }
+
+inline vmask operator<(vfloat a, vfloat b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline vmask operator>(vfloat a, vfloat b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline vmask operator&(vmask a, vmask b) { return {_mm_and_ps(a.v, b.v)}; }
+inline vmask operator|(vmask a, vmask b) { return {_mm_or_ps(a.v, b.v)}; }
+
+inline vfloat Select(vmask mask, vfloat a, vfloat b) {
+  return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+}
+inline uint32_t MoveMask(vmask mask) {
+  return static_cast<uint32_t>(_mm_movemask_ps(mask.v));
+}
+inline vmask FromBits(uint32_t bits) {
+  const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+  const __m128i set =
+      _mm_and_si128(_mm_set1_epi32(static_cast<int>(bits)), lanes);
+  return {_mm_castsi128_ps(_mm_cmpeq_epi32(set, lanes))};
+}
+
+inline vfloat Exp(vfloat x) {
+  __m128 a = _mm_min_ps(_mm_max_ps(x.v, _mm_set1_ps(-87.3f)),
+                        _mm_set1_ps(88.3f));
+  const __m128i n =
+      _mm_cvtps_epi32(_mm_mul_ps(a, _mm_set1_ps(1.44269504089f)));
+  const __m128 nf = _mm_cvtepi32_ps(n);
+  a = _mm_sub_ps(a, _mm_mul_ps(nf, _mm_set1_ps(0.693359375f)));
+  a = _mm_sub_ps(a, _mm_mul_ps(nf, _mm_set1_ps(-2.12194440e-4f)));
+
+  __m128 p = _mm_set1_ps(1.9875691500e-4f);
+  p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(1.3981999507e-3f));
+  p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(8.3334519073e-3f));
+  p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(4.1665795894e-2f));
+  p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(1.6666665459e-1f));
+  p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(5.0000001201e-1f));
+  p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, a), a),
+                 _mm_add_ps(a, _mm_set1_ps(1.0f)));
+
+  const __m128i scale =
+      _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+  return {_mm_mul_ps(p, _mm_castsi128_ps(scale))};
+}
+#else
+constexpr uint32_t kWidth = 4;
+
+struct vfloat {
+  float v[4];
+};
+struct vmask {
+  bool v[4];
+};
+
+inline vfloat Set1(float x) { return {{x, x, x, x}}; }
+inline vfloat Load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void Store(float* p, vfloat a) { std::memcpy(p, a.v, sizeof(a.v)); }
+
+inline vfloat Gather(const float* base, const uint32_t* indices,
+                     uint32_t stride) {
+  return {{base[indices[0] * stride], base[indices[1] * stride],
+           base[indices[2] * stride], base[indices[3] * stride]}};
+}
+
+#define MY_SIMD_LANEWISE(Type, expr) \
+  Type r;                            \
+  for (int i = 0; i < 4; i++) r.v[i] = (expr);  \
+  return r
+
+inline vfloat operator+(vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vfloat, a.v[i] + b.v[i]);
+}
+inline vfloat operator-(vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vfloat, a.v[i] - b.v[i]);
+}
+inline vfloat operator*(vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vfloat, a.v[i] * b.v[i]);
+}
+inline vfloat operator/(vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vfloat, a.v[i] / b.v[i]);
+}
+inline vfloat Min(vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vfloat, a.v[i] < b.v[i] ? a.v[i] : b.v[i]);
+}
+inline vfloat Max(vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vfloat, a.v[i] > b.v[i] ? a.v[i] : b.v[i]);
+}
+inline vfloat Sqrt(vfloat a) { MY_SIMD_LANEWISE(vfloat, std::sqrt(a.v[i])); }
+inline vfloat Floor(vfloat a) { MY_SIMD_LANEWISE(vfloat, std::floor(a.v[i])); }
+inline vfloat RsqrtEstimate(vfloat a) {
+  MY_SIMD_LANEWISE(vfloat, 1.0f / std::sqrt(a.v[i]));
+}
+
+inline vmask operator<(vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vmask, a.v[i] < b.v[i]);
+}
+inline vmask operator>(vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vmask, a.v[i] > b.v[i]);
+}
+inline vmask operator&(vmask a, vmask b) {
+  MY_SIMD_LANEWISE(vmask, a.v[i] && b.v[i]);
+}
+inline vmask operator|(vmask a, vmask b) {
+  MY_SIMD_LANEWISE(vmask, a.v[i] || b.v[i]);
+}
+
+inline vfloat Select(vmask mask, vfloat a, vfloat b) {
+  MY_SIMD_LANEWISE(vfloat, mask.v[i] ? a.v[i] : b.v[i]);
+}
+inline uint32_t MoveMask(vmask mask) {
+  return (mask.v[0] ? 1u : 0u) | (mask.v[1] ? 2u : 0u) |
+         (mask.v[2] ? 4u : 0u) | (mask.v[3] ? 8u : 0u);
+}
+inline vmask FromBits(uint32_t bits) {
+  MY_SIMD_LANEWISE(vmask, ((bits >> i) & 1) != 0);
+}
+
+inline vfloat Exp(vfloat x) { MY_SIMD_LANEWISE(vfloat, std::exp(x.v[i])); }
+
+#undef MY_SIMD_LANEWISE
+#endif
+
+inline vfloat MulAdd(vfloat a, vfloat b, vfloat c) { return a * b + c; }
+
+inline vfloat Lerp(vfloat a, vfloat b, vfloat t) { return a + (b - a) * t; }
+
+// 1 / sqrt(a) to about 22 bits: the estimate and one Newton-Raphson step,
+// much cheaper than a square root and a division.
+inline vfloat Rsqrt(vfloat a) {
+  const vfloat e = RsqrtEstimate(a);
+  return e * (Set1(1.5f) - Set1(0.5f) * a * e * e);
+}
+
+inline vfloat Saturate(vfloat a) { return Min(Max(a, Set1(0.0f)), Set1(1.0f)); }
+}  // namespace simd
+}  // namespace my
\ No newline at end of file
@@ -12,9 +12,18 @@ fxc /E main /T gs_5_0 ./hlsl/GS_ParticleSystem.hlsl /Fo ./hlsl/objs/GS_ParticleS
 :: PS
 fxc /E main /T ps_5_0 ./hlsl/PS_Default.hlsl /Fo ./hlsl/objs/PS_Default
 fxc /E main /T ps_5_0 ./hlsl/PS_ParticleSystem.hlsl /Fo ./hlsl/objs/PS_ParticleSystem
+fxc /E PS_RayMARCH /T ps_5_0 ./hlsl/PS_RayMARCH.hlsl /Fo ./hlsl/objs/PS_RayMARCH
+fxc /E PS_RayMARCH /T ps_5_0 /D USE_DISTANCE_VOLUME ./hlsl/PS_RayMARCH.hlsl /Fo ./hlsl/objs/PS_RayMARCH_VOLUME
 
 :: CS
 fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_KickoffUpdate.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_KickoffUpdate
 fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_Emit.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_Emit
 fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_Emit_FROMMESH.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_Emit_FROMMESH
-fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_Simulate.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_Simulate
\ No newline at end of file
+fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_Simulate.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_Simulate
+fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_Grow.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_Grow
+fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_FinishUpdate.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_FinishUpdate
+fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_SPH_Count.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_SPH_Count
+fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_SPH_Offsets.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_SPH_Offsets
+fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_SPH_Scatter.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_SPH_Scatter
+fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_SPH_Density.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_SPH_Density
+fxc /E main /T cs_5_0 ./hlsl/CS_ParticleSystem_SPH_Force.hlsl /Fo ./hlsl/objs/CS_ParticleSystem_SPH_Force
\ No newline at end of file
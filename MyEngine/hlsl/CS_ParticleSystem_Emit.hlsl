@@ -7,60 +7,94 @@ RWStructuredBuffer<uint> deadBuffer : register(u3);
 RWByteAddressBuffer counterBuffer : register(u4);
 
 #ifdef EMIT_FROM_MESH
+// pooled geometry of every emitter mesh, tightly packed float3 positions
 ByteAddressBuffer meshVertexBuffer : register(t0);
 ByteAddressBuffer meshIndexBuffer : register(t1);
+// emission sets of all emitters back to back: area-weighted alias buckets
+// over the triangles each emitter may emit from
+StructuredBuffer<EmissionEntry> emissionSets : register(t3);
+
+static const uint VERTEXBUFFER_POS_STRIDE = 12;
 #endif
 
-[numthreads(1, 1, 1)]
+StructuredBuffer<EmitterParams> emitterTable : register(t2);
+
+// Emitter owning emit thread emitIndex: the last row whose range starts at or
+// before it (rows that emit nothing share their offset with the next row).
+uint FindEmitter(uint emitIndex)
+{
+    uint lo = 0;
+    uint hi = xEmitterCount;
+    while (lo + 1 < hi)
+    {
+        const uint mid = (lo + hi) / 2;
+        if (emitterTable[mid].emitOffset <= emitIndex)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+[numthreads(THREADCOUNT_EMIT, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
     uint emitCount = counterBuffer.Load(PARTICLECOUNTER_OFFSET_REALEMITCOUNT);
     if (DTid.x >= emitCount)
         return;
   
+    const uint emitterIndex = FindEmitter(DTid.x);
+    const EmitterParams emitter = emitterTable[emitterIndex];
+  
+    // streams are numbered per emitter, so adding or removing another emitter
+    // does not change this one's particles
     RNG rng;
-    rng.init(uint2(xEmitterRandomness, DTid.x), frame_count);
+    rng.init(emitter.seed, DTid.x - emitter.emitOffset, frame_count);
     
-    const float4x4 worldMatrix = xEmitterWorld;
+    const float4x4 worldMatrix = emitter.world;
     float3 emitPos = 0;
     float3 nor = 0;
-    float3 velocity = xParticleVelocity;
-    float4 baseColor = unpack_rgba(xParticleColor);
+    float3 velocity = emitter.velocity;
+    float4 baseColor = unpack_rgba(emitter.color);
 
 #ifdef EMIT_FROM_MESH
-	// random triangle on emitter surface:
-    const uint triangleCount = xEmitterMeshIndexCount / 3;
-    const uint tri = rng.next_uint(triangleCount);
+    [branch]
+    if (emitter.emissionSetCount > 0)
+    {
+		// random triangle of the emission set, proportional to its area:
+        float fraction;
+        const uint bucket = rng.next_uint_frac(emitter.emissionSetCount, fraction);
+        const EmissionEntry entry = emissionSets[emitter.emissionSetOffset + bucket];
+        const uint tri = fraction < entry.probability ? entry.triangle : entry.aliasTriangle;
 
-	// load indices of triangle from index buffer
-    const uint stride = 4;
-    uint i0 = meshIndexBuffer.Load(tri * 3 * stride);
-    uint i1 = meshIndexBuffer.Load(tri * 3 * stride + stride);
-    uint i2 = meshIndexBuffer.Load(tri * 3 * stride + stride * 2);
+		// load indices of triangle from index buffer
+        const uint stride = 4;
+        const uint3 indices = meshIndexBuffer.Load3((emitter.meshIndexOffset + tri * 3) * stride);
+        uint i0 = emitter.meshVertexOffset + indices.x;
+        uint i1 = emitter.meshVertexOffset + indices.y;
+        uint i2 = emitter.meshVertexOffset + indices.z;
 
-	// load vertices of triangle from vertex buffer:
-    float3 pos0 = asfloat(meshVertexBuffer.Load3(i0 * xEmitterMeshVertexPositionStride));
-    float3 pos1 = asfloat(meshVertexBuffer.Load3(i1 * xEmitterMeshVertexPositionStride));
-    float3 pos2 = asfloat(meshVertexBuffer.Load3(i2 * xEmitterMeshVertexPositionStride));
+		// load vertices of triangle from vertex buffer:
+        float3 pos0 = asfloat(meshVertexBuffer.Load3(i0 * VERTEXBUFFER_POS_STRIDE));
+        float3 pos1 = asfloat(meshVertexBuffer.Load3(i1 * VERTEXBUFFER_POS_STRIDE));
+        float3 pos2 = asfloat(meshVertexBuffer.Load3(i2 * VERTEXBUFFER_POS_STRIDE));
 
-	// random barycentric coords:
-    float f = rng.next_float();
-    float g = rng.next_float();
-	[flatten]
-    if (f + g > 1)
-    {
-        f = 1 - f;
-        g = 1 - g;
-    }
-    float2 bary = float2(f, g);
+		// random barycentric coords:
+        float f = rng.next_float();
+        float g = rng.next_float();
+		[flatten]
+        if (f + g > 1)
+        {
+            f = 1 - f;
+            g = 1 - g;
+        }
+        float2 bary = float2(f, g);
 
-	// compute final surface position on triangle from barycentric coords:
-    emitPos = attribute_at_bary(pos0, pos1, pos2, bary);
-    nor = normalize(cross(pos1 - pos0, pos2 - pos0));
-    nor = normalize(mul(nor, (float3x3) worldMatrix));
-    
-    if (length(velocity) > 0 && abs(dot(nor, normalize(velocity))) < 0.9f)
-        return;
+		// compute final surface position on triangle from barycentric coords:
+        emitPos = attribute_at_bary(pos0, pos1, pos2, bary);
+        nor = normalize(cross(pos1 - pos0, pos2 - pos0));
+        nor = normalize(mul(nor, (float3x3) worldMatrix));
+    }
     
 #else
     // Just emit from center point:
@@ -69,34 +103,34 @@ void main(uint3 DTid : SV_DispatchThreadID)
     
     float3 pos = mul(float4(emitPos, 1), worldMatrix).xyz;
     
-    float particleStartingSize = xParticleSize + xParticleSize * (rng.next_float() - 0.5f) * xParticleRandomFactor;
+    float particleStartingSize = emitter.size + emitter.size * (rng.next_float() - 0.5f) * emitter.randomFactor;
     
     // create new particle:
     Particle particle;
     particle.position = pos;
-    particle.force = 0;
-    particle.mass = xParticleMass;
-    particle.velocity = velocity + (nor + (float3(rng.next_float(), rng.next_float(), rng.next_float()) - 0.5f) * xParticleRandomFactor) * xParticleNormalFactor;
-    particle.rotationalVelocity = xParticleRotation + (rng.next_float() - 0.5f) * xParticleRandomFactor;
-    particle.maxLife = xParticleLifeSpan + xParticleLifeSpan * (rng.next_float() - 0.5f) * xParticleLifeSpanRandomness;
+    particle.positionPrev = particle.position;
+    particle.emitterIndex = emitterIndex;
+    particle.velocity = velocity + (nor + (float3(rng.next_float(), rng.next_float(), rng.next_float()) - 0.5f) * emitter.randomFactor) * emitter.normalFactor;
+    particle.rotationalVelocity = emitter.rotation + (rng.next_float() - 0.5f) * emitter.randomFactor;
+    particle.maxLife = emitter.lifeSpan + emitter.lifeSpan * (rng.next_float() - 0.5f) * emitter.lifeSpanRandomness;
     particle.life = particle.maxLife;
-    particle.sizeBeginEnd = float2(particleStartingSize, particleStartingSize * xParticleScaling);
+    particle.sizeBeginEnd = float2(particleStartingSize, particleStartingSize * emitter.scaling);
     
-    baseColor.r *= lerp(1, rng.next_float(), xParticleRandomColorFactor);
-    baseColor.g *= lerp(1, rng.next_float(), xParticleRandomColorFactor);
-    baseColor.b *= lerp(1, rng.next_float(), xParticleRandomColorFactor);
+    baseColor.r *= lerp(1, rng.next_float(), emitter.randomColorFactor);
+    baseColor.g *= lerp(1, rng.next_float(), emitter.randomColorFactor);
+    baseColor.b *= lerp(1, rng.next_float(), emitter.randomColorFactor);
     particle.color = pack_rgba(baseColor);
     
-    // new particle index retrieved from dead list (pop):
-    uint deadCount;
-    counterBuffer.InterlockedAdd(PARTICLECOUNTER_OFFSET_DEADCOUNT, -1, deadCount);
-    uint newParticleIndex = deadBuffer[deadCount - 1];
+    // the kickoff already reserved the emitted ranges of both lists, so
+    // thread i pops the i-th dead slot from the top and pushes it to the
+    // i-th reserved alive entry (the same slots the CPU backend picks):
+    const uint deadCount = counterBuffer.Load(PARTICLECOUNTER_OFFSET_DEADCOUNT);
+    const uint aliveCount = counterBuffer.Load(PARTICLECOUNTER_OFFSET_ALIVECOUNT);
+    uint newParticleIndex = deadBuffer[deadCount + emitCount - 1 - DTid.x];
     
     // write out the new particle:
     particleBuffer[newParticleIndex] = particle;
     
     // and add index to the alive list (push):
-    uint aliveCount;
-    counterBuffer.InterlockedAdd(PARTICLECOUNTER_OFFSET_ALIVECOUNT, 1, aliveCount);
-    aliveBuffer_CURRENT[aliveCount] = newParticleIndex;
+    aliveBuffer_CURRENT[aliveCount - emitCount + DTid.x] = newParticleIndex;
 }
\ No newline at end of file
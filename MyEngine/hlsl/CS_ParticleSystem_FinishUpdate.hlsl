@@ -0,0 +1,14 @@
+#include "Header.hlsli"
+
+RWByteAddressBuffer counterBuffer : register(u4);
+RWByteAddressBuffer indirectBuffers : register(u5);
+
+[numthreads(1, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    // the NEW alive list holds exactly the survivors of the simulate pass, so
+    // it doubles as the draw list; draw one point per entry:
+    uint aliveCount_NEW = counterBuffer.Load(PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION);
+
+    indirectBuffers.Store4(ARGUMENTBUFFER_OFFSET_DRAWPARTICLES, uint4(aliveCount_NEW, 1, 0, 0));
+}
\ No newline at end of file
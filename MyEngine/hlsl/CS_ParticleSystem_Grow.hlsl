@@ -0,0 +1,16 @@
+#include "Header.hlsli"
+
+RWStructuredBuffer<uint> deadBuffer : register(u3);
+RWByteAddressBuffer counterBuffer : register(u4);
+
+[numthreads(THREADCOUNT_EMIT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    if (DTid.x >= xEmitterGrowCount)
+        return;
+
+    // push the new slot onto the dead list, after the ones already free:
+    uint deadIndex;
+    counterBuffer.InterlockedAdd(PARTICLECOUNTER_OFFSET_DEADCOUNT, 1, deadIndex);
+    deadBuffer[deadIndex] = xEmitterGrowOffset + DTid.x;
+}
\ No newline at end of file
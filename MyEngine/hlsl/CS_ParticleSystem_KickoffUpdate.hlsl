@@ -1,6 +1,7 @@
 #include "Header.hlsli"
 
 RWByteAddressBuffer counterBuffer : register(u4);
+RWByteAddressBuffer indirectBuffers : register(u5);
 
 [numthreads(1, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
@@ -12,14 +13,23 @@ void main(uint3 DTid : SV_DispatchThreadID)
     uint aliveCount_NEW = counterBuffer.Load(PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION);
 
 	// we can not emit more than there are free slots in the dead list:
-    uint realEmitCount = min(deadCount, xEmitCount);
+    uint realEmitCount = min(deadCount, xEmitTotal);
 
-	// copy new alivelistcount to current alivelistcount:
-    counterBuffer.Store(PARTICLECOUNTER_OFFSET_ALIVECOUNT, aliveCount_NEW);
+	// every emit thread yields exactly one particle, so reserve the emitted
+	// range up front: with the counts stored below, emit thread i pops
+	// dead[deadCount + realEmitCount - 1 - i] (the i-th slot from the old
+	// top, as the CPU backend does) and pushes
+	// alive[aliveCount - realEmitCount + i] without any atomics
+    counterBuffer.Store(PARTICLECOUNTER_OFFSET_ALIVECOUNT, aliveCount_NEW + realEmitCount);
+    counterBuffer.Store(PARTICLECOUNTER_OFFSET_DEADCOUNT, deadCount - realEmitCount);
 
 	// reset new alivecount:
     counterBuffer.Store(PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION, 0);
 
 	// write real emit count:
     counterBuffer.Store(PARTICLECOUNTER_OFFSET_REALEMITCOUNT, realEmitCount);
+
+    // size the emit and simulate dispatches to the work that exists:
+    indirectBuffers.Store3(ARGUMENTBUFFER_OFFSET_DISPATCHEMIT, uint3((realEmitCount + THREADCOUNT_EMIT - 1) / THREADCOUNT_EMIT, 1, 1));
+    indirectBuffers.Store3(ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION, uint3((aliveCount_NEW + realEmitCount + THREADCOUNT_SIMULATION - 1) / THREADCOUNT_SIMULATION, 1, 1));
 }
\ No newline at end of file
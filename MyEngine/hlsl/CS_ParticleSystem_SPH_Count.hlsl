@@ -0,0 +1,32 @@
+#include "Header.hlsli"
+
+// First pass of the SPH neighbor grid: counts the alive fluid particles of
+// every bucket, and remembers the bucket of each and its rank in there.
+
+StructuredBuffer<Particle> particleBuffer : register(t0);
+StructuredBuffer<uint> aliveBuffer_CURRENT : register(t1);
+StructuredBuffer<EmitterParams> emitterTable : register(t2);
+
+RWStructuredBuffer<uint> cellCountBuffer : register(u0);
+RWStructuredBuffer<uint2> rankBuffer : register(u1);
+RWByteAddressBuffer counterBuffer : register(u4);
+
+[numthreads(THREADCOUNT_SIMULATION, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    uint aliveCount = counterBuffer.Load(PARTICLECOUNTER_OFFSET_ALIVECOUNT);
+    if (DTid.x >= aliveCount)
+        return;
+
+    Particle particle = particleBuffer[aliveBuffer_CURRENT[DTid.x]];
+
+    // dying particles are left out, the simulation kills them anyway
+    uint bucket = SPH_NO_BUCKET;
+    uint rank = 0;
+    if (emitterTable[particle.emitterIndex].sph && particle.life > 0)
+    {
+        bucket = sph_bucket(sph_cell(particle.position));
+        InterlockedAdd(cellCountBuffer[bucket], 1, rank);
+    }
+    rankBuffer[DTid.x] = uint2(bucket, rank);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "Header.hlsli"
+
+// SPH density of every fluid particle, in sorted order, from the particles
+// of the 27 cells around it (poly6 kernel).
+
+StructuredBuffer<Particle> particleBuffer : register(t0);
+StructuredBuffer<EmitterParams> emitterTable : register(t2);
+StructuredBuffer<uint> sortedBuffer : register(t4);
+StructuredBuffer<uint> cellStartBuffer : register(t5);
+
+RWStructuredBuffer<float> densityBuffer : register(u0); // per particle slot
+
+[numthreads(THREADCOUNT_SIMULATION, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    if (DTid.x >= cellStartBuffer[SPH_GRID_SIZE])
+        return;
+
+    const uint particleIndex = sortedBuffer[DTid.x];
+    const float3 position = particleBuffer[particleIndex].position;
+    const int3 cell = sph_cell(position);
+
+    float density = 0;
+    for (int z = -1; z <= 1; ++z)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            for (int x = -1; x <= 1; ++x)
+            {
+                const int3 neighborCell = cell + int3(x, y, z);
+                const uint bucket = sph_bucket(neighborCell);
+                const uint end = cellStartBuffer[bucket + 1];
+                for (uint i = cellStartBuffer[bucket]; i < end; ++i)
+                {
+                    const Particle neighbor = particleBuffer[sortedBuffer[i]];
+
+                    // two of the cells may share a bucket; count it once
+                    if (any(sph_cell(neighbor.position) != neighborCell))
+                        continue;
+
+                    const float3 d = neighbor.position - position;
+                    const float r2 = dot(d, d);
+                    if (r2 < xSPH_h2)
+                    {
+                        const float w = xSPH_h2 - r2;
+                        density += emitterTable[neighbor.emitterIndex].mass * w * w * w;
+                    }
+                }
+            }
+        }
+    }
+
+    densityBuffer[particleIndex] = xSPH_poly6_constant * density;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "Header.hlsli"
+
+// SPH pressure (spiky kernel) and viscosity forces on every fluid particle,
+// in sorted order. What is written is the acceleration, force / density,
+// which the simulation integrates.
+
+StructuredBuffer<Particle> particleBuffer : register(t0);
+StructuredBuffer<EmitterParams> emitterTable : register(t2);
+StructuredBuffer<uint> sortedBuffer : register(t4);
+StructuredBuffer<uint> cellStartBuffer : register(t5);
+StructuredBuffer<float> densityBuffer : register(t6); // per particle slot
+
+RWStructuredBuffer<float4> forceBuffer : register(u0); // per particle slot
+
+[numthreads(THREADCOUNT_SIMULATION, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    if (DTid.x >= cellStartBuffer[SPH_GRID_SIZE])
+        return;
+
+    const uint particleIndex = sortedBuffer[DTid.x];
+    const float density = densityBuffer[particleIndex];
+    if (!(density > 0))
+    {
+        forceBuffer[particleIndex] = 0;
+        return;
+    }
+
+    const Particle particle = particleBuffer[particleIndex];
+    const int3 cell = sph_cell(particle.position);
+    const float pressure = xSPH_K * (density - xSPH_p0);
+
+    float3 pressureSum = 0;
+    float3 viscositySum = 0;
+    for (int z = -1; z <= 1; ++z)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            for (int x = -1; x <= 1; ++x)
+            {
+                const int3 neighborCell = cell + int3(x, y, z);
+                const uint bucket = sph_bucket(neighborCell);
+                const uint end = cellStartBuffer[bucket + 1];
+                for (uint i = cellStartBuffer[bucket]; i < end; ++i)
+                {
+                    const uint neighborIndex = sortedBuffer[i];
+                    const Particle neighbor = particleBuffer[neighborIndex];
+
+                    // two of the cells may share a bucket; count it once
+                    if (any(sph_cell(neighbor.position) != neighborCell))
+                        continue;
+
+                    // the particle itself and ones at the same spot have no
+                    // direction
+                    const float3 d = particle.position - neighbor.position;
+                    const float r2 = dot(d, d);
+                    if (r2 >= xSPH_h2 || r2 <= 0)
+                        continue;
+
+                    const float r = sqrt(r2);
+                    const float hr = xSPH_h - r;
+                    const float neighborDensity = densityBuffer[neighborIndex];
+                    const float massOverDensity = neighborDensity > 0 ? emitterTable[neighbor.emitterIndex].mass / neighborDensity : 0;
+                    const float neighborPressure = xSPH_K * (neighborDensity - xSPH_p0);
+
+                    // m / rho * (p_i + p_j) / 2 times the spiky gradient,
+                    // (h - r)^2 along d / r
+                    pressureSum += massOverDensity * (pressure + neighborPressure) * 0.5 * hr * hr * d / r;
+                    // m / rho times the viscosity laplacian, h - r
+                    viscositySum += massOverDensity * hr * (neighbor.velocity - particle.velocity);
+                }
+            }
+        }
+    }
+
+    const float3 force = -xSPH_spiky_constant * pressureSum + xSPH_e * xSPH_visc_constant * viscositySum;
+    forceBuffer[particleIndex] = float4(force / density, 0);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "Header.hlsli"
+
+// Exclusive prefix sum of the bucket counts in a single group: the first
+// sorted particle of every bucket, and the fluid particle count at
+// SPH_GRID_SIZE. The counts are cleared for the next step on the way.
+
+RWStructuredBuffer<uint> cellCountBuffer : register(u0);
+RWStructuredBuffer<uint> cellStartBuffer : register(u1);
+
+static const uint BUCKETS_PER_THREAD = SPH_GRID_SIZE / THREADCOUNT_SPH_OFFSETS;
+
+groupshared uint threadSums[THREADCOUNT_SPH_OFFSETS];
+
+[numthreads(THREADCOUNT_SPH_OFFSETS, 1, 1)]
+void main(uint3 GTid : SV_GroupThreadID)
+{
+    const uint firstBucket = GTid.x * BUCKETS_PER_THREAD;
+
+    uint sum = 0;
+    for (uint i = 0; i < BUCKETS_PER_THREAD; ++i)
+    {
+        sum += cellCountBuffer[firstBucket + i];
+    }
+    threadSums[GTid.x] = sum;
+    GroupMemoryBarrierWithGroupSync();
+
+    // inclusive scan of the thread sums:
+    for (uint offset = 1; offset < THREADCOUNT_SPH_OFFSETS; offset *= 2)
+    {
+        uint value = GTid.x >= offset ? threadSums[GTid.x - offset] : 0;
+        GroupMemoryBarrierWithGroupSync();
+        threadSums[GTid.x] += value;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    uint start = threadSums[GTid.x] - sum;
+    for (uint bucket = firstBucket; bucket < firstBucket + BUCKETS_PER_THREAD; ++bucket)
+    {
+        const uint count = cellCountBuffer[bucket];
+        cellStartBuffer[bucket] = start;
+        cellCountBuffer[bucket] = 0;
+        start += count;
+    }
+
+    if (GTid.x == THREADCOUNT_SPH_OFFSETS - 1)
+    {
+        cellStartBuffer[SPH_GRID_SIZE] = start;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include "Header.hlsli"
+
+// Last pass of the SPH neighbor grid: every fluid particle takes the sorted
+// slot its bucket start and rank give it.
+
+StructuredBuffer<uint> aliveBuffer_CURRENT : register(t1);
+StructuredBuffer<uint2> rankBuffer : register(t4);
+StructuredBuffer<uint> cellStartBuffer : register(t5);
+
+RWStructuredBuffer<uint> sortedBuffer : register(u0);
+RWByteAddressBuffer counterBuffer : register(u4);
+
+[numthreads(THREADCOUNT_SIMULATION, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    uint aliveCount = counterBuffer.Load(PARTICLECOUNTER_OFFSET_ALIVECOUNT);
+    if (DTid.x >= aliveCount)
+        return;
+
+    const uint2 rank = rankBuffer[DTid.x];
+    if (rank.x == SPH_NO_BUCKET)
+        return;
+
+    sortedBuffer[cellStartBuffer[rank.x] + rank.y] = aliveBuffer_CURRENT[DTid.x];
+}
\ No newline at end of file
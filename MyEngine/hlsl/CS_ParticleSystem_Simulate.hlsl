@@ -6,41 +6,325 @@ RWStructuredBuffer<uint> aliveBuffer_NEW : register(u2);
 RWStructuredBuffer<uint> deadBuffer : register(u3);
 RWByteAddressBuffer counterBuffer : register(u4);
 
-static const uint VERTEXBUFFER_POS_STRIDE = 12;
+StructuredBuffer<EmitterParams> emitterTable : register(t2);
+StructuredBuffer<float4> sphForceBuffer : register(t3); // acceleration per slot
+StructuredBuffer<BVHNode> colliderNodes : register(t4);
+StructuredBuffer<BVHTriangle> colliderTriangles : register(t5);
+StructuredBuffer<SDFInstance> distanceColliders : register(t6);
+StructuredBuffer<SDFBrick> distanceBricks : register(t7);
+StructuredBuffer<float> distanceSamples : register(t8);
+StructuredBuffer<ForceFieldParams> forceFields : register(t9);
 
-[numthreads(1, 1, 1)]
+// Slab test of from + d * t, t in [0, tMax), against the bounds of node;
+// tNear is where the segment enters them.
+bool collider_bounds(BVHNode node, float3 from, float3 inverse, float tMax, out float tNear)
+{
+    const float3 t0 = (node.boundsMin - from) * inverse;
+    const float3 t1 = (node.boundsMax - from) * inverse;
+    const float3 lo = min(t0, t1);
+    const float3 hi = max(t0, t1);
+    tNear = max(max(lo.x, lo.y), max(lo.z, 0));
+    const float tFar = min(min(hi.x, hi.y), min(hi.z, tMax));
+    return !(tFar < tNear);
+}
+
+// Moeller-Trumbore, both sides: where from + d * t crosses the triangle, if
+// that is in [0, tMax).
+bool collider_triangle(BVHTriangle tri, float3 from, float3 d, float tMax, out float t)
+{
+    t = tMax;
+    const float3 e1 = tri.v1 - tri.v0;
+    const float3 e2 = tri.v2 - tri.v0;
+    const float3 p = cross(d, e2);
+    const float det = dot(e1, p);
+    if (det * det < 1e-30)
+        return false;
+    
+    const float inverse = 1 / det;
+    const float3 s = from - tri.v0;
+    const float u = dot(s, p) * inverse;
+    const float3 q = cross(s, e1);
+    const float v = dot(d, q) * inverse;
+    const float crossing = dot(e2, q) * inverse;
+    if (u < 0 || v < 0 || u + v > 1 || crossing < 0 || !(crossing < tMax))
+        return false;
+    t = crossing;
+    return true;
+}
+
+// Nearest crossing of the segment from -> to with the collider, as
+// MeshBVH::IntersectSegment() (C++) finds it: depth first, nearer child
+// first. normal is the unit triangle normal on the side of from.
+bool collider_segment(float3 from, float3 to, out float hitT, out float3 normal)
+{
+    hitT = 1;
+    normal = 0;
+    const float3 d = to - from;
+    const float3 inverse = 1 / (abs(d) < 1e-20 ? 1e-20 : d);
+    
+    float tNear;
+    if (xColliderNodeCount == 0 || !collider_bounds(colliderNodes[0], from, inverse, hitT, tNear))
+        return false;
+    
+    uint hitTriangle = 0xFFFFFFFF;
+    uint stack[BVH_MAX_DEPTH];
+    uint stackSize = 0;
+    uint nodeIndex = 0;
+    [loop]
+    while (true)
+    {
+        const BVHNode node = colliderNodes[nodeIndex];
+        if (node.triangleCount > 0)
+        {
+            for (uint i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++)
+            {
+                float t;
+                if (collider_triangle(colliderTriangles[i], from, d, hitT, t))
+                {
+                    hitT = t;
+                    hitTriangle = i;
+                }
+            }
+        }
+        else
+        {
+            const uint left = node.leftFirst;
+            float nearLeft, nearRight;
+            const bool hitLeft = collider_bounds(colliderNodes[left], from, inverse, hitT, nearLeft);
+            const bool hitRight = collider_bounds(colliderNodes[left + 1], from, inverse, hitT, nearRight);
+            if (hitLeft && hitRight)
+            {
+                const bool rightFirst = nearRight < nearLeft;
+                stack[stackSize++] = rightFirst ? left : left + 1;
+                nodeIndex = rightFirst ? left + 1 : left;
+                continue;
+            }
+            if (hitLeft || hitRight)
+            {
+                nodeIndex = hitLeft ? left : left + 1;
+                continue;
+            }
+        }
+        if (stackSize == 0)
+            break;
+        nodeIndex = stack[--stackSize];
+    }
+    
+    if (hitTriangle == 0xFFFFFFFF)
+        return false;
+    const BVHTriangle tri = colliderTriangles[hitTriangle];
+    normal = normalize(cross(tri.v1 - tri.v0, tri.v2 - tri.v0));
+    normal = dot(normal, d) > 0 ? -normal : normal;
+    return true;
+}
+
+// Trilinear sample of a distance collider at pos (OS), as SampleSDF() (C++)
+// takes it, and the gradient of the interpolation.
+float sdf_sample(SDFInstance instance, float3 pos, out float3 gradient)
+{
+    gradient = 0;
+    const float3 voxel = (pos - instance.volumeMin) / instance.voxelSize;
+    const int3 brick = (int3) floor(voxel / SDF_BRICK_SIZE);
+    if (any(brick < 0) || any(brick >= (int3) instance.brickDim))
+        return instance.band;
+
+    const SDFBrick entry = distanceBricks[instance.brickOffset + (brick.z * instance.brickDim.y + brick.y) * instance.brickDim.x + brick.x];
+    if (entry.index == SDF_NO_SAMPLES)
+        return entry.value;
+
+    const float3 local = voxel - brick * SDF_BRICK_SIZE;
+    const uint3 cell = min((uint3) local, SDF_BRICK_SIZE - 1);
+    const float3 t = local - cell;
+
+    const uint axis = SDF_BRICK_SIZE + 1;
+    const uint base = entry.index * axis * axis * axis + (cell.z * axis + cell.y) * axis + cell.x;
+    const float c000 = distanceSamples[base];
+    const float c100 = distanceSamples[base + 1];
+    const float c010 = distanceSamples[base + axis];
+    const float c110 = distanceSamples[base + axis + 1];
+    const float c001 = distanceSamples[base + axis * axis];
+    const float c101 = distanceSamples[base + axis * axis + 1];
+    const float c011 = distanceSamples[base + axis * axis + axis];
+    const float c111 = distanceSamples[base + axis * axis + axis + 1];
+
+    const float x00 = lerp(c000, c100, t.x);
+    const float x10 = lerp(c010, c110, t.x);
+    const float x01 = lerp(c001, c101, t.x);
+    const float x11 = lerp(c011, c111, t.x);
+    const float y0 = lerp(x00, x10, t.y);
+    const float y1 = lerp(x01, x11, t.y);
+    gradient.x = lerp(lerp(c100 - c000, c110 - c010, t.y), lerp(c101 - c001, c111 - c011, t.y), t.z);
+    gradient.y = lerp(x10 - x00, x11 - x01, t.z);
+    gradient.z = y1 - y0;
+    gradient /= instance.voxelSize;
+    return lerp(y0, y1, t.z);
+}
+
+// Distance from pos (WS) to the nearest distance collider surface and the
+// unit direction away from it, as SDFColliderSet::GetDistance() (C++).
+float sdf_distance(float3 pos, out float3 normal)
+{
+    float nearest = 1e30;
+    float3 direction = 0;
+    for (uint i = 0; i < xDistanceColliderCount; i++)
+    {
+        const SDFInstance instance = distanceColliders[i];
+        float3 gradient;
+        const float distance = sdf_sample(instance, mul(float4(pos, 1), instance.worldToLocal).xyz, gradient) * instance.distanceScale;
+        if (distance < nearest)
+        {
+            nearest = distance;
+            direction = mul((float3x3) instance.worldToLocal, gradient);
+        }
+    }
+    const float length2 = dot(direction, direction);
+    normal = length2 > 0 ? direction * rsqrt(length2) : 0;
+    return nearest;
+}
+
+// Hoskins' hash33 (Hash without Sine) of a lattice point: three values in
+// [0, 1).
+float3 hash33(float3 q)
+{
+    float3 p3 = frac(q * float3(0.1031, 0.1030, 0.0973));
+    p3 += dot(p3, p3.yxz + 33.33);
+    return frac((p3.xxy + p3.yxx) * p3.zyx);
+}
+
+// Curl of three value noise potentials at p with analytic gradients, as
+// CurlNoise() in ParticleForceFields.cpp (C++).
+float3 curl_noise(float3 p)
+{
+    const float3 cell = floor(p);
+    const float3 f = p - cell;
+    const float3 u = f * f * f * (f * (f * 6 - 15) + 10);
+    const float3 du = 30 * f * f * (f * (f - 2) + 1);
+
+    const float3 a = hash33(cell);
+    const float3 b = hash33(cell + float3(1, 0, 0));
+    const float3 c = hash33(cell + float3(0, 1, 0));
+    const float3 d = hash33(cell + float3(1, 1, 0));
+    const float3 e = hash33(cell + float3(0, 0, 1));
+    const float3 g = hash33(cell + float3(1, 0, 1));
+    const float3 h = hash33(cell + float3(0, 1, 1));
+    const float3 i = hash33(cell + float3(1, 1, 1));
+
+    // component k of every term belongs to potential k
+    const float3 k1 = b - a;
+    const float3 k2 = c - a;
+    const float3 k3 = e - a;
+    const float3 k4 = a - b - c + d;
+    const float3 k5 = a - c - e + h;
+    const float3 k6 = a - b - e + g;
+    const float3 k7 = b + c + e + i - a - d - g - h;
+    const float3 dx = du.x * (k1 + k4 * u.y + k6 * u.z + k7 * u.y * u.z);
+    const float3 dy = du.y * (k2 + k5 * u.z + k4 * u.x + k7 * u.z * u.x);
+    const float3 dz = du.z * (k3 + k6 * u.x + k5 * u.y + k7 * u.x * u.y);
+    return float3(dy.z - dz.y, dz.x - dx.z, dx.y - dy.x);
+}
+
+// Acceleration the force fields of emitter give a particle at pos (WS), as
+// AccumulateForceFields() in ParticleForceFields.cpp (C++).
+float3 force_field_acceleration(EmitterParams emitter, float3 pos)
+{
+    float3 acceleration = 0;
+    for (uint i = 0; i < emitter.forceFieldCount; i++)
+    {
+        const ForceFieldParams field = forceFields[emitter.forceFieldOffset + i];
+        const float3 offset = pos - field.position;
+        float3 force = field.direction;
+        float distanceSq = dot(offset, offset);
+        if (field.type == FORCE_FIELD_ATTRACTOR)
+        {
+            force = -offset * rsqrt(max(distanceSq, FORCE_FIELD_MIN_DISTANCE_SQ));
+        }
+        else if (field.type == FORCE_FIELD_VORTEX)
+        {
+            const float3 radial = offset - field.direction * dot(offset, field.direction);
+            distanceSq = dot(radial, radial);
+            force = cross(field.direction, radial) * rsqrt(max(distanceSq, FORCE_FIELD_MIN_DISTANCE_SQ));
+        }
+        else if (field.type == FORCE_FIELD_TURBULENCE)
+        {
+            force = curl_noise(pos * field.frequency);
+        }
+        else if (field.type != FORCE_FIELD_WIND)
+        {
+            continue;
+        }
+        
+        // (1 - d / range)^2, 1 everywhere without a range
+        const float fade = saturate(1 - sqrt(distanceSq) * field.rangeRcp);
+        acceleration += force * field.strength * fade * fade;
+    }
+    return acceleration;
+}
+
+[numthreads(THREADCOUNT_SIMULATION, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
     uint aliveCount = counterBuffer.Load(PARTICLECOUNTER_OFFSET_ALIVECOUNT);
     if (DTid.x >= aliveCount)
         return;
     
-    const float dt = delta_time;
+    const float dt = xEmitterFixedTimestep > 0 ? xEmitterFixedTimestep : delta_time;
     
     uint particleIndex = aliveBuffer_CURRENT[DTid.x];
     Particle particle = particleBuffer[particleIndex];
+    const EmitterParams emitter = emitterTable[particle.emitterIndex];
     
     const float lifeLerp = 1 - particle.life / particle.maxLife;
     const float particleSize = lerp(particle.sizeBeginEnd.x, particle.sizeBeginEnd.y, lifeLerp);
     
+    // keep the previous state for render interpolation:
+    particle.positionPrev = particle.position;
+    
+    // SPH forces, from the passes that ran since the emit:
+    if (emitter.sph && particle.life > 0)
+    {
+        particle.velocity += sphForceBuffer[particleIndex].xyz * dt;
+    }
+    
 	// integrate:
-    particle.force += xParticleGravity;
-    particle.velocity += particle.force * dt;
+    particle.velocity += (emitter.gravity + force_field_acceleration(emitter, particle.position)) * dt;
     particle.position += particle.velocity * dt;
     
-    // reset force for next frame:
-    particle.force = 0;
-    
     // drag: 
-    particle.velocity *= xParticleDrag;
+    particle.velocity *= emitter.drag;
    
     if (particle.life > 0)
     {
+        // swept collision with the models: back to where the step crossed
+        // a triangle, bouncing the velocity along its normal
+        float hitT;
+        float3 normal;
+        if (collider_segment(particle.positionPrev, particle.position, hitT, normal))
+        {
+            particle.position = lerp(particle.positionPrev, particle.position, hitT) + normal * BVH_COLLISION_SKIN;
+            const float approach = dot(particle.velocity, normal);
+            if (approach < 0)
+                particle.velocity -= (1 + emitter.restitution) * approach * normal;
+        }
+        
+        // baked distance colliders: out along the normal when closer to a
+        // surface than the skin, bouncing the same way
+        if (xDistanceColliderCount > 0)
+        {
+            const float distance = sdf_distance(particle.position, normal);
+            if (distance < SDF_COLLISION_SKIN)
+            {
+                particle.position += normal * (SDF_COLLISION_SKIN - distance);
+                const float approach = dot(particle.velocity, normal);
+                if (approach < 0)
+                    particle.velocity -= (1 + emitter.restitution) * approach * normal;
+            }
+        }
+        
         // floor collision:
         if (particle.position.y - particleSize < floorHeight)
         {
             particle.position.y = particleSize + floorHeight;
-            particle.velocity.y *= -xEmitterRestitution;
+            particle.velocity.y *= -emitter.restitution;
         }
         
         particle.life -= dt;
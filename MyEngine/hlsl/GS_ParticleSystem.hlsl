@@ -5,6 +5,7 @@ struct VertexOut
     float4 pos : SV_POSITION;
     float size : PARTICLESIZE;
     uint color : PARTICLECOLOR;
+    float rotation : PARTICLEROTATION;
 };
 
 struct GeoOut
@@ -23,21 +24,17 @@ static const float3 BILLBOARD[] =
 	float3(1, 1, 0),
 };
 
-StructuredBuffer<Particle> particles : register(t0);
-
 [maxvertexcount(4)]
 void main(
-	point VertexOut gin[1], uint primID : SV_PrimitiveID,
+	point VertexOut gin[1],
 	inout TriangleStream<GeoOut> triStream)
 {
-    // load particle data:
-    Particle particle = particles[primID];
-    if (particle.life <= 0)
+    // particles are drawn from the draw list, so every point is alive; only
+    // the ones that ran out of life in the last step are fully transparent
+    if ((gin[0].color >> 24u) == 0)
         return;
     
-    // calculate render properties from life:
-    const float lifeLerp = 1 - particle.life / particle.maxLife;
-    float rotation = lifeLerp * particle.rotationalVelocity;
+    float rotation = gin[0].rotation;
     float2x2 rot = float2x2(cos(rotation), -sin(rotation), sin(rotation), cos(rotation));
         
     GeoOut gout;
@@ -3,8 +3,8 @@ static const float PI = 3.14159265358979323846;
 struct Particle
 {
     float3 position;
-    float mass;
-    float3 force;
+    uint emitterIndex; // slot of the emitter in the emitter table
+    float3 positionPrev; // position before the last simulation step
     float rotationalVelocity;
     float3 velocity;
     float maxLife;
@@ -24,37 +24,82 @@ static const uint PARTICLECOUNTER_OFFSET_DEADCOUNT = PARTICLECOUNTER_OFFSET_ALIV
 static const uint PARTICLECOUNTER_OFFSET_REALEMITCOUNT = PARTICLECOUNTER_OFFSET_DEADCOUNT + 4;
 static const uint PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION = PARTICLECOUNTER_OFFSET_REALEMITCOUNT + 4;
 
+// must match ParticleSystemTypes.h
+static const uint THREADCOUNT_EMIT = 256;
+static const uint THREADCOUNT_SIMULATION = 256;
+static const uint THREADCOUNT_SPH_OFFSETS = 1024;
+static const uint SPH_GRID_SIZE = 65536; // buckets of the SPH neighbor grid
+
+static const uint ARGUMENTBUFFER_OFFSET_DISPATCHEMIT = 0;
+static const uint ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION = ARGUMENTBUFFER_OFFSET_DISPATCHEMIT + 12;
+static const uint ARGUMENTBUFFER_OFFSET_DRAWPARTICLES = ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION + 12;
+
 cbuffer cbFrame : register(b0)
 {
     uint frame_count;
     float time;
     float time_previous;
     float delta_time;
+
+    float interpolation; // blend from positionPrev to position when drawing
+    uint3 frame_padding;
 };
 
-cbuffer cbParticleSystem : register(b1)
+// One row of the emitter table, must match EmitterParams in
+// ParticleSystemTypes.h. Emitter i owns emit threads
+// [emitOffset, emitOffset + emitCount) of the batched emit dispatch.
+struct EmitterParams
 {
-    float4x4 xEmitterWorld;
+    float4x4 world;
 
-    uint xEmitCount;
-    uint xEmitterMeshIndexCount;
-    uint xEmitterMeshVertexPositionStride;
-    float xEmitterRandomness;
+    uint emitCount;
+    uint emitOffset;
+    uint meshIndexOffset; // first index in the pooled geometry
+    uint meshVertexOffset; // added to every index of the mesh
 
-    float xParticleSize;
-    float xParticleScaling;
-    float xParticleRotation;
-    uint xParticleColor;
+    uint emissionSetOffset; // first bucket in the pooled emission sets
+    uint emissionSetCount; // 0 emits from the emitter origin
+    uint seed;
+    uint color;
 
-    float xParticleRandomFactor;
-    float xParticleNormalFactor;
-    float xParticleLifeSpan;
-    float xParticleLifeSpanRandomness;
+    float size;
+    float scaling;
+    float rotation;
+    float randomFactor;
 
-    float xParticleMass;
-    float xParticleMotionBlurAmount;
-    float xParticleRandomColorFactor;
+    float normalFactor;
+    float lifeSpan;
+    float lifeSpanRandomness;
+    float randomColorFactor;
+
+    float3 gravity;
+    float restitution;
+
+    float3 velocity;
+    float drag;
+
+    float mass;
+    uint sph; // 1 when the particles are part of the SPH fluid
+    uint forceFieldOffset; // first field in the pooled force fields
+    uint forceFieldCount;
+};
+
+// One bucket of an emitter's emission set, must match EmissionEntry in
+// EmissionSet.h: an alias bucket over the triangles the emitter may emit from.
+struct EmissionEntry
+{
+    float probability;
+    uint triangle; // kept with probability `probability`
+    uint aliasTriangle; // taken otherwise
+    uint padding;
+};
+
+cbuffer cbParticleSystem : register(b1)
+{
+    uint xEmitterCount; // rows in the emitter table
+    uint xEmitTotal; // sum of emitCount over all emitters
     uint xEmitterMaxParticleCount;
+    float xParticleMotionBlurAmount;
 
     uint xEmitterFramesX;
     uint xEmitterFramesY;
@@ -81,12 +126,88 @@ cbuffer cbParticleSystem : register(b1)
     float xEmitterFixedTimestep; // we can force a fixed timestep (>0) onto the
                                 // simulation to avoid blowing up
 
-    float3 xParticleGravity;
-    float xEmitterRestitution;
+    uint xEmitterGrowOffset; // first slot added by the last pool growth
+    uint xEmitterGrowCount; // number of slots to push onto the dead list
+    uint xColliderNodeCount; // nodes of the collider BVH, 0 without one
+    uint xDistanceColliderCount; // baked distance colliders, 0 without any
+};
+
+// Collider BVH over the model triangles, built and refit by MeshBVH (C++);
+// must match BVHNode and BVHTriangle in MeshBVH.h. The children of an inner
+// node are adjacent.
+struct BVHNode
+{
+    float3 boundsMin; // WS
+    uint leftFirst; // first of the two children, or first leaf triangle
+    float3 boundsMax; // WS
+    uint triangleCount; // 0 for inner nodes
+};
+
+struct BVHTriangle
+{
+    float3 v0; // WS
+    float3 v1;
+    float3 v2;
+};
+static const uint BVH_MAX_DEPTH = 32; // deepest leaf
+static const float BVH_COLLISION_SKIN = 1e-3; // left between particle and surface
+
+// Baked distance fields of the models placed in the world, packed by
+// SDFColliderSet (C++); must match SDFInstance and SDFBrick in MeshSDF.h.
+struct SDFInstance
+{
+    float4x4 worldToLocal;
+    float3 volumeMin; // OS
+    float voxelSize; // OS
+    uint3 brickDim; // bricks per axis
+    uint brickOffset; // of the first brick in the packed bricks
+    float distanceScale; // OS to WS distances
+    float band; // OS; the field is clamped to +-band beyond it
+    uint2 padding;
+};
 
-    float3 xParticleVelocity;
-    float xParticleDrag;
+struct SDFBrick
+{
+    uint index; // of the brick's samples, or SDF_NO_SAMPLES
+    float value; // what the whole brick reads when it has no samples
 };
+static const uint SDF_NO_SAMPLES = 0xFFFFFFFF;
+static const uint SDF_BRICK_SIZE = 8; // voxels per brick and axis
+static const float SDF_COLLISION_SKIN = 1e-3; // left between particle and surface
+
+// One pooled force field, must match ForceFieldParams in
+// ParticleSystemTypes.h; the type is a ForceFieldType.
+struct ForceFieldParams
+{
+    float3 position; // WS
+    uint type;
+    float3 direction; // unit length
+    float strength;
+    float rangeRcp; // 0 without falloff
+    float frequency;
+    uint2 padding;
+};
+static const uint FORCE_FIELD_ATTRACTOR = 0;
+static const uint FORCE_FIELD_VORTEX = 1;
+static const uint FORCE_FIELD_WIND = 2;
+static const uint FORCE_FIELD_TURBULENCE = 3;
+static const float FORCE_FIELD_MIN_DISTANCE_SQ = 1e-8; // no direction closer
+
+static const uint SPH_NO_BUCKET = 0xFFFFFFFF; // particle outside the fluid
+
+// Cell of the SPH neighbor grid holding pos, one smoothing radius wide.
+inline int3 sph_cell(float3 pos)
+{
+    return (int3) clamp(floor(pos * xSPH_h_rcp), -1e9, 1e9);
+}
+
+// Bucket of a cell, must match NeighborGrid::GetBucket() (C++) with
+// SPH_GRID_SIZE buckets. Cells along x land in consecutive buckets.
+inline uint sph_bucket(int3 cell)
+{
+    const uint row = ((uint) cell.y * 73856093 ^ (uint) cell.z * 19349663) * 0x9E3779B1;
+    return ((row >> 16) + (uint) cell.x) & (SPH_GRID_SIZE - 1);
+}
 
 cbuffer cbQuadRenderer : register(b2)
 {
@@ -111,6 +232,45 @@ cbuffer cbQuadRenderer : register(b2)
     float distBoxSize; // WS
 };
 
+struct Metaball
+{
+    float3 center;
+    float radius;
+};
+
+struct MetaballCell
+{
+    uint first; // in the entry list
+    uint count;
+};
+
+// Uniform grid over the metaball spheres, built by MetaballGrid (C++).
+cbuffer cbMetaballGrid : register(b3)
+{
+    float3 xGridMin; // WS
+    float xGridCellSize;
+    uint3 xGridDim;
+    float xGridCutoff; // influence radius beyond a sphere's surface
+};
+
+struct MetaballBrick
+{
+    uint index; // of the brick's samples, or METABALL_NO_SAMPLES
+    float value; // what the whole brick reads when it has no samples
+};
+static const uint METABALL_NO_SAMPLES = 0xFFFFFFFF;
+static const uint METABALL_BRICK_SIZE = 8; // voxels per brick and axis
+
+// Sparse distance volume baked from the grid, built by MetaballVolume (C++).
+cbuffer cbMetaballVolume : register(b4)
+{
+    float3 xVolumeMin; // WS
+    float xVoxelSize;
+    uint xBrickDim; // bricks per axis
+    uint xBrickSamples; // (METABALL_BRICK_SIZE + 1)^3
+    uint2 xVolumePadding;
+};
+
 struct Material
 {
     float4 DiffuseAlbedo;
@@ -169,47 +329,73 @@ float3 BlinnPhong(float3 lightStrength, float3 lightVec, float3 normal, float3 t
     return (mat.DiffuseAlbedo.rgb + specAlbedo) * lightStrength;
 }
 
-// Random number generator based on: https://github.com/diharaw/helios/blob/master/src/engine/shader/random.glsl
-struct RNG
+// Philox4x32-10 counter-based random number generator.
+// http://www.thesalmons.org/john/random123/papers/random123sc11.pdf
+// Must match my::RNG in Random.h bit for bit: a stream is keyed by the emitter
+// seed and counted by (slot, frame, block), four words per block.
+static const uint PHILOX_M0 = 0xD2511F53;
+static const uint PHILOX_M1 = 0xCD9E8D57;
+static const uint PHILOX_W0 = 0x9E3779B9;
+static const uint PHILOX_W1 = 0xBB67AE85;
+
+// 32x32 -> 64 bit product from 16 bit halves (no 64 bit integers in SM5).
+void philox_mulhilo(uint a, uint b, out uint hi, out uint lo)
 {
-    uint2 s; // state
+    lo = a * b;
+
+    uint aLo = a & 0xffff;
+    uint aHi = a >> 16;
+    uint bLo = b & 0xffff;
+    uint bHi = b >> 16;
+
+    uint ll = aLo * bLo;
+    uint lh = aLo * bHi;
+    uint hl = aHi * bLo;
+    uint hh = aHi * bHi;
+
+    uint mid = (ll >> 16) + (lh & 0xffff) + (hl & 0xffff);
+    hi = hh + (lh >> 16) + (hl >> 16) + (mid >> 16);
+}
 
-	// xoroshiro64* random number generator.
-	// http://prng.di.unimi.it/xoroshiro64star.c
-    uint rotl(uint x, uint k)
+uint4 philox4x32_10(uint4 c, uint2 k)
+{
+    [unroll]
+    for (uint round = 0; round < 10; round++)
     {
-        return (x << k) | (x >> (32 - k));
+        uint hi0, lo0, hi1, lo1;
+        philox_mulhilo(PHILOX_M0, c.x, hi0, lo0);
+        philox_mulhilo(PHILOX_M1, c.z, hi1, lo1);
+        c = uint4(hi1 ^ c.y ^ k.x, lo1, hi0 ^ c.w ^ k.y, lo0);
+        k += uint2(PHILOX_W0, PHILOX_W1);
     }
-	// Xoroshiro64* RNG
-    uint next()
-    {
-        uint result = s.x * 0x9e3779bb;
+    return c;
+}
 
-        s.y ^= s.x;
-        s.x = rotl(s.x, 26) ^ s.y ^ (s.y << 9);
-        s.y = rotl(s.y, 13);
+struct RNG
+{
+    uint4 counter;
+    uint2 key;
+    uint4 block;
+    uint used;
 
-        return result;
-    }
-	// Thomas Wang 32-bit hash.
-	// http://www.reedbeta.com/blog/quick-and-easy-gpu-random-numbers-in-d3d11/
-    uint hash(uint seed)
+    void init(uint seed, uint slot, uint frameIndex)
     {
-        seed = (seed ^ 61) ^ (seed >> 16);
-        seed *= 9;
-        seed = seed ^ (seed >> 4);
-        seed *= 0x27d4eb2d;
-        seed = seed ^ (seed >> 15);
-        return seed;
+        counter = uint4(slot, frameIndex, 0, 0);
+        key = uint2(seed, 0);
+        block = 0;
+        used = 4;
     }
-
-    void init(uint2 id, uint frameIndex)
+    uint next()
     {
-        uint s0 = (id.x << 16) | id.y;
-        uint s1 = frameIndex;
-        s.x = hash(s0);
-        s.y = hash(s1);
-        next();
+        if (used == 4)
+        {
+            block = philox4x32_10(counter, key);
+            counter.z++;
+            used = 0;
+        }
+        uint result = used == 0 ? block.x : used == 1 ? block.y : used == 2 ? block.z : block.w;
+        used++;
+        return result;
     }
     float next_float()
     {
@@ -221,6 +407,15 @@ struct RNG
         float f = next_float();
         return uint(floor(f * nmax));
     }
+    // Uniform index in [0, nmax) plus a uniform fraction within it, both from
+    // one word: the high and low halves of next() * nmax.
+    uint next_uint_frac(uint nmax, out float frac)
+    {
+        uint hi, lo;
+        philox_mulhilo(next(), nmax, hi, lo);
+        frac = asfloat(0x3f800000 | (lo >> 9)) - 1.0;
+        return hi;
+    }
     float2 next_float2()
     {
         return float2(next_float(), next_float());
@@ -4,122 +4,144 @@
 #define SURF_DIST 1e-5f
 #define SURF_REFINEMENT 5
 
-StructuredBuffer<Particle> particleBuffer : register(t0);
-
-cbuffer cbQuadRenderer : register(b0)
-{
-    PostRenderer quadRenderer;
-}
+// metaball spheres and the grid over them, rebuilt every frame by
+// MetaballGrid (C++); a cell lists the spheres within xGridCutoff of it
+StructuredBuffer<Metaball> metaballs : register(t0);
+StructuredBuffer<uint> metaballColors : register(t1);
+StructuredBuffer<MetaballCell> metaballCells : register(t2);
+StructuredBuffer<uint> metaballEntries : register(t3);
 
 float SphereSDF(float3 pos, float3 center, float radius)
 {
     return length(pos - center) - radius;
 }
 
-float SmoothMax(float a, float b, float k)
+MetaballCell GetCell(float3 pos)
 {
-    return log(exp(k * a) + exp(k * b)) / k;
+    MetaballCell cell = { 0, 0 };
+    int3 coord = (int3) floor((pos - xGridMin) / xGridCellSize);
+    if (all(coord >= 0) && all(coord < (int3) xGridDim))
+        cell = metaballCells[(coord.z * xGridDim.y + coord.y) * xGridDim.x + coord.x];
+    return cell;
 }
 
-float SmoothMin(float a, float b, float k)
-{
-    return -SmoothMax(-a, -b, k);
-}
+#ifdef USE_DISTANCE_VOLUME
+StructuredBuffer<MetaballBrick> volumeBricks : register(t4);
+StructuredBuffer<float> volumeSamples : register(t5);
 
-float SmoothMinN(float values[MAX_PARTICLES], int n, float k)
-{
-    float sum = 0.0f;
-    for (int i = 0; i < n; i++)
-    {
-        sum += exp(-k * values[i]);
-    }
-    return -log(sum) / k;
-}
-
-float GetLifeLerp(int index)
-{
-    return 1 - particleBuffer[index].life / particleBuffer[index].maxLife;
-}
-
-float GetParticleSize(int index)
+// Trilinear sample of the baked volume, a fixed cost per step.
+float GetDist(float3 pos)
 {
-    float lifeLerp = GetLifeLerp(index);
-    return lerp(particleBuffer[index].sizeBeginEnd.x, particleBuffer[index].sizeBeginEnd.y, lifeLerp);
+    const float3 voxel = (pos - xVolumeMin) / xVoxelSize;
+    const int3 brick = (int3) floor(voxel / METABALL_BRICK_SIZE);
+    if (any(brick < 0) || any(brick >= (int) xBrickDim))
+        return xGridCutoff;
+
+    const MetaballBrick entry = volumeBricks[(brick.z * xBrickDim + brick.y) * xBrickDim + brick.x];
+    if (entry.index == METABALL_NO_SAMPLES)
+        return entry.value;
+
+    const float3 local = voxel - brick * METABALL_BRICK_SIZE;
+    const uint3 cell = min((uint3) local, METABALL_BRICK_SIZE - 1);
+    const float3 t = local - cell;
+
+    const uint axis = METABALL_BRICK_SIZE + 1;
+    const uint base = entry.index * xBrickSamples + (cell.z * axis + cell.y) * axis + cell.x;
+    const float x00 = lerp(volumeSamples[base], volumeSamples[base + 1], t.x);
+    const float x10 = lerp(volumeSamples[base + axis], volumeSamples[base + axis + 1], t.x);
+    const float x01 = lerp(volumeSamples[base + axis * axis], volumeSamples[base + axis * axis + 1], t.x);
+    const float x11 = lerp(volumeSamples[base + axis * axis + axis], volumeSamples[base + axis * axis + axis + 1], t.x);
+    return lerp(lerp(x00, x10, t.y), lerp(x01, x11, t.y), t.z);
 }
-
+#else
+// Smooth minimum of the sphere distances over the spheres of pos's cell;
+// the ones left out are too far to matter. Never more than xGridCutoff.
 float GetDist(float3 pos)
 {
-#define USE_SMOOTH_MIN_N
-#ifdef USE_SMOOTH_MIN_N
-    float distances[MAX_PARTICLES];
-    for (int i = 0; i < MAX_PARTICLES; i++)
-    {
-        float3 center = particleBuffer[i].position;
-        float radius = GetParticleSize(i) / 2.0f;
-        distances[i] = SphereSDF(pos, center, radius);
-    }
-    float k = quadRenderer.smoothingCoefficient;
-    return SmoothMinN(distances, MAX_PARTICLES, k);
-#else
-    float3 center = particleBuffer[0].position;
-    float radius = GetParticleSize(0) / 2.0f;
-    float distance = SphereSDF(pos, center, radius);
-    for (int i = 1; i < MAX_PARTICLES; i++)
+    const MetaballCell cell = GetCell(pos);
+    const float k = smoothingCoefficient;
+
+    float sum = 0.0f;
+    for (uint i = 0; i < cell.count; i++)
     {
-        center = particleBuffer[i].position;
-        radius = GetParticleSize(i) / 2.0f;
-        float k = quadRenderer.smoothingCoefficient;
-        distance = SmoothMin(distance, SphereSDF(pos, center, radius), k);
+        const Metaball ball = metaballs[metaballEntries[cell.first + i]];
+        const float distance = SphereSDF(pos, ball.center, ball.radius);
+        if (distance < xGridCutoff)
+            sum += exp(-k * distance);
     }
-    return distance;
-#endif
+    return sum > 0.0f ? min(-log(sum) / k, xGridCutoff) : xGridCutoff;
 }
+#endif
 
-float3 GetNormal(float3 pos)
+struct MetaballSurface
 {
-    float distance = GetDist(pos);
-    float2 epsilon = float2(0.01f, 0.0f);
-    float3 normal = distance - float3(
-        GetDist(pos - epsilon.xyy),
-        GetDist(pos - epsilon.yxy),
-        GetDist(pos - epsilon.yyx));
-    return normalize(normal);
-}
-
-float3 GetColor(float3 pos)
+    float distance;
+    float3 normal;
+    float3 color;
+};
+
+// The field, its normal and its color from one walk over pos's cell, for
+// shading a hit. With w_i = exp(-k * d_i), the gradient of the smooth
+// minimum is sum(w_i * grad(d_i)) / sum(w_i), grad(d_i) being the unit
+// vector from sphere i's center to pos; only its direction matters here.
+// Reads the grid even with USE_DISTANCE_VOLUME, like the color always did.
+MetaballSurface GetSurface(float3 pos)
 {
+    const MetaballCell cell = GetCell(pos);
+    const float k = smoothingCoefficient;
+
+    float sum = 0.0f;
+    float3 gradient = float3(0.0f, 0.0f, 0.0f);
     float3 color = float3(0.0f, 0.0f, 0.0f);
     float weightSum = 0.0f;
-    for (int i = 0; i < MAX_PARTICLES; i++)
+    for (uint i = 0; i < cell.count; i++)
     {
-        float3 center = particleBuffer[i].position;
-        float radius = GetParticleSize(i) / 2.0f;
-        float weight = 1.0f / SphereSDF(pos, center, radius);
-        color += unpack_rgba(particleBuffer[i].color).rgb * weight;
+        const uint index = metaballEntries[cell.first + i];
+        const Metaball ball = metaballs[index];
+        const float3 offset = pos - ball.center;
+        const float len = length(offset);
+        const float distance = len - ball.radius;
+
+        const float weight = 1.0f / distance;
+        color += unpack_rgba(metaballColors[index]).rgb * weight;
         weightSum += weight;
+
+        if (distance < xGridCutoff)
+        {
+            const float w = exp(-k * distance);
+            sum += w;
+            if (len > 0.0f)
+                gradient += w * offset / len;
+        }
     }
-    color /= weightSum;
-    return color;
+
+    MetaballSurface surface;
+    surface.distance = sum > 0.0f ? min(-log(sum) / k, xGridCutoff) : xGridCutoff;
+    surface.normal = any(gradient != 0.0f) ? normalize(gradient) : gradient;
+    surface.color = weightSum != 0.0f ? color / weightSum : color;
+    return surface;
 }
 
 float3 GetLight(float3 pos)
 {
-    float3 toEye = normalize(quadRenderer.posCam - pos);
+    float3 toEye = normalize(posCam - pos);
+
+    float3 lightRGB = unpack_rgba(lightColor).rgb;
 
-    float3 lightColor = unpack_rgba(quadRenderer.lightColor).rgb;
+    const MetaballSurface surface = GetSurface(pos);
 
-    float4 diffuseAlbedo = float4(GetColor(pos), 1.0f);
+    float4 diffuseAlbedo = float4(surface.color, 1.0f);
     const float3 fresnelR0 = float3(0.05f, 0.05f, 0.05f);
     const float shininess = 0.8f;
     Material mat = { diffuseAlbedo, fresnelR0, shininess };
 
-    float3 normal = GetNormal(pos);
+    float3 normal = surface.normal;
             
-    float3 lightVec = normalize(quadRenderer.posLight - pos);
+    float3 lightVec = normalize(posLight - pos);
 
     // Scale light down by Lambert's cosine law.
     float ndotl = max(dot(lightVec, normal), 0.0f);
-    float3 lightStrength = lightColor * quadRenderer.lightIntensity * ndotl;
+    float3 lightStrength = lightRGB * lightIntensity * ndotl;
             
     return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
 }
@@ -129,8 +151,8 @@ float4 PS_RayMARCH(float4 position : SV_POSITION) : SV_Target
     float x = position.x;
     float y = position.y;
 
-    float width = quadRenderer.rtSize.x;
-    float height = quadRenderer.rtSize.y;
+    float width = rtSize.x;
+    float height = rtSize.y;
     
     float4 posP;
     posP.x = +2.0f * x / width - 1.0f;
@@ -138,12 +160,12 @@ float4 PS_RayMARCH(float4 position : SV_POSITION) : SV_Target
     posP.z = 0.0f;
     posP.w = 1.0f;
 
-    float3 rayOrigin = quadRenderer.posCam;
-    float3 rayDir = normalize(mul(posP, quadRenderer.matPS2WS).xyz - rayOrigin);
+    float3 rayOrigin = posCam;
+    float3 rayDir = normalize(mul(posP, matPS2WS).xyz - rayOrigin);
 
     float2 hits = ComputeAABBHits(
-        rayOrigin, quadRenderer.distBoxCenter - quadRenderer.distBoxSize,
-        quadRenderer.distBoxCenter + quadRenderer.distBoxSize, rayDir);
+        rayOrigin, distBoxCenter - distBoxSize,
+        distBoxCenter + distBoxSize, rayDir);
     
     if (hits.x > hits.y)
     {
@@ -5,6 +5,7 @@ struct VertexOut
     float4 pos : SV_POSITION;
     float size : PARTICLESIZE;
     uint color : PARTICLECOLOR;
+    float rotation : PARTICLEROTATION;
 };
 
 StructuredBuffer<Particle> particles : register(t0);
@@ -12,7 +13,8 @@ StructuredBuffer<uint> aliveList : register(t1);
 
 VertexOut main(uint vertexID : SV_VertexID)
 {
-    uint particleIndex = vertexID;
+    // the draw list only holds alive particles, one vertex each:
+    uint particleIndex = aliveList[vertexID];
     
     // load particle data:
     Particle particle = particles[particleIndex];
@@ -26,8 +28,9 @@ VertexOut main(uint vertexID : SV_VertexID)
     particleColor.a *= opacity;
     
     VertexOut vout;
-    vout.pos = float4(particle.position, 1);
+    vout.pos = float4(lerp(particle.positionPrev, particle.position, interpolation), 1);
     vout.size = size;
     vout.color = pack_rgba(particleColor);
+    vout.rotation = lifeLerp * particle.rotationalVelocity;
     return vout;
 }
\ No newline at end of file
@@ -224,7 +224,10 @@ int main(int, char**) {
 
       ImGui::Begin("MyEngine Settings");
 
-      if (ImGui::CollapsingHeader("Emitter")) {
+      if (ImGui::CollapsingHeader("Particle World")) {
+        static const uint32_t kMinSubsteps = 1;
+        static const uint32_t kMaxSubsteps = 16;
+
         auto data = my::ParticleSystem::GetStatistics();
 
         std::string ss;
@@ -232,63 +235,167 @@ int main(int, char**) {
             "Alive Particle Count = " + std::to_string(data.aliveCount) + "\n";
         ss += "Dead Particle Count = " + std::to_string(data.deadCount) + "\n";
         ss += "GPU Emit count = " + std::to_string(data.realEmitCount) + "\n";
+        ss += "Captured at step " +
+              std::to_string(my::ParticleSystem::GetStatisticsFrame()) + "\n";
+
+        auto bindings = my::ParticleSystem::GetStateCacheCounters();
+        ss += "Bindings passed on = " +
+              std::to_string(bindings.forwardedBindings) + "\n";
+        ss += "Redundant bindings skipped = " +
+              std::to_string(bindings.redundantBindings) + "\n";
+        ss += "Hazard unbinds = " + std::to_string(bindings.hazardUnbinds) +
+              "\n";
+        ss += "Barriers skipped = " +
+              std::to_string(bindings.skippedBarriers) + "\n";
+        ss += "Device calls avoided = " +
+              std::to_string(bindings.GetAvoidedCalls()) + "\n";
+
+        auto uploads = my::GetConstantBufferStats();
+        ss += "Constant bytes uploaded = " +
+              std::to_string(uploads.uploadedBytes) + "\n";
+        ss += "Constant bytes skipped = " +
+              std::to_string(uploads.skippedBytes) + "\n";
 
         ImGui::Text(ss.c_str());
 
-        auto emitter = my::ParticleSystem::GetParticleEmitter();
-
-        static char meshName[256] = "";
-        ImGui::InputText("Mesh", meshName, IM_ARRAYSIZE(meshName));
-        emitter->meshName = meshName;
-
-        ImGui::SeparatorText("Transform");
-
-        Vector3 s;
-        Quaternion r;
-        Vector3 t;
-        emitter->transform.Decompose(s, r, t);
-
-        float translation[3] = {t.x, t.y, t.z};
-        ImGui::InputFloat3("Translation", translation);
-
-        Vector3 euler = r.ToEuler();
-        euler *= 180.0f / XM_PI;
-        float rotation[3] = {euler.x, euler.y, euler.z};
-        ImGui::InputFloat3("Rotation", rotation);
-
-        float scale[3] = {s.x, s.y, s.z};
-        ImGui::InputFloat3("Scale", scale);
-
-        emitter->transform = Matrix::CreateScale(scale[0], scale[1], scale[2]);
-        emitter->transform *= Matrix::CreateFromYawPitchRoll(
-            rotation[1] * XM_PI / 180.0f, rotation[0] * XM_PI / 180.0f,
-            rotation[2] * XM_PI / 180.0f);
-        emitter->transform *= Matrix::CreateTranslation(
-            translation[0], translation[1], translation[2]);
-
-        ImGui::Separator();
-
-        ImVec4 color = ImGui::ColorConvertU32ToFloat4(emitter->color);
-        ImGui::ColorEdit3("Color", (float*)&color);
-        emitter->color = ImGui::ColorConvertFloat4ToU32(color);
-
-        ImGui::SliderFloat("Emit", &emitter->count, 0, 10000);
-        ImGui::SliderFloat("Size", &emitter->size, 0.01f, 10.0f);
-        ImGui::SliderFloat("Rotation", &emitter->rotation, 0.0f, 1.0f);
-        ImGui::SliderFloat("Normal factor", &emitter->normal_factor, 0.0f,
-                           100.0f);
-        ImGui::SliderFloat("Scaling", &emitter->scale, 0.0f, 100.0f);
-        ImGui::SliderFloat("Life span", &emitter->life, 0.0f, 100.0f);
-        ImGui::SliderFloat("Life randomness", &emitter->random_life, 0.0f,
-                           2.0f);
-        ImGui::SliderFloat("Randomness", &emitter->random_factor, 0.0f, 1.0f);
-        ImGui::SliderFloat("Color randomness", &emitter->random_color, 0.0f,
-                           2.0f);
-        ImGui::SliderFloat("Mass", &emitter->mass, 0.1f, 100.0f);
-        ImGui::SliderFloat("Drag", &emitter->drag, 0.0f, 1.0f);
-        ImGui::SliderFloat("Restitution", &emitter->restitution, 0.0f, 1.0f);
-        ImGui::InputFloat3("Velocity", emitter->velocity);
-        ImGui::InputFloat3("Gravity", emitter->gravity);
+        auto settings = my::ParticleSystem::GetWorldSettings();
+
+        ImGui::InputScalar("Max particles", ImGuiDataType_U32,
+                           &settings->max_particles);
+        ImGui::SliderFloat("Fixed timestep", &settings->fixed_timestep,
+                           1.0f / 240.0f, 1.0f / 15.0f, "%.4f s");
+        ImGui::SliderScalar("Max substeps", ImGuiDataType_U32,
+                            &settings->max_substeps, &kMinSubsteps,
+                            &kMaxSubsteps);
+
+        ImGui::SeparatorText("SPH fluid");
+        ImGui::SliderFloat("Smoothing radius", &settings->sph_h, 0.1f, 10.0f);
+        ImGui::SliderFloat("Pressure stiffness", &settings->sph_K, 0.0f,
+                           1000.0f);
+        ImGui::SliderFloat("Rest density", &settings->sph_p0, 0.0f, 10.0f);
+        ImGui::SliderFloat("Viscosity", &settings->sph_e, 0.0f, 1.0f);
+      }
+
+      if (ImGui::CollapsingHeader("Emitter")) {
+        static my::EmitterID selected = my::INVALID_EMITTER;
+
+        if (ImGui::Button("Add"))
+          selected = my::ParticleSystem::CreateEmitter();
+        ImGui::SameLine();
+        if (ImGui::Button("Remove")) {
+          my::ParticleSystem::DestroyEmitter(selected);
+          selected = my::INVALID_EMITTER;
+        }
+
+        const uint32_t emitterCount = my::ParticleSystem::GetEmitterCount();
+        for (uint32_t i = 0; i < emitterCount; i++) {
+          const my::EmitterID id = my::ParticleSystem::GetEmitterAt(i);
+          const std::string label = "Emitter " + std::to_string(id);
+          if (ImGui::Selectable(label.c_str(), selected == id)) selected = id;
+        }
+
+        if (my::ParticleSystem::GetEmitter(selected) == nullptr)
+          selected = my::ParticleSystem::GetEmitterAt(0);
+
+        auto emitter = my::ParticleSystem::GetEmitter(selected);
+        if (emitter != nullptr) {
+          ImGui::Separator();
+
+          // the text field edits a copy, reloaded when the selection changes
+          static char meshName[256] = "";
+          static my::EmitterID meshNameOwner = my::INVALID_EMITTER;
+          if (meshNameOwner != selected) {
+            strncpy_s(meshName, emitter->meshName.c_str(), _TRUNCATE);
+            meshNameOwner = selected;
+          }
+          ImGui::InputText("Mesh", meshName, IM_ARRAYSIZE(meshName));
+          emitter->meshName = meshName;
+
+          ImGui::SeparatorText("Transform");
+
+          Vector3 s;
+          Quaternion r;
+          Vector3 t;
+          emitter->transform.Decompose(s, r, t);
+
+          float translation[3] = {t.x, t.y, t.z};
+          bool transformChanged =
+              ImGui::InputFloat3("Translation", translation);
+
+          Vector3 euler = r.ToEuler();
+          euler *= 180.0f / XM_PI;
+          float rotation[3] = {euler.x, euler.y, euler.z};
+          transformChanged |= ImGui::InputFloat3("Rotation", rotation);
+
+          float scale[3] = {s.x, s.y, s.z};
+          transformChanged |= ImGui::InputFloat3("Scale", scale);
+
+          // only recompose on edits: a decompose/recompose round trip drifts,
+          // and every transform change rebuilds the emitter's emission set
+          if (transformChanged) {
+            emitter->transform =
+                Matrix::CreateScale(scale[0], scale[1], scale[2]);
+            emitter->transform *= Matrix::CreateFromYawPitchRoll(
+                rotation[1] * XM_PI / 180.0f, rotation[0] * XM_PI / 180.0f,
+                rotation[2] * XM_PI / 180.0f);
+            emitter->transform *= Matrix::CreateTranslation(
+                translation[0], translation[1], translation[2]);
+          }
+
+          ImGui::Separator();
+
+          ImVec4 color = ImGui::ColorConvertU32ToFloat4(emitter->color);
+          ImGui::ColorEdit3("Color", (float*)&color);
+          emitter->color = ImGui::ColorConvertFloat4ToU32(color);
+
+          ImGui::SliderFloat("Emit", &emitter->count, 0, 10000);
+          ImGui::InputScalar("Seed", ImGuiDataType_U32, &emitter->seed);
+          ImGui::SliderFloat("Size", &emitter->size, 0.01f, 10.0f);
+          ImGui::SliderFloat("Rotation", &emitter->rotation, 0.0f, 1.0f);
+          ImGui::SliderFloat("Normal factor", &emitter->normal_factor, 0.0f,
+                             100.0f);
+          ImGui::SliderFloat("Scaling", &emitter->scale, 0.0f, 100.0f);
+          ImGui::SliderFloat("Life span", &emitter->life, 0.0f, 100.0f);
+          ImGui::SliderFloat("Life randomness", &emitter->random_life, 0.0f,
+                             2.0f);
+          ImGui::SliderFloat("Randomness", &emitter->random_factor, 0.0f,
+                             1.0f);
+          ImGui::SliderFloat("Color randomness", &emitter->random_color, 0.0f,
+                             2.0f);
+          ImGui::SliderFloat("Mass", &emitter->mass, 0.1f, 100.0f);
+          ImGui::SliderFloat("Drag", &emitter->drag, 0.0f, 1.0f);
+          ImGui::SliderFloat("Restitution", &emitter->restitution, 0.0f,
+                             1.0f);
+          ImGui::InputFloat3("Velocity", emitter->velocity);
+          ImGui::InputFloat3("Gravity", emitter->gravity);
+          ImGui::Checkbox("SPH fluid", &emitter->sph);
+
+          ImGui::SeparatorText("Force fields");
+          if (ImGui::Button("Add field")) emitter->force_fields.emplace_back();
+          const char* fieldTypes[] = {"Attractor", "Vortex", "Wind",
+                                      "Turbulence"};
+          for (size_t f = 0; f < emitter->force_fields.size(); f++) {
+            ParticleForceField& field = emitter->force_fields[f];
+            ImGui::PushID(static_cast<int>(f));
+            ImGui::Separator();
+            int type = static_cast<int>(field.type);
+            if (ImGui::Combo("Type", &type, fieldTypes,
+                             IM_ARRAYSIZE(fieldTypes)))
+              field.type = static_cast<ForceFieldType>(type);
+            ImGui::InputFloat3("Position", field.position);
+            ImGui::InputFloat3("Direction", field.direction);
+            ImGui::SliderFloat("Strength", &field.strength, -50.0f, 50.0f);
+            ImGui::SliderFloat("Range", &field.range, 0.0f, 100.0f);
+            if (field.type == ForceFieldType::Turbulence)
+              ImGui::SliderFloat("Frequency", &field.frequency, 0.01f, 10.0f);
+            const bool remove = ImGui::Button("Remove field");
+            ImGui::PopID();
+            if (remove) {
+              emitter->force_fields.erase(emitter->force_fields.begin() + f);
+              break;
+            }
+          }
+        }
       }
 
       if (ImGui::CollapsingHeader("Scene")) {
@@ -322,6 +429,30 @@ int main(int, char**) {
         if (ImGui::Checkbox("Wireframe", &isWireframe)) {
           my::SetWireframe(isWireframe);
         }
+
+        bool distanceCollision = my::IsDistanceCollision();
+        if (ImGui::Checkbox("Distance field collision", &distanceCollision)) {
+          my::SetDistanceCollision(distanceCollision);
+        }
+
+        if (ImGui::Button("CPU Simulate Benchmark")) {
+          my::RunSimulateBenchmark(1000000, 64);
+        }
+        if (ImGui::Button("CPU SPH Benchmark")) {
+          my::RunFluidBenchmark(100000, 64);
+        }
+        if (ImGui::Button("Neighbor Grid Benchmark")) {
+          my::RunNeighborGridBenchmark(10000, 10000000);
+        }
+        if (ImGui::Button("Mesh BVH Benchmark")) {
+          my::RunMeshBVHBenchmark(100000, 1000000);
+        }
+        if (ImGui::Button("Mesh SDF Benchmark")) {
+          my::RunMeshSDFBenchmark(100000, 1000000);
+        }
+        if (ImGui::Button("Force Field Benchmark")) {
+          my::RunForceFieldBenchmark(1000000);
+        }
       }
 
       ImGui::End();